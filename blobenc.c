@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "blobenc.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#include <immintrin.h>
+#define BLOBENC_X86 1
+#endif
+
+static const char hex_digits[] = "0123456789ABCDEF";
+static const char b64_digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static size_t (*hex_encode)( char *, const unsigned char *, size_t ) = NULL;
+static const char *hex_encode_name = "scalar";
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-104811
+  Function Name	: blobenc_hex_scalar
+  Returns Type	: size_t
+  ----Parameter List
+  1. char *dst,
+  2.  const unsigned char *src,
+  3.  size_t l ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Upper case hex, two output bytes per input byte, no terminator.
+Returns the number of bytes written to dst.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+size_t blobenc_hex_scalar( char *dst, const unsigned char *src, size_t l ) {
+	size_t i;
+
+	for (i = 0; i < l; i++) {
+		dst[i *2] = hex_digits[src[i] >> 4];
+		dst[i *2 +1] = hex_digits[src[i] & 0x0F];
+	}
+
+	return l *2;
+}
+
+#ifdef BLOBENC_X86
+/**
+ * Splits each byte in to its two nibbles, interleaves them hi/lo and
+ * then uses the nibbles as pshufb indices in to the digit table.
+ */
+__attribute__((target("ssse3")))
+static size_t hex_ssse3( char *dst, const unsigned char *src, size_t l ) {
+	const __m128i digits = _mm_loadu_si128((const __m128i *)hex_digits);
+	const __m128i low_mask = _mm_set1_epi8(0x0F);
+	size_t i = 0;
+
+	while (i +16 <= l) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src +i));
+		__m128i hi = _mm_and_si128( _mm_srli_epi16(v, 4), low_mask );
+		__m128i lo = _mm_and_si128( v, low_mask );
+
+		_mm_storeu_si128((__m128i *)(dst +i *2), _mm_shuffle_epi8( digits, _mm_unpacklo_epi8(hi, lo) ));
+		_mm_storeu_si128((__m128i *)(dst +i *2 +16), _mm_shuffle_epi8( digits, _mm_unpackhi_epi8(hi, lo) ));
+		i += 16;
+	}
+
+	blobenc_hex_scalar( dst +i *2, src +i, l -i );
+
+	return l *2;
+}
+
+__attribute__((target("avx2")))
+static size_t hex_avx2( char *dst, const unsigned char *src, size_t l ) {
+	const __m256i digits = _mm256_broadcastsi128_si256( _mm_loadu_si128((const __m128i *)hex_digits) );
+	const __m256i low_mask = _mm256_set1_epi8(0x0F);
+	size_t i = 0;
+
+	while (i +32 <= l) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(src +i));
+		__m256i hi = _mm256_and_si256( _mm256_srli_epi16(v, 4), low_mask );
+		__m256i lo = _mm256_and_si256( v, low_mask );
+		__m256i a = _mm256_shuffle_epi8( digits, _mm256_unpacklo_epi8(hi, lo) );
+		__m256i b = _mm256_shuffle_epi8( digits, _mm256_unpackhi_epi8(hi, lo) );
+
+		/* unpack works per 128 bit lane, so put the lanes back in byte order */
+		_mm256_storeu_si256((__m256i *)(dst +i *2), _mm256_permute2x128_si256(a, b, 0x20));
+		_mm256_storeu_si256((__m256i *)(dst +i *2 +32), _mm256_permute2x128_si256(a, b, 0x31));
+		i += 32;
+	}
+
+	hex_ssse3( dst +i *2, src +i, l -i );
+
+	return l *2;
+}
+#endif
+
+
+
+
+static void hex_encode_select( void ) {
+
+	hex_encode = blobenc_hex_scalar;
+	hex_encode_name = "scalar";
+
+#ifdef BLOBENC_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("ssse3")) {
+		hex_encode = hex_ssse3;
+		hex_encode_name = "ssse3";
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		hex_encode = hex_avx2;
+		hex_encode_name = "avx2";
+	}
+#endif
+}
+
+
+
+
+const char *blobenc_kernel_name( void ) {
+	if (!hex_encode) hex_encode_select();
+	return hex_encode_name;
+}
+
+
+
+
+size_t blobenc_hex( char *dst, const unsigned char *src, size_t l ) {
+	if (!hex_encode) hex_encode_select();
+	return hex_encode( dst, src, l );
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-105027
+  Function Name	: blobenc_base64
+  Returns Type	: size_t
+  ----Parameter List
+  1. char *dst,
+  2.  const unsigned char *src,
+  3.  size_t l ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Standard ( RFC 4648 ) base64 with '=' padding.  dst needs room for
+BLOBENC_BASE64_LENGTH(l) bytes.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+size_t blobenc_base64( char *dst, const unsigned char *src, size_t l ) {
+	char *d = dst;
+
+	while (l >= 3) {
+		uint32_t n = (src[0] << 16) | (src[1] << 8) | src[2];
+
+		d[0] = b64_digits[(n >> 18) & 0x3F];
+		d[1] = b64_digits[(n >> 12) & 0x3F];
+		d[2] = b64_digits[(n >> 6) & 0x3F];
+		d[3] = b64_digits[n & 0x3F];
+		d += 4;
+		src += 3;
+		l -= 3;
+	}
+
+	if (l > 0) {
+		uint32_t n = src[0] << 16;
+
+		if (l == 2) n |= src[1] << 8;
+		d[0] = b64_digits[(n >> 18) & 0x3F];
+		d[1] = b64_digits[(n >> 12) & 0x3F];
+		d[2] = (l == 2) ? b64_digits[(n >> 6) & 0x3F] : '=';
+		d[3] = '=';
+		d += 4;
+	}
+
+	return d -dst;
+}
@@ -0,0 +1,17 @@
+#ifndef UNDARK_BLOBENC_H
+#define UNDARK_BLOBENC_H
+
+#include <stddef.h>
+
+#define BLOB_ENCODING_HEX 0
+#define BLOB_ENCODING_BASE64 1
+
+#define BLOBENC_HEX_LENGTH(l) ((l) *2)
+#define BLOBENC_BASE64_LENGTH(l) ((((l) +2) /3) *4)
+
+size_t blobenc_hex( char *dst, const unsigned char *src, size_t l );
+size_t blobenc_hex_scalar( char *dst, const unsigned char *src, size_t l );
+size_t blobenc_base64( char *dst, const unsigned char *src, size_t l );
+const char *blobenc_kernel_name( void );
+
+#endif
@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/resource.h>
+#else
+#include <mman.h>
+#endif
+
+#include "iopolicy.h"
+
+struct io_policy_name {
+	const char *name;
+	int flag;
+};
+
+static struct io_policy_name io_policy_names[] = {
+	{ "sequential", IO_POLICY_SEQUENTIAL },
+	{ "willneed", IO_POLICY_WILLNEED },
+	{ "prefetch-overflow", IO_POLICY_PREFETCH_OVERFLOW },
+	{ "populate", IO_POLICY_POPULATE },
+	{ "hugepages", IO_POLICY_HUGEPAGES },
+	{ "dontneed", IO_POLICY_DONTNEED },
+	{ NULL, 0 }
+};
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-114210
+  Function Name	: io_policy_init
+  Returns Type	: int
+  ----Parameter List
+  1. struct io_policy *io ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int io_policy_init( struct io_policy *io ) {
+	long ps;
+
+	memset(io, 0, sizeof(struct io_policy));
+	io->window = IO_POLICY_WINDOW_DEFAULT;
+
+	ps = sysconf(_SC_PAGESIZE);
+	io->page_size = (ps > 0) ? ps : 4096;
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-114233
+  Function Name	: io_policy_parse
+  Returns Type	: int
+  ----Parameter List
+  1. struct io_policy *io,
+  2.  const char *list ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Comma separated list of policy names, "none" clears them all.
+Returns 1 on an unknown name.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int io_policy_parse( struct io_policy *io, const char *list ) {
+	const char *p = list;
+
+	while (*p) {
+		struct io_policy_name *n;
+		size_t l;
+
+		l = strcspn(p, ",");
+		if ((l == 4) && (strncmp(p, "none", 4) == 0)) {
+			io->flags = 0;
+		} else {
+			for (n = io_policy_names; n->name; n++) {
+				if ((strlen(n->name) == l) && (strncmp(p, n->name, l) == 0)) break;
+			}
+			if (!n->name) return 1;
+			io->flags |= n->flag;
+		}
+
+		p += l;
+		if (*p == ',') p++;
+	}
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-114312
+  Function Name	: advise
+  Returns Type	: int
+  ----Parameter List
+  1. struct io_policy *io,
+  2.  size_t offset,
+  3.  size_t l,
+  4.  int advice ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+madvise() a range of the image, widened out to system page
+boundaries and clipped to the image.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int advise( struct io_policy *io, size_t offset, size_t l, int advice ) {
+	size_t start, end;
+
+	if (offset >= io->size) return 0;
+	if (offset +l > io->size) l = io->size -offset;
+
+	start = offset & ~(io->page_size -1);
+	end = offset +l;
+	if (end <= start) return 0;
+
+#ifndef _WIN32
+	if (madvise( io->origin +start, end -start, advice ) != 0) {
+		io->advice_failures++;
+		return 1;
+	}
+#endif
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-114405
+  Function Name	: *io_policy_map
+  Returns Type	: char
+  ----Parameter List
+  1. struct io_policy *io,
+  2.  int fd,
+  3.  size_t size ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Maps the image according to the policy.  Normally a private read
+only file mapping, optionally pre-faulted ( populate ).  With
+hugepages the image is read in to an anonymous mapping marked
+MADV_HUGEPAGE instead, file mappings can't portably use them.
+
+Returns NULL on failure.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+char *io_policy_map( struct io_policy *io, int fd, size_t size ) {
+	void *m;
+	int mflags = MAP_PRIVATE;
+
+	io->size = size;
+
+#if !defined(_WIN32) && defined(MADV_HUGEPAGE)
+	if (io->flags & IO_POLICY_HUGEPAGES) {
+		size_t done = 0;
+
+		m = mmap( NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0 );
+		if (m == MAP_FAILED) return NULL;
+		if (madvise( m, size, MADV_HUGEPAGE ) != 0) io->advice_failures++;
+
+		while (done < size) {
+			ssize_t r = pread( fd, (char *)m +done, size -done, done );
+			if (r < 0) {
+				if (errno == EINTR) continue;
+				munmap( m, size );
+				return NULL;
+			}
+			if (r == 0) break;
+			done += r;
+		}
+
+		io->origin = m;
+		io->anonymous = 1;
+		io->flags &= ~IO_POLICY_DONTNEED; // would throw away the only copy
+		return io->origin;
+	}
+#endif
+
+#ifdef MAP_POPULATE
+	if (io->flags & IO_POLICY_POPULATE) mflags |= MAP_POPULATE;
+#endif
+
+	m = mmap( NULL, size, PROT_READ, mflags, fd, 0 );
+	if (m == MAP_FAILED) return NULL;
+	io->origin = m;
+
+#ifdef MADV_SEQUENTIAL
+	if (io->flags & IO_POLICY_SEQUENTIAL) advise( io, 0, size, MADV_SEQUENTIAL );
+#endif
+
+	return io->origin;
+}
+
+
+
+
+int io_policy_unmap( struct io_policy *io ) {
+	if (io->origin) munmap( io->origin, io->size );
+	io->origin = NULL;
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-114522
+  Function Name	: io_policy_scan_front
+  Returns Type	: int
+  ----Parameter List
+  1. struct io_policy *io,
+  2.  size_t offset ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Called as the page scan moves forward.  Keeps a WILLNEED window
+ahead of offset ( issued a half window at a time so we aren't
+making a syscall per page ) and drops what's a window behind.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int io_policy_scan_front( struct io_policy *io, size_t offset ) {
+
+#ifdef MADV_WILLNEED
+	if ((io->flags & IO_POLICY_WILLNEED) && (offset +io->window /2 >= io->advised_to) && (io->advised_to < io->size)) {
+		size_t from = (io->advised_to > offset) ? io->advised_to : offset;
+		size_t to = offset +io->window;
+
+		if (to > io->size) to = io->size;
+		advise( io, from, to -from, MADV_WILLNEED );
+		io->willneed_calls++;
+		io->willneed_bytes += to -from;
+		io->advised_to = to;
+	}
+#endif
+
+#ifdef MADV_DONTNEED
+	if ((io->flags & IO_POLICY_DONTNEED) && (offset > io->window) && (offset -io->window >= io->released_to +io->window /2)) {
+		size_t to = (offset -io->window) & ~(io->page_size -1);
+
+		if (to > io->released_to) {
+			advise( io, io->released_to, to -io->released_to, MADV_DONTNEED );
+			io->dontneed_calls++;
+			io->dontneed_bytes += to -io->released_to;
+			io->released_to = to;
+		}
+	}
+#endif
+
+	return 0;
+}
+
+
+
+
+int io_policy_prefetch( struct io_policy *io, char *p, size_t l ) {
+
+	if (!(io->flags & IO_POLICY_PREFETCH_OVERFLOW)) return 0;
+	if ((p < io->origin) || (p >= io->origin +io->size)) return 0;
+
+#ifdef MADV_WILLNEED
+	advise( io, p -io->origin, l, MADV_WILLNEED );
+#endif
+	io->prefetch_calls++;
+	io->prefetch_bytes += l;
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-114701
+  Function Name	: io_policy_stats
+  Returns Type	: int
+  ----Parameter List
+  1. struct io_policy *io,
+  2.  FILE *f ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int io_policy_stats( struct io_policy *io, FILE *f ) {
+	struct io_policy_name *n;
+
+	fprintf(f,"io-policy:");
+	if (io->flags == 0) fprintf(f," none");
+	for (n = io_policy_names; n->name; n++) {
+		if (io->flags & n->flag) fprintf(f," %s", n->name);
+	}
+	fprintf(f,"%s\n", io->anonymous ? " (anonymous copy)" : "");
+
+	fprintf(f,"io-willneed: %llu calls, %llu bytes\n", (unsigned long long)io->willneed_calls, (unsigned long long)io->willneed_bytes);
+	fprintf(f,"io-prefetch-overflow: %llu calls, %llu bytes\n", (unsigned long long)io->prefetch_calls, (unsigned long long)io->prefetch_bytes);
+	fprintf(f,"io-dontneed: %llu calls, %llu bytes\n", (unsigned long long)io->dontneed_calls, (unsigned long long)io->dontneed_bytes);
+	fprintf(f,"io-advice-failures: %llu\n", (unsigned long long)io->advice_failures);
+
+#ifndef _WIN32
+	{
+		struct rusage ru;
+
+		if (getrusage( RUSAGE_SELF, &ru ) == 0) {
+			fprintf(f,"io-page-faults: %ld minor, %ld major\n", ru.ru_minflt, ru.ru_majflt);
+		}
+	}
+#endif
+
+	return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef UNDARK_IOPOLICY_H
+#define UNDARK_IOPOLICY_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define IO_POLICY_SEQUENTIAL 0x01 // MADV_SEQUENTIAL over the whole image
+#define IO_POLICY_WILLNEED 0x02 // MADV_WILLNEED a window ahead of the scan front
+#define IO_POLICY_PREFETCH_OVERFLOW 0x04 // MADV_WILLNEED overflow chains before assembling them
+#define IO_POLICY_POPULATE 0x08 // MAP_POPULATE, fault the whole image in up front
+#define IO_POLICY_HUGEPAGES 0x10 // copy the image in to anonymous, huge page backed memory
+#define IO_POLICY_DONTNEED 0x20 // MADV_DONTNEED pages that have fallen behind the scan front
+
+#define IO_POLICY_WINDOW_DEFAULT (4 *1024 *1024)
+
+struct io_policy {
+	int flags;
+	size_t window; // how far ahead/behind the scan front we advise
+	size_t page_size; // system page size, advice has to be aligned to it
+
+	char *origin;
+	size_t size;
+	int anonymous; // image lives in anonymous memory rather than a file mapping
+
+	size_t advised_to; // WILLNEED issued up to here
+	size_t released_to; // DONTNEED issued up to here
+
+	uint64_t willneed_calls, willneed_bytes;
+	uint64_t prefetch_calls, prefetch_bytes;
+	uint64_t dontneed_calls, dontneed_bytes;
+	uint64_t advice_failures;
+};
+
+int io_policy_init( struct io_policy *io );
+int io_policy_parse( struct io_policy *io, const char *list );
+char *io_policy_map( struct io_policy *io, int fd, size_t size );
+int io_policy_unmap( struct io_policy *io );
+int io_policy_scan_front( struct io_policy *io, size_t offset );
+int io_policy_prefetch( struct io_policy *io, char *p, size_t l );
+int io_policy_stats( struct io_policy *io, FILE *f );
+
+#endif
@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "kwsearch.h"
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-134105
+  Function Name	: kwsearch_init
+  Returns Type	: int
+  ----Parameter List
+  1. struct kwsearch *k ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int kwsearch_init( struct kwsearch *k ) {
+	memset(k, 0, sizeof(struct kwsearch));
+	k->min_length = SIZE_MAX;
+
+	return 0;
+}
+
+
+
+
+/**
+ * Adds a state with no transitions, returns its number or -1 if
+ * we're out of memory.
+ */
+static int32_t new_state( struct kwsearch *k ) {
+	int32_t s;
+
+	if (k->states == k->allocated) {
+		int allocated = k->allocated ? k->allocated *2 : 64;
+		int32_t *next, *fail;
+		uint16_t *match;
+
+		next = realloc( k->next, (size_t)allocated *KWSEARCH_ALPHABET *sizeof(int32_t) );
+		if (!next) return -1;
+		k->next = next;
+		fail = realloc( k->fail, allocated *sizeof(int32_t) );
+		if (!fail) return -1;
+		k->fail = fail;
+		match = realloc( k->match, allocated *sizeof(uint16_t) );
+		if (!match) return -1;
+		k->match = match;
+		k->allocated = allocated;
+	}
+
+	s = k->states++;
+	memset( k->next +(size_t)s *KWSEARCH_ALPHABET, 0xFF, KWSEARCH_ALPHABET *sizeof(int32_t) );
+	k->fail[s] = 0;
+	k->match[s] = 0;
+
+	return s;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-134232
+  Function Name	: kwsearch_add
+  Returns Type	: int
+  ----Parameter List
+  1. struct kwsearch *k,
+  2.  const unsigned char *pattern,
+  3.  size_t l ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Adds one pattern to the trie.  Returns 1 on an empty or over long
+pattern, if we've already compiled, or if we're out of memory.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int kwsearch_add( struct kwsearch *k, const unsigned char *pattern, size_t l ) {
+	int32_t s = 0;
+	size_t i;
+
+	if ((l == 0) || (l > KWSEARCH_PATTERN_MAX) || (k->compiled)) return 1;
+	if ((k->states == 0) && (new_state( k ) < 0)) return 1;
+
+	for (i = 0; i < l; i++) {
+		int32_t t = k->next[(size_t)s *KWSEARCH_ALPHABET +pattern[i]];
+
+		if (t < 0) {
+			t = new_state( k );
+			if (t < 0) return 1;
+			k->next[(size_t)s *KWSEARCH_ALPHABET +pattern[i]] = t;
+		}
+		s = t;
+	}
+
+	k->match[s] = l;
+	k->patterns++;
+	if (l < k->min_length) k->min_length = l;
+	if (l > k->max_length) k->max_length = l;
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-134418
+  Function Name	: kwsearch_load
+  Returns Type	: int
+  ----Parameter List
+  1. struct kwsearch *k,
+  2.  const char *file ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+One pattern per line, taken byte for byte apart from the line
+ending.  Blank lines are skipped.  Returns the number of patterns
+added, -1 if the file can't be read, -2 on a line longer than
+KWSEARCH_PATTERN_MAX.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int kwsearch_load( struct kwsearch *k, const char *file ) {
+	char line[KWSEARCH_PATTERN_MAX +3];
+	FILE *f;
+	int added = 0;
+
+	f = fopen( file, "rb" );
+	if (!f) return -1;
+
+	while (fgets( line, sizeof(line), f )) {
+		size_t l = strlen(line);
+
+		if ((l > 0) && (line[l -1] != '\n') && (!feof(f))) {
+			fclose(f);
+			return -2;
+		}
+		while ((l > 0) && ((line[l -1] == '\n') || (line[l -1] == '\r'))) l--;
+		if (l == 0) continue;
+		if (l > KWSEARCH_PATTERN_MAX) {
+			fclose(f);
+			return -2;
+		}
+		if (kwsearch_add( k, (unsigned char *)line, l ) == 0) added++;
+	}
+
+	fclose(f);
+
+	return added;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-134605
+  Function Name	: kwsearch_compile
+  Returns Type	: int
+  ----Parameter List
+  1. struct kwsearch *k ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Breadth first over the trie, setting each state's failure link
+and filling its missing transitions from the failure state's
+( which being shallower is already complete ).  After this next[]
+is a DFA with no -1 entries.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int kwsearch_compile( struct kwsearch *k ) {
+	int32_t *queue;
+	int head = 0, tail = 0;
+	int c;
+
+	if (k->compiled) return 0;
+	if (k->states == 0) return 1;
+
+	queue = malloc( k->states *sizeof(int32_t) );
+	if (!queue) return 1;
+
+	memset( k->first, 0, sizeof(k->first) );
+	k->first_count = 0;
+
+	for (c = 0; c < KWSEARCH_ALPHABET; c++) {
+		int32_t t = k->next[c];
+
+		if (t < 0) {
+			k->next[c] = 0;
+		} else {
+			k->fail[t] = 0;
+			queue[tail++] = t;
+			k->first[c] = 1;
+			k->first_byte = c;
+			k->first_count++;
+		}
+	}
+
+	while (head < tail) {
+		int32_t r = queue[head++];
+		int32_t *row = k->next +(size_t)r *KWSEARCH_ALPHABET;
+		int32_t *frow = k->next +(size_t)k->fail[r] *KWSEARCH_ALPHABET;
+
+		if (k->match[r] == 0) k->match[r] = k->match[k->fail[r]];
+
+		for (c = 0; c < KWSEARCH_ALPHABET; c++) {
+			if (row[c] < 0) {
+				row[c] = frow[c];
+			} else {
+				k->fail[row[c]] = frow[c];
+				queue[tail++] = row[c];
+			}
+		}
+	}
+
+	free(queue);
+	k->compiled = 1;
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-134810
+  Function Name	: kwsearch_scan
+  Returns Type	: size_t
+  ----Parameter List
+  1. struct kwsearch *k,
+  2.  const unsigned char *p,
+  3.  size_t l,
+  4.  kwsearch_hit_fn fn,
+  5.  void *arg ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Calls fn for every position a pattern ends at ( the longest one
+if several end together ), with the offset the match starts at.
+fn returning non-zero stops the scan.  Returns the number of
+hits.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+size_t kwsearch_scan( struct kwsearch *k, const unsigned char *p, size_t l, kwsearch_hit_fn fn, void *arg ) {
+	int32_t s = 0;
+	size_t i = 0;
+	size_t hits = 0;
+
+	if ((!k->compiled) || (k->patterns == 0)) return 0;
+
+	while (i < l) {
+		if (s == 0) {
+			if (k->first_count == 1) {
+				const unsigned char *f = memchr( p +i, k->first_byte, l -i );
+
+				if (!f) break;
+				i = f -p;
+			} else {
+				while ((i < l) && (!k->first[p[i]])) i++;
+				if (i >= l) break;
+			}
+		}
+
+		s = k->next[(size_t)s *KWSEARCH_ALPHABET +p[i]];
+		i++;
+
+		if (k->match[s]) {
+			hits++;
+			if ((fn) && (fn( i -k->match[s], k->match[s], arg ))) break;
+		}
+	}
+
+	return hits;
+}
+
+
+
+
+static int stop_at_first( size_t offset, size_t length, void *arg ) {
+	return 1;
+}
+
+
+
+
+int kwsearch_find( struct kwsearch *k, const unsigned char *p, size_t l ) {
+	return kwsearch_scan( k, p, l, stop_at_first, NULL ) > 0;
+}
+
+
+
+
+int kwsearch_free( struct kwsearch *k ) {
+	if (k->next) free(k->next);
+	if (k->fail) free(k->fail);
+	if (k->match) free(k->match);
+	kwsearch_init( k );
+
+	return 0;
+}
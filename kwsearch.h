@@ -0,0 +1,44 @@
+#ifndef UNDARK_KWSEARCH_H
+#define UNDARK_KWSEARCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define KWSEARCH_ALPHABET 256
+#define KWSEARCH_PATTERN_MAX 1024 // longest pattern line we take from a file
+
+/**
+ * Multi-pattern byte string search ( Aho-Corasick ).
+ *
+ * Patterns are added to a trie, kwsearch_compile() then fills in
+ * the failure links and turns it in to a full DFA, so the scan is
+ * one table lookup per byte whatever the number of patterns.  While
+ * sitting in the root state we skip ahead to the next byte that can
+ * start a pattern ( memchr() when there's only one such byte ).
+ */
+struct kwsearch {
+	int32_t *next; // [state *KWSEARCH_ALPHABET +byte], -1 in the trie until compiled
+	int32_t *fail;
+	uint16_t *match; // longest pattern ending in this state, following fail links, 0 for none
+	int states, allocated;
+
+	int patterns;
+	size_t min_length, max_length;
+
+	uint8_t first[KWSEARCH_ALPHABET]; // bytes that move us out of the root
+	int first_count;
+	unsigned char first_byte; // the only one, when first_count == 1
+	int compiled;
+};
+
+typedef int (*kwsearch_hit_fn)( size_t offset, size_t length, void *arg );
+
+int kwsearch_init( struct kwsearch *k );
+int kwsearch_add( struct kwsearch *k, const unsigned char *pattern, size_t l );
+int kwsearch_load( struct kwsearch *k, const char *file );
+int kwsearch_compile( struct kwsearch *k );
+size_t kwsearch_scan( struct kwsearch *k, const unsigned char *p, size_t l, kwsearch_hit_fn fn, void *arg );
+int kwsearch_find( struct kwsearch *k, const unsigned char *p, size_t l );
+int kwsearch_free( struct kwsearch *k );
+
+#endif
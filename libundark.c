@@ -0,0 +1,3428 @@
+/**
+ * libundark - the carving engine behind undark.
+ *
+ * Rather CPU intensive likely, relies on the correlation
+ * that the SQLite length of payload should be the same
+ * as the summation of the payload cell sizes.
+ *
+ * Written by Paul L Daniels (pldaniels@pldaniels.com)
+ *
+ * BSD Revised licence ( see LICENCE )
+ *
+ * Original version released October 6, 2013
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <ctype.h>
+#include <time.h>
+#include <errno.h>
+#include <math.h>
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#endif
+#ifdef __linux__
+#include <linux/fs.h> // BLKGETSIZE64
+#endif
+#ifdef _WIN32
+#include <winsock2.h>
+#include <mman.h>
+#endif
+
+#include "libundark.h"
+#include "varint.h"
+#include "numfmt.h"
+#include "iopolicy.h"
+#include "pagereader.h"
+#include "kwsearch.h"
+#include "spanset.h"
+#include "textesc.h"
+#include "recindex.h"
+#include "pagehash.h"
+#include "sigmatch.h"
+#include "trace.h"
+
+#define FL __FILE__,__LINE__
+#define VERBOSE if (g->opt.verbose)
+#define DEBUG if (g->opt.debug)
+
+#define DECODE_MODE_FREESPACE 1
+#define DECODE_MODE_NORMAL 0
+
+#define PAYLOAD_SIZE_MINIMUM 10
+#define PAYLOAD_CELLS_MAX 1000
+#define VARINT_MAP_SLACK 256 // mapped past the end of the page, for record headers running over it
+#define OVERFLOW_PAGES_MAX 10000
+
+#define PTRMAP_ROOTPAGE 1 // pointer map entry types, as SQLite writes them
+#define PTRMAP_FREEPAGE 2
+#define PTRMAP_OVERFLOW1 3 // first page of a chain, parent is the b-tree page holding the cell
+#define PTRMAP_OVERFLOW2 4 // later pages, parent is the overflow page before
+#define PTRMAP_BTREE 5
+#define PENDING_BYTE 0x40000000 // the page holding it is never used, nor mapped
+
+#define TIMESTAMP_MAGNITUDE_MIN 100000000.0 // fewer seconds past its epoch and a reading isn't taken as a timestamp
+#define TIMESTAMP_PLAUSIBLE_MIN 631152000.0 // 1990-01-01, readings before it are some other unit
+#define TIMESTAMP_LATEST_GRACE 86400 // past now a reading may still be, clocks and time zones being what they are
+#define EPOCH_COCOA 978307200.0 // 2001-01-01 in Unix seconds
+#define EPOCH_WEBKIT -11644473600.0 // 1601-01-01
+
+#define ESTIMATE_SEED 0x9E3779B97F4A7C15ULL // fixed, the same image and budget sample the same pages
+#define ESTIMATE_Z 1.959964 // 95% two sided
+#define ESTIMATE_STRATUM_MINIMUM 2 // pages sampled from each stratum before the rest, for a variance
+
+#define YIELD_DELETED 0 // freelist and unallocated pages, table leaves with freeblocks or fragments
+#define YIELD_GAP 1 // table leaves with room between the cell pointers and the cells
+#define YIELD_OTHER 2
+#define YIELD_CLASSES 3
+
+
+
+struct undark {
+	struct undark_options opt;
+
+	char *input_file; // actual file name
+	int fd;
+	char *db_origin;	// the mmap'd file origin
+	char *db_end; // the computed end of the mmap'd file ( based on file size )
+	char *db_cfp; // current file position
+	char *db_cpp; // current page position
+	char *db_cpp_limit; // end of the current page
+	size_t db_size;
+
+	uint32_t page_size, page_count, page_number;
+	uint32_t schema_format; // header offset 44, 4+ stores 0 and 1 as serial types 8/9
+	int text_encoding; // UNDARK_TEXT_*, header offset 56 unless overridden
+
+	uint32_t freelist_first_page, freelist_page_count;
+	uint32_t *freelist_pages;
+	uint32_t freelist_pages_current_index;
+
+	uint8_t *ptrmap_type; // PTRMAP_* of pages 1..ptrmap_pages, NULL if there's no pointer map ( or we're not checking it )
+	uint32_t *ptrmap_parent;
+	uint8_t *ptrmap_loaded; // per pointer map page, its entries have been read in
+	uint32_t ptrmap_pages, ptrmap_span; // pages covered, pages per map page including itself
+	uint32_t pending_page;
+	uint64_t ptrmap_maps, ptrmap_steps, ptrmap_rejected;
+
+	int64_t date_lower, date_upper; // Unix seconds, rows need a timestamp cell in [lower, upper)
+	int64_t date_latest; // Unix seconds, readings after it aren't plausible
+	int date_filter;
+
+	struct io_policy io; // how we map and advise the kernel about the image
+	struct page_reader reader; // explicit read backends ( pread/io_uring ) instead of mmap
+
+	undark_row_callback callback;
+	void *callback_arg;
+	int status; // UNDARK_STOPPED/UNDARK_ERROR ends the carve early
+	struct undark_cell row_cells[PAYLOAD_CELLS_MAX+1];
+
+	struct kwsearch grep; // only pages, then rows, containing one of these get carved
+
+	struct sigmatch signatures; // only records fitting one of these get decoded ( UNDARK_signature_add )
+	uint64_t signature_types[PAYLOAD_CELLS_MAX+1];
+
+	struct recindex index; // every record handed to deliver_row() is written here ( UNDARK_index_write )
+	int indexing;
+
+	uint8_t *page_same; // 1 for pages not carved, found in the baseline image ( UNDARK_baseline ) or repeating an earlier page ( UNDARK_dedup_pages )
+	uint32_t page_same_count;
+	struct pagehash_table baseline_rows; // row_hash() of every row carved from the baseline's changed pages
+	int baseline;
+
+	struct varint_map varints; // every varint of the current page
+
+	struct spanset accepted; // records claimed in the current page
+	struct sql_payload *candidate, *pending; // decode scratch, and the best record not yet handed out
+	uint64_t candidates, candidates_skipped, conflicts, rows_delivered;
+	uint64_t grep_pages, grep_pages_carved, grep_rows, grep_rows_matched;
+	uint64_t date_rows, date_rows_matched;
+	uint64_t index_written, index_read, index_stale;
+	uint64_t baseline_pages, baseline_pages_carved, pages_same, baseline_rows_suppressed;
+	uint64_t pages_duplicate;
+	int dedup;
+	uint64_t yield_pages[YIELD_CLASSES], yield_rows[YIELD_CLASSES];
+
+	char error[1024];
+};
+
+
+
+
+struct cell {
+	int t; // serial
+	int o; // offset
+	int s; // size
+};
+
+
+
+struct sql_payload {
+	uint64_t prefix_length;
+	uint64_t length;
+	uint64_t rowid;
+	uint64_t header_size;
+	int cell_count;
+	int cell_page;
+	int cell_page_offset;
+	struct cell cells[PAYLOAD_CELLS_MAX+1];
+	uint32_t overflow_pages[OVERFLOW_PAGES_MAX+1];
+	char *mapped_data, *mapped_data_endpoint;
+	int header_exact; // the serial types ended exactly where the header size said
+	int confidence; // see row_confidence()
+	size_t span; // bytes of the page the record covers
+	size_t forced_length; // what a freespace decode was given, kept for the index
+	char *overflow_pointer; // the first overflow page number, just after the part of the record on its own page
+};
+
+struct sqlite_leaf_header {
+	int page_number;
+	int page_byte;
+	uint16_t freeblock_offset;
+	uint16_t freeblock_size;
+	uint16_t freeblock_next;
+	int cellcount;
+	int cell_offset;
+	int freebytes;
+};
+
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20131002-220244
+  Function Name	: tdump
+  Returns Type	: int
+  ----Parameter List
+  1. char *p, 
+  2.  uint16_t l , 
+  ------------------
+  Exit Codes	: 
+  Side Effects	: 
+  --------------------------------------------------------------------
+Comments:
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int tdump( char *p, uint16_t l ) {
+
+	while (l--) {
+		if (isprint(*p)) fprintf(stdout,"%c", *p); else fprintf(stdout,".");
+		p++;
+	}
+
+	return 0;
+}
+
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20131002-220250
+  Function Name	: hdump
+  Returns Type	: int
+  ----Parameter List
+  1. char *p, 
+  2.  uint16_t l , 
+  ------------------
+  Exit Codes	: 
+  Side Effects	: 
+  --------------------------------------------------------------------
+Comments:
+
+Combo hex + text dump, 16 byte wide rows
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int hdump( unsigned char *p, uint16_t length, char *msg ) {
+
+	int oc = 0;
+	int ll = length;
+
+	fprintf(stdout,"%s: Hexdumping %d bytes from %p\n", msg, ll, p);
+	uint16_t c = 0;
+
+	if (p == NULL) {
+		fprintf(stdout,"ERROR: NULL passed.\n");
+		//		exit(1);
+	}
+
+	while (ll > 0) {
+		int br;
+		unsigned char *op;
+
+		fprintf(stdout,"%04X [%06d] ",oc, ll);
+		oc+=16;
+
+		br = ll;
+		op = p;
+		while (ll--) {
+			fprintf(stdout,"%02X ", *p);
+			c++;
+			p++;
+			if (c%16 == 0) break;
+		}
+
+		ll = br;
+		p = op;
+		c = 0;
+
+		fprintf(stdout, "  [%06d]", ll );
+		while (ll--) {
+			fprintf(stdout,"%c", isprint(*p)?*p:'.');
+			c++;
+			p++;
+			if (c%16 == 0)  break;
+		}
+
+		fprintf(stdout," %d\n",ll);
+	}
+
+	fprintf(stdout,"\n");
+
+
+	return 0;
+}
+
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-135402
+  Function Name	: grep_page
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark *g ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Does the current page contain any of the grep patterns?  We run
+over a little past the page end so a pattern straddling the
+boundary still counts.  Pages without a hit never get as far as
+the row decoder.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int grep_page( struct undark *g ) {
+	char *end = g->db_cpp_limit +g->grep.max_length -1;
+
+	if (end > g->db_end +1) end = g->db_end +1;
+	g->grep_pages++;
+	if (end <= g->db_cpp) return 0;
+
+	if (!kwsearch_find( &(g->grep), (unsigned char *)g->db_cpp, end -g->db_cpp )) return 0;
+
+	DEBUG fprintf(stdout,"%s:%d:DEBUG: grep hit in page %d\n", FL, g->page_number );
+	g->grep_pages_carved++;
+
+	return 1;
+}
+
+
+
+
+/**
+ * Size of the data for serial type s, *type gets s with blobs and
+ * text folded to 12/13.  Not for the reserved 10 and 11.
+ */
+static uint64_t serial_size( int *type, uint64_t s ) {
+	static const uint8_t sizes[12] = { 0, 1, 2, 3, 4, 6, 8, 8, 0, 0, 0, 0 };
+
+	if (s < 12) {
+		*type = s;
+		return sizes[s];
+	}
+	*type = (s & 0x01) ? 13 : 12;
+
+	return (s -*type) /2;
+}
+
+
+
+
+/**
+ * The pointer map page page's entry is on, as SQLite places them,
+ * one every ptrmap_span pages from page 2, skipping the pending
+ * byte page.
+ */
+static uint32_t ptrmap_page( struct undark *g, uint32_t page ) {
+	uint32_t map = ((page -2) /g->ptrmap_span) *g->ptrmap_span +2;
+
+	if (map == g->pending_page) map++;
+
+	return map;
+}
+
+
+
+
+/**
+ * Reads in the entries of the map page covering page, the first
+ * time one of them is asked for.  A map page past the end of the
+ * image leaves its entries 0, unknown.
+ */
+static void ptrmap_load( struct undark *g, uint32_t page ) {
+	uint32_t group = (page -2) /g->ptrmap_span;
+	uint32_t next = (group +1) *g->ptrmap_span +2; // the next group's map page
+	uint32_t map, n;
+	size_t offset;
+	unsigned char *e;
+
+	if (g->ptrmap_loaded[group]) return;
+	g->ptrmap_loaded[group] = 1;
+
+	map = ptrmap_page( g, page );
+	offset = (size_t)(map -1) *g->page_size;
+	if (offset +g->page_size > g->db_size) return;
+	page_reader_fetch( &(g->reader), offset, g->page_size );
+	g->ptrmap_maps++;
+
+	e = (unsigned char *)g->db_origin +offset;
+	for (n = map +1; (n < next) && (n <= g->ptrmap_pages); n++, e += 5) {
+		g->ptrmap_type[n] = e[0];
+		g->ptrmap_parent[n] = ((uint32_t)e[1] << 24) | (e[2] << 16) | (e[3] << 8) | e[4];
+	}
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-183350
+  Function Name	: ptrmap_step
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark *g,
+  2.  uint32_t page,
+  3.  uint32_t parent,
+  4.  int type ,
+  ------------------
+  Exit Codes	: 0 if the pointer map says page can't follow parent
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+One step along an overflow chain, from parent ( the page holding
+the cell, type PTRMAP_OVERFLOW1, or the overflow page before,
+PTRMAP_OVERFLOW2 ) to page, checked against the pointer map of an
+autovacuum image.
+
+Pointer map pages and the pending byte page are never overflow
+pages.  Otherwise the entry has to be the type and parent the step
+implies, or a free page, a deleted record's chain goes back on the
+freelist with its content intact until the page is reused.  A cell
+carved from a page that's itself free can't be expected to match
+its old parent, any first overflow page will do.  Pages the map
+doesn't cover, and entries that aren't a type at all, aren't
+checked.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int ptrmap_step( struct undark *g, uint32_t page, uint32_t parent, int type ) {
+	uint8_t t;
+
+	if (!g->ptrmap_type) return 1;
+	if ((page < 2) || (page > g->ptrmap_pages)) return 1;
+
+	g->ptrmap_steps++;
+	if ((page == g->pending_page) || (page == ptrmap_page( g, page ))) return 0;
+
+	ptrmap_load( g, page );
+	t = g->ptrmap_type[page];
+	if ((t < PTRMAP_ROOTPAGE) || (t > PTRMAP_BTREE)) return 1;
+	if (t == PTRMAP_FREEPAGE) return 1;
+	if (t != type) return 0;
+	if (g->ptrmap_parent[page] == parent) return 1;
+
+	if ((type == PTRMAP_OVERFLOW1) && (parent >= 2) && (parent <= g->ptrmap_pages) && (parent != ptrmap_page( g, parent ))) {
+		ptrmap_load( g, parent );
+		if (g->ptrmap_type[parent] == PTRMAP_FREEPAGE) return 1;
+	}
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20131004-175721
+  Function Name	: decode_row_meta
+  Returns Type	: int
+  ----Parameter List
+  1. uint8_t *p, 
+  2.  struct sql_payload *payload , 
+  ------------------
+  Exit Codes	: 
+  Side Effects	: 
+  --------------------------------------------------------------------
+Comments:
+
+Decodes the payload header data so that we can then later
+pull the actual data from the file.
+
+--------------------------------------------------------------------
+Changes:
+added 'mode',  standard, or freespace
+20261018: every overflow chain step is checked against the pointer
+map ( ptrmap_step() ), a chain that can't be right rejects the record
+before the rest of it is walked.
+20261018: the first overflow page number is read after the record's
+local part, sized as SQLite does, not from the end of the page; only
+a record that was the last cell on its page got the right chain.
+
+\------------------------------------------------------------------*/
+static int decode_row( struct undark *g, char *p, char *data_endpoint, struct sql_payload *payload, int mode, size_t forced_length ) {
+	int t = 0, offset;
+	int matched = 0; // columns, when the header fitted a --signature
+	char *plh_ep; // payload header end point
+	char *base = p;
+
+	DEBUG {
+		fprintf(stdout,"%s:%d:DEBUG:DECODING ROW-------------------------MODE:%s\n", FL, (mode?"Freespace":"Standard"));
+		hdump((unsigned char *)p, 16, "Decode_row start data");
+	}
+
+	payload->overflow_pages[0] = 0;
+	payload->overflow_pointer = NULL;
+	payload->cell_count = 0;
+	payload->header_exact = 0;
+	payload->forced_length = forced_length;
+
+	if ( mode == DECODE_MODE_FREESPACE ) {
+		payload->length = forced_length -4; // and we still have to deduct the payload header size
+	} else {
+		varint_map_decode( &(g->varints), &(payload->length), p, &p );
+	}
+
+	if (payload->length > g->db_size) return 0;
+	if (payload->length < g->opt.rs_min) return 0;
+	if (payload->length > g->opt.rs_max) return 0;
+
+	DEBUG fprintf(stdout,"%s:%d:DEBUG:Payload size: %lu\n", FL, (unsigned long int)payload->length);
+
+	if ( mode == DECODE_MODE_FREESPACE ) {
+		payload->rowid = 1;
+	} else {
+		varint_map_decode( &(g->varints), &(payload->rowid), p, &p );
+	}
+
+	if (payload->rowid < 1) return 0;
+
+	payload->prefix_length = p -base; // store this so we know how many bytes the length + Row ID took up.
+
+	plh_ep = p; // first set up the beginning of the payload header array size.
+	varint_map_decode( &(g->varints), &(payload->header_size), p, &p );
+	if (payload->header_size > g->page_size) return 0;
+	if (payload->header_size < 2) return 0; // need at least 2 bytes
+	if (plh_ep +payload->header_size > g->db_origin +g->db_size) return 0; // the header runs off the end of the image
+
+	/**
+	 * With signatures only records of those tables are wanted, the
+	 * serial types are checked against them straight off the header
+	 * bytes, before the overflow chain is walked or anything else
+	 * decoded.  A match gives us the serial types as well.
+	 */
+	if (g->signatures.count) {
+		size_t l = payload->header_size -(p -plh_ep);
+
+		if (payload->header_size <= (uint64_t)(p -plh_ep)) return 0;
+		if (p +l > g->db_origin +g->db_size) return 0;
+		matched = sigmatch_find( &(g->signatures), (unsigned char *)p, l, g->signature_types, PAYLOAD_CELLS_MAX +1 );
+		if (!matched) return 0;
+	}
+
+	if (mode == DECODE_MODE_FREESPACE) {
+		payload->length -= payload->header_size;
+		DEBUG fprintf(stdout,"%s:%d:DEBUG: Looking for %lu bytes of data after the payload header\n", FL , (long unsigned int)payload->length);
+		fflush(stdout);
+	}
+
+	// If the payload size exceeds the usable page size, then we have to do some more checking
+
+	if (payload->length > (g->page_size -(unsigned char)g->db_origin[20] -35)) {
+		uint32_t tmp, ovp;
+		int ovpi = 1;
+
+		/**
+		 * The first overflow page number follows the part of the
+		 * record kept on the page, which SQLite sizes from the
+		 * usable page size.  A freeblock has no cell to size from
+		 * and only its own end to go on.
+		 */
+		if (mode == DECODE_MODE_FREESPACE) {
+			payload->overflow_pointer = data_endpoint -4;
+		} else {
+			uint64_t u = g->page_size -(unsigned char)g->db_origin[20];
+			uint64_t x = u -35, m = ((u -12) *32 /255) -23;
+			uint64_t k = m +((payload->length -m) %(u -4));
+
+			payload->overflow_pointer = base +payload->prefix_length +((k <= x) ? k : m);
+			if (payload->overflow_pointer +4 > data_endpoint) return 0;
+		}
+
+		// get the FIRST overflow page
+		memcpy(&tmp, payload->overflow_pointer, 4);
+		ovp = payload->overflow_pages[0] = ntohl(tmp);
+
+		// if the page is beyond the file range, then we've just got defective input data
+		if (ovp > g->page_count) return 0;
+		if (!ptrmap_step( g, ovp, g->page_number, PTRMAP_OVERFLOW1 )) {
+			g->ptrmap_rejected++;
+			return 0;
+		}
+		DEBUG fprintf(stdout,"%s:%d:DEBUG: First overflow page = %lu\n", FL , (long unsigned int)ovp);
+		DEBUG hdump((unsigned char *)(payload->overflow_pointer -12), 16, "First overflow page start data");
+
+
+		while (ovp > 0) {
+
+			void *calculated_address;
+
+			calculated_address = g->db_origin +( (ovp -1) *g->page_size);
+			DEBUG fprintf(stdout,"%s:%d:DEBUG: Calculated address: %p\n", FL, calculated_address);
+
+			// test for seeking beyond the db limit
+			//if ((g->db_origin +((ovp -1) *g->page_size)) > (g->db_end -4)) {
+
+			if ( calculated_address > (void *)(g->db_end -4)) { //PLD:20141220-0000
+				DEBUG	fprintf(stdout,"%s:%d:ERROR: Seek beyond end of data looking for overflow page (%p > %p)\n", FL, calculated_address, g->db_end);
+				break;
+			} 
+
+			if ( calculated_address < (void *)(g->db_origin)) { //PLD:20141220-0000
+				DEBUG	fprintf(stdout,"%s:%d:ERROR: Seek before DB starts (%p < %p)\n", FL, calculated_address, g->db_origin);
+				break;
+			} 
+
+			page_reader_fetch( &(g->reader), (char *)calculated_address -g->db_origin, 4 );
+			memcpy(&tmp, calculated_address, 4);
+			ovp = payload->overflow_pages[ovpi] = ntohl(tmp);
+			DEBUG fprintf(stdout,"%s:%d:DEBUG: overflow page[%d] = %d\n", FL , ovpi, ovp);
+			DEBUG fflush(stdout);
+			if ((ovp) && (!ptrmap_step( g, ovp, payload->overflow_pages[ovpi -1], PTRMAP_OVERFLOW2 ))) {
+				g->ptrmap_rejected++;
+				return 0;
+			}
+			ovpi++;
+			if (ovpi > OVERFLOW_PAGES_MAX) {
+				fprintf(stdout,"ERROR: No more space for overflow pages\n");
+				fflush(stdout);
+				payload->overflow_pages[0] = 0;
+				break;
+			}
+			payload->overflow_pages[ovpi] = 0;
+		}
+
+
+		DEBUG {
+			fprintf(stdout,"DEBUG: Total of %d overflow pages\n",ovpi);
+			ovpi = 0;
+			while (payload->overflow_pages[ovpi]) {
+				fprintf(stdout,"DEBUG: Overflow %d->%d\n", ovpi, payload->overflow_pages[ovpi]);
+				ovpi++;
+			}
+		}
+	}  // overflow handling
+
+	if (payload->header_size > g->page_size) return 0; // sorry, no can do with the way we're playing this decoding game.
+
+	plh_ep += payload->header_size; // if we got a sane value, then we can use this for the full decode size ( includes the size of the first varint telling us the size )
+
+	DEBUG { fprintf(stdout,"[L:%lld][id:%lld][PLHz:%lld]", payload->length, payload->rowid, payload->header_size); }
+
+	t = 0;
+	offset = 0;
+
+	if (matched) {
+		for (t = 0; t < matched; t++) {
+			payload->cells[t].s = serial_size( &(payload->cells[t].t), g->signature_types[t] );
+			payload->cells[t].o = (plh_ep +offset) -base;
+			offset += payload->cells[t].s;
+			if (offset > payload->length) return 0;
+		}
+		t = payload->cell_count = matched -1;
+		if ( t > g->opt.cc_max ) return 0;
+		p = plh_ep; // sigmatch_find() only matches a header that ends exactly
+
+	} else while (1) {
+		uint64_t s;
+		int vil;
+
+		vil = varint_map_decode( &(g->varints), &s, p, &p );
+
+		if (vil > 8) return 0; // no var int should be bigger than 8 bytes.
+
+		if ((s == 10) || (s == 11)) {
+			DEBUG fprintf(stdout,"%s:%d:DEBUG: celltype 10/11 reserved, aborting row.\n",FL);
+			return 0;
+		}
+		s = serial_size( &(payload->cells[t].t), s ); // set the type, s becomes the size
+
+		payload->cells[t].s = s; // set the size/length
+		payload->cells[t].o = (plh_ep +offset) -base;
+		offset += payload->cells[t].s;
+		if (offset > payload->length) return 0;
+
+		DEBUG { fprintf(stdout,"[%d:%d:%d-%d(%d)]", t, payload->cells[t].t, payload->cells[t].s, payload->cells[t].o, plh_ep -p ); }
+
+		if (p >= plh_ep) break;
+		t++;
+		payload->cell_count++;
+		if ( t > g->opt.cc_max ) return 0;
+	} // while decoding the cells
+
+	if (p == plh_ep) {
+		payload->header_exact = 1;
+		DEBUG {
+			fprintf(stdout,"DEBUG: Payload head size match. (%d =? %d)\n ", p -base,plh_ep -base);
+			fprintf(stdout,"DEBUG: Data size by cell meta sum = %d\n ", offset );
+		}
+	} else {
+		DEBUG {
+			fprintf(stdout,"DEBUG: Payload scan end point, and predicted end point didn't match, difference %d \n", p -plh_ep );
+		}
+	}
+
+	if ( t < g->opt.cc_min )  {
+		DEBUG fprintf(stdout,"%s:%d:DEBUG: cell count under the minimum, so aborting\n", FL );
+		return 0;
+	}
+
+	DEBUG fprintf(stdout,"Offset [%u] + headersize [%lu] = length check [%lu]... \n", offset, (unsigned long int)payload->header_size, (unsigned long int)payload->length);
+
+	if (mode == DECODE_MODE_FREESPACE) {
+		/** there can often be multiple entries within freespace, so we have to be
+		 * a little looser with our acceptance criterion
+		 */
+		if (offset <= payload->length) {
+			DEBUG fprintf(stdout,"%s:%d:DEBUG: FREESPACE SUBMATCH FOUND ( %u of %lu used )\n", FL , offset, (long unsigned int) payload->length);
+			return (offset +payload->header_size +4);
+		}
+	}
+
+	if (offset + payload->header_size  == payload->length) {
+		DEBUG fprintf(stdout,"\nMATCH FOUND!\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * Bytes from base a record's cells reach, as far as the end of the
+ * image.
+ */
+static size_t record_extent( struct undark *g, char *base, struct sql_payload *payload ) {
+	size_t available = (g->db_origin +g->db_size) -base;
+	size_t extent = 0;
+	int t;
+
+	for (t = 0; t <= payload->cell_count; t++) {
+		size_t end = (size_t)payload->cells[t].o +payload->cells[t].s;
+
+		if (payload->cells[t].o < 0) continue;
+		if (end > extent) extent = end;
+	}
+
+	return (extent > available) ? available : extent;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-150214
+  Function Name	: row_dated
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark *g,
+  2.  char *data,
+  3.  char *limit,
+  4.  struct sql_payload *payload,
+  5.  int *beyond ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Does any integer or real cell read as a timestamp in the date
+range?  Each value is tried as
+
+	Unix seconds and milliseconds
+	Cocoa seconds ( 2001 epoch, reals too ) and nanoseconds
+	Chrome/WebKit microseconds ( 1601 epoch )
+
+A reading has to be plausible before it's held against the window,
+at least TIMESTAMP_MAGNITUDE_MIN seconds past its epoch ( otherwise
+every counter and flag in the database would be a 1970 date, and
+every Unix time a 2001 Cocoa nanosecond one ), no earlier than 1990
+and no later than g->date_latest.  Without that an open ended window
+took any integer over 1e8, Unix seconds read as Cocoa 31 years on,
+milliseconds read as seconds in the year 40000.  A value can still
+read plausibly in more than one unit, 720000000 is Cocoa 2023 and
+Unix 1992, and the row is kept if any of them is in the window.
+Cells running past limit aren't looked at and set *beyond, the
+caller decides if it's worth assembling the overflow to see them.
+
+--------------------------------------------------------------------
+Changes:
+20261018: Readings must be plausible dates, 1990 to date_latest
+
+\------------------------------------------------------------------*/
+static int row_dated( struct undark *g, char *data, char *limit, struct sql_payload *payload, int *beyond ) {
+	static const double scale[] = { 1.0, 1e-3, 1.0, 1e-9, 1e-6 };
+	static const double epoch[] = { 0.0, 0.0, EPOCH_COCOA, EPOCH_COCOA, EPOCH_WEBKIT };
+	double lower = (double)g->date_lower, upper = (double)g->date_upper;
+	double latest = (double)g->date_latest;
+	int t, i;
+
+	for (t = 0; t <= payload->cell_count; t++) {
+		struct cell *c = &(payload->cells[t]);
+		unsigned char *d = (unsigned char *)data +c->o;
+		double v;
+
+		if ((c->t < 1) || (c->t > 7) || (c->o < 0)) continue;
+		if ((char *)d +c->s > limit) {
+			*beyond = 1;
+			continue;
+		}
+
+		if (c->t == 7) v = numfmt_be_double( d );
+		else v = (double)numfmt_be_int( d, c->s );
+		if (!(v >= TIMESTAMP_MAGNITUDE_MIN)) continue; // negatives and NaN too
+
+		for (i = 0; i < (int)(sizeof(scale) /sizeof(scale[0])); i++) {
+			double since = v *scale[i], when = since +epoch[i];
+
+			if ((since < TIMESTAMP_MAGNITUDE_MIN) || (when < TIMESTAMP_PLAUSIBLE_MIN) || (when > latest)) continue;
+			if ((when >= lower) && (when < upper)) return 1;
+		}
+	}
+
+	return 0;
+}
+
+
+
+
+/**
+ * FNV-1a over the ( folded ) serial types, an index record whose
+ * signature doesn't match what decodes now is from another image.
+ */
+static uint32_t row_signature( struct sql_payload *payload ) {
+	uint32_t h = 2166136261u;
+	int t;
+
+	for (t = 0; t <= payload->cell_count; t++) {
+		h ^= (uint32_t)payload->cells[t].t;
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+
+
+
+/**
+ * Appends the record about to be delivered to the carve index,
+ * before any date/grep filtering so a later --from-index can
+ * filter differently.
+ */
+static int index_row( struct undark *g, char *base, struct sql_payload *payload, int mode ) {
+	struct recindex_record r;
+
+	r.offset = base -g->db_origin;
+	r.rowid = payload->rowid;
+	r.length = payload->length;
+	r.page = g->page_number;
+	r.overflow = payload->overflow_pages[0];
+	r.signature = row_signature( payload );
+	r.forced_length = (mode == DECODE_MODE_FREESPACE) ? payload->forced_length : 0;
+	r.cell_count = payload->cell_count +1;
+	r.freespace = (mode == DECODE_MODE_FREESPACE);
+	r.confidence = payload->confidence;
+
+	if (recindex_append( &(g->index), &r )) {
+		snprintf(g->error, sizeof(g->error), "Cannot write to the carve index ( %s )", strerror(errno));
+		g->status = UNDARK_ERROR;
+		return 1;
+	}
+	g->index_written++;
+
+	return 0;
+}
+
+
+
+
+/**
+ * Identity of a row for --baseline, the rowid and every cell's type
+ * and bytes.  Where the record sits doesn't come in to it.
+ */
+static uint64_t row_hash( const struct undark_row *row ) {
+	uint64_t h = pagehash_bytes( &(row->rowid), sizeof(row->rowid), row->cell_count );
+	int t;
+
+	for (t = 0; t < row->cell_count; t++) {
+		const struct undark_cell *c = &(row->cells[t]);
+
+		h = pagehash_bytes( c->data, c->length, h +c->type );
+	}
+
+	return h;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20131008-182215
+  Function Name	: deliver_row
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark *glob, 
+  2.  char *p, 
+  3.  char *data_endpoint, 
+  4.  struct sql_payload *payload, 
+  5.  int decode , 
+  ------------------
+  Exit Codes	: 
+  Side Effects	: 
+  --------------------------------------------------------------------
+Comments:
+
+--------------------------------------------------------------------
+Changes:
+20261018: no longer writes CSV, the cells are handed to the row
+callback by pointer.  Overflow copies are sized by the chain
+length, a row with a short payload length and a long chain used
+to run off the end of the allocation.
+20261018: records are written to the carve index, if there is one.
+20261018: rows already carved from the baseline image are dropped.
+20261018: a record's cells are read in before the date range check,
+it was looking at unread bytes past the front with pread/uring.
+
+\------------------------------------------------------------------*/
+static int deliver_row( struct undark *g, char *base, char *data_endpoint, struct sql_payload *payload, int mode ) {
+	struct undark_row row;
+	size_t available, extent = 0;
+	int t = 0;
+	int ovpi;
+	int dated = 0, beyond = 0;
+	void *addr;
+
+
+	DEBUG fprintf(stdout,"\n-DUMPING ROW------------------\n");
+	DEBUG hdump((unsigned char *)base, 16, "Dump_row starting data");
+
+	if ( payload->length > g->db_size ) {
+		DEBUG fprintf(stdout,"%s:%d:ERROR: Nonsensical payload length of %ld requested, ignoring.\n", FL, (long int)payload->length);
+		return -1;
+	}
+
+	if ((g->indexing) && (index_row( g, base, payload, mode ))) return -1;
+
+	/**
+	 * Date range first, before the overflow chain is copied or any
+	 * of the row is formatted.  Only a row whose timestamp might be
+	 * out in the overflow gets assembled to be checked again.
+	 */
+	if (g->date_filter) {
+		g->date_rows++;
+		if (payload->overflow_pages[0] == 0) {
+			/* a cell can run past the page, and so past what the read backends have loaded */
+			page_reader_fetch( &(g->reader), base -g->db_origin, record_extent( g, base, payload ) );
+			dated = row_dated( g, base, g->db_origin +g->db_size, payload, &beyond );
+		} else {
+			dated = row_dated( g, base, payload->overflow_pointer, payload, &beyond );
+		}
+		if ((!dated) && ((!beyond) || (payload->overflow_pages[0] == 0))) {
+			DEBUG fprintf(stdout,"%s:%d:DEBUG: No timestamp in the date range, skipping\n", FL );
+			return 0;
+		}
+	}
+
+	if (payload->overflow_pages[0] == 0) {
+		payload->mapped_data = base;
+		payload->mapped_data_endpoint = data_endpoint;
+		available = (g->db_origin +g->db_size) -base;
+
+	} else {
+		size_t chain = 0;
+		uint64_t t = trace_start( TRACE_SAMPLED );
+
+		while (payload->overflow_pages[chain]) chain++;
+		available = (chain +1) *g->page_size;
+		if (available < payload->length) available = payload->length;
+
+		payload->mapped_data = malloc( (available +100) *sizeof(char) );
+		if ( !payload->mapped_data ) {
+			snprintf(g->error, sizeof(g->error), "Cannot allocate %lu bytes for mapped data", (unsigned long)available +100);
+			g->status = UNDARK_ERROR;
+			return -1;
+		}
+		DEBUG fprintf(stdout,"ALLOCATED %d bytes to mapped data\n", (int)(available +100) );
+		memset( payload->mapped_data, 'X', available +100 );
+
+		// load in the first, default page.
+		DEBUG fprintf(stdout,"Copying data for initial page\n");
+		memcpy(payload->mapped_data, base, payload->overflow_pointer -base );
+		payload->mapped_data_endpoint = payload->mapped_data +(payload->overflow_pointer -base);
+		//		DEBUG hdump( (unsigned char *)payload->mapped_data, payload->mapped_data_endpoint -payload->mapped_data +4  );
+
+		// Let the kernel start reading the whole chain before we walk it
+		ovpi = 0;
+		while (payload->overflow_pages[ovpi]) {
+			io_policy_prefetch( &(g->io), g->db_origin +((payload->overflow_pages[ovpi]-1) *g->page_size), g->page_size );
+			ovpi++;
+		}
+
+		// Load in the overflow pages (if any)
+		ovpi = 0;
+		while (payload->overflow_pages[ovpi]) {
+			DEBUG fprintf(stdout,"Copying data from file to memory for page %d to offset [%d]\n", payload->overflow_pages[ovpi], (int)(payload->mapped_data_endpoint -payload->mapped_data));
+
+			addr = g->db_origin +((payload->overflow_pages[ovpi]-1) *g->page_size) +4; //PLD:20141221-2240 segfault fix
+			if (( addr < (void *)g->db_origin) || ( addr > (void *)g->db_end)) {
+				DEBUG fprintf(stdout,"%s:%d:deliver_row:ERROR: page seek request outside of boundaries of file (%p < %p > %p)\n", FL, g->db_origin, addr, g->db_end);
+				free( payload->mapped_data );
+				return -1;
+			}
+
+			page_reader_fetch( &(g->reader), (char *)addr -g->db_origin, g->page_size -4 );
+			memcpy(payload->mapped_data_endpoint, addr, g->page_size -4);
+			payload->mapped_data_endpoint += g->page_size -4;
+
+			//	DEBUG hdump( (unsigned char *)payload->mapped_data, payload->mapped_data_endpoint -payload->mapped_data );
+
+			ovpi++;
+		}
+		if (t) trace_span( t, "overflow", "carve", "\"pages\":%lu,\"bytes\":%lu", (unsigned long)chain, (unsigned long)payload->length );
+	}
+
+	DEBUG hdump((unsigned char *)payload->mapped_data, payload->mapped_data_endpoint -payload->mapped_data, "Payload mapped data" );
+
+	row.rowid = payload->rowid;
+	row.freespace = (mode == DECODE_MODE_FREESPACE);
+	row.overflow = (payload->overflow_pages[0] != 0);
+	row.page = g->page_number;
+	row.offset = base -g->db_origin;
+	row.length = payload->length;
+	row.cell_count = payload->cell_count +1;
+	row.confidence = payload->confidence;
+	row.cells = g->row_cells;
+
+	/**
+	 * Cells are clipped to the data we actually have, a bogus
+	 * record can claim well past the end of the image.
+	 */
+	for (t = 0; t <= payload->cell_count; t++) {
+		struct undark_cell *c = &(g->row_cells[t]);
+		size_t o = payload->cells[t].o;
+
+		c->type = payload->cells[t].t;
+		c->data = payload->mapped_data +o;
+		c->length = payload->cells[t].s;
+		if (o >= available) c->length = 0;
+		else if (c->length > available -o) c->length = available -o;
+		if (o +c->length > extent) extent = o +c->length;
+	}
+
+	/* nothing stops a cell claiming more than the page, make sure it's been read in */
+	if (!row.overflow) page_reader_fetch( &(g->reader), base -g->db_origin, extent );
+
+	if ((g->date_filter) && (!dated)) {
+		beyond = 0;
+		if (!row_dated( g, payload->mapped_data, payload->mapped_data +available, payload, &beyond )) {
+			DEBUG fprintf(stdout,"%s:%d:DEBUG: No timestamp in the date range, skipping\n", FL );
+			free( payload->mapped_data );
+			return 0;
+		}
+	}
+	if (g->date_filter) g->date_rows_matched++;
+
+	if (g->grep.patterns) {
+		g->grep_rows++;
+		if (!kwsearch_find( &(g->grep), (unsigned char *)payload->mapped_data, extent )) {
+			DEBUG fprintf(stdout,"%s:%d:DEBUG: No grep pattern in the row, skipping\n", FL );
+			if (payload->overflow_pages[0] != 0) free( payload->mapped_data );
+			return 0;
+		}
+		g->grep_rows_matched++;
+	}
+
+	if ((g->baseline) && (pagehash_table_find( &(g->baseline_rows), row_hash( &row ), NULL ))) {
+		DEBUG fprintf(stdout,"%s:%d:DEBUG: Row is in the baseline, skipping\n", FL );
+		g->baseline_rows_suppressed++;
+		if (payload->overflow_pages[0] != 0) free( payload->mapped_data );
+		return 0;
+	}
+
+	g->rows_delivered++;
+	if (g->callback( &row, g->callback_arg )) g->status = UNDARK_STOPPED;
+
+	if (payload->overflow_pages[0] != 0) free( payload->mapped_data );
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-141540
+  Function Name	: row_confidence
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark *g,
+  2.  char *base,
+  3.  char *data_endpoint,
+  4.  struct sql_payload *payload,
+  5.  int exact ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+How much we believe a decoded record, 0..UNDARK_CONFIDENCE_MAX.
+
+	30	cell sizes sum exactly to the payload length
+	20	serial types end exactly where the header size says
+	20	the record is plausible: something carries data, the
+		length and rowid varints have no leading 0x80 padding,
+		and integers use the smallest serial type that holds
+		them ( SQLite always writes them that way )
+	30	text cells are clean UTF-8 ( or UTF-16 ), scaled by the
+		fraction of bytes that are
+
+Only the part of the record in this page is looked at.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int row_confidence( struct undark *g, char *base, char *data_endpoint, struct sql_payload *payload, int exact ) {
+	size_t text_bytes = 0, text_bad = 0;
+	int ints = 0, ints_canonical = 0, carrying = 0;
+	int score = 0;
+	int prefix_canonical = 1;
+	int t;
+
+	if (exact) score += 30;
+	if (payload->header_exact) score += 20;
+
+	if (payload->prefix_length) {
+		uint64_t v;
+		char *q = base;
+
+		if ((unsigned char)*q == 0x80) prefix_canonical = 0;
+		varint_map_decode( &(g->varints), &v, q, &q );
+		if ((unsigned char)*q == 0x80) prefix_canonical = 0;
+	}
+
+	for (t = 0; t <= payload->cell_count; t++) {
+		struct cell *c = &(payload->cells[t]);
+		unsigned char *d = (unsigned char *)base +c->o;
+
+		if (c->o < 0) continue; // sizes that overflowed, nothing here to look at
+		if ((c->s > 0) || (c->t == 8) || (c->t == 9)) carrying++;
+
+		if ((c->t >= 1) && (c->t <= 6)) {
+			int64_t v, lim;
+
+			ints++;
+			if ((char *)d +c->s > data_endpoint) continue;
+			v = numfmt_be_int( d, c->s );
+			switch (c->t) {
+				case 1: lim = 0; break;
+				case 2: lim = 0x7F; break;
+				case 3: lim = 0x7FFF; break;
+				case 4: lim = 0x7FFFFF; break;
+				case 5: lim = 0x7FFFFFFF; break;
+				default: lim = 0x7FFFFFFFFFFFLL; break;
+			}
+			if (c->t == 1) {
+				if ((g->schema_format < 4) || ((v != 0) && (v != 1))) ints_canonical++;
+			} else if ((v > lim) || (v < -lim -1)) {
+				ints_canonical++;
+			}
+
+		} else if ((c->t == 13) && (c->s > 0)) {
+			size_t l = c->s;
+			size_t i = 0;
+
+			if ((char *)d >= data_endpoint) continue;
+			if ((char *)d +l > data_endpoint) l = data_endpoint -(char *)d;
+			text_bytes += l;
+			if (g->text_encoding != UNDARK_TEXT_UTF8) {
+				text_bad += textesc_utf16_invalid( d, l, (g->text_encoding == UNDARK_TEXT_UTF16BE) );
+				continue;
+			}
+			while (i < l) {
+				i += textesc_clean_run( d +i, l -i );
+				if (i >= l) break;
+				if ((d[i] != '"') && (d[i] != '\t') && (d[i] != '\n') && (d[i] != '\r')) text_bad++;
+				i++;
+			}
+		}
+	}
+
+	if ((carrying) && (prefix_canonical)) score += 10;
+	if (ints == 0) score += 10;
+	else score += (10 *ints_canonical) /ints;
+	if (text_bytes == 0) score += 30;
+	else score += (30 *(text_bytes -text_bad)) /text_bytes;
+
+	return score;
+}
+
+
+
+
+/**
+ * With the page's varints mapped, the checks decode_row() opens
+ * with ( payload length, rowid, header size ) are three lookups, and
+ * most candidates fail one of them.  0 if the record at p can't be
+ * one, 1 if it's worth decoding ( or isn't in the map ).
+ */
+static inline int prefix_plausible( struct undark *g, char *p ) {
+	struct varint_map *m = &(g->varints);
+	uint64_t length, header_size;
+	size_t i;
+
+	if ((p < m->base) || (p +27 > m->end)) return 1; // three varints of up to 9 bytes
+	i = p -m->base;
+
+	if (!m->length[i]) return 1;
+	length = m->value[i];
+	if ((length > g->db_size) || (length < g->opt.rs_min) || (length > g->opt.rs_max)) return 0;
+
+	i += m->length[i];
+	if (!m->length[i]) return 1;
+	if (m->value[i] < 1) return 0; // rowid
+
+	i += m->length[i];
+	if (!m->length[i]) return 1;
+	header_size = m->value[i];
+	if ((header_size < 2) || (header_size > g->page_size)) return 0;
+	if (header_size > length) return 0; // the cells can't add up to the length then
+
+	return 1;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20131004-211659
+  Function Name	: *find_next_sms
+  Returns Type	: char
+  ----Parameter List
+  1. char *s, 
+  2.  char *end_point , 
+  ------------------
+  Exit Codes	: 
+  Side Effects	: 
+  --------------------------------------------------------------------
+Comments:
+
+Finds rows within a block.
+
+With --fine-search a decoded record isn't handed out straight
+away, it's held as pending while we look for anything that starts
+inside it.  If one does and scores higher ( row_confidence ) it
+replaces the pending one, otherwise it's dropped.  Records that
+score the maximum are trusted outright, candidates inside them are
+skipped without even being decoded.
+
+Otherwise the scan steps over each record it decodes and every
+row goes straight out, as it always has.  The step is the payload
+length, short of the record's end by its length and rowid varints,
+so a candidate found there overlaps the record, and both are kept.
+
+--------------------------------------------------------------------
+Changes:
+20261018: overlap resolution via the accepted span set
+20261018: only with --fine-search, in the normal scan a candidate in
+the tail of the record before could displace it and drop a real row.
+20261018: a record with an overflow chain covers, and is stepped
+over by, only the part of it on this page and the overflow pointer.
+
+\------------------------------------------------------------------*/
+static char *find_next_row( struct undark *g, char *s, char *end_point, char *global_start, int mode, size_t forced_length ) {
+
+	char *p;
+	char *pending_p = NULL;
+	struct sql_payload *sql = g->candidate;
+	struct sql_payload *pending = g->pending;
+	struct sql_payload *tmp;
+	int resolve = ((mode == DECODE_MODE_NORMAL) && (g->opt.fine_search)); // overlaps are scored, not all delivered
+
+	DEBUG fprintf(stdout,"find_next_row: MODE: %d\n", mode );
+	if (s == NULL) fprintf(stdout,"ERROR: NULL passed as search-space parameter\n");
+	p = s;
+	do {
+		struct span *claimed;
+		uint64_t length;
+		int row;
+
+		claimed = ((resolve) && ((uint32_t)(p -g->db_cpp) < g->accepted.reach)) ? spanset_find( &(g->accepted), p -g->db_cpp ) : NULL;
+		if ((claimed) && (claimed->score >= UNDARK_CONFIDENCE_MAX)) {
+			DEBUG fprintf(stdout,"%s:%d:DEBUG: Skipping to +%u, inside an accepted record\n", FL, claimed->end );
+			g->candidates_skipped += (g->db_cpp +claimed->end) -p;
+			p = g->db_cpp +claimed->end;
+			continue;
+		}
+
+		g->candidates++;
+		if ((mode == DECODE_MODE_NORMAL) && (!g->opt.plain_decode) && (!prefix_plausible( g, p ))) {
+			p++;
+			continue;
+		}
+		row = decode_row( g, p, end_point, sql, mode, forced_length );
+		if (row) {
+			DEBUG fprintf(stdout,"ROWID: %ld found [+%ld] record size: %d bytes\n", (unsigned long int)sql->rowid, p -global_start, (unsigned int)( sql->length+sql->prefix_length ));
+			fflush(stdout);
+
+			/** If we're only wanting the removed, no-key-value rows, then 
+			  * continue to the next row 
+			  */
+			if ((g->opt.removed_only)&&(row >= 0)) {
+				p++;
+				continue;
+			}
+
+			length = sql->length;
+			if ((mode == DECODE_MODE_NORMAL) && (sql->overflow_pointer)) length = (sql->overflow_pointer +4) -(p +sql->prefix_length); // only the local part is on this page
+
+			if ((mode == DECODE_MODE_NORMAL)&&( g->opt.freelist_space_only == 1)) {
+				// do nothing
+			} else  {
+				sql->span = (mode == DECODE_MODE_FREESPACE) ? (size_t)row : sql->prefix_length +length;
+				if (sql->span > (size_t)(end_point -p)) sql->span = end_point -p;
+				if (sql->span < 1) sql->span = 1;
+				sql->confidence = row_confidence( g, p, end_point, sql, (mode == DECODE_MODE_NORMAL) || ((size_t)row == forced_length) );
+
+				if (!resolve) {
+					deliver_row( g, p, end_point, sql, mode );
+					if (g->status) break;
+
+				} else if ((pending_p) && (p < pending_p +pending->span)) {
+					/* starts inside the pending record, only one of them can be real */
+					g->conflicts++;
+					DEBUG fprintf(stdout,"%s:%d:DEBUG: Overlapping records, pending scores %d, new one %d\n", FL, pending->confidence, sql->confidence );
+					if (sql->confidence <= pending->confidence) {
+						p++;
+						continue;
+					} else {
+						spanset_remove( &(g->accepted), pending_p -g->db_cpp );
+						tmp = pending; pending = sql; sql = tmp;
+						pending_p = p;
+						spanset_add( &(g->accepted), pending_p -g->db_cpp, (pending_p -g->db_cpp) +pending->span, pending->confidence );
+					}
+				} else {
+					if (pending_p) {
+						deliver_row( g, pending_p, end_point, pending, mode );
+						if (g->status) break;
+					}
+					tmp = pending; pending = sql; sql = tmp;
+					pending_p = p;
+					spanset_add( &(g->accepted), pending_p -g->db_cpp, (pending_p -g->db_cpp) +pending->span, pending->confidence );
+				}
+			}
+
+			fflush(stdout);
+			if (mode == DECODE_MODE_NORMAL) {
+				if (g->opt.fine_search) p++;
+				else p+= length;
+			} else {
+				if (row >= forced_length) {
+					DEBUG fprintf(stdout,"%s:%d:DEBUG: No more data left in freespace block to examine\n", FL);
+					p = end_point;
+					break;
+				} else {
+					p+=row; forced_length -= row;
+					DEBUG hdump((unsigned char *)p,64, "After freespace decode");
+				}
+			}
+		} else {
+			p++;
+		}
+
+	} while (p < end_point -PAYLOAD_SIZE_MINIMUM);
+
+	if ((pending_p) && (!g->status)) deliver_row( g, pending_p, end_point, pending, mode );
+
+	return NULL;
+
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-131204
+  Function Name	: UNDARK_options_init
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark_options *o ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+The defaults the undark CLI has always used.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int UNDARK_options_init( struct undark_options *o ) {
+
+	memset(o, 0, sizeof(struct undark_options));
+	o->debug = 0;
+	o->verbose = 0;
+	o->cc_max = PAYLOAD_CELLS_MAX;
+	o->cc_min = 2;
+	o->rs_max = SIZE_MAX;
+	o->rs_min = 10;
+	o->page_size = 0;
+	o->page_start = 0;
+	o->page_end = 0;
+	o->fine_search = 0;
+	o->freelist_space_only = 0;
+	o->removed_only = 0;
+	o->freespace_minimum = SIZE_MAX; // C99
+
+	o->io_flags = 0;
+	o->io_window = IO_POLICY_WINDOW_DEFAULT;
+	o->input_backend = UNDARK_INPUT_MMAP;
+	o->read_chunk = READER_CHUNK_DEFAULT;
+	o->read_depth = READER_DEPTH_DEFAULT;
+	o->decompress_reserve = 0;
+	o->text_encoding = 0;
+	o->date_after = INT64_MIN;
+	o->date_before = INT64_MAX;
+	o->date_latest = 0;
+	o->plain_decode = 0;
+	o->scan_order = UNDARK_SCAN_FILE;
+	o->ptrmap_check = 1;
+
+	return 0;
+}
+
+
+
+
+int UNDARK_options_io_policy( struct undark_options *o, const char *list ) {
+	struct io_policy io;
+
+	io_policy_init( &io );
+	io.flags = o->io_flags;
+	if (io_policy_parse( &io, list )) return UNDARK_ERROR;
+	o->io_flags = io.flags;
+
+	return UNDARK_OK;
+}
+
+
+
+
+/**
+ * auto ( from the header ), utf8, utf16le or utf16be.
+ */
+int UNDARK_options_text_encoding( struct undark_options *o, const char *name ) {
+
+	if (strcmp(name, "auto") == 0) o->text_encoding = 0;
+	else if (strcmp(name, "utf8") == 0) o->text_encoding = UNDARK_TEXT_UTF8;
+	else if (strcmp(name, "utf16le") == 0) o->text_encoding = UNDARK_TEXT_UTF16LE;
+	else if (strcmp(name, "utf16be") == 0) o->text_encoding = UNDARK_TEXT_UTF16BE;
+	else return UNDARK_ERROR;
+
+	return UNDARK_OK;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-150540
+  Function Name	: UNDARK_options_date
+  Returns Type	: int
+  ----Parameter List
+  1. int64_t *t,
+  2.  const char *when ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Unix seconds, or a UTC date YYYY-MM-DD with an optional HH:MM[:SS]
+after a space or T, in to *t ( o->date_after/date_before/date_latest ).
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int UNDARK_options_date( int64_t *t, const char *when ) {
+	int y, m, d, hh = 0, mm = 0, ss = 0;
+	int n = 0;
+	int64_t days;
+	char *e;
+
+	if (*when == '\0') return UNDARK_ERROR;
+
+	*t = strtoll( when, &e, 10 );
+	if (*e == '\0') return UNDARK_OK;
+
+	if ((sscanf( when, "%4d-%2d-%2d%n", &y, &m, &d, &n ) != 3) || (n != 10)) return UNDARK_ERROR;
+	if (when[n] != '\0') {
+		int k = 0;
+
+		if ((when[n] != ' ') && (when[n] != 'T')) return UNDARK_ERROR;
+		if (sscanf( when +n +1, "%2d:%2d%n:%2d%n", &hh, &mm, &k, &ss, &k ) < 2) return UNDARK_ERROR;
+		if (when[n +1 +k] != '\0') return UNDARK_ERROR;
+	}
+	if ((m < 1) || (m > 12) || (d < 1) || (d > 31) || (hh > 23) || (mm > 59) || (ss > 60)) return UNDARK_ERROR;
+
+	// days since 1970-01-01 in the proleptic Gregorian calendar, March based years
+	if (m <= 2) y--;
+	days = (int64_t)365 *y +y /4 -y /100 +y /400 +(153 *(m +((m > 2) ? -3 : 9)) +2) /5 +d -1 -719468;
+	*t = days *86400 +hh *3600 +mm *60 +ss;
+
+	return UNDARK_OK;
+}
+
+
+
+
+int UNDARK_options_input_backend( struct undark_options *o, const char *name ) {
+	struct page_reader r;
+
+	page_reader_init( &r );
+	if (page_reader_parse_backend( &r, name )) return UNDARK_ERROR;
+	o->input_backend = r.backend;
+
+	return UNDARK_OK;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-131322
+  Function Name	: *UNDARK_new
+  Returns Type	: struct undark
+  ----Parameter List
+  1. const struct undark_options *o ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Allocates a context for carving one image, NULL if we're out of
+memory.  The options are copied, NULL gets the defaults.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+struct undark *UNDARK_new( const struct undark_options *o ) {
+	struct undark *g;
+
+	g = calloc( 1, sizeof(struct undark) );
+	if (!g) return NULL;
+
+	if (o) g->opt = *o;
+	else UNDARK_options_init( &(g->opt) );
+
+	g->page_size = g->opt.page_size;
+	g->page_count = 0;
+	g->page_number = 1;
+	g->input_file = NULL;
+	g->fd = -1;
+	g->date_lower = g->opt.date_after;
+	g->date_upper = g->opt.date_before;
+	g->date_filter = ((g->date_lower != INT64_MIN) || (g->date_upper != INT64_MAX));
+	g->date_latest = (g->opt.date_latest) ? g->opt.date_latest : (int64_t)time( NULL ) +TIMESTAMP_LATEST_GRACE;
+	g->text_encoding = UNDARK_TEXT_UTF8;
+
+	g->db_cfp = NULL;
+	g->db_cpp = NULL;
+
+	kwsearch_init( &(g->grep) );
+	sigmatch_init( &(g->signatures) );
+	varint_map_init( &(g->varints) );
+
+	spanset_init( &(g->accepted) );
+	g->candidate = malloc( 2 *sizeof(struct sql_payload) );
+	if (!g->candidate) {
+		free(g);
+		return NULL;
+	}
+	g->pending = g->candidate +1;
+
+	io_policy_init( &(g->io) );
+	g->io.flags = g->opt.io_flags;
+	g->io.window = g->opt.io_window;
+	if (g->io.window < g->io.page_size) g->io.window = g->io.page_size;
+
+	page_reader_init( &(g->reader) );
+	g->reader.backend = g->opt.input_backend;
+	g->reader.chunk = g->opt.read_chunk;
+	g->reader.depth = g->opt.read_depth;
+	g->reader.reserve = g->opt.decompress_reserve;
+
+	return g;
+}
+
+
+
+
+const char *UNDARK_error( struct undark *g ) {
+	return g->error;
+}
+
+
+
+
+int UNDARK_text_encoding( struct undark *g ) {
+	return g->text_encoding;
+}
+
+
+
+
+uint32_t UNDARK_page_size( struct undark *g ) {
+	return g->page_size;
+}
+
+
+
+
+uint32_t UNDARK_page_count( struct undark *g ) {
+	return g->page_count;
+}
+
+
+
+
+/**
+ * 1 if the open image is mmap'd whole, cell data ( outside an
+ * overflow copy ) then stays valid until UNDARK_close().
+ */
+int UNDARK_image_mapped( struct undark *g ) {
+	return (g->db_origin) && (g->reader.backend == READER_MMAP);
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-135611
+  Function Name	: UNDARK_grep_add
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark *g,
+  2.  const char *pattern,
+  3.  size_t l ,
+  ------------------
+  Exit Codes	: UNDARK_OK, UNDARK_ERROR
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Once any pattern is added only rows containing one of them ( byte
+for byte, anywhere in the record ) are handed to the callback, and
+pages without a hit aren't decoded at all.  Must be called before
+UNDARK_carve().
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int UNDARK_grep_add( struct undark *g, const char *pattern, size_t l ) {
+
+	if (kwsearch_add( &(g->grep), (const unsigned char *)pattern, l )) {
+		snprintf(g->error, sizeof(g->error), "Cannot add grep pattern ( empty, longer than %d bytes, or out of memory )", KWSEARCH_PATTERN_MAX);
+		return UNDARK_ERROR;
+	}
+
+	return UNDARK_OK;
+}
+
+
+
+
+int UNDARK_grep_load( struct undark *g, const char *file ) {
+	int added;
+
+	added = kwsearch_load( &(g->grep), file );
+	if (added == -1) {
+		snprintf(g->error, sizeof(g->error), "Cannot read grep patterns from '%s' ( %s )", file, strerror(errno));
+		return UNDARK_ERROR;
+	}
+	if (added == -2) {
+		snprintf(g->error, sizeof(g->error), "Grep pattern in '%s' is longer than %d bytes", file, KWSEARCH_PATTERN_MAX);
+		return UNDARK_ERROR;
+	}
+	if (added == 0) {
+		snprintf(g->error, sizeof(g->error), "No grep patterns in '%s'", file);
+		return UNDARK_ERROR;
+	}
+
+	return UNDARK_OK;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-162140
+  Function Name	: UNDARK_signature_add
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark *g,
+  2.  const char *list ,
+  ------------------
+  Exit Codes	: UNDARK_OK, UNDARK_ERROR
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Adds a comma list of record signatures, built in names or class
+strings ( see signatures.def ).  Once there are any, records that
+don't fit one of them aren't decoded.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int UNDARK_signature_add( struct undark *g, const char *list ) {
+	char spec[SIGMATCH_CLASSES_MAX +2];
+
+	while (*list) {
+		size_t l = strcspn( list, "," );
+		int r;
+
+		if (l >= sizeof(spec)) l = sizeof(spec) -1; // too long to be valid, sigmatch_add() says so
+		memcpy(spec, list, l);
+		spec[l] = '\0';
+		list += strcspn( list, "," );
+		if (*list) list++;
+
+		r = sigmatch_add( &(g->signatures), spec );
+		if (r == 2) {
+			snprintf(g->error, sizeof(g->error), "No more than %d signatures", SIGMATCH_MAX);
+			return UNDARK_ERROR;
+		}
+		if (r) {
+			char names[256] = "";
+			const char *n;
+			int i;
+
+			for (i = 0; (n = sigmatch_builtin( i )); i++) {
+				if (i) strncat(names, ", ", sizeof(names) -strlen(names) -1);
+				strncat(names, n, sizeof(names) -strlen(names) -1);
+			}
+			snprintf(g->error, sizeof(g->error), "Signature '%.300s' is neither a built in ( %s ) nor a string of n, i, r, t, b ( upper case for or NULL ) and *, with an optional trailing +", spec, names);
+			return UNDARK_ERROR;
+		}
+	}
+
+	return UNDARK_OK;
+}
+
+
+
+
+/**
+ * Bytes in the input, a block device's size rather than the 0 stat
+ * gives for one.
+ */
+static size_t input_size( int fd, struct stat *st ) {
+	off_t end;
+
+	if (!S_ISBLK( st->st_mode )) return st->st_size;
+#ifdef BLKGETSIZE64
+	{
+		uint64_t bytes;
+
+		if (ioctl( fd, BLKGETSIZE64, &bytes ) == 0) return bytes;
+	}
+#endif
+	end = lseek( fd, 0, SEEK_END );
+	lseek( fd, 0, SEEK_SET );
+
+	return (end > 0) ? (size_t)end : 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-131450
+  Function Name	: UNDARK_open
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark *g,
+  2.  const char *input_file ,
+  ------------------
+  Exit Codes	: UNDARK_OK, UNDARK_ERROR
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Maps ( or starts reading/decompressing ) the image and picks up
+the page size, page count and freelist details from its header.
+
+--------------------------------------------------------------------
+Changes:
+20261018: sets up the pointer map of an autovacuum image, for
+checking overflow chains against ( opt.ptrmap_check ).
+20261018: the size of a block device comes from input_size(), stat
+gives 0 for one.
+
+\------------------------------------------------------------------*/
+int UNDARK_open( struct undark *g, const char *input_file ) {
+	struct stat st;
+	char *p;
+	int stat_result;
+	uint64_t t;
+
+	g->input_file = strdup( input_file );
+	if (!g->input_file) {
+		snprintf(g->error, sizeof(g->error), "Cannot allocate memory for the file name");
+		return UNDARK_ERROR;
+	}
+
+	/**
+	 * Check our input file sanity
+	 *
+	 */
+	stat_result = stat( g->input_file, &st );
+	if (stat_result != 0) {
+		snprintf(g->error, sizeof(g->error), "Cannot access input file '%s' ( %s )", g->input_file, strerror(errno));
+		return UNDARK_ERROR;
+	}
+
+
+	/**
+	 * Map our input file to memory, makes it a lot easier
+	 * to jump around if we need to and saves us having to
+	 * handle buffer limits - leave it to the OS to manage :)
+	 *
+	 * The pread/io_uring backends fill an anonymous buffer instead,
+	 * so the rest of the code can still treat it as mapped memory,
+	 * but we must wait for the reads to land before touching pages.
+	 */
+	t = trace_start( TRACE_ALWAYS );
+	g->fd = open( g->input_file, O_RDONLY );
+	if (g->fd < 0) {
+		snprintf(g->error, sizeof(g->error), "Cannot open input file '%s' ( %s )", g->input_file, strerror(errno));
+		return UNDARK_ERROR;
+	}
+	g->db_size = input_size( g->fd, &st );
+
+	/**
+	 * gzip/zstd images get decompressed in to memory by a worker
+	 * thread while we carve, rather than having to be unpacked to
+	 * disk first.  Until it's done we only know an upper bound for
+	 * the size, the page loop picks up the real one as it goes.
+	 */
+	if (page_reader_detect( &(g->reader), g->fd, g->db_size )) {
+		snprintf(g->error, sizeof(g->error), "Input '%s' is %s compressed, but libundark was built without %s", g->input_file
+				, (g->reader.compression == COMPRESSION_GZIP) ? "gzip" : "zstd"
+				, (g->reader.compression == COMPRESSION_GZIP) ? "zlib ( UNDARK_ZLIB )" : "libzstd ( UNDARK_ZSTD )");
+		return UNDARK_ERROR;
+	}
+
+	if (g->reader.backend != READER_MMAP) {
+		g->db_origin = page_reader_open( &(g->reader), g->fd, g->db_size );
+		if (g->db_origin) {
+			page_reader_wait( &(g->reader), 100 ); // SQLite header
+			g->db_size = page_reader_size( &(g->reader) );
+		}
+	} else {
+		g->db_origin = io_policy_map( &(g->io), g->fd, g->db_size );
+	}
+	if (g->db_origin == NULL) {
+		snprintf(g->error, sizeof(g->error), "Cannot map input file '%s' ( %s )", g->input_file, strerror(errno));
+		return UNDARK_ERROR;
+	}
+	g->db_end = g->db_origin +g->db_size -1;
+	if (t) trace_span( t, "map", "open", "\"bytes\":%lu", (unsigned long)g->db_size );
+
+	//fprintf(stderr,"DB origin: %p\nDB end: %p\n", g->db_origin, g->db_end );
+
+	/**
+	 * Start decoding the database
+	 *
+	 * Though it's not really required for us to care about the
+	 * SQLite page sizes, it can be useful in case we get boundary
+	 * situations and try to follow the data across a page
+	 *
+	 * If the page size is already set via parameter, then skip
+	 *
+	 */
+	t = trace_start( TRACE_ALWAYS );
+	if (g->page_size == 0) {
+		p = g->db_origin +16;
+		g->page_size =	(*(p+1)) | ((*p)<<8);
+	}
+	if (g->page_size == 0) {
+		snprintf(g->error, sizeof(g->error), "No page size in the header of '%s'", g->input_file);
+		return UNDARK_ERROR;
+	}
+
+	/**
+	 * Get the number of pages that are supposed to be in the database, though
+	 * we can ignore this and simply parse through the whole DB page at a time
+	 * until we reach the end
+	 */
+	p = g->db_origin +28;
+	memcpy( &g->page_count, g->db_origin +28, 4 ); // copy the page count from the header
+	g->page_count = ntohl( g->page_count ); // convert to local format
+
+	DEBUG fprintf(stdout,"Pagesize: %u, Pagecount: %u\n", g->page_size, g->page_count);
+
+	/** 
+	 * Get the free list meta data
+	 *
+	 */
+	memcpy( &g->freelist_first_page, g->db_origin +32, 4 ); // copy the page count from the header
+	g->freelist_first_page = ntohl( g->freelist_first_page );
+	DEBUG fprintf(stdout,"First page of freelist trunk: %d\n", g->freelist_first_page );
+
+	memcpy( &g->freelist_page_count, g->db_origin +36, 4 ); // copy the page count from the header
+	g->freelist_page_count = ntohl( g->freelist_page_count );
+	DEBUG fprintf(stdout,"Freelist page count: %d\n", g->freelist_page_count );
+
+	memcpy( &g->schema_format, g->db_origin +44, 4 );
+	g->schema_format = ntohl( g->schema_format );
+
+	/**
+	 * Text encoding, 1 UTF-8, 2 UTF-16le, 3 UTF-16be.  Anything else
+	 * is a damaged header ( or a brand new DB with no schema yet ),
+	 * SQLite itself defaults to UTF-8.
+	 */
+	if (g->opt.text_encoding) {
+		g->text_encoding = g->opt.text_encoding;
+	} else {
+		uint32_t e;
+
+		memcpy( &e, g->db_origin +56, 4 );
+		e = ntohl( e );
+		g->text_encoding = ((e >= UNDARK_TEXT_UTF8) && (e <= UNDARK_TEXT_UTF16BE)) ? (int)e : UNDARK_TEXT_UTF8;
+	}
+	DEBUG fprintf(stdout,"Text encoding: %d\n", g->text_encoding );
+
+	/**
+	 * An autovacuum image ( a largest root page at offset 52 ) has
+	 * pointer map pages, the parent of every overflow page.  Their
+	 * entries are read in as the overflow chains need them.
+	 */
+	if (g->opt.ptrmap_check) {
+		uint32_t largest_root, usable, pages;
+
+		memcpy( &largest_root, g->db_origin +52, 4 );
+		largest_root = ntohl( largest_root );
+		usable = g->page_size -(unsigned char)g->db_origin[20];
+		pages = g->db_size /g->page_size;
+		if ((g->page_count) && (g->page_count < pages)) pages = g->page_count;
+
+		if ((largest_root) && (usable >= 480) && (pages > 2)) {
+			g->ptrmap_span = usable /5 +1;
+			g->ptrmap_pages = pages;
+			g->pending_page = PENDING_BYTE /g->page_size +1;
+			g->ptrmap_type = calloc( (size_t)pages +1, sizeof(uint8_t) );
+			g->ptrmap_parent = calloc( (size_t)pages +1, sizeof(uint32_t) );
+			g->ptrmap_loaded = calloc( (size_t)(pages -2) /g->ptrmap_span +1, sizeof(uint8_t) );
+			if ((!g->ptrmap_type) || (!g->ptrmap_parent) || (!g->ptrmap_loaded)) {
+				snprintf(g->error, sizeof(g->error), "Cannot allocate memory for the pointer map");
+				return UNDARK_ERROR;
+			}
+			DEBUG fprintf(stdout,"Pointer map: %u pages per map page\n", g->ptrmap_span );
+		}
+	}
+	if (t) trace_span( t, "header", "open", "\"page_size\":%u,\"page_count\":%u", g->page_size, g->page_count );
+
+
+	/**
+	 * Get the actual free list pages
+	 *
+	 */
+	if (0) {
+		if (g->freelist_page_count) {
+			g->freelist_pages = malloc( (g->freelist_page_count +1) *sizeof(uint32_t) );
+			if (!g->freelist_pages) {
+				snprintf(g->error, sizeof(g->error), "Cannot allocate memory to build page free list");
+				return UNDARK_ERROR;
+			} else {
+				uint32_t next_page;
+				uint32_t pli;
+
+				next_page = g->freelist_first_page;
+				g->freelist_pages[0] = next_page;
+				g->freelist_pages[1] = 0;
+				pli = 1;
+				if ( pli < g->freelist_page_count ) {
+					do {
+						uint32_t tmp_page, leaf_page_count;
+						char *fp, *current_page_endpoint;
+						uint32_t jump;
+
+						jump = ((next_page-2) *g->page_size);
+						fp = g->db_origin +jump;
+						current_page_endpoint = fp +g->page_size;
+						fprintf(stdout,"Freelist - current trunk page = %d [ offset: %X ]\n", next_page, jump);
+						hdump((unsigned char*)fp, g->page_size, "Current trunk page");
+						DEBUG fflush(stdout);
+
+						memcpy( &tmp_page, fp, sizeof(uint32_t));
+						tmp_page = ntohl(tmp_page);
+						fp += sizeof(uint32_t);
+						DEBUG fprintf(stdout,"Next trunk page (if any): %d\n",tmp_page);
+						DEBUG fflush(stdout);
+
+						memcpy( &leaf_page_count, fp, sizeof(uint32_t));
+						leaf_page_count = ntohl(leaf_page_count);
+						fp += sizeof(uint32_t);
+						DEBUG fprintf(stdout,"Leaf page count: %d\n",leaf_page_count);
+						DEBUG fflush(stdout);
+
+						//while ((pli <= g->freelist_page_count)&&( fp < current_page_endpoint )) {
+						while (( fp < current_page_endpoint )&&( leaf_page_count-- )) {
+							hdump((unsigned char*)fp, 16, "Next free page possible");
+							memcpy( &(g->freelist_pages[pli]), fp, sizeof(uint32_t));
+							g->freelist_pages[pli] = ntohl( g->freelist_pages[pli] );
+							DEBUG fprintf(stdout, "Next free page[%d]: %d\n", pli, g->freelist_pages[pli]);
+							if (g->freelist_pages[pli] == 0) {
+								fprintf(stdout,"End of freelist detected\n");
+								fflush(stdout);
+								break;
+							}
+							fflush(stdout);
+							pli++;
+							fp+= sizeof(uint32_t);
+						}
+
+						next_page = tmp_page;
+					} while (next_page > 0);
+						fprintf(stdout,"Freepages - END\n");
+						fflush(stdout);
+					}
+				} // if there were more than one page
+			}
+
+	}
+
+	return UNDARK_OK;
+}
+
+
+
+
+/**
+ * Hashes every page of an open image in to a freshly allocated
+ * array, the last page may be short.  A compressed image is
+ * decompressed to the end first, for its size.
+ */
+static uint64_t *hash_pages( struct undark *g, uint32_t *count ) {
+	uint64_t *hashes;
+	uint32_t n;
+	uint64_t t = trace_start( TRACE_ALWAYS );
+
+	if (g->reader.backend == READER_DECOMPRESS) {
+		g->db_size = page_reader_finish( &(g->reader) );
+		g->db_end = g->db_origin +g->db_size -1;
+	}
+
+	*count = (g->db_size +g->page_size -1) /g->page_size;
+	hashes = malloc( ((size_t)*count +1) *sizeof(uint64_t) );
+	if (!hashes) return NULL;
+
+	for (n = 0; n < *count; n++) {
+		size_t offset = (size_t)n *g->page_size;
+		size_t l = (g->db_size -offset < g->page_size) ? g->db_size -offset : g->page_size;
+
+		page_reader_fetch( &(g->reader), offset, l );
+		hashes[n] = pagehash_bytes( g->db_origin +offset, l, l );
+	}
+	if (t) trace_span( t, "hash", "pages", "\"pages\":%u", *count );
+
+	return hashes;
+}
+
+
+
+
+/**
+ * Is page a ( 1 based ) of image x byte for byte page b of image y?
+ * Used to confirm a hash match, both pages are read in again as the
+ * reader may not have kept them.
+ */
+static int page_equal( struct undark *x, uint32_t a, struct undark *y, uint32_t b ) {
+	size_t xo = (size_t)(a -1) *x->page_size, yo = (size_t)(b -1) *y->page_size;
+	size_t xl = (x->db_size -xo < x->page_size) ? x->db_size -xo : x->page_size;
+	size_t yl = (y->db_size -yo < y->page_size) ? y->db_size -yo : y->page_size;
+
+	if (xl != yl) return 0;
+	page_reader_fetch( &(x->reader), xo, xl );
+	page_reader_fetch( &(y->reader), yo, yl );
+
+	return (memcmp( x->db_origin +xo, y->db_origin +yo, xl ) == 0);
+}
+
+
+
+
+/**
+ * Is page a of image x, hashing to hash, also in image y?  t holds
+ * y's page hashes.
+ */
+static int page_in( struct undark *x, uint32_t a, uint64_t hash, struct pagehash_table *t, struct undark *y ) {
+	uint32_t b;
+
+	return (pagehash_table_find( t, hash, &b )) && (page_equal( x, a, y, b ));
+}
+
+
+
+
+static int baseline_row( struct undark_row *row, void *arg ) {
+	struct undark *g = arg;
+
+	return pagehash_table_add( &(g->baseline_rows), row_hash( row ), 0 );
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-160631
+  Function Name	: UNDARK_baseline
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark *g,
+  2.  const char *file ,
+  ------------------
+  Exit Codes	: UNDARK_OK, UNDARK_ERROR
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Compares the open image against an earlier snapshot of it, so the
+carves after this only turn up what's changed.
+
+Every page of both is hashed.  A page of ours that's byte for byte
+a page anywhere in the baseline ( not just at the same number, a
+vacuum moves pages about ) isn't carved at all.  Baseline pages
+whose content is nowhere in our image are carved, and rows from
+them with the same rowid and cells as one of ours stop ours being
+delivered.  Baseline pages that are still in our image aren't
+carved, their rows are in a page of ours that's skipped anyway.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int UNDARK_baseline( struct undark *g, const char *file ) {
+	struct undark_options o = g->opt;
+	struct pagehash_table old_pages, new_pages;
+	uint64_t *old_hashes = NULL, *new_hashes = NULL;
+	uint32_t old_count = 0, new_count = 0, n, m;
+	struct undark *b;
+	int carved, result = UNDARK_ERROR;
+
+	if (!g->db_origin) {
+		snprintf(g->error, sizeof(g->error), "No input opened");
+		return UNDARK_ERROR;
+	}
+
+	/* the baseline's rows are wanted whatever the date window */
+	o.date_after = INT64_MIN;
+	o.date_before = INT64_MAX;
+	b = UNDARK_new( &o );
+	if (!b) {
+		snprintf(g->error, sizeof(g->error), "Cannot allocate memory for the baseline");
+		return UNDARK_ERROR;
+	}
+	if (UNDARK_open( b, file ) != UNDARK_OK) {
+		snprintf(g->error, sizeof(g->error), "Baseline: %.1000s", b->error);
+		UNDARK_close( b );
+		return UNDARK_ERROR;
+	}
+	if (b->page_size != g->page_size) {
+		snprintf(g->error, sizeof(g->error), "Baseline '%s' has a page size of %u, not %u", file, b->page_size, g->page_size);
+		UNDARK_close( b );
+		return UNDARK_ERROR;
+	}
+
+	pagehash_table_init( &old_pages );
+	pagehash_table_init( &new_pages );
+
+	old_hashes = hash_pages( b, &old_count );
+	new_hashes = hash_pages( g, &new_count );
+	if (!g->page_same) g->page_same = calloc( (size_t)new_count +1, sizeof(uint8_t) );
+	if ((!old_hashes) || (!new_hashes) || (!g->page_same)) goto nomem;
+	g->page_same_count = new_count;
+	g->baseline_pages = old_count;
+
+	for (m = 0; m < old_count; m++) {
+		if (pagehash_table_add( &old_pages, old_hashes[m], m +1 )) goto nomem;
+	}
+	for (n = 0; n < new_count; n++) {
+		if (page_in( g, n +1, new_hashes[n], &old_pages, b )) {
+			g->page_same[n +1] = 1;
+			g->pages_same++;
+		}
+		if (pagehash_table_add( &new_pages, new_hashes[n], n +1 )) goto nomem;
+	}
+
+	/**
+	 * Carve runs of baseline pages that have gone from our image,
+	 * a run at a time so records crossing in to the next page
+	 * still decode.
+	 */
+	g->baseline = 1;
+	m = 0;
+	while (m < old_count) {
+		uint32_t first;
+
+		if (page_in( b, m +1, old_hashes[m], &new_pages, g )) {
+			m++;
+			continue;
+		}
+
+		first = m;
+		while ((m < old_count) && (!page_in( b, m +1, old_hashes[m], &new_pages, g ))) m++;
+		g->baseline_pages_carved += m -first;
+
+		carved = UNDARK_carve_pages( b, first +1, m, baseline_row, g );
+		if (carved == UNDARK_STOPPED) goto nomem;
+		if (carved == UNDARK_ERROR) {
+			snprintf(g->error, sizeof(g->error), "Baseline: %.1000s", b->error);
+			goto done;
+		}
+	}
+
+	DEBUG fprintf(stdout,"%s:%d:DEBUG: Baseline: %llu of %u pages unchanged, %llu rows from %llu changed baseline pages\n", FL
+			, (unsigned long long)g->pages_same, new_count
+			, (unsigned long long)g->baseline_rows.count, (unsigned long long)g->baseline_pages_carved );
+	result = UNDARK_OK;
+	goto done;
+
+nomem:
+	snprintf(g->error, sizeof(g->error), "Cannot allocate memory for the baseline page hashes");
+
+done:
+	if (old_hashes) free(old_hashes);
+	if (new_hashes) free(new_hashes);
+	pagehash_table_free( &old_pages );
+	pagehash_table_free( &new_pages );
+	UNDARK_close( b );
+
+	return result;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-164407
+  Function Name	: UNDARK_dedup_pages
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark *g,
+  2.  const char *table ,
+  ------------------
+  Exit Codes	: UNDARK_OK, UNDARK_ERROR
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Freelist pages, checkpointed copies and fragmented images often
+hold the same page many times over.  Every page is hashed, one
+whose bytes are the same as an earlier page's isn't carved, only
+the first copy is.  With table, each skipped page is written to
+it as "page,offset,same as page" so every location of the rows is
+still known.
+
+Pages already skipped for UNDARK_baseline() aren't considered,
+call this after it.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int UNDARK_dedup_pages( struct undark *g, const char *table ) {
+	struct pagehash_table seen;
+	uint64_t *hashes = NULL;
+	uint32_t count = 0, n, first;
+	FILE *f = NULL;
+	int result = UNDARK_ERROR;
+
+	if (!g->db_origin) {
+		snprintf(g->error, sizeof(g->error), "No input opened");
+		return UNDARK_ERROR;
+	}
+
+	if (table) {
+		f = fopen( table, "w" );
+		if (!f) {
+			snprintf(g->error, sizeof(g->error), "Cannot open duplicate page table '%s' ( %s )", table, strerror(errno));
+			return UNDARK_ERROR;
+		}
+	}
+
+	pagehash_table_init( &seen );
+	hashes = hash_pages( g, &count );
+	if (!hashes) goto nomem;
+	if (!g->page_same) {
+		g->page_same = calloc( (size_t)count +1, sizeof(uint8_t) );
+		if (!g->page_same) goto nomem;
+		g->page_same_count = count;
+	}
+
+	for (n = 1; n <= count; n++) {
+		if (g->page_same[n]) continue;
+
+		if ((pagehash_table_find( &seen, hashes[n -1], &first )) && (page_equal( g, n, g, first ))) {
+			g->page_same[n] = 1;
+			g->pages_duplicate++;
+			if (f) fprintf(f, "%u,%llu,%u\n", n, (unsigned long long)(n -1) *g->page_size, first);
+			continue;
+		}
+		if (n == 1) continue; // the carve doesn't search page 1, so it can't stand in for its copies
+		if (pagehash_table_add( &seen, hashes[n -1], n )) goto nomem;
+	}
+
+	g->dedup = 1;
+	result = UNDARK_OK;
+	goto done;
+
+nomem:
+	snprintf(g->error, sizeof(g->error), "Cannot allocate memory for the page hashes");
+
+done:
+	if ((f) && (fclose( f ) != 0) && (result == UNDARK_OK)) {
+		snprintf(g->error, sizeof(g->error), "Cannot write to the duplicate page table '%s' ( %s )", table, strerror(errno));
+		result = UNDARK_ERROR;
+	}
+	if (hashes) free(hashes);
+	pagehash_table_free( &seen );
+
+	return result;
+}
+
+
+
+
+/**
+ * Rows found on one sampled page.
+ */
+struct estimate_count {
+	uint64_t rows, deleted;
+	int deleted_all; // a freelist/unallocated page, nothing on it is live
+};
+
+struct estimate_sums {
+	double n, y, yy, d, dd, dy, t, tt; // pages, rows, deleted rows, seconds and their squares/products
+};
+
+
+
+
+static int estimate_row( struct undark_row *row, void *arg ) {
+	struct estimate_count *c = arg;
+
+	c->rows++;
+	if ((c->deleted_all) || (row->freespace)) c->deleted++;
+
+	return 0;
+}
+
+
+
+
+static double estimate_clock( void ) {
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ts.tv_sec +ts.tv_nsec /1e9;
+}
+
+
+
+
+/**
+ * xorshift64*, the sample only has to be spread, not secret.
+ */
+static uint64_t estimate_random( uint64_t *state ) {
+	uint64_t x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+
+	return x *0x2545F4914F6CDD1DULL;
+}
+
+
+
+
+/**
+ * Marks the freelist trunk and leaf pages, following the trunk chain
+ * from the header.  A damaged chain just ends the walk.
+ */
+static void mark_freelist( struct undark *g, uint8_t *stratum, uint32_t pages ) {
+	uint32_t trunk = g->freelist_first_page, walked = 0;
+	uint32_t per_trunk = g->page_size /4 -2;
+
+	while ((trunk > 0) && (trunk <= pages) && (walked++ < pages) && (stratum[trunk] != UNDARK_STRATUM_FREELIST)) {
+		unsigned char *p = (unsigned char *)g->db_origin +(size_t)(trunk -1) *g->page_size;
+		uint32_t next, count, i;
+
+		page_reader_fetch( &(g->reader), (char *)p -g->db_origin, g->page_size );
+		stratum[trunk] = UNDARK_STRATUM_FREELIST;
+		next = ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+		count = ((uint32_t)p[4] << 24) | (p[5] << 16) | (p[6] << 8) | p[7];
+		if (count > per_trunk) count = per_trunk;
+		for (i = 0; i < count; i++) {
+			unsigned char *l = p +8 +i *4;
+			uint32_t leaf = ((uint32_t)l[0] << 24) | (l[1] << 16) | (l[2] << 8) | l[3];
+
+			if ((leaf > 0) && (leaf <= pages)) stratum[leaf] = UNDARK_STRATUM_FREELIST;
+		}
+		trunk = next;
+	}
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-180112
+  Function Name	: page_strata
+  Returns Type	: uint8_t *
+  ----Parameter List
+  1. struct undark *g,
+  2.  uint32_t *pages ,
+  ------------------
+  Exit Codes	: NULL if we're out of memory
+  Side Effects	: a compressed image is decompressed in full
+  --------------------------------------------------------------------
+Comments:
+
+UNDARK_STRATUM_* of every page ( 1 based, *pages of them ), from
+the header and the freelist trunks alone.  The header's page count
+is only good if it was written by a version that keeps it,
+valid-for matching the change counter, otherwise every page counts
+as allocated.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static uint8_t *page_strata( struct undark *g, uint32_t *pages ) {
+	uint8_t *stratum;
+	uint32_t allocated, n, change_counter, valid_for;
+
+	if (g->reader.backend == READER_DECOMPRESS) {
+		g->db_size = page_reader_finish( &(g->reader) );
+		g->db_end = g->db_origin +g->db_size -1;
+	}
+	*pages = (g->db_size +g->page_size -1) /g->page_size;
+
+	page_reader_fetch( &(g->reader), 0, 100 ); // the carve may have moved on from the header
+	memcpy( &change_counter, g->db_origin +24, 4 );
+	memcpy( &valid_for, g->db_origin +92, 4 );
+	allocated = g->page_count;
+	if ((change_counter != valid_for) || (allocated == 0) || (allocated > *pages)) allocated = *pages;
+
+	stratum = calloc( (size_t)*pages +1, sizeof(uint8_t) );
+	if (!stratum) return NULL;
+	for (n = allocated +1; n <= *pages; n++) stratum[n] = UNDARK_STRATUM_UNALLOCATED;
+	mark_freelist( g, stratum, *pages );
+
+	return stratum;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-175208
+  Function Name	: UNDARK_estimate
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark *g,
+  2.  double budget,
+  3.  struct undark_estimate *e ,
+  ------------------
+  Exit Codes	: UNDARK_OK, UNDARK_ERROR
+  Side Effects	: the sampled pages are carved, their rows only counted
+  --------------------------------------------------------------------
+Comments:
+
+Triage, what would a full carve with the options in force find and
+how long would it take, from carving a random sample of pages for
+about budget seconds.
+
+The pages are split in to strata that yield very differently, the
+b-tree ( everything within the header's page count that isn't on
+the freelist ), the freelist ( walked from the header ) and the
+unallocated pages past the header's page count.  That's all the
+header and the freelist trunks tell us without reading every page,
+which is what we're avoiding, so leaf pages aren't a stratum of
+their own, the sampled ones are only counted.  Each stratum gets
+ESTIMATE_STRATUM_MINIMUM pages first, then pages go to whichever
+has had the smallest share of its pages so far, so the sample ends
+up proportional whenever the budget runs out.
+
+Totals are the usual stratified estimates, sum of N * mean with
+variance sum of N^2 ( 1 - n/N ) s^2 / n, the deleted ratio is a
+ratio estimate.  A stratum with only one page sampled has no
+variance to go on, its interval is left at 0.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int UNDARK_estimate( struct undark *g, double budget, struct undark_estimate *e ) {
+	struct estimate_sums sums[UNDARK_STRATA];
+	uint32_t *order[UNDARK_STRATA] = { NULL, NULL, NULL };
+	uint32_t fill[UNDARK_STRATA] = { 0, 0, 0 };
+	uint8_t *stratum = NULL;
+	uint64_t random_state = ESTIMATE_SEED;
+	uint32_t pages, n;
+	double start, var_rows = 0, var_deleted = 0, var_seconds = 0, var_ratio = 0;
+	int h, result = UNDARK_ERROR;
+
+	if (!g->db_origin) {
+		snprintf(g->error, sizeof(g->error), "No input opened");
+		return UNDARK_ERROR;
+	}
+
+	memset(e, 0, sizeof(struct undark_estimate));
+	memset(sums, 0, sizeof(sums));
+	start = estimate_clock();
+
+	stratum = page_strata( g, &pages );
+	if (!stratum) goto nomem;
+
+	for (n = 1; n <= pages; n++) e->strata[stratum[n]].pages++;
+	for (h = 0; h < UNDARK_STRATA; h++) {
+		if (!e->strata[h].pages) continue;
+		order[h] = malloc( (size_t)e->strata[h].pages *sizeof(uint32_t) );
+		if (!order[h]) goto nomem;
+	}
+	for (n = 1; n <= pages; n++) order[stratum[n]][fill[stratum[n]]++] = n;
+	e->pages = pages;
+
+	for (;;) {
+		struct estimate_count count;
+		struct estimate_sums *sum;
+		uint32_t page, left, r;
+		unsigned char *type;
+		double t, best_share = 0;
+		int best = -1;
+
+		for (h = 0; h < UNDARK_STRATA; h++) {
+			struct undark_estimate_stratum *st = &(e->strata[h]);
+			double share;
+
+			if (st->sampled >= st->pages) continue;
+			share = (st->sampled < ESTIMATE_STRATUM_MINIMUM) ? -1.0 : (st->sampled +1.0) /st->pages;
+			if ((best < 0) || (share < best_share)) {
+				best = h;
+				best_share = share;
+			}
+		}
+		if (best < 0) break; // every page sampled
+		if ((e->sampled > 0) && (estimate_clock() -start >= budget)) break;
+
+		/* without replacement, a partial shuffle of the stratum's pages */
+		h = best;
+		left = e->strata[h].pages -e->strata[h].sampled;
+		r = e->strata[h].sampled +(uint32_t)(estimate_random( &random_state ) %left);
+		page = order[h][r];
+		order[h][r] = order[h][e->strata[h].sampled];
+		order[h][e->strata[h].sampled] = page;
+
+		count.rows = count.deleted = 0;
+		count.deleted_all = (h != UNDARK_STRATUM_BTREE);
+		t = estimate_clock();
+		if (UNDARK_carve_pages( g, page, page, estimate_row, &count ) == UNDARK_ERROR) goto done;
+		t = estimate_clock() -t;
+
+		type = (unsigned char *)g->db_origin +(size_t)(page -1) *g->page_size +((page == 1) ? 100 : 0);
+		if (*type == 13) e->strata[h].sampled_leaf++;
+		e->strata[h].sampled++;
+		e->sampled++;
+
+		sum = &(sums[h]);
+		sum->n++;
+		sum->y += count.rows;
+		sum->yy += (double)count.rows *count.rows;
+		sum->d += count.deleted;
+		sum->dd += (double)count.deleted *count.deleted;
+		sum->dy += (double)count.deleted *count.rows;
+		sum->t += t;
+		sum->tt += t *t;
+	}
+	e->elapsed = estimate_clock() -start;
+
+	/**
+	 * Stratified totals, then the deleted ratio
+	 */
+	e->complete = 1;
+	for (h = 0; h < UNDARK_STRATA; h++) {
+		struct undark_estimate_stratum *st = &(e->strata[h]);
+		struct estimate_sums *sum = &(sums[h]);
+		double N = st->pages, k, fpc;
+
+		if (!st->pages) continue;
+		if (!sum->n) {
+			e->complete = 0;
+			continue;
+		}
+		st->rows = N *sum->y /sum->n;
+		st->deleted = N *sum->d /sum->n;
+		st->seconds = N *sum->t /sum->n;
+		e->rows += st->rows;
+		e->deleted += st->deleted;
+		e->seconds += st->seconds;
+		if (sum->n < 2) continue;
+
+		fpc = 1.0 -sum->n /N;
+		k = N *N *fpc /sum->n /(sum->n -1);
+		st->rows_ci = k *(sum->yy -sum->y *sum->y /sum->n);
+		st->deleted_ci = k *(sum->dd -sum->d *sum->d /sum->n);
+		st->seconds_ci = k *(sum->tt -sum->t *sum->t /sum->n);
+		var_rows += st->rows_ci;
+		var_deleted += st->deleted_ci;
+		var_seconds += st->seconds_ci;
+		st->rows_ci = ESTIMATE_Z *sqrt( fmax( st->rows_ci, 0 ) );
+		st->deleted_ci = ESTIMATE_Z *sqrt( fmax( st->deleted_ci, 0 ) );
+		st->seconds_ci = ESTIMATE_Z *sqrt( fmax( st->seconds_ci, 0 ) );
+	}
+	e->rows_ci = ESTIMATE_Z *sqrt( fmax( var_rows, 0 ) );
+	e->deleted_ci = ESTIMATE_Z *sqrt( fmax( var_deleted, 0 ) );
+	e->seconds_ci = ESTIMATE_Z *sqrt( fmax( var_seconds, 0 ) );
+
+	if (e->rows > 0) {
+		double R = e->deleted /e->rows;
+
+		for (h = 0; h < UNDARK_STRATA; h++) {
+			struct estimate_sums *sum = &(sums[h]);
+			double N = e->strata[h].pages, residual;
+
+			if (sum->n < 2) continue;
+			/* sum of ( d -R y )^2 less its mean's share */
+			residual = sum->dd -2 *R *sum->dy +R *R *sum->yy;
+			residual -= (sum->d -R *sum->y) *(sum->d -R *sum->y) /sum->n;
+			var_ratio += N *N *(1.0 -sum->n /N) /sum->n /(sum->n -1) *residual;
+		}
+		e->deleted_ratio = R;
+		e->deleted_ratio_ci = ESTIMATE_Z *sqrt( fmax( var_ratio, 0 ) ) /e->rows;
+	}
+
+	result = UNDARK_OK;
+	goto done;
+
+nomem:
+	snprintf(g->error, sizeof(g->error), "Cannot allocate memory for the page sample");
+
+done:
+	for (h = 0; h < UNDARK_STRATA; h++) {
+		if (order[h]) free( order[h] );
+	}
+	if (stratum) free( stratum );
+
+	return result;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-155117
+  Function Name	: UNDARK_index_write
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark *g,
+  2.  const char *file ,
+  ------------------
+  Exit Codes	: UNDARK_OK, UNDARK_ERROR
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Every record the carves after this accept ( before date/grep
+filtering ) is also written to a carve index in file, which
+UNDARK_carve_index() can later re-decode without searching the
+image again.  Call once the image is open, the index is tied to
+its header.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int UNDARK_index_write( struct undark *g, const char *file ) {
+	struct recindex_header h;
+
+	if (!g->db_origin) {
+		snprintf(g->error, sizeof(g->error), "No input opened");
+		return UNDARK_ERROR;
+	}
+
+	h.version = RECINDEX_VERSION;
+	h.page_size = g->page_size;
+	page_reader_fetch( &(g->reader), 0, 100 );
+	h.image_hash = recindex_image_hash( (unsigned char *)g->db_origin, 100 );
+	if (recindex_create( &(g->index), file, &h )) {
+		snprintf(g->error, sizeof(g->error), "Cannot create carve index '%s' ( %s )", file, strerror(errno));
+		recindex_close( &(g->index) );
+		return UNDARK_ERROR;
+	}
+	g->indexing = 1;
+
+	return UNDARK_OK;
+}
+
+
+
+
+/**
+ * YIELD_* of a page, stratum from page_strata().  Only the b-tree
+ * page header is looked at, page 1's is after the database header.
+ */
+static int yield_class( struct undark *g, uint32_t page, uint8_t stratum ) {
+	size_t offset = (size_t)(page -1) *g->page_size;
+	unsigned char *h;
+	uint32_t cells, content;
+	int64_t gap;
+
+	if (stratum != UNDARK_STRATUM_BTREE) return YIELD_DELETED;
+
+	h = (unsigned char *)g->db_origin +offset +(page == 1 ? 100 : 0);
+	page_reader_fetch( &(g->reader), (char *)h -g->db_origin, 8 );
+	if ((char *)h +7 > g->db_end) return YIELD_OTHER;
+	if (h[0] != 13) return YIELD_OTHER; // only table leaves hold rows
+
+	if ((h[1] | h[2]) || (h[7])) return YIELD_DELETED;
+
+	cells = (h[3] << 8) | h[4];
+	content = (h[5] << 8) | h[6];
+	if (content == 0) content = 65536;
+	gap = (int64_t)content -((char *)h -g->db_origin -offset +8 +2 *cells);
+	if (gap >= (int64_t)g->opt.rs_min) return YIELD_GAP;
+
+	return YIELD_OTHER;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-181540
+  Function Name	: carve_yield
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark *g,
+  2.  undark_row_callback cb,
+  3.  void *arg ,
+  ------------------
+  Exit Codes	: UNDARK_OK, UNDARK_STOPPED, UNDARK_ERROR
+  Side Effects	: every page header is read before the first page is carved
+  --------------------------------------------------------------------
+Comments:
+
+UNDARK_SCAN_YIELD.  Pages are put in YIELD_* classes from their
+headers and the freelist, then each class is carved in turn, in
+file order within the class, as runs of consecutive pages.  Every
+page is still carved exactly once, with the same result it would
+give in a file order walk, only the order rows come out in changes.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int carve_yield( struct undark *g, undark_row_callback cb, void *arg ) {
+	uint8_t *class;
+	uint32_t pages, n, first;
+	uint64_t rows;
+	int c, r = UNDARK_OK;
+
+	if (!g->db_origin) {
+		snprintf(g->error, sizeof(g->error), "No input opened");
+		return UNDARK_ERROR;
+	}
+
+	class = page_strata( g, &pages );
+	if (!class) {
+		snprintf(g->error, sizeof(g->error), "Cannot allocate memory for the page classes");
+		return UNDARK_ERROR;
+	}
+	for (n = 1; n <= pages; n++) {
+		class[n] = yield_class( g, n, class[n] );
+		g->yield_pages[class[n]]++;
+	}
+
+	for (c = 0; c < YIELD_CLASSES; c++) {
+		for (n = 1; n <= pages; n++) {
+			if (class[n] != c) continue;
+			for (first = n; (n < pages) && (class[n +1] == c); n++);
+
+			rows = g->rows_delivered;
+			r = UNDARK_carve_pages( g, first, n, cb, arg );
+			g->yield_rows[c] += g->rows_delivered -rows;
+			if (r != UNDARK_OK) goto done;
+		}
+	}
+
+done:
+	free( class );
+
+	return r;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-131733
+  Function Name	: UNDARK_carve
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark *g,
+  2.  undark_row_callback cb,
+  3.  void *arg ,
+  ------------------
+  Exit Codes	: UNDARK_OK, UNDARK_STOPPED, UNDARK_ERROR
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Walks the image a page at a time, calling cb for every row that
+decodes.  cb returning non-zero stops the walk ( UNDARK_STOPPED ).
+
+--------------------------------------------------------------------
+Changes:
+20261018: now UNDARK_carve_pages() over the whole image.
+20261018: opt.scan_order UNDARK_SCAN_YIELD carves the pages likeliest
+to hold deleted records first ( carve_yield() ).
+
+\------------------------------------------------------------------*/
+int UNDARK_carve( struct undark *g, undark_row_callback cb, void *arg ) {
+	if (g->opt.scan_order == UNDARK_SCAN_YIELD) return carve_yield( g, cb, arg );
+
+	return UNDARK_carve_pages( g, 1, 0, cb, arg );
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-152208
+  Function Name	: UNDARK_carve_pages
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark *g,
+  2.  uint32_t first,
+  3.  uint32_t last,
+  4.  undark_row_callback cb,
+  5.  void *arg ,
+  ------------------
+  Exit Codes	: UNDARK_OK, UNDARK_STOPPED, UNDARK_ERROR
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Carves pages first..last ( 1 based, last 0 for to the end ).  Can be
+called any number of times on the one open image, a range other
+than the whole image reads just the pages it needs rather than
+waiting on the sequential front.
+
+--------------------------------------------------------------------
+Changes:
+20261018: traced, "fetch", "classify" and "page" spans per page, all
+sampled together so a recorded page has all three.
+20261018: a range holds its current page ( page_reader_hold ) so the
+overflow lookups it makes can't push it out of the read pool.
+
+\------------------------------------------------------------------*/
+int UNDARK_carve_pages( struct undark *g, uint32_t first, uint32_t last, undark_row_callback cb, void *arg ) {
+	int ranged = ((first > 1) || (last > 0));
+
+	if (!g->db_origin) {
+		snprintf(g->error, sizeof(g->error), "No input opened");
+		return UNDARK_ERROR;
+	}
+
+	if ((g->grep.patterns) && (kwsearch_compile( &(g->grep) ))) {
+		snprintf(g->error, sizeof(g->error), "Cannot allocate memory for the grep patterns");
+		return UNDARK_ERROR;
+	}
+
+	if (first < 1) first = 1;
+	if ((last > 0) && (last < first)) return UNDARK_OK;
+	if ((size_t)(first -1) *g->page_size >= g->db_size) return UNDARK_OK;
+
+	g->callback = cb;
+	g->callback_arg = arg;
+	g->status = UNDARK_OK;
+	g->page_number = first;
+
+	g->db_cfp = g->db_cpp = g->db_origin +(size_t)(first -1) *g->page_size;
+
+	/*
+		if ((g->freelist_space_only)&&(g->freelist_page_count)) {
+		g->freelist_pages_current_index = 0;
+		data = f+((g->freelist_pages[g->freelist_pages_current_index]-1) *g->page_size);
+		}
+	 */
+
+	DEBUG fprintf(stdout,"%s:%d:DEBUG: Commence decoding data\n", FL );
+	fflush(stdout);
+
+	while ((g->db_cpp < g->db_end) && ((last == 0) || (g->page_number <= last))) {
+		struct sqlite_leaf_header leaf;
+		int freeblock_mode = 0;
+		uint64_t tp = trace_start( TRACE_SAMPLED ); // one sampling decision for all of this page's spans
+		uint64_t tc, rows, candidates;
+		int carve;
+
+		/* load the next page from the file in to the scratch pad */
+		g->db_cfp = g->db_cpp;
+		io_policy_scan_front( &(g->io), g->db_cpp -g->db_origin );
+		if (ranged) page_reader_hold( &(g->reader), g->db_cpp -g->db_origin, 2 *g->page_size );
+		else page_reader_wait( &(g->reader), (g->db_cpp -g->db_origin) +2 *g->page_size ); // the page, plus slack for records running over its end
+		if (g->reader.backend == READER_DECOMPRESS) {
+			g->db_size = page_reader_size( &(g->reader) );
+			g->db_end = g->db_origin +g->db_size -1;
+			if (g->db_cpp >= g->db_end) break;
+		}
+		if ((tp) && (g->reader.backend != READER_MMAP)) { // mapped, there's nothing to wait for
+			trace_span( tp, "fetch", "io", "\"page\":%u", g->page_number );
+			tp = trace_clock( TRACE_ALWAYS );
+		}
+		g->db_cpp_limit = g->db_cpp +g->page_size ; // was -1 ?
+
+		if ((g->page_same) && (g->page_number <= g->page_same_count) && (g->page_same[g->page_number])) {
+			DEBUG fprintf(stdout,"%s:%d:DEBUG: Page %u is in the baseline or a duplicate, skipping\n", FL, g->page_number );
+			g->db_cpp += g->page_size;
+			g->page_number++;
+			continue;
+		}
+
+		DEBUG fprintf(stdout,"\n\n%s:%d:-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=START.\n", FL);
+
+		/* process the block, mostly this is just removing any 0-bytes
+			from the block so our strstr() calls aren't prematurely terminated.
+		 */
+		DEBUG {
+			char *p;
+			size_t l;
+			int bc = 0;
+
+			fprintf(stdout,"%s:%d:Dumping main block in RAW... [ Page No: %lu, Offset: %lu (0x%X),  size : %d ]\n"
+					, FL
+					, (long unsigned int)g->page_number
+					, (long unsigned int)(g->db_cpp -g->db_origin)
+					, (unsigned int)(g->db_cpp -g->db_origin)
+					,  g->page_size
+					);
+
+			p = g->db_cfp;
+			l = g->page_size;
+			while (l--) {
+				{ if (isprint(*p)) { fprintf(stdout,"%c", *p); } else fprintf(stdout,"_");}
+				p++;
+				bc++;
+				if (bc%128 == 0) fprintf(stdout,"\n");
+			}
+			fprintf(stdout,"\n");
+			fflush(stdout);
+		} // debug
+
+
+
+		leaf.freeblock_offset = 0;
+		leaf.freeblock_size = 0;
+		leaf.freeblock_next = 0;
+		leaf.page_number = g->page_number;
+
+		/* Decode the page header */
+		if (*(g->db_cfp) == 13) { 
+
+			DEBUG fprintf(stdout,"%s:%d:DEBUG: Decoding page header for page %d\n", FL , g->page_number );
+			fflush(stdout);
+			leaf.page_byte = 13;
+
+			/**
+			 * Get freeblock offset and determine if we have a free block in this
+			 * page that needs to be inspected.  This is one of the more commonly
+			 * needed parts of data for our row recovery 
+			 *
+			 */
+			memcpy( &(leaf.freeblock_offset), (g->db_cfp +1), 2 );
+			leaf.freeblock_offset = ntohs( leaf.freeblock_offset );
+			if (leaf.freeblock_offset > 0) {
+				uint16_t next, sz, off;
+
+				freeblock_mode = 1;
+				off = leaf.freeblock_offset;
+
+				DEBUG fprintf(stdout,"%s:%d:DEBUG: FREEBLOCK mode ON: header decode [offset=%u]\n", FL , leaf.freeblock_offset);
+
+				do {
+					DEBUG hdump((unsigned char *)(g->db_cfp +off), 16, "Freeblock header data");
+
+					memcpy( &next, ( g->db_cfp +off ), 2 );
+					next = ntohs( next );
+					memcpy( &sz, ( g->db_cfp +off +2 ), 2 );
+					sz = ntohs( sz );
+
+					DEBUG fprintf(stdout,"%s:%d:DEBUG: Freeblock size = %u, next position = %u\n", FL, sz, next );
+
+					if (next) off = next;
+				} while (next);
+				DEBUG fprintf(stdout,"%s:%d:DEBUG: END OF FREEBLOCK TRACE\n", FL);
+
+				memcpy( &(leaf.freeblock_next), ( g->db_cfp +leaf.freeblock_offset ), 2 );
+				leaf.freeblock_next = ntohs( leaf.freeblock_next );
+				memcpy( &(leaf.freeblock_size), ( g->db_cfp +leaf.freeblock_offset +2 ), 2 );
+				leaf.freeblock_size = ntohs( leaf.freeblock_size );
+			}
+
+			DEBUG fprintf(stdout,"%s:%d:DEBUG: Freeblock offset = %u, size = %u, next block = %u \n", FL , leaf.freeblock_offset, leaf.freeblock_size, leaf.freeblock_next );
+			if (leaf.freeblock_size > 0) {
+				DEBUG fprintf(stdout,"%s:%d:DEBUG: Freeblock data [ %d bytes total [4 bytes for header] ]\n", FL, leaf.freeblock_size );
+				DEBUG hdump( (unsigned char *)(g->db_cfp +leaf.freeblock_offset+4), leaf.freeblock_size-4, "Actual data in free block" );
+			}
+			fflush(stdout);
+			//				leaf.freeblock_offset = ntohs( ta );
+			leaf.cellcount = ntohs(*(g->db_cfp+3));
+			leaf.cell_offset = ntohs(*(g->db_cfp+5));
+			leaf.freebytes = (*(g->db_cfp+7));
+
+			DEBUG fprintf(stdout,"%s:%d:DEBUG: PAGEHEADER:%d pagebyte: %d, freeblock offset: %d, cell count: %d, first cell offset %d, free bytes %d\n", FL 
+					, leaf.page_number
+					, leaf.page_byte
+					, leaf.freeblock_offset
+					, leaf.cellcount
+					, leaf.cell_offset
+					, leaf.freebytes
+					);
+
+			/**
+			 * If we're wanting free block sourced data, then simply jump
+			 * to the start of the free block space and commence the searching
+			 * in the next section ( find_next_row ).
+			 *
+			 * After this the g->db_cfp pointer should be sitting on the first
+			 * varint of the payload header which defines the header length
+			 * (inclusive)
+			 *
+			 * Detecting rows in the freeblocks is done differently to the 
+			 * normal data, so 
+			 *
+			 */
+			if (g->opt.freelist_space_only) {
+
+				if ((leaf.freeblock_offset > 0) && (leaf.freeblock_size > 0)) {
+
+					DEBUG fprintf(stdout,"%s:%d:DEBUG: Shifting to freespace at %d from page start\n", FL , leaf.freeblock_offset);
+					g->db_cfp = g->db_cfp + leaf.freeblock_offset +4;
+
+					DEBUG fprintf(stdout,"%s:%d:DEBUG: New position = %p\n", FL , g->db_cfp);
+					DEBUG hdump((unsigned char *)g->db_cfp -4,32, "Scratch pointer at freespace data start (including 4 byte header)");
+					DEBUG fflush(stdout);
+				}
+			}
+
+			fflush(stdout);
+		} // if we have a leaf page, which we can decode the header on.
+
+
+
+
+		//if ((leaf.page_byte == 13)) {
+		carve = 1;
+		if (g->grep.patterns) {
+			tc = tp ? trace_clock( TRACE_ALWAYS ) : 0;
+			carve = grep_page( g );
+			if (tc) trace_span( tc, "classify", "carve", "\"page\":%u,\"carve\":%d", g->page_number, carve );
+		}
+		rows = g->rows_delivered;
+		candidates = g->candidates;
+		if (carve) {
+
+			char *row;
+			spanset_clear( &(g->accepted) );
+			{
+				/* every failed candidate moves us on one byte, so the
+				 * varints get mapped once for the page rather than decoded
+				 * again from each start that runs in to them */
+				size_t l = (size_t)g->page_size +VARINT_MAP_SLACK;
+
+				if (l > (size_t)((g->db_origin +g->db_size) -g->db_cpp)) l = (g->db_origin +g->db_size) -g->db_cpp;
+				if (!g->opt.plain_decode) varint_map_build( &(g->varints), g->db_cpp, l );
+			}
+			row = g->db_cfp;
+			DEBUG fprintf(stdout,"%s:%d:DEBUG: g->db_cfp search at = %p\n", FL , g->db_cfp);
+			do {
+
+				if ((row > g->db_origin)&&(row < g->db_end)) {
+
+					row = find_next_row( g, row, g->db_cpp_limit, g->db_cfp, freeblock_mode, leaf.freeblock_size );
+					if (g->status) break;
+
+					//if (row > g->db_end) fprintf(stdout,"ERROR: beyond end point\n");
+					if (row > g->db_cpp_limit) fprintf(stdout,"ERROR: beyond end point\n");
+					if (row < g->db_cfp) DEBUG fprintf(stdout,"%s:%d:DEBUG: Row location not in g->db_cfp page\n", FL );
+					if (row == NULL) DEBUG fprintf(stdout,"%s:%d:DEBUG: Row has been returned as NULL\n", FL );
+					DEBUG fprintf(stdout,"%s:%d:DEBUG: ROW found at offset: %ld\n", FL, row-g->db_cfp);
+				} else {
+
+					break;
+				}
+
+			} while (row && (row < g->db_cpp_limit ));
+			//} while (row && (row < g->db_cpp_limit ) && (row < g->db_end) );
+
+			DEBUG fprintf(stdout,"%s:%d:DEBUG: Finished searching for rows in DB page %d\n", FL , g->page_number);
+		}
+		if (tp) trace_span( tp, "page", "carve", "\"page\":%u,\"candidates\":%llu,\"rows\":%llu", g->page_number
+				, (unsigned long long)(g->candidates -candidates), (unsigned long long)(g->rows_delivered -rows) );
+
+		/**
+		 * NOTE: Free #pages# are different to freeblocks within a page
+		 *
+		 *
+		 if ((g->freelist_space_only)&&(g->freelist_page_count)) {
+		 g->freelist_pages_current_index++;
+		 if (g->freelist_pages_current_index > g->freelist_page_count) {
+		 DEBUG fprintf(stdout,"%s:%d:DEBUG:Out of freespace pages, exiting search\n", FL );
+		 break;
+		 }
+		 data = f+((g->freelist_pages[g->freelist_pages_current_index] -1) *g->page_size);
+		 } else {
+		 */
+		{
+			g->db_cpp += g->page_size;
+			g->page_number++;
+		}
+
+		if (g->status) break;
+
+	} // while (data < endpoint)
+	varint_map_clear( &(g->varints) );
+
+	if ((g->indexing) && (g->status != UNDARK_ERROR) && (recindex_flush( &(g->index) ))) {
+		snprintf(g->error, sizeof(g->error), "Cannot write to the carve index ( %s )", strerror(errno));
+		g->status = UNDARK_ERROR;
+	}
+
+	return g->status;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-155342
+  Function Name	: UNDARK_carve_index
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark *g,
+  2.  const char *file,
+  3.  undark_row_callback cb,
+  4.  void *arg ,
+  ------------------
+  Exit Codes	: UNDARK_OK, UNDARK_STOPPED, UNDARK_ERROR
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Re-carves just the records listed in a carve index written by
+UNDARK_index_write() from this image, no candidate search.  Each
+record is decoded again where the index says it is, so the cell
+count/row size limits and date/grep filters in force now apply,
+but one that no longer decodes the same ( different rowid, length,
+types or overflow head ) is counted as stale and passed over.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int UNDARK_carve_index( struct undark *g, const char *file, undark_row_callback cb, void *arg ) {
+	struct recindex x;
+	struct recindex_header h;
+	struct recindex_record r;
+	struct sql_payload *sql = g->candidate;
+	int n;
+
+	if (!g->db_origin) {
+		snprintf(g->error, sizeof(g->error), "No input opened");
+		return UNDARK_ERROR;
+	}
+
+	if ((g->grep.patterns) && (kwsearch_compile( &(g->grep) ))) {
+		snprintf(g->error, sizeof(g->error), "Cannot allocate memory for the grep patterns");
+		return UNDARK_ERROR;
+	}
+
+	page_reader_fetch( &(g->reader), 0, 100 );
+	n = recindex_open( &x, file, &h );
+	if (n == 1) snprintf(g->error, sizeof(g->error), "Cannot read carve index '%s' ( %s )", file, strerror(errno));
+	else if (n == 2) snprintf(g->error, sizeof(g->error), "'%s' is not a carve index this version of undark can read", file);
+	else if (h.page_size != g->page_size) {
+		snprintf(g->error, sizeof(g->error), "Carve index '%s' was written with a page size of %u, not %u", file, h.page_size, g->page_size);
+		n = 3;
+	} else if (h.image_hash != recindex_image_hash( (unsigned char *)g->db_origin, 100 )) {
+		snprintf(g->error, sizeof(g->error), "Carve index '%s' was written from a different image", file);
+		n = 3;
+	}
+	if (n) {
+		recindex_close( &x );
+		return UNDARK_ERROR;
+	}
+
+	g->callback = cb;
+	g->callback_arg = arg;
+	g->status = UNDARK_OK;
+
+	while ((g->status == UNDARK_OK) && ((n = recindex_next( &x, &r )) == 1)) {
+		size_t page_offset = (size_t)(r.page -1) *g->page_size;
+		int mode = r.freespace ? DECODE_MODE_FREESPACE : DECODE_MODE_NORMAL;
+		char *p;
+
+		g->index_read++;
+		if ((r.page < 1) || (r.offset < page_offset) || (r.offset >= page_offset +g->page_size)) {
+			g->index_stale++;
+			continue;
+		}
+
+		page_reader_hold( &(g->reader), page_offset, 2 *g->page_size );
+		if (g->reader.backend == READER_DECOMPRESS) {
+			g->db_size = page_reader_size( &(g->reader) );
+			g->db_end = g->db_origin +g->db_size -1;
+		}
+		if (r.offset +PAYLOAD_SIZE_MINIMUM >= g->db_size) {
+			g->index_stale++;
+			continue;
+		}
+
+		g->page_number = r.page;
+		g->db_cpp = g->db_origin +page_offset;
+		g->db_cpp_limit = g->db_cpp +g->page_size;
+		p = g->db_origin +r.offset;
+
+		g->candidates++;
+		if ((!decode_row( g, p, g->db_cpp_limit, sql, mode, r.forced_length ))
+				|| ((!r.freespace) && (sql->rowid != r.rowid))
+				|| (sql->length != r.length)
+				|| (sql->cell_count +1 != r.cell_count)
+				|| (sql->overflow_pages[0] != r.overflow)
+				|| (row_signature( sql ) != r.signature)) {
+			DEBUG fprintf(stdout,"%s:%d:DEBUG: Index record at %llu no longer decodes the same, skipping\n", FL, (unsigned long long)r.offset );
+			g->index_stale++;
+			continue;
+		}
+		sql->confidence = r.confidence;
+
+		deliver_row( g, p, g->db_cpp_limit, sql, mode );
+	}
+
+	if ((n < 0) && (g->status == UNDARK_OK)) {
+		snprintf(g->error, sizeof(g->error), "Carve index '%s' is truncated or unreadable after %llu records", file, (unsigned long long)g->index_read);
+		g->status = UNDARK_ERROR;
+	}
+	recindex_close( &x );
+
+	if ((g->indexing) && (g->status != UNDARK_ERROR) && (recindex_flush( &(g->index) ))) {
+		snprintf(g->error, sizeof(g->error), "Cannot write to the carve index ( %s )", strerror(errno));
+		g->status = UNDARK_ERROR;
+	}
+
+	return g->status;
+}
+
+
+
+
+int UNDARK_stats( struct undark *g, FILE *f ) {
+	page_reader_stats( &(g->reader), f );
+	io_policy_stats( &(g->io), f );
+	if (g->grep.patterns) {
+		fprintf(f,"grep: %d patterns, %llu of %llu pages carved, %llu of %llu rows matched\n", g->grep.patterns
+				, (unsigned long long)g->grep_pages_carved, (unsigned long long)g->grep_pages
+				, (unsigned long long)g->grep_rows_matched, (unsigned long long)g->grep_rows);
+	}
+	if (g->date_filter) {
+		fprintf(f,"date: %llu of %llu rows had a timestamp in range\n"
+				, (unsigned long long)g->date_rows_matched, (unsigned long long)g->date_rows);
+	}
+	if (g->signatures.count) {
+		int i;
+
+		fprintf(f,"signatures:");
+		for (i = 0; i < g->signatures.count; i++) {
+			fprintf(f,"%s %s %llu", i ? "," : "", g->signatures.sigs[i].name, (unsigned long long)g->signatures.sigs[i].matched);
+		}
+		fprintf(f," records matched\n");
+	}
+	if (g->baseline) {
+		fprintf(f,"baseline: %llu of %u pages unchanged, %llu of %llu baseline pages carved, %llu rows already in the baseline\n"
+				, (unsigned long long)g->pages_same, g->page_same_count
+				, (unsigned long long)g->baseline_pages_carved, (unsigned long long)g->baseline_pages
+				, (unsigned long long)g->baseline_rows_suppressed);
+	}
+	if (g->dedup) {
+		fprintf(f,"dedup: %llu of %u pages repeat an earlier page, not carved\n", (unsigned long long)g->pages_duplicate, g->page_same_count);
+	}
+	if (g->opt.scan_order == UNDARK_SCAN_YIELD) {
+		fprintf(f,"scan-order: yield, %llu likely deleted pages ( %llu rows ), %llu with unallocated space ( %llu rows ), %llu others ( %llu rows )\n"
+				, (unsigned long long)g->yield_pages[YIELD_DELETED], (unsigned long long)g->yield_rows[YIELD_DELETED]
+				, (unsigned long long)g->yield_pages[YIELD_GAP], (unsigned long long)g->yield_rows[YIELD_GAP]
+				, (unsigned long long)g->yield_pages[YIELD_OTHER], (unsigned long long)g->yield_rows[YIELD_OTHER]);
+	}
+	if (g->ptrmap_type) {
+		fprintf(f,"ptrmap: %llu map pages read, %llu overflow steps checked, %llu chains rejected\n"
+				, (unsigned long long)g->ptrmap_maps, (unsigned long long)g->ptrmap_steps, (unsigned long long)g->ptrmap_rejected);
+	}
+	if (g->indexing) fprintf(f,"index: %llu records written\n", (unsigned long long)g->index_written);
+	if (g->index_read) {
+		fprintf(f,"index: %llu records read, %llu stale\n", (unsigned long long)g->index_read, (unsigned long long)g->index_stale);
+	}
+	fprintf(f,"candidates: %llu decoded, %llu skipped inside accepted records, %llu overlaps resolved, %llu rows delivered\n"
+			, (unsigned long long)g->candidates, (unsigned long long)g->candidates_skipped
+			, (unsigned long long)g->conflicts, (unsigned long long)g->rows_delivered);
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-131901
+  Function Name	: UNDARK_close
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark *g ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Unmaps/stops reading the image and frees the context.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int UNDARK_close( struct undark *g ) {
+
+	if (!g) return 0;
+
+	if (g->reader.backend != READER_MMAP) page_reader_close( &(g->reader) );
+	else io_policy_unmap( &(g->io) );
+	if (g->fd >= 0) close(g->fd);
+	if (g->freelist_pages) free(g->freelist_pages);
+	if (g->ptrmap_type) free(g->ptrmap_type);
+	if (g->ptrmap_parent) free(g->ptrmap_parent);
+	if (g->ptrmap_loaded) free(g->ptrmap_loaded);
+	kwsearch_free( &(g->grep) );
+	sigmatch_free( &(g->signatures) );
+	varint_map_free( &(g->varints) );
+	recindex_close( &(g->index) );
+	pagehash_table_free( &(g->baseline_rows) );
+	if (g->page_same) free(g->page_same);
+	spanset_free( &(g->accepted) );
+	if (g->candidate) free(g->candidate);
+	if (g->input_file) free(g->input_file);
+	free(g);
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-132012
+  Function Name	: UNDARK_cell_integer
+  Returns Type	: int64_t
+  ----Parameter List
+  1. const struct undark_cell *c ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Value of an integer cell ( serial types 1..6, 8 and 9 ), 0 for
+anything else.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int64_t UNDARK_cell_integer( const struct undark_cell *c ) {
+
+	if (c->type == UNDARK_CELL_ONE) return 1;
+	if ((c->type < 1) || (c->type > 6)) return 0;
+	if (c->length < (size_t)numfmt_serial_size( c->type )) return 0;
+
+	return numfmt_be_int( (const unsigned char *)c->data, numfmt_serial_size( c->type ) );
+}
+
+
+
+
+double UNDARK_cell_real( const struct undark_cell *c ) {
+
+	if ((c->type != UNDARK_CELL_REAL) || (c->length < 8)) return (double)UNDARK_cell_integer( c );
+
+	return numfmt_be_double( (const unsigned char *)c->data );
+}
@@ -0,0 +1,164 @@
+#ifndef UNDARK_LIBUNDARK_H
+#define UNDARK_LIBUNDARK_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * libundark - the undark carving engine, without the CSV.
+ *
+ * Open an image, then carve it, every row found is handed to a
+ * callback as an array of typed cells.  Cell data points straight
+ * in to the image ( or in to a copy assembled from the overflow
+ * chain ), so it is only valid for the duration of the callback.
+ * The exception is an image UNDARK_image_mapped() says is mmap'd
+ * whole, where data outside an overflow copy stays put until
+ * UNDARK_close(); the pread/uring backends and compressed images
+ * reuse the memory behind pages the carve has moved past.
+ *
+ * Nothing here calls exit(), failures come back as UNDARK_ERROR
+ * with the reason available from UNDARK_error().
+ */
+
+#define UNDARK_OK 0
+#define UNDARK_ERROR 1
+#define UNDARK_STOPPED 2 // the row callback asked us to stop
+
+#define UNDARK_INPUT_MMAP 0
+#define UNDARK_INPUT_PREAD 1
+#define UNDARK_INPUT_URING 2
+
+#define UNDARK_CELL_NULL 0
+#define UNDARK_CELL_REAL 7
+#define UNDARK_CELL_ZERO 8
+#define UNDARK_CELL_ONE 9
+#define UNDARK_CELL_BLOB 12
+#define UNDARK_CELL_TEXT 13
+
+#define UNDARK_CONFIDENCE_MAX 100
+
+#define UNDARK_TEXT_UTF8 1 // as stored at header offset 56
+#define UNDARK_TEXT_UTF16LE 2
+#define UNDARK_TEXT_UTF16BE 3
+
+#define UNDARK_SCAN_FILE 0 // pages in file order
+#define UNDARK_SCAN_YIELD 1 // pages most likely to hold deleted records first ( see UNDARK_carve )
+
+struct undark; // carving context, private to libundark.c
+
+struct undark_options {
+	uint8_t debug; // very large dumps to stdout
+	uint8_t verbose;
+
+	int cc_min, cc_max;  // cell count limits
+	size_t rs_min, rs_max; // row/payload limits
+	uint32_t page_size; // 0 to take it from the header
+	uint32_t page_start, page_end;
+	int fine_search;
+	int freelist_space_only;
+	int removed_only;
+	size_t freespace_minimum;
+
+	int io_flags; // IO_POLICY_* ( see UNDARK_options_io_policy )
+	size_t io_window;
+	int input_backend; // UNDARK_INPUT_*
+	size_t read_chunk;
+	int read_depth;
+	size_t decompress_reserve; // 0 to guess
+	int text_encoding; // UNDARK_TEXT_*, 0 to take it from the header
+	int64_t date_after, date_before; // Unix seconds, INT64_MIN/MAX for no limit ( see UNDARK_options_date )
+	int64_t date_latest; // Unix seconds, no timestamp reads as later than this, 0 for a day past the time of UNDARK_new()
+	int plain_decode; // no varint map or prefix rejection, every candidate fully decoded ( --self-check's yardstick )
+	int scan_order; // UNDARK_SCAN_*
+	int ptrmap_check; // overflow chains must agree with an autovacuum image's pointer map
+};
+
+/**
+ * type is the SQLite serial type for 0..9, blobs and text are
+ * folded to UNDARK_CELL_BLOB/TEXT with the size in length.
+ * Integers ( 1..6 ) and reals ( 7 ) are left big-endian in the
+ * record, see UNDARK_cell_integer/real.  Text is as stored, in the
+ * database's encoding ( see UNDARK_text_encoding ).
+ */
+struct undark_cell {
+	int type;
+	const char *data;
+	size_t length;
+};
+
+struct undark_row {
+	uint64_t rowid;
+	int freespace; // carved from a freeblock, the rowid isn't known
+	int overflow; // assembled from an overflow chain
+	uint32_t page; // page the record starts in
+	size_t offset; // of the record in the image
+	size_t length; // payload length from the record
+	int cell_count;
+	int confidence; // 0..UNDARK_CONFIDENCE_MAX, how well the record hangs together
+	struct undark_cell *cells;
+};
+
+typedef int (*undark_row_callback)( struct undark_row *row, void *arg );
+
+#define UNDARK_STRATUM_BTREE 0 // within the header's page count, not on the freelist
+#define UNDARK_STRATUM_FREELIST 1 // freelist trunk and leaf pages
+#define UNDARK_STRATUM_UNALLOCATED 2 // past the header's page count
+#define UNDARK_STRATA 3
+
+/**
+ * What UNDARK_estimate() expects a full carve to find, every total
+ * with the half width of its 95% confidence interval ( _ci ).
+ * Deleted rows are those carved from freeblocks, freelist pages and
+ * unallocated pages.  seconds is carving alone, writing the rows
+ * out isn't counted.
+ */
+struct undark_estimate_stratum {
+	uint32_t pages, sampled;
+	uint32_t sampled_leaf; // of those sampled, how many were table leaves
+	double rows, rows_ci;
+	double deleted, deleted_ci;
+	double seconds, seconds_ci;
+};
+
+struct undark_estimate {
+	struct undark_estimate_stratum strata[UNDARK_STRATA];
+	uint32_t pages, sampled;
+	int complete; // every stratum with pages was sampled, otherwise the totals leave some out
+	double elapsed; // seconds spent sampling
+	double rows, rows_ci;
+	double deleted, deleted_ci;
+	double deleted_ratio, deleted_ratio_ci;
+	double seconds, seconds_ci;
+};
+
+int UNDARK_options_init( struct undark_options *o );
+int UNDARK_options_io_policy( struct undark_options *o, const char *list );
+int UNDARK_options_input_backend( struct undark_options *o, const char *name );
+int UNDARK_options_text_encoding( struct undark_options *o, const char *name );
+int UNDARK_options_date( int64_t *t, const char *when );
+
+struct undark *UNDARK_new( const struct undark_options *o );
+int UNDARK_open( struct undark *g, const char *input_file );
+int UNDARK_carve( struct undark *g, undark_row_callback cb, void *arg );
+int UNDARK_carve_pages( struct undark *g, uint32_t first, uint32_t last, undark_row_callback cb, void *arg );
+int UNDARK_baseline( struct undark *g, const char *file );
+int UNDARK_dedup_pages( struct undark *g, const char *table );
+int UNDARK_estimate( struct undark *g, double budget, struct undark_estimate *e );
+int UNDARK_index_write( struct undark *g, const char *file );
+int UNDARK_carve_index( struct undark *g, const char *file, undark_row_callback cb, void *arg );
+const char *UNDARK_error( struct undark *g );
+int UNDARK_text_encoding( struct undark *g );
+uint32_t UNDARK_page_size( struct undark *g );
+uint32_t UNDARK_page_count( struct undark *g );
+int UNDARK_image_mapped( struct undark *g );
+int UNDARK_grep_add( struct undark *g, const char *pattern, size_t l );
+int UNDARK_grep_load( struct undark *g, const char *file );
+int UNDARK_signature_add( struct undark *g, const char *list );
+int UNDARK_stats( struct undark *g, FILE *f );
+int UNDARK_close( struct undark *g );
+
+int64_t UNDARK_cell_integer( const struct undark_cell *c );
+double UNDARK_cell_real( const struct undark_cell *c );
+
+#endif
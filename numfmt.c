@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include "numfmt.h"
+
+static const char digit_pairs[] =
+"00010203040506070809"
+"10111213141516171819"
+"20212223242526272829"
+"30313233343536373839"
+"40414243444546474849"
+"50515253545556575859"
+"60616263646566676869"
+"70717273747576777879"
+"80818283848586878889"
+"90919293949596979899";
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-111402
+  Function Name	: numfmt_be_int
+  Returns Type	: int64_t
+  ----Parameter List
+  1. const unsigned char *p,
+  2.  int bytes ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Big-endian two's complement integer of 1..8 bytes, sign extended
+to 64 bits.  SQLite uses 1, 2, 3, 4, 6 and 8 byte widths.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int64_t numfmt_be_int( const unsigned char *p, int bytes ) {
+	uint64_t v;
+	int i;
+
+	v = (p[0] & 0x80) ? UINT64_MAX : 0; // preload the sign
+	for (i = 0; i < bytes; i++) {
+		v = (v << 8) | p[i];
+	}
+
+	return (int64_t)v;
+}
+
+
+
+
+double numfmt_be_double( const unsigned char *p ) {
+	uint64_t v = 0;
+	double d;
+	int i;
+
+	for (i = 0; i < 8; i++) v = (v << 8) | p[i];
+	memcpy(&d, &v, sizeof(d));
+
+	return d;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-111519
+  Function Name	: numfmt_int64
+  Returns Type	: size_t
+  ----Parameter List
+  1. char *dst,
+  2.  int64_t v ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Integer to ASCII, two digits per step.  dst is not terminated,
+returns the number of bytes written ( at most 20 ).
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+size_t numfmt_int64( char *dst, int64_t v ) {
+	char tmp[NUMFMT_BUFFER_SIZE];
+	char *p = tmp +sizeof(tmp);
+	uint64_t u;
+	size_t l;
+
+	u = (v < 0) ? (uint64_t)0 -(uint64_t)v : (uint64_t)v;
+
+	while (u >= 100) {
+		unsigned int pair = (u % 100) *2;
+		u /= 100;
+		*--p = digit_pairs[pair +1];
+		*--p = digit_pairs[pair];
+	}
+	if (u >= 10) {
+		*--p = digit_pairs[u *2 +1];
+		*--p = digit_pairs[u *2];
+	} else {
+		*--p = '0' +u;
+	}
+	if (v < 0) *--p = '-';
+
+	l = tmp +sizeof(tmp) -p;
+	memcpy(dst, p, l);
+
+	return l;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-111647
+  Function Name	: numfmt_double
+  Returns Type	: size_t
+  ----Parameter List
+  1. char *dst,
+  2.  double d ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Shortest decimal that reads back as the same double.  Whole
+numbers below 2^53 go through the integer path and get a ".0"
+so they still read as REAL.  Otherwise we try 15, 16 then 17
+significant digits - 17 always round trips.  A denormal holds
+fewer than 15 digits, so 15 can round trip without being the
+shortest, those are tried from 1 digit up.
+
+--------------------------------------------------------------------
+Changes:
+20261018: denormals searched from 1 digit, 5e-324 came out as
+4.94065645841247e-324.
+
+\------------------------------------------------------------------*/
+size_t numfmt_double( char *dst, double d ) {
+	char tmp[NUMFMT_BUFFER_SIZE];
+	int precision;
+	int l = 0;
+
+	if (isnan(d)) { memcpy(dst, "NaN", 3); return 3; }
+	if (isinf(d)) {
+		if (d < 0) { memcpy(dst, "-Inf", 4); return 4; }
+		memcpy(dst, "Inf", 3);
+		return 3;
+	}
+
+	if ((d == floor(d)) && (fabs(d) < 9007199254740992.0)) {
+		size_t il;
+
+		if ((d == 0) && (signbit(d))) { memcpy(dst, "-0.0", 4); return 4; }
+		il = numfmt_int64( dst, (int64_t)d );
+		dst[il++] = '.';
+		dst[il++] = '0';
+		return il;
+	}
+
+	for (precision = (fabs(d) < DBL_MIN) ? 1 : 15; precision <= 17; precision++) {
+		l = snprintf(tmp, sizeof(tmp), "%.*g", precision, d);
+		if (strtod(tmp, NULL) == d) break;
+	}
+
+	memcpy(dst, tmp, l);
+
+	return l;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-111803
+  Function Name	: numfmt_serial_size
+  Returns Type	: int
+  ----Parameter List
+  1. int serial_type ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Byte width of the numeric serial types, -1 for anything that
+isn't a fixed size number.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int numfmt_serial_size( int serial_type ) {
+	switch (serial_type) {
+		case 1: return 1;
+		case 2: return 2;
+		case 3: return 3;
+		case 4: return 4;
+		case 5: return 6;
+		case 6: return 8;
+		case 7: return 8;
+		case 8: case 9: return 0;
+	}
+
+	return -1;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-111920
+  Function Name	: numfmt_serial
+  Returns Type	: size_t
+  ----Parameter List
+  1. char *dst,
+  2.  int serial_type,
+  3.  const unsigned char *p ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Formats a numeric cell ( serial types 1..9 ) in to dst, which
+must have NUMFMT_BUFFER_SIZE bytes.  Returns 0 for non-numeric
+serial types.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+size_t numfmt_serial( char *dst, int serial_type, const unsigned char *p ) {
+
+	switch (serial_type) {
+		case 1: case 2: case 3: case 4: case 5: case 6:
+			return numfmt_int64( dst, numfmt_be_int( p, numfmt_serial_size( serial_type ) ) );
+		case 7:
+			return numfmt_double( dst, numfmt_be_double( p ) );
+		case 8:
+			*dst = '0';
+			return 1;
+		case 9:
+			*dst = '1';
+			return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef UNDARK_NUMFMT_H
+#define UNDARK_NUMFMT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NUMFMT_BUFFER_SIZE 32 // enough for any int64 or double we produce
+
+int64_t numfmt_be_int( const unsigned char *p, int bytes );
+double numfmt_be_double( const unsigned char *p );
+size_t numfmt_int64( char *dst, int64_t v );
+size_t numfmt_double( char *dst, double d );
+int numfmt_serial_size( int serial_type );
+size_t numfmt_serial( char *dst, int serial_type, const unsigned char *p );
+
+#endif
@@ -0,0 +1,331 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "outbuf.h"
+#include "outzip.h"
+#include "trace.h"
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-093512
+  Function Name	: outbuf_init
+  Returns Type	: int
+  ----Parameter List
+  1. struct outbuf *ob,
+  2.  int fd ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int outbuf_init( struct outbuf *ob, int fd ) {
+	ob->fd = fd;
+	ob->unbuffered = 0;
+	ob->failed = 0;
+	ob->zip = NULL;
+	ob->iovcnt = 0;
+	ob->scratch_used = 0;
+	ob->pending = 0;
+	ob->bytes_written = 0;
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-093540
+  Function Name	: outbuf_flush
+  Returns Type	: int
+  ----Parameter List
+  1. struct outbuf *ob ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Submits the whole gather list, resubmitting the remainder on
+short writes.  Any stdio data on stdout is flushed first so that
+debug/diagnostic lines stay in order with the row data.
+
+--------------------------------------------------------------------
+Changes:
+20261018: a failed write is remembered, later flushes just drop
+their data rather than reporting the same error for every row.
+20261018: hands the list to an outzip when compressing.
+20261018: traced, "flush" span.
+
+\------------------------------------------------------------------*/
+int outbuf_flush( struct outbuf *ob ) {
+	struct iovec *iov = ob->iov;
+	int iovcnt = ob->iovcnt;
+	uint64_t t = trace_start( TRACE_SAMPLED );
+	uint64_t before = ob->bytes_written;
+
+	fflush(stdout);
+
+	if (ob->failed) iovcnt = 0; // already reported, don't keep at it
+
+	if (ob->zip) {
+		for (; iovcnt > 0; iov++, iovcnt--) {
+			if (outzip_write( ob->zip, iov->iov_base, iov->iov_len )) {
+				fprintf(stderr,"ERROR: %s\n", ob->zip->error);
+				ob->failed = 1;
+				break;
+			}
+			ob->bytes_written += iov->iov_len;
+		}
+		iovcnt = 0;
+	}
+
+	while (iovcnt > 0) {
+		ssize_t written;
+
+#ifndef _WIN32
+		written = writev( ob->fd, iov, iovcnt );
+#else
+		written = write( ob->fd, iov->iov_base, iov->iov_len );
+#endif
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			fprintf(stderr,"ERROR: Cannot write output ( %s )\n", strerror(errno));
+			ob->failed = 1;
+			ob->iovcnt = 0;
+			ob->scratch_used = 0;
+			ob->pending = 0;
+			return 1;
+		}
+
+		ob->bytes_written += written;
+		while ((iovcnt > 0) && ((size_t)written >= iov->iov_len)) {
+			written -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (char *)iov->iov_base +written;
+			iov->iov_len -= written;
+		}
+	}
+
+	ob->iovcnt = 0;
+	ob->scratch_used = 0;
+	ob->pending = 0;
+	if (t) trace_span( t, "flush", "output", "\"bytes\":%llu", (unsigned long long)(ob->bytes_written -before) );
+
+	return ob->failed;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-093603
+  Function Name	: outbuf_ref
+  Returns Type	: int
+  ----Parameter List
+  1. struct outbuf *ob,
+  2.  const char *p,
+  3.  size_t l ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Queues a span by reference, no copy.  Very short spans are copied
+into the scratch instead, they'd otherwise just burn iovec slots.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int outbuf_ref( struct outbuf *ob, const char *p, size_t l ) {
+
+	if (l == 0) return 0;
+	if (l < OUTBUF_REF_MINIMUM) return outbuf_copy( ob, p, l );
+
+	if (ob->iovcnt >= OUTBUF_IOV_MAX) {
+		if (outbuf_flush( ob )) return 1;
+	}
+
+	ob->iov[ob->iovcnt].iov_base = (void *)p;
+	ob->iov[ob->iovcnt].iov_len = l;
+	ob->iovcnt++;
+	ob->pending += l;
+
+	if (ob->unbuffered) return outbuf_flush( ob );
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-093627
+  Function Name	: *outbuf_reserve
+  Returns Type	: char
+  ----Parameter List
+  1. struct outbuf *ob,
+  2.  size_t l ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Hands back l bytes of scratch space which are already part of the
+gather list, the caller must fill all of them.  Consecutive scratch
+writes are merged in to the same iovec.
+
+Returns NULL if l is larger than the scratch buffer.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+char *outbuf_reserve( struct outbuf *ob, size_t l ) {
+	char *p;
+	struct iovec *last;
+
+	if (l > OUTBUF_SCRATCH_SIZE) return NULL;
+
+	if ((ob->scratch_used +l > OUTBUF_SCRATCH_SIZE)||(ob->iovcnt >= OUTBUF_IOV_MAX)) {
+		if (outbuf_flush( ob )) return NULL;
+	}
+
+	p = ob->scratch +ob->scratch_used;
+	last = ob->iovcnt ? &(ob->iov[ob->iovcnt -1]) : NULL;
+
+	if ((last) && ((char *)last->iov_base +last->iov_len == p)) {
+		last->iov_len += l;
+	} else {
+		ob->iov[ob->iovcnt].iov_base = p;
+		ob->iov[ob->iovcnt].iov_len = l;
+		ob->iovcnt++;
+	}
+
+	ob->scratch_used += l;
+	ob->pending += l;
+
+	return p;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-093655
+  Function Name	: outbuf_copy
+  Returns Type	: int
+  ----Parameter List
+  1. struct outbuf *ob,
+  2.  const char *p,
+  3.  size_t l ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int outbuf_copy( struct outbuf *ob, const char *p, size_t l ) {
+
+	while (l > 0) {
+		size_t chunk = l;
+		char *d;
+
+		if (chunk > OUTBUF_SCRATCH_SIZE) chunk = OUTBUF_SCRATCH_SIZE;
+		d = outbuf_reserve( ob, chunk );
+		if (!d) return 1;
+		memcpy( d, p, chunk );
+		p += chunk;
+		l -= chunk;
+	}
+
+	if (ob->unbuffered) return outbuf_flush( ob );
+
+	return 0;
+}
+
+
+
+
+int outbuf_putc( struct outbuf *ob, char c ) {
+	char *d;
+
+	d = outbuf_reserve( ob, 1 );
+	if (!d) return 1;
+	*d = c;
+
+	if (ob->unbuffered) return outbuf_flush( ob );
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-093721
+  Function Name	: outbuf_printf
+  Returns Type	: int
+  ----Parameter List
+  1. struct outbuf *ob,
+  2.  const char *fmt,
+  3.  ... ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Formats straight in to the scratch buffer, for the odd bits of
+output that aren't worth a dedicated formatter.  Output longer
+than the scratch buffer is truncated.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int outbuf_printf( struct outbuf *ob, const char *fmt, ... ) {
+	va_list ap;
+	char tmp[256];
+	int l;
+
+	va_start(ap, fmt);
+	l = vsnprintf( tmp, sizeof(tmp), fmt, ap );
+	va_end(ap);
+	if (l < 0) return 1;
+
+	if ((size_t)l < sizeof(tmp)) return outbuf_copy( ob, tmp, l );
+
+	{
+		char *big;
+
+		if (l > OUTBUF_SCRATCH_SIZE) l = OUTBUF_SCRATCH_SIZE;
+		big = malloc( l +1 );
+		if (!big) return 1;
+		va_start(ap, fmt);
+		vsnprintf( big, l +1, fmt, ap );
+		va_end(ap);
+		l = outbuf_copy( ob, big, l );
+		free( big );
+	}
+
+	return l;
+}
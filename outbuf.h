@@ -0,0 +1,59 @@
+#ifndef UNDARK_OUTBUF_H
+#define UNDARK_OUTBUF_H
+
+#include <stddef.h>
+#ifndef _WIN32
+#include <sys/uio.h>
+#else
+struct iovec {
+	void *iov_base;
+	size_t iov_len;
+};
+#endif
+
+struct outzip;
+
+#define OUTBUF_IOV_MAX 512
+#define OUTBUF_SCRATCH_SIZE 65536
+#define OUTBUF_REF_MINIMUM 16 // spans shorter than this are cheaper to copy than to reference
+
+/**
+ * Row output gather list.
+ *
+ * Spans that can go out unchanged ( mostly text straight from the mmap )
+ * are referenced in place, anything that has to be generated ( escapes,
+ * hex, numbers, separators ) is written into the scratch buffer.  The
+ * whole list is handed to writev() in one go.
+ *
+ * Referenced memory must stay valid until the next outbuf_flush(),
+ * which may be a long way off ( a --split-output sink, the reorder
+ * spool ), so only memory that lives for the whole run should be
+ * referenced.  Cell data does only when UNDARK_image_mapped() says
+ * the image is mmap'd whole, the pread/uring backends and the
+ * decompressor recycle theirs as the carve moves on, anything else
+ * goes in by outbuf_copy().
+ * With zip set the flush copies the list in to the compressor
+ * instead, it does the writing.
+ */
+struct outbuf {
+	int fd;
+	int unbuffered; // flush after every append ( debug mode, keeps ordering with stdio )
+	int failed; // a write has failed since outbuf_init, later ones aren't attempted
+	struct outzip *zip; // compress on the way out rather than writing to fd, NULL for plain
+	int iovcnt;
+	size_t scratch_used;
+	size_t pending;
+	size_t bytes_written;
+	struct iovec iov[OUTBUF_IOV_MAX];
+	char scratch[OUTBUF_SCRATCH_SIZE];
+};
+
+int outbuf_init( struct outbuf *ob, int fd );
+int outbuf_ref( struct outbuf *ob, const char *p, size_t l );
+int outbuf_copy( struct outbuf *ob, const char *p, size_t l );
+int outbuf_putc( struct outbuf *ob, char c );
+char *outbuf_reserve( struct outbuf *ob, size_t l );
+int outbuf_printf( struct outbuf *ob, const char *fmt, ... );
+int outbuf_flush( struct outbuf *ob );
+
+#endif
@@ -0,0 +1,521 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#ifdef UNDARK_ZLIB
+#include <zlib.h>
+#endif
+#ifdef UNDARK_ZSTD
+#include <zstd.h>
+#endif
+
+#include "outzip.h"
+#include "trace.h"
+
+#define GZIP_HEADER_SIZE 24 // with the "UD" extra field
+#define GZIP_TRAILER_SIZE 8
+#define SEEKABLE_SKIPPABLE_MAGIC 0x184D2A5E
+#define SEEKABLE_MAGIC 0x8F92EAB1
+
+
+static void put_le32( unsigned char *p, uint32_t v ) {
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+	p[2] = (v >> 16) & 0xff;
+	p[3] = (v >> 24) & 0xff;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-165122
+  Function Name	: outzip_method
+  Returns Type	: int
+  ----Parameter List
+  1. const char *spec,
+  2.  int *method,
+  3.  int *level ,
+  ------------------
+  Exit Codes	: 1 for a spec we don't know, 2 if this build can't
+  				  do it
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+spec is none, gzip or zstd, optionally followed by :<level>
+( gzip 1..9, default 6, zstd 1..22, default 3 ).
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int outzip_method( const char *spec, int *method, int *level ) {
+	const char *colon = strchr( spec, ':' );
+	size_t l = colon ? (size_t)(colon -spec) : strlen( spec );
+	int max;
+
+	if ((l == 4) && (strncmp( spec, "none", 4 ) == 0)) {
+		*method = OUTZIP_NONE;
+		*level = 0;
+		return colon ? 1 : 0;
+	} else if ((l == 4) && (strncmp( spec, "gzip", 4 ) == 0)) {
+		*method = OUTZIP_GZIP;
+		*level = 6;
+		max = 9;
+	} else if ((l == 4) && (strncmp( spec, "zstd", 4 ) == 0)) {
+		*method = OUTZIP_ZSTD;
+		*level = 3;
+		max = 22;
+	} else return 1;
+
+	if (colon) {
+		char *end;
+		long v = strtol( colon +1, &end, 10 );
+
+		if ((end == colon +1) || (*end) || (v < 1) || (v > max)) return 1;
+		*level = v;
+	}
+
+#ifndef UNDARK_ZLIB
+	if (*method == OUTZIP_GZIP) return 2;
+#endif
+#ifndef UNDARK_ZSTD
+	if (*method == OUTZIP_ZSTD) return 2;
+#endif
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-165348
+  Function Name	: compress_block
+  Returns Type	: int
+  ----Parameter List
+  1. struct outzip *z,
+  2.  struct outzip_block *b ,
+  ------------------
+  Exit Codes	: 1 on failure, b->failed is set as well
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Compresses b->in in to b->out as one self contained frame.  Run by
+the workers without the lock, b is theirs while it's BUSY.
+
+gzip members are put together by hand ( raw deflate between our
+own header and trailer ) because the member's length has to go in
+its header and isn't known until it's compressed.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int compress_block( struct outzip *z, struct outzip_block *b ) {
+	uint64_t t = trace_start( TRACE_ALWAYS );
+
+	b->out_used = 0;
+	b->failed = 1;
+
+#ifdef UNDARK_ZLIB
+	if (z->method == OUTZIP_GZIP) {
+		unsigned char *h = (unsigned char *)b->out;
+		z_stream s;
+
+		memset(&s, 0, sizeof(s));
+		if (deflateInit2( &s, z->level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY ) != Z_OK) return 1;
+		s.next_in = (Bytef *)b->in;
+		s.avail_in = b->in_used;
+		s.next_out = (Bytef *)b->out +GZIP_HEADER_SIZE;
+		s.avail_out = b->out_size -GZIP_HEADER_SIZE -GZIP_TRAILER_SIZE;
+		if (deflate( &s, Z_FINISH ) != Z_STREAM_END) {
+			deflateEnd( &s );
+			return 1;
+		}
+		b->out_used = GZIP_HEADER_SIZE +s.total_out +GZIP_TRAILER_SIZE;
+		deflateEnd( &s );
+
+		h[0] = 0x1f; h[1] = 0x8b; h[2] = 8; h[3] = 0x04; // deflate, FEXTRA
+		put_le32( h +4, 0 ); // no mtime
+		h[8] = 0; h[9] = 255; // OS unknown
+		h[10] = 12; h[11] = 0; // XLEN
+		h[12] = 'U'; h[13] = 'D'; h[14] = 8; h[15] = 0;
+		put_le32( h +16, b->out_used );
+		put_le32( h +20, b->in_used );
+
+		put_le32( (unsigned char *)b->out +b->out_used -8, crc32( crc32( 0, NULL, 0 ), (Bytef *)b->in, b->in_used ) );
+		put_le32( (unsigned char *)b->out +b->out_used -4, b->in_used );
+		b->failed = 0;
+	}
+#endif
+
+#ifdef UNDARK_ZSTD
+	if (z->method == OUTZIP_ZSTD) {
+		size_t r = ZSTD_compress( b->out, b->out_size, b->in, b->in_used, z->level );
+
+		if (ZSTD_isError( r )) return 1;
+		b->out_used = r;
+		b->failed = 0;
+	}
+#endif
+	if (t) trace_span( t, "compress", "output", "\"in\":%lu,\"out\":%lu", (unsigned long)b->in_used, (unsigned long)b->out_used );
+
+	return b->failed;
+}
+
+
+
+
+/**
+ * Worker thread, compresses READY blocks, oldest first, until
+ * outzip_close() says to stop and there are none left.
+ */
+static void *worker_main( void *arg ) {
+	struct outzip *z = arg;
+
+	trace_thread( "compress" );
+	pthread_mutex_lock( &(z->lock) );
+	for (;;) {
+		struct outzip_block *b = NULL;
+		int i;
+
+		for (i = 0; i < z->block_count; i++) {
+			if ((z->blocks[i].state == OUTZIP_BLOCK_READY) && ((!b) || (z->blocks[i].sequence < b->sequence))) b = &(z->blocks[i]);
+		}
+		if (!b) {
+			if (z->stopping) break;
+			pthread_cond_wait( &(z->cond), &(z->lock) );
+			continue;
+		}
+
+		b->state = OUTZIP_BLOCK_BUSY;
+		pthread_mutex_unlock( &(z->lock) );
+		compress_block( z, b );
+		pthread_mutex_lock( &(z->lock) );
+		b->state = OUTZIP_BLOCK_DONE;
+		pthread_cond_broadcast( &(z->cond) );
+	}
+	pthread_mutex_unlock( &(z->lock) );
+
+	return NULL;
+}
+
+
+
+
+/**
+ * Writes all of p, riding out short writes.  Once a write has
+ * failed nothing more is written.
+ */
+static int write_all( struct outzip *z, const char *p, size_t l ) {
+
+	while ((l > 0) && (!z->failed)) {
+		ssize_t written = write( z->fd, p, l );
+
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			snprintf(z->error, sizeof(z->error), "Cannot write output ( %s )", strerror(errno));
+			z->failed = 1;
+			break;
+		}
+		z->bytes_out += written;
+		p += written;
+		l -= written;
+	}
+
+	return z->failed;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-165731
+  Function Name	: drain
+  Returns Type	: int
+  ----Parameter List
+  1. struct outzip *z,
+  2.  uint64_t upto ,
+  ------------------
+  Exit Codes	:
+  Side Effects	: called, and returns, with z->lock held
+  --------------------------------------------------------------------
+Comments:
+
+Writes frames in sequence order, waiting on the workers for every
+one before upto, then carrying on with any others already done.
+The lock is dropped while writing.  Time spent waiting shows up in
+the trace as "wait", the producer is ahead of the workers.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int drain( struct outzip *z, uint64_t upto ) {
+	uint64_t waiting = 0, t;
+
+	while (z->writing < z->filling) {
+		struct outzip_block *b = &(z->blocks[z->writing %z->block_count]);
+
+		if (b->state != OUTZIP_BLOCK_DONE) {
+			if (z->writing >= upto) break;
+			if (!waiting) waiting = trace_start( TRACE_ALWAYS );
+			pthread_cond_wait( &(z->cond), &(z->lock) );
+			continue;
+		}
+
+		pthread_mutex_unlock( &(z->lock) );
+		if (waiting) trace_span( waiting, "wait", "output", "\"frame\":%llu", (unsigned long long)z->writing );
+		waiting = 0;
+		t = trace_start( TRACE_ALWAYS );
+		if ((b->failed) && (!z->failed)) {
+			snprintf(z->error, sizeof(z->error), "Cannot compress output");
+			z->failed = 1;
+		}
+		if (!z->failed) {
+			write_all( z, b->out, b->out_used );
+			if (z->frame_count >= z->frames_allocated) {
+				size_t n = z->frames_allocated ? z->frames_allocated *2 : 1024;
+				uint32_t *frames = realloc( z->frames, n *2 *sizeof(uint32_t) );
+
+				if (frames) {
+					z->frames = frames;
+					z->frames_allocated = n;
+				}
+			}
+			if (z->frame_count < z->frames_allocated) {
+				z->frames[z->frame_count *2] = b->out_used;
+				z->frames[z->frame_count *2 +1] = b->in_used;
+				z->frame_count++;
+			} else if (!z->failed) {
+				snprintf(z->error, sizeof(z->error), "Cannot allocate memory for the output frame index");
+				z->failed = 1;
+			}
+		}
+		if (t) trace_span( t, "write", "output", "\"frame\":%llu,\"bytes\":%lu", (unsigned long long)z->writing, (unsigned long)b->out_used );
+		pthread_mutex_lock( &(z->lock) );
+
+		b->in_used = 0;
+		b->state = OUTZIP_BLOCK_FREE;
+		z->writing++;
+	}
+
+	return z->failed;
+}
+
+
+
+
+/**
+ * Hands the block being filled to the workers and moves on to the
+ * next, writing out whatever's been compressed while we're here.
+ */
+static int submit( struct outzip *z ) {
+	struct outzip_block *b = &(z->blocks[z->filling %z->block_count]);
+
+	pthread_mutex_lock( &(z->lock) );
+	b->sequence = z->filling;
+	b->state = OUTZIP_BLOCK_READY;
+	z->filling++;
+	pthread_cond_broadcast( &(z->cond) );
+
+	/* the next block in the ring has to have been written before we fill it */
+	drain( z, (z->filling >= (uint64_t)z->block_count) ? z->filling -z->block_count +1 : 0 );
+	pthread_mutex_unlock( &(z->lock) );
+
+	return z->failed;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-165902
+  Function Name	: outzip_open
+  Returns Type	: int
+  ----Parameter List
+  1. struct outzip *z,
+  2.  int fd,
+  3.  int method,
+  4.  int level,
+  5.  int threads ,
+  ------------------
+  Exit Codes	: 1 on failure, reason in z->error
+  Side Effects	: starts the worker threads
+  --------------------------------------------------------------------
+Comments:
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int outzip_open( struct outzip *z, int fd, int method, int level, int threads ) {
+	size_t bound = 0;
+	int i;
+
+	memset(z, 0, sizeof(struct outzip));
+	z->fd = fd;
+	z->method = method;
+	z->level = level;
+	if (threads < 1) threads = 1;
+	if (threads > OUTZIP_THREADS_MAX) threads = OUTZIP_THREADS_MAX;
+	z->threads = threads;
+
+#ifdef UNDARK_ZLIB
+	if (method == OUTZIP_GZIP) bound = compressBound( OUTZIP_BLOCK_SIZE ) +GZIP_HEADER_SIZE +GZIP_TRAILER_SIZE;
+#endif
+#ifdef UNDARK_ZSTD
+	if (method == OUTZIP_ZSTD) bound = ZSTD_compressBound( OUTZIP_BLOCK_SIZE );
+#endif
+	if (!bound) {
+		snprintf(z->error, sizeof(z->error), "Output compression not supported by this build");
+		return 1;
+	}
+
+	z->block_count = threads *2 +1;
+	z->blocks = calloc( z->block_count, sizeof(struct outzip_block) );
+	if (!z->blocks) goto nomem;
+	for (i = 0; i < z->block_count; i++) {
+		z->blocks[i].in = malloc( OUTZIP_BLOCK_SIZE );
+		z->blocks[i].out = malloc( bound );
+		z->blocks[i].out_size = bound;
+		if ((!z->blocks[i].in) || (!z->blocks[i].out)) goto nomem;
+	}
+
+	pthread_mutex_init( &(z->lock), NULL );
+	pthread_cond_init( &(z->cond), NULL );
+	for (i = 0; i < threads; i++) {
+		if (pthread_create( &(z->workers[i]), NULL, worker_main, z ) != 0) break;
+		z->started++;
+	}
+	if (!z->started) {
+		snprintf(z->error, sizeof(z->error), "Cannot start the output compression thread ( %s )", strerror(errno));
+		pthread_mutex_destroy( &(z->lock) );
+		pthread_cond_destroy( &(z->cond) );
+		goto fail;
+	}
+
+	return 0;
+
+nomem:
+	snprintf(z->error, sizeof(z->error), "Cannot allocate memory for output compression");
+
+fail:
+	if (z->blocks) {
+		for (i = 0; i < z->block_count; i++) {
+			if (z->blocks[i].in) free(z->blocks[i].in);
+			if (z->blocks[i].out) free(z->blocks[i].out);
+		}
+		free(z->blocks);
+		z->blocks = NULL;
+	}
+
+	return 1;
+}
+
+
+
+
+/**
+ * Queues l bytes at p for output, they're copied so p can go as
+ * soon as we return.
+ */
+int outzip_write( struct outzip *z, const char *p, size_t l ) {
+
+	z->bytes_in += l;
+	while (l > 0) {
+		struct outzip_block *b = &(z->blocks[z->filling %z->block_count]);
+		size_t n = OUTZIP_BLOCK_SIZE -b->in_used;
+
+		if (n > l) n = l;
+		memcpy( b->in +b->in_used, p, n );
+		b->in_used += n;
+		p += n;
+		l -= n;
+
+		if ((b->in_used == OUTZIP_BLOCK_SIZE) && (submit( z ))) return 1;
+	}
+
+	return z->failed;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-170115
+  Function Name	: outzip_close
+  Returns Type	: int
+  ----Parameter List
+  1. struct outzip *z ,
+  ------------------
+  Exit Codes	: 1 if anything failed along the way, reason in
+  				  z->error
+  Side Effects	: stops the workers, doesn't close the fd
+  --------------------------------------------------------------------
+Comments:
+
+Compresses and writes the last, partial, block ( an empty one if
+there was no output at all, so it's still a valid file ), then
+the zstd seek table.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int outzip_close( struct outzip *z ) {
+	int i;
+
+	if (!z->blocks) return 1;
+
+	if ((z->blocks[z->filling %z->block_count].in_used > 0) || (z->filling == 0)) submit( z );
+
+	pthread_mutex_lock( &(z->lock) );
+	drain( z, z->filling );
+	z->stopping = 1;
+	pthread_cond_broadcast( &(z->cond) );
+	pthread_mutex_unlock( &(z->lock) );
+	for (i = 0; i < z->started; i++) pthread_join( z->workers[i], NULL );
+	pthread_mutex_destroy( &(z->lock) );
+	pthread_cond_destroy( &(z->cond) );
+
+	if ((z->method == OUTZIP_ZSTD) && (!z->failed)) {
+		size_t l = 8 +z->frame_count *8 +9;
+		unsigned char *t = malloc( l );
+		size_t f;
+
+		if (t) {
+			put_le32( t, SEEKABLE_SKIPPABLE_MAGIC );
+			put_le32( t +4, l -8 );
+			for (f = 0; f < z->frame_count; f++) {
+				put_le32( t +8 +f *8, z->frames[f *2] );
+				put_le32( t +8 +f *8 +4, z->frames[f *2 +1] );
+			}
+			put_le32( t +l -9, z->frame_count );
+			t[l -5] = 0; // no checksums
+			put_le32( t +l -4, SEEKABLE_MAGIC );
+			write_all( z, (char *)t, l );
+			free(t);
+		} else {
+			snprintf(z->error, sizeof(z->error), "Cannot allocate memory for the output seek table");
+			z->failed = 1;
+		}
+	}
+
+	for (i = 0; i < z->block_count; i++) {
+		free(z->blocks[i].in);
+		free(z->blocks[i].out);
+	}
+	free(z->blocks);
+	z->blocks = NULL;
+	if (z->frames) free(z->frames);
+	z->frames = NULL;
+
+	return z->failed;
+}
@@ -0,0 +1,76 @@
+#ifndef UNDARK_OUTZIP_H
+#define UNDARK_OUTZIP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define OUTZIP_NONE 0
+#define OUTZIP_GZIP 1
+#define OUTZIP_ZSTD 2
+
+#define OUTZIP_BLOCK_SIZE (1024 *1024) // uncompressed bytes per frame
+#define OUTZIP_THREADS_MAX 16
+
+#define OUTZIP_BLOCK_FREE 0
+#define OUTZIP_BLOCK_READY 1 // full, waiting for a worker
+#define OUTZIP_BLOCK_BUSY 2
+#define OUTZIP_BLOCK_DONE 3 // compressed, waiting to be written
+
+/**
+ * Compressed output ( --output-compress ).
+ *
+ * Output is cut in to OUTZIP_BLOCK_SIZE blocks and each one is
+ * compressed as a frame of its own by a pool of worker threads, so
+ * the carve only ever copies bytes in to a block.  Frames are
+ * written in order by the thread calling outzip_write()/
+ * outzip_close(), the workers never touch the file.
+ *
+ * Every frame decompresses on its own, which is what makes the
+ * output seekable.  gzip frames are gzip members ( gunzip reads
+ * them as one stream ) with an extra field, subfield "UD", holding
+ * the member's length and its uncompressed length, both 32 bit
+ * little endian, so a reader can step from member to member.  zstd
+ * output ends with the seek table of the zstd seekable format, a
+ * skippable frame listing the same two sizes for each frame.
+ */
+struct outzip_block {
+	char *in;
+	size_t in_used;
+	char *out;
+	size_t out_size, out_used;
+	uint64_t sequence;
+	int state; // OUTZIP_BLOCK_*
+	int failed;
+};
+
+struct outzip {
+	int fd;
+	int method; // OUTZIP_*
+	int level;
+	int threads;
+
+	struct outzip_block *blocks; // a ring of threads *2
+	int block_count;
+	uint64_t filling; // sequence of the block being filled
+	uint64_t writing; // next sequence to go out
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t workers[OUTZIP_THREADS_MAX];
+	int started, stopping;
+
+	uint32_t *frames; // compressed, uncompressed size pairs for the seek table
+	size_t frame_count, frames_allocated;
+
+	int failed;
+	uint64_t bytes_in, bytes_out;
+	char error[256];
+};
+
+int outzip_method( const char *spec, int *method, int *level );
+int outzip_open( struct outzip *z, int fd, int method, int level, int threads );
+int outzip_write( struct outzip *z, const char *p, size_t l );
+int outzip_close( struct outzip *z );
+
+#endif
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pagehash.h"
+
+#define PRIME1 0x9E3779B185EBCA87ULL
+#define PRIME2 0xC2B2AE3D27D4EB4FULL
+#define PRIME3 0x165667B19E3779F9ULL
+
+#define ROTL(x,r) (((x) << (r)) | ((x) >> (64 -(r))))
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-160214
+  Function Name	: pagehash_bytes
+  Returns Type	: uint64_t
+  ----Parameter List
+  1. const void *p,
+  2.  size_t l,
+  3.  uint64_t seed ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+One lane of multiply/rotate per eight bytes ( the xxHash64 round ),
+the tail a byte at a time, then a final avalanche so nearby pages
+don't land in nearby table slots.  Pass the previous result as
+seed to chain several buffers together.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+uint64_t pagehash_bytes( const void *p, size_t l, uint64_t seed ) {
+	const unsigned char *b = p;
+	uint64_t h = seed +PRIME3 +(uint64_t)l *PRIME1;
+	uint64_t v;
+
+	while (l >= 8) {
+		memcpy( &v, b, 8 );
+		v *= PRIME2;
+		v = ROTL( v, 31 );
+		v *= PRIME1;
+		h ^= v;
+		h = ROTL( h, 27 ) *PRIME1 +PRIME3;
+		b += 8;
+		l -= 8;
+	}
+	while (l--) {
+		h ^= (*b++) *PRIME3;
+		h = ROTL( h, 11 ) *PRIME1;
+	}
+
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+
+
+
+int pagehash_table_init( struct pagehash_table *t ) {
+	memset(t, 0, sizeof(struct pagehash_table));
+
+	return 0;
+}
+
+
+
+
+/**
+ * Doubles the table and puts every key back in to it.
+ */
+static int table_grow( struct pagehash_table *t ) {
+	size_t size = t->size ? t->size *2 : 1024;
+	uint64_t *keys;
+	uint32_t *values;
+	size_t i;
+
+	keys = calloc( size, sizeof(uint64_t) );
+	values = malloc( size *sizeof(uint32_t) );
+	if ((!keys) || (!values)) {
+		if (keys) free(keys);
+		if (values) free(values);
+		return 1;
+	}
+
+	for (i = 0; i < t->size; i++) {
+		size_t slot;
+
+		if (!t->keys[i]) continue;
+		slot = t->keys[i] & (size -1);
+		while (keys[slot]) slot = (slot +1) & (size -1);
+		keys[slot] = t->keys[i];
+		values[slot] = t->values[i];
+	}
+
+	if (t->keys) free(t->keys);
+	if (t->values) free(t->values);
+	t->keys = keys;
+	t->values = values;
+	t->size = size;
+
+	return 0;
+}
+
+
+
+
+/**
+ * Adds key ( 0 is taken as 1, it marks an empty slot ) unless it's
+ * already there.  1 if we're out of memory.
+ */
+int pagehash_table_add( struct pagehash_table *t, uint64_t key, uint32_t value ) {
+	size_t slot;
+
+	if (!key) key = 1;
+	if ((t->count +1) *2 > t->size) {
+		if (table_grow( t )) return 1;
+	}
+
+	slot = key & (t->size -1);
+	while (t->keys[slot]) {
+		if (t->keys[slot] == key) return 0;
+		slot = (slot +1) & (t->size -1);
+	}
+	t->keys[slot] = key;
+	t->values[slot] = value;
+	t->count++;
+
+	return 0;
+}
+
+
+
+
+/**
+ * 1 if key is in the table, with its value in *value ( if that's
+ * not NULL ).
+ */
+int pagehash_table_find( struct pagehash_table *t, uint64_t key, uint32_t *value ) {
+	size_t slot;
+
+	if (!t->size) return 0;
+	if (!key) key = 1;
+
+	slot = key & (t->size -1);
+	while (t->keys[slot]) {
+		if (t->keys[slot] == key) {
+			if (value) *value = t->values[slot];
+			return 1;
+		}
+		slot = (slot +1) & (t->size -1);
+	}
+
+	return 0;
+}
+
+
+
+
+int pagehash_table_free( struct pagehash_table *t ) {
+	if (t->keys) free(t->keys);
+	if (t->values) free(t->values);
+	t->keys = NULL;
+	t->values = NULL;
+	t->size = t->count = 0;
+
+	return 0;
+}
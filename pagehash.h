@@ -0,0 +1,32 @@
+#ifndef UNDARK_PAGEHASH_H
+#define UNDARK_PAGEHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Page and row hashing for --baseline.
+ *
+ * pagehash_bytes() is a fast 64 bit hash, eight bytes a step, for
+ * whole pages ( it's run over every page of both images ) and
+ * chained over row cells.  Hashes are only compared within the one
+ * run, they're never written out, so host byte order is fine.
+ *
+ * A pagehash_table maps 64 bit keys to a 32 bit value ( the page
+ * number, or 0 when it's just a set ), open addressing.  Only the
+ * first value added for a key is kept.
+ */
+struct pagehash_table {
+	uint64_t *keys; // 0 for an empty slot
+	uint32_t *values;
+	size_t size, count;
+};
+
+uint64_t pagehash_bytes( const void *p, size_t l, uint64_t seed );
+
+int pagehash_table_init( struct pagehash_table *t );
+int pagehash_table_add( struct pagehash_table *t, uint64_t key, uint32_t value );
+int pagehash_table_find( struct pagehash_table *t, uint64_t key, uint32_t *value );
+int pagehash_table_free( struct pagehash_table *t );
+
+#endif
@@ -0,0 +1,1900 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/uio.h>
+#else
+#include <mman.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#if defined(SYS_memfd_create) && defined(MAP_NORESERVE)
+#define READER_HAVE_MEMFD 1
+#endif
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define READER_HAVE_URING 1
+#endif
+#endif
+
+#ifdef UNDARK_ZLIB
+#include <zlib.h>
+#endif
+#ifdef UNDARK_ZSTD
+#include <zstd.h>
+#endif
+
+#include "pagereader.h"
+#include "trace.h"
+
+#define URING_PRIO_RANDOM ((2 << 13) | 0) // IOPRIO_CLASS_BE, highest level
+#define DECOMPRESS_INPUT_CHUNK (1024 *1024)
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-121530
+  Function Name	: read_at
+  Returns Type	: int
+  ----Parameter List
+  1. int fd,
+  2.  char *dst,
+  3.  size_t l,
+  4.  size_t offset ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Synchronous positioned read of the full range, short reads are
+retried.  Anything past EOF is left zeroed.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int read_at( int fd, char *dst, size_t l, size_t offset ) {
+
+	while (l > 0) {
+		ssize_t r;
+
+#ifndef _WIN32
+		r = pread( fd, dst, l, offset );
+#else
+		if (lseek( fd, offset, SEEK_SET ) < 0) return 1;
+		r = read( fd, dst, l );
+#endif
+		if (r < 0) {
+			if (errno == EINTR) continue;
+			return 1;
+		}
+		if (r == 0) break;
+		dst += r;
+		offset += r;
+		l -= r;
+	}
+
+	return 0;
+}
+
+
+
+
+/**
+ * Bytes in chunk c, the last one may be short.
+ */
+static size_t chunk_length( struct page_reader *r, size_t c ) {
+	size_t offset = c *r->chunk;
+
+	return (offset +r->chunk > r->size) ? r->size -offset : r->chunk;
+}
+
+
+
+
+static char *slot_buffer( struct page_reader *r, uint32_t s ) {
+	return r->pool +(size_t)s *r->chunk;
+}
+
+
+
+
+static int chunk_state( struct page_reader *r, size_t c ) {
+	uint32_t s = r->chunk_slot[c];
+
+	return (s == READER_NO_SLOT) ? CHUNK_EMPTY : r->slots[s].state;
+}
+
+
+
+
+/**
+ * Chunks that mustn't give up their slot: first..last ( the range
+ * being loaded ), the scanner's window and the reads queued ahead
+ * of it, page_reader_hold's range and the last decompressed fetch.
+ */
+static int chunk_pinned( struct page_reader *r, size_t c, size_t first, size_t last ) {
+
+	if ((c >= first) && (c <= last)) return 1;
+	if ((c >= r->window) && ((c < r->window_end) || (c < r->next_submit))) return 1;
+	if ((c >= r->hold_first) && (c <= r->hold_last)) return 1;
+	if ((c >= r->fetch_first) && (c <= r->fetch_last)) return 1;
+
+	return 0;
+}
+
+
+
+
+/**
+ * Gives chunk c's slot back to the pool, the image reads as zeros
+ * there again.  Only with a memfd pool.
+ */
+static void release_chunk( struct page_reader *r, size_t c ) {
+	uint32_t s = r->chunk_slot[c];
+
+#ifdef READER_HAVE_MEMFD
+	mmap( r->buf +c *r->chunk, r->chunk, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED|MAP_NORESERVE, -1, 0 );
+#endif
+	r->slots[s].state = CHUNK_EMPTY;
+	r->chunk_slot[c] = READER_NO_SLOT;
+	r->free_slots[r->free_count++] = s;
+}
+
+
+
+
+/**
+ * Moves the scanner's window to [end -READER_RETAIN, end), chunks it
+ * has moved past go back to the pool unless something else still
+ * wants them.  Returns 1 if it moved back ( a second carve ).
+ */
+static int move_window( struct page_reader *r, size_t end ) {
+	size_t window = (end > READER_RETAIN) ? (end -READER_RETAIN) /r->chunk : 0;
+	int rewound = (window < r->window);
+	size_t c;
+
+	if ((!rewound) && (r->pool_fd >= 0)) {
+		for (c = r->window; c < window; c++) {
+			uint32_t s = r->chunk_slot[c];
+
+			if ((s == READER_NO_SLOT) || (r->slots[s].state != CHUNK_DONE) || (r->slots[s].used)) continue;
+			if ((c >= r->hold_first) && (c <= r->hold_last)) continue;
+			if ((c >= r->fetch_first) && (c <= r->fetch_last)) continue;
+			release_chunk( r, c );
+			r->recycled++;
+		}
+	}
+	r->window = window;
+	r->window_end = (end +r->chunk -1) /r->chunk;
+
+	return rewound;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-190512
+  Function Name	: take_slot
+  Returns Type	: uint32_t
+  ----Parameter List
+  1. struct page_reader *r,
+  2.  size_t c,
+  3.  size_t first,
+  4.  size_t last ,
+  ------------------
+  Exit Codes	: READER_NO_SLOT if every slot is in use
+  Side Effects	: may push another chunk out of the pool
+  --------------------------------------------------------------------
+Comments:
+
+A slot to read chunk c in to, mapped in at c's place in the image.
+A free one if there is one, otherwise the least recently fetched
+chunk that isn't pinned ( see chunk_pinned ) gives its up, chunks
+only the front wanted going first.  first..last is the range being
+loaded.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static uint32_t take_slot( struct page_reader *r, size_t c, size_t first, size_t last ) {
+	uint32_t s = r->chunk_slot[c];
+
+	if (s != READER_NO_SLOT) return s; // a read of it that failed
+
+	if (r->pool_fd < 0) {
+		s = c; // the pool is the image
+	} else {
+		if (r->free_count == 0) {
+			uint64_t oldest = UINT64_MAX;
+			uint32_t victim = READER_NO_SLOT;
+			size_t i;
+
+			for (i = 0; i < r->slot_count; i++) {
+				struct reader_slot *x = &(r->slots[i]);
+
+				if ((x->state != CHUNK_DONE) || (x->used >= oldest)) continue;
+				if (chunk_pinned( r, x->chunk, first, last )) continue;
+				oldest = x->used;
+				victim = i;
+			}
+			if (victim == READER_NO_SLOT) return READER_NO_SLOT;
+			release_chunk( r, r->slots[victim].chunk );
+			r->evicted++;
+		}
+
+		s = r->free_slots[--r->free_count];
+#ifdef READER_HAVE_MEMFD
+		if (mmap( r->buf +c *r->chunk, r->chunk, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_FIXED, r->pool_fd, (off_t)s *r->chunk ) == MAP_FAILED) {
+			r->free_slots[r->free_count++] = s;
+			return READER_NO_SLOT;
+		}
+#endif
+	}
+
+	r->slots[s].chunk = c;
+	r->slots[s].used = 0;
+	r->slots[s].state = CHUNK_EMPTY;
+	r->chunk_slot[c] = s;
+
+	return s;
+}
+
+
+
+
+/**
+ * Synchronous read of chunk c, for pread and for whatever the
+ * ring couldn't take.
+ */
+static int read_chunk( struct page_reader *r, size_t c, size_t first, size_t last ) {
+	size_t offset = c *r->chunk;
+	size_t l = chunk_length( r, c );
+	uint32_t s = take_slot( r, c, first, last );
+
+	if (s == READER_NO_SLOT) {
+		fprintf(stderr,"ERROR: No read buffer free for %lu bytes at %lu\n", (unsigned long)l, (unsigned long)offset);
+		return 1;
+	}
+	if (read_at( r->fd, slot_buffer( r, s ), l, offset )) {
+		fprintf(stderr,"ERROR: Cannot read %lu bytes at %lu ( %s )\n", (unsigned long)l, (unsigned long)offset, strerror(errno));
+		return 1;
+	}
+	r->slots[s].state = CHUNK_DONE;
+	r->reads++;
+	r->read_bytes += l;
+
+	return 0;
+}
+
+
+
+
+#ifdef READER_HAVE_URING
+
+struct uring {
+	int fd;
+	unsigned entries;
+	unsigned pending; // queued in the SQ ring but not yet submitted
+
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+
+	void *sq_ring, *cq_ring;
+	size_t sq_ring_size, cq_ring_size, sqes_size;
+};
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-121648
+  Function Name	: *uring_setup
+  Returns Type	: struct uring
+  ----Parameter List
+  1. unsigned entries ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Raw syscall set up of a ring, so we don't need liburing.  Returns
+NULL if the kernel ( or a seccomp policy ) won't give us one.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static struct uring *uring_setup( unsigned entries ) {
+	struct io_uring_params p;
+	struct uring *u;
+	char *sq, *cq;
+
+	u = calloc( 1, sizeof(struct uring) );
+	if (!u) return NULL;
+
+	memset(&p, 0, sizeof(p));
+	u->fd = syscall( __NR_io_uring_setup, entries, &p );
+	if (u->fd < 0) {
+		free(u);
+		return NULL;
+	}
+
+	u->entries = p.sq_entries;
+	u->sq_ring_size = p.sq_off.array +p.sq_entries *sizeof(unsigned);
+	u->cq_ring_size = p.cq_off.cqes +p.cq_entries *sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (u->cq_ring_size > u->sq_ring_size) u->sq_ring_size = u->cq_ring_size;
+		u->cq_ring_size = u->sq_ring_size;
+	}
+
+	u->sq_ring = mmap( NULL, u->sq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_SQ_RING );
+	if (u->sq_ring == MAP_FAILED) goto fail;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		u->cq_ring = u->sq_ring;
+	} else {
+		u->cq_ring = mmap( NULL, u->cq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_CQ_RING );
+		if (u->cq_ring == MAP_FAILED) { munmap( u->sq_ring, u->sq_ring_size ); goto fail; }
+	}
+
+	u->sqes_size = p.sq_entries *sizeof(struct io_uring_sqe);
+	u->sqes = mmap( NULL, u->sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_SQES );
+	if (u->sqes == MAP_FAILED) {
+		if (u->cq_ring != u->sq_ring) munmap( u->cq_ring, u->cq_ring_size );
+		munmap( u->sq_ring, u->sq_ring_size );
+		goto fail;
+	}
+
+	sq = u->sq_ring;
+	cq = u->cq_ring;
+	u->sq_head = (unsigned *)(sq +p.sq_off.head);
+	u->sq_tail = (unsigned *)(sq +p.sq_off.tail);
+	u->sq_mask = (unsigned *)(sq +p.sq_off.ring_mask);
+	u->sq_array = (unsigned *)(sq +p.sq_off.array);
+	u->cq_head = (unsigned *)(cq +p.cq_off.head);
+	u->cq_tail = (unsigned *)(cq +p.cq_off.tail);
+	u->cq_mask = (unsigned *)(cq +p.cq_off.ring_mask);
+	u->cqes = (struct io_uring_cqe *)(cq +p.cq_off.cqes);
+
+	return u;
+
+fail:
+	close( u->fd );
+	free( u );
+	return NULL;
+}
+
+
+
+
+static void uring_destroy( struct uring *u ) {
+	munmap( u->sqes, u->sqes_size );
+	if (u->cq_ring != u->sq_ring) munmap( u->cq_ring, u->cq_ring_size );
+	munmap( u->sq_ring, u->sq_ring_size );
+	close( u->fd );
+	free( u );
+}
+
+
+
+
+static int uring_enter( struct uring *u, unsigned wait_nr ) {
+	int r;
+
+	do {
+		r = syscall( __NR_io_uring_enter, u->fd, u->pending, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0, NULL, 0 );
+	} while ((r < 0) && (errno == EINTR));
+
+	if (r < 0) return 1;
+	u->pending -= r;
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-121902
+  Function Name	: uring_queue_chunk
+  Returns Type	: int
+  ----Parameter List
+  1. struct page_reader *r,
+  2.  size_t c,
+  3.  int prio,
+  4.  size_t first,
+  5.  size_t last ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Adds a read of chunk c to the SQ ring ( submitting what's already
+there first if the ring is full ).  The slot it's read in to rides
+along as the user_data.  first..last as for take_slot().
+
+--------------------------------------------------------------------
+Changes:
+20261018: reads go in to a pool slot rather than the chunk's own
+place in an image sized buffer.
+
+\------------------------------------------------------------------*/
+static int uring_queue_chunk( struct page_reader *r, size_t c, int prio, size_t first, size_t last ) {
+	struct uring *u = r->ring;
+	struct io_uring_sqe *sqe;
+	unsigned tail, idx;
+	size_t offset = c *r->chunk;
+	uint32_t s;
+
+	tail = *u->sq_tail;
+	if (tail -__atomic_load_n( u->sq_head, __ATOMIC_ACQUIRE ) >= u->entries) {
+		if (uring_enter( u, 0 )) return 1;
+		if (tail -__atomic_load_n( u->sq_head, __ATOMIC_ACQUIRE ) >= u->entries) return 1;
+	}
+
+	s = take_slot( r, c, first, last );
+	if (s == READER_NO_SLOT) return 1;
+
+	idx = tail & *u->sq_mask;
+	sqe = &(u->sqes[idx]);
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode = r->fixed_buffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+	sqe->fd = r->fd;
+	sqe->addr = (uint64_t)(uintptr_t)slot_buffer( r, s );
+	sqe->len = chunk_length( r, c );
+	sqe->off = offset;
+	sqe->ioprio = prio;
+	sqe->buf_index = r->fixed_buffers ? s : 0;
+	sqe->user_data = s;
+	u->sq_array[idx] = idx;
+	__atomic_store_n( u->sq_tail, tail +1, __ATOMIC_RELEASE );
+
+	u->pending++;
+	r->slots[s].state = CHUNK_INFLIGHT;
+	r->inflight++;
+	r->reads++;
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-122044
+  Function Name	: uring_reap
+  Returns Type	: int
+  ----Parameter List
+  1. struct page_reader *r ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Marks finished chunks as done.  Failed or short reads are
+finished off synchronously rather than requeued, they're rare
+and it keeps the bookkeeping simple.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int uring_reap( struct page_reader *r ) {
+	struct uring *u = r->ring;
+	unsigned head, tail;
+
+	head = *u->cq_head;
+	tail = __atomic_load_n( u->cq_tail, __ATOMIC_ACQUIRE );
+
+	while (head != tail) {
+		struct io_uring_cqe *cqe = &(u->cqes[head & *u->cq_mask]);
+		uint32_t s = cqe->user_data;
+		size_t c = r->slots[s].chunk;
+		size_t offset = c *r->chunk;
+		size_t l = chunk_length( r, c );
+		char *dst = slot_buffer( r, s );
+
+		if (cqe->res < 0) {
+			if (read_at( r->fd, dst, l, offset )) {
+				fprintf(stderr,"ERROR: Cannot read %lu bytes at %lu ( %s )\n", (unsigned long)l, (unsigned long)offset, strerror(-cqe->res));
+			}
+		} else if ((size_t)cqe->res < l) {
+			read_at( r->fd, dst +cqe->res, l -cqe->res, offset +cqe->res );
+		}
+
+		r->read_bytes += l;
+		r->slots[s].state = CHUNK_DONE;
+		r->inflight--;
+		head++;
+	}
+
+	__atomic_store_n( u->cq_head, head, __ATOMIC_RELEASE );
+
+	return 0;
+}
+
+#endif // READER_HAVE_URING
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-131020
+  Function Name	: publish
+  Returns Type	: void
+  ----Parameter List
+  1. struct page_reader *r,
+  2.  size_t produced,
+  3.  int finished ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Decompressor side, moves the front up and wakes the scanner.  Once
+finished the image size is final.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static void publish( struct page_reader *r, size_t produced, int finished ) {
+
+	pthread_mutex_lock( &(r->lock) );
+	r->front = produced;
+	r->read_bytes = produced;
+	if (finished) {
+		r->size = produced;
+		r->finished = 1;
+	}
+	pthread_cond_broadcast( &(r->cond) );
+	pthread_mutex_unlock( &(r->lock) );
+}
+
+
+
+
+/**
+ * One pass through a compressed input, gzip ( any number of members )
+ * or zstd.  The decompressor thread has one, the second pass another.
+ */
+struct decoder {
+	int compression;
+	unsigned char *in;
+	size_t in_offset; // next byte of the compressed file to read in
+	size_t out; // bytes decompressed so far
+	int ended; // the stream is done, or damaged
+	int clean; // the last thing decoded finished a member/frame
+	const char *damage; // why it ended early, NULL if it didn't
+	size_t frame_out, frame_in; // where the last zstd frame ended, out and in
+#ifdef UNDARK_ZLIB
+	z_stream zs;
+#endif
+#ifdef UNDARK_ZSTD
+	ZSTD_DStream *ds;
+	ZSTD_inBuffer zin;
+#endif
+};
+
+/**
+ * Somewhere a decoder can start from other than the top: a copy of
+ * the inflate state ( window and all ) for gzip, just the start of
+ * a frame for zstd, which can't be copied mid frame.
+ */
+struct decoder_checkpoint {
+	size_t out, in_offset;
+#ifdef UNDARK_ZLIB
+	z_stream zs;
+#endif
+};
+
+
+
+
+static void checkpoint_free( struct decoder_checkpoint *cp ) {
+
+#ifdef UNDARK_ZLIB
+	if (cp->zs.state) inflateEnd( &(cp->zs) );
+#endif
+	free( cp );
+}
+
+
+
+
+static int decoder_init( struct page_reader *r, struct decoder *d ) {
+
+	memset(d, 0, sizeof(struct decoder));
+	d->compression = r->compression;
+	d->in = malloc( DECOMPRESS_INPUT_CHUNK );
+	if (!d->in) return 1;
+
+#ifdef UNDARK_ZLIB
+	if ((d->compression == COMPRESSION_GZIP) && (inflateInit2( &(d->zs), 15 +32 ) == Z_OK)) return 0;
+#endif
+#ifdef UNDARK_ZSTD
+	if (d->compression == COMPRESSION_ZSTD) {
+		d->ds = ZSTD_createDStream();
+		if (d->ds) {
+			ZSTD_initDStream( d->ds );
+			d->zin.src = d->in;
+			return 0;
+		}
+	}
+#endif
+	free( d->in );
+	d->in = NULL;
+
+	return 1;
+}
+
+
+
+
+static void decoder_end( struct decoder *d ) {
+
+#ifdef UNDARK_ZLIB
+	if (d->compression == COMPRESSION_GZIP) inflateEnd( &(d->zs) );
+#endif
+#ifdef UNDARK_ZSTD
+	if ((d->compression == COMPRESSION_ZSTD) && (d->ds)) ZSTD_freeDStream( d->ds );
+#endif
+	free( d->in );
+	d->in = NULL;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-131142
+  Function Name	: decoder_read
+  Returns Type	: size_t
+  ----Parameter List
+  1. struct page_reader *r,
+  2.  struct decoder *d,
+  3.  char *dst,
+  4.  size_t room ,
+  ------------------
+  Exit Codes	: bytes decompressed in to dst, short only at the end
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+A truncated or damaged stream isn't fatal, whatever came out before
+the damage is still worth carving, so the decoder just ends with
+the reason in damage.
+
+--------------------------------------------------------------------
+Changes:
+20261018: was inflate_gzip() and decompress_zstd(), each decompressing
+the whole stream in to the image buffer, now a chunk at a time in to
+wherever the caller wants it.
+
+\------------------------------------------------------------------*/
+static size_t decoder_read( struct page_reader *r, struct decoder *d, char *dst, size_t room ) {
+	size_t got = 0;
+
+	while ((got < room) && (!d->ended)) {
+		int empty = 0;
+
+#ifdef UNDARK_ZLIB
+		if (d->compression == COMPRESSION_GZIP) empty = (d->zs.avail_in == 0);
+#endif
+#ifdef UNDARK_ZSTD
+		if (d->compression == COMPRESSION_ZSTD) empty = (d->zin.pos >= d->zin.size);
+#endif
+		if (empty) {
+			size_t l = DECOMPRESS_INPUT_CHUNK;
+
+			if (d->in_offset >= r->compressed_size) {
+				d->ended = 1;
+				if (!d->clean) d->damage = "truncated";
+				break;
+			}
+			if (d->in_offset +l > r->compressed_size) l = r->compressed_size -d->in_offset;
+			if (read_at( r->fd, (char *)d->in, l, d->in_offset )) {
+				d->ended = 1;
+				d->damage = "read error";
+				break;
+			}
+			d->in_offset += l;
+#ifdef UNDARK_ZLIB
+			d->zs.next_in = d->in;
+			d->zs.avail_in = l;
+#endif
+#ifdef UNDARK_ZSTD
+			d->zin.size = l;
+			d->zin.pos = 0;
+#endif
+		}
+
+#ifdef UNDARK_ZLIB
+		if (d->compression == COMPRESSION_GZIP) {
+			size_t l = room -got;
+			int ret;
+
+			if (l > (1UL << 30)) l = 1UL << 30;
+			d->zs.next_out = (unsigned char *)dst +got;
+			d->zs.avail_out = l;
+			ret = inflate( &(d->zs), Z_NO_FLUSH );
+			got = (char *)d->zs.next_out -dst;
+
+			d->clean = (ret == Z_STREAM_END);
+			if (ret == Z_STREAM_END) {
+				if ((d->zs.avail_in == 0) && (d->in_offset >= r->compressed_size)) d->ended = 1;
+				else inflateReset( &(d->zs) ); // another member follows
+			} else if ((ret != Z_OK) && (ret != Z_BUF_ERROR)) {
+				d->ended = 1;
+				d->damage = d->zs.msg ? d->zs.msg : "damaged";
+			}
+		}
+#endif
+#ifdef UNDARK_ZSTD
+		if (d->compression == COMPRESSION_ZSTD) {
+			ZSTD_outBuffer zout;
+			size_t ret;
+
+			zout.dst = dst +got;
+			zout.size = room -got;
+			zout.pos = 0;
+			ret = ZSTD_decompressStream( d->ds, &zout, &(d->zin) );
+			got += zout.pos;
+
+			d->clean = (ret == 0);
+			if (ret == 0) {
+				d->frame_out = d->out +got;
+				d->frame_in = d->in_offset -(d->zin.size -d->zin.pos);
+			}
+			if (ZSTD_isError( ret )) {
+				d->ended = 1;
+				d->damage = ZSTD_getErrorName( ret );
+			}
+		}
+#endif
+	}
+
+	d->out += got;
+
+	return got;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-192240
+  Function Name	: checkpoint_take
+  Returns Type	: void
+  ----Parameter List
+  1. struct page_reader *r,
+  2.  struct decoder *d ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Decompressor side, at the start of a chunk, leaves a checkpoint for
+the second pass.  Once there are READER_CHECKPOINTS every other one
+goes and they're twice as far apart from then on, so a long image
+costs no more memory, just a longer run from the nearest one.  Out
+of memory just means no checkpoint.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static void checkpoint_take( struct page_reader *r, struct decoder *d ) {
+	struct decoder_checkpoint *cp;
+	size_t i, last = 0;
+
+	if (!r->checkpoints) return;
+	pthread_mutex_lock( &(r->lock) );
+	if (r->checkpoint_count) last = r->checkpoints[r->checkpoint_count -1]->out;
+	pthread_mutex_unlock( &(r->lock) );
+
+	cp = calloc( 1, sizeof(struct decoder_checkpoint) );
+	if (!cp) return;
+#ifdef UNDARK_ZLIB
+	if (d->compression == COMPRESSION_GZIP) {
+		if (inflateCopy( &(cp->zs), &(d->zs) ) != Z_OK) {
+			free( cp );
+			return;
+		}
+		cp->out = d->out;
+		cp->in_offset = d->in_offset -d->zs.avail_in;
+	}
+#endif
+	if (d->compression == COMPRESSION_ZSTD) {
+		cp->out = d->frame_out;
+		cp->in_offset = d->frame_in;
+	}
+	if ((cp->out == 0) || (cp->out <= last)) {
+		checkpoint_free( cp );
+		return;
+	}
+
+	pthread_mutex_lock( &(r->lock) );
+	if (r->checkpoint_count >= READER_CHECKPOINTS) {
+		for (i = 0; i < r->checkpoint_count; i++) {
+			if (i & 1) r->checkpoints[i /2] = r->checkpoints[i]; // the ones on the new span
+			else checkpoint_free( r->checkpoints[i] );
+		}
+		r->checkpoint_count /= 2;
+		r->checkpoint_span *= 2;
+	}
+	r->checkpoints[r->checkpoint_count++] = cp;
+	pthread_mutex_unlock( &(r->lock) );
+}
+
+
+
+
+/**
+ * Second pass side, starts d from the last checkpoint at or before
+ * start, if that's nearer than wherever d has got to.  Under the
+ * lock, the checkpoints can go while the decompressor runs.
+ */
+static void checkpoint_resume( struct page_reader *r, struct decoder *d, size_t start ) {
+	struct decoder_checkpoint *cp = NULL;
+	size_t i;
+
+	for (i = 0; (i < r->checkpoint_count) && (r->checkpoints[i]->out <= start); i++) cp = r->checkpoints[i];
+	if ((!cp) || ((d->out <= start) && (d->out >= cp->out))) return;
+
+#ifdef UNDARK_ZLIB
+	if (d->compression == COMPRESSION_GZIP) {
+		inflateEnd( &(d->zs) );
+		if (inflateCopy( &(d->zs), &(cp->zs) ) != Z_OK) {
+			inflateInit2( &(d->zs), 15 +32 ); // from the top then
+			d->in_offset = d->out = 0;
+			return;
+		}
+		d->zs.next_in = d->in;
+		d->zs.avail_in = 0;
+	}
+#endif
+#ifdef UNDARK_ZSTD
+	if (d->compression == COMPRESSION_ZSTD) {
+		ZSTD_initDStream( d->ds );
+		d->zin.size = d->zin.pos = 0;
+	}
+#endif
+	d->in_offset = cp->in_offset;
+	d->out = cp->out;
+	d->ended = d->clean = 0;
+	d->damage = NULL;
+	r->second_resumes++;
+}
+
+
+
+
+/**
+ * Chunks the decompressor keeps: the scanner's window and the depth
+ * ahead of it, the last fetch and the held range.  Under the lock.
+ */
+static int chunk_wanted( struct page_reader *r, size_t c ) {
+
+	if ((c >= r->window) && (c < r->next_submit)) return 1;
+	if ((c >= r->fetch_first) && (c <= r->fetch_last)) return 1;
+	if ((c >= r->hold_first) && (c <= r->hold_last)) return 1;
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-191204
+  Function Name	: decompress_ring
+  Returns Type	: int
+  ----Parameter List
+  1. struct page_reader *r,
+  2.  struct decoder *d ,
+  ------------------
+  Exit Codes	: 1 if there's no memory for a scratch chunk
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Decompressor side, a chunk at a time.  Waits while the next chunk
+would be more than depth ahead of the scanner, unless a fetch or
+page_reader_finish is waiting further on.  A chunk nobody wants
+kept ( see chunk_wanted ) goes through a scratch buffer and is
+dropped, the second pass brings it back if it's asked for.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int decompress_ring( struct page_reader *r, struct decoder *d ) {
+	char *scratch = malloc( r->chunk );
+	size_t c;
+
+	if (!scratch) return 1;
+
+	for (c = 0; !d->ended; c++) {
+		uint32_t s = READER_NO_SLOT;
+		size_t done = 0;
+		char *dst;
+
+		if (c >= r->chunk_count) {
+			fprintf(stderr,"ERROR: Decompressed image is larger than the %lu bytes reserved, see --decompress-reserve\n", (unsigned long)r->reserve);
+			break;
+		}
+
+		pthread_mutex_lock( &(r->lock) );
+		while ((!r->stop) && (!r->draining) && (c >= r->next_submit) && (c >= r->want)) {
+			pthread_cond_wait( &(r->cond), &(r->lock) );
+		}
+		if (r->stop) {
+			pthread_mutex_unlock( &(r->lock) );
+			break;
+		}
+		/* a second pass may have got to it first */
+		if ((r->chunk_slot[c] == READER_NO_SLOT) && (chunk_wanted( r, c ))) s = take_slot( r, c, c, c );
+		if (s != READER_NO_SLOT) r->slots[s].state = CHUNK_INFLIGHT;
+		else r->dropped++;
+		pthread_mutex_unlock( &(r->lock) );
+
+		if ((c > 0) && (c %r->checkpoint_span == 0)) checkpoint_take( r, d );
+
+		dst = (s != READER_NO_SLOT) ? slot_buffer( r, s ) : scratch;
+		while ((done < r->chunk) && (!d->ended)) {
+			size_t step = r->chunk -done;
+
+			if (step > READER_PUBLISH_STEP) step = READER_PUBLISH_STEP;
+			done += decoder_read( r, d, dst +done, step );
+			if ((done == r->chunk) && (s != READER_NO_SLOT)) {
+				pthread_mutex_lock( &(r->lock) );
+				r->slots[s].state = CHUNK_DONE;
+				pthread_mutex_unlock( &(r->lock) );
+			}
+			publish( r, c *r->chunk +done, 0 );
+		}
+		if ((done < r->chunk) && (s != READER_NO_SLOT)) {
+			pthread_mutex_lock( &(r->lock) );
+			r->slots[s].state = CHUNK_DONE;
+			pthread_mutex_unlock( &(r->lock) );
+		}
+	}
+
+	free( scratch );
+	publish( r, d->out, 1 );
+
+	return 0;
+}
+
+
+
+
+/**
+ * Decompressor side without a ring, straight in to the image.
+ */
+static int decompress_whole( struct page_reader *r, struct decoder *d ) {
+
+	while (!d->ended) {
+		size_t room = r->reserve -d->out;
+
+		if (room == 0) {
+			fprintf(stderr,"ERROR: Decompressed image is larger than the %lu bytes reserved, see --decompress-reserve\n", (unsigned long)r->reserve);
+			break;
+		}
+		if (room > READER_PUBLISH_STEP) room = READER_PUBLISH_STEP;
+		decoder_read( r, d, r->buf +d->out, room );
+		publish( r, d->out, 0 );
+		if (r->stop) break;
+	}
+	publish( r, d->out, 1 );
+
+	return 0;
+}
+
+
+
+
+static void *decompress_main( void *arg ) {
+	struct page_reader *r = arg;
+	struct decoder d;
+	int failed = 1;
+	uint64_t t;
+
+	trace_thread( "decompress" );
+	t = trace_start( TRACE_ALWAYS );
+	if (decoder_init( r, &d ) == 0) {
+		if (r->pool_fd >= 0) failed = decompress_ring( r, &d );
+		else failed = decompress_whole( r, &d );
+		if ((d.damage) && (!r->stop)) {
+			fprintf(stderr,"WARNING: %s stream ended early ( %s ), carving the %lu bytes recovered\n"
+					, (r->compression == COMPRESSION_GZIP) ? "gzip" : "zstd"
+					, d.damage
+					, (unsigned long)d.out
+					);
+		}
+		decoder_end( &d );
+	}
+	if (t) trace_span( t, "decompress", "io", "\"failed\":%d", failed );
+
+	if (failed) {
+		pthread_mutex_lock( &(r->lock) );
+		r->failed = 1;
+		pthread_mutex_unlock( &(r->lock) );
+		publish( r, 0, 1 );
+	}
+
+	return NULL;
+}
+
+
+
+
+/**
+ * Blocks until the decompressor is past end, or done.  Under the
+ * lock.
+ */
+static void decompress_front( struct page_reader *r, size_t end ) {
+
+	if ((!r->finished) && (r->front < end)) r->front_waits++;
+	while ((!r->finished) && (r->front < end)) {
+		pthread_cond_wait( &(r->cond), &(r->lock) );
+	}
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-191530
+  Function Name	: second_pass
+  Returns Type	: int
+  ----Parameter List
+  1. struct page_reader *r,
+  2.  size_t c,
+  3.  size_t first,
+  4.  size_t last ,
+  ------------------
+  Exit Codes	: 1 if it couldn't be decompressed again
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Scanner side, decompresses chunk c again in to a slot, for a chunk
+the ring has recycled ( or the decompressor dropped ).  The second
+decoder carries on from wherever it last got to, or from the nearest
+checkpoint before c if that's closer ( see checkpoint_take ), and
+only starts again from the top if there's neither.  first..last as
+for take_slot().
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int second_pass( struct page_reader *r, size_t c, size_t first, size_t last ) {
+	struct decoder *d = r->second;
+	size_t start = c *r->chunk;
+	uint32_t s;
+
+	if (!d) {
+		d = malloc( sizeof(struct decoder) );
+		if ((!d) || (decoder_init( r, d ))) {
+			free( d );
+			return 1;
+		}
+		r->second = d;
+	}
+	pthread_mutex_lock( &(r->lock) );
+	checkpoint_resume( r, d, start );
+	pthread_mutex_unlock( &(r->lock) );
+	if (d->out > start) {
+		decoder_end( d );
+		if (decoder_init( r, d )) {
+			free( d );
+			r->second = NULL;
+			return 1;
+		}
+		r->second_restarts++;
+	}
+	if ((!r->scratch) && (!(r->scratch = malloc( r->chunk )))) return 1;
+
+	while ((d->out < start) && (!d->ended)) {
+		size_t skip = start -d->out;
+
+		decoder_read( r, d, r->scratch, (skip > r->chunk) ? r->chunk : skip );
+	}
+	if (d->out != start) return 0; // past the end, it stays zeros
+
+	pthread_mutex_lock( &(r->lock) );
+	if (r->chunk_slot[c] != READER_NO_SLOT) {
+		/* the decompressor got there while we were on the way */
+		if (chunk_state( r, c ) != CHUNK_DONE) decompress_front( r, start +r->chunk );
+		pthread_mutex_unlock( &(r->lock) );
+		return 0;
+	}
+	s = take_slot( r, c, first, last );
+	if (s != READER_NO_SLOT) r->slots[s].state = CHUNK_INFLIGHT;
+	pthread_mutex_unlock( &(r->lock) );
+	if (s == READER_NO_SLOT) {
+		fprintf(stderr,"ERROR: No buffer free in the decompression ring for %lu bytes at %lu\n", (unsigned long)r->chunk, (unsigned long)start);
+		return 1;
+	}
+
+	decoder_read( r, d, slot_buffer( r, s ), r->chunk );
+
+	pthread_mutex_lock( &(r->lock) );
+	r->slots[s].state = CHUNK_DONE;
+	r->second_chunks++;
+	pthread_mutex_unlock( &(r->lock) );
+
+	return 0;
+}
+
+
+
+
+/**
+ * Scanner side, makes sure chunks first..last are in the ring, with
+ * a second pass for any that aren't.  One the decompressor is still
+ * working on is waited for.
+ */
+static int decompress_fill( struct page_reader *r, size_t first, size_t last ) {
+	size_t c;
+
+	for (c = first; c <= last; c++) {
+		int missing;
+
+		pthread_mutex_lock( &(r->lock) );
+		if ((r->finished) && (c *r->chunk >= r->size)) {
+			pthread_mutex_unlock( &(r->lock) );
+			break;
+		}
+		missing = (r->chunk_slot[c] == READER_NO_SLOT);
+		if ((!missing) && (chunk_state( r, c ) != CHUNK_DONE)) decompress_front( r, (c +1) *r->chunk );
+		pthread_mutex_unlock( &(r->lock) );
+		if ((missing) && (second_pass( r, c, first, last ))) return 1;
+	}
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-131530
+  Function Name	: page_reader_detect
+  Returns Type	: int
+  ----Parameter List
+  1. struct page_reader *r,
+  2.  int fd,
+  3.  size_t size ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Looks for a gzip or zstd magic at the start of the input, and if
+found switches the reader over to decompression.  Also works out
+how much address space to reserve for the image: READER_RESERVE_SPAN
+with a ring, which only costs address space, otherwise the size the
+stream claims ( gzip ISIZE / zstd frame size ) if any, but at least
+READER_RESERVE_RATIO times the compressed size as neither is
+reliable for multi member/frame files.
+
+Returns 1 if the file is compressed in a format we weren't built
+with.
+
+--------------------------------------------------------------------
+Changes:
+20261018: READER_RESERVE_SPAN of address space when the image goes
+through a ring.
+
+\------------------------------------------------------------------*/
+int page_reader_detect( struct page_reader *r, int fd, size_t size ) {
+	unsigned char magic[18];
+	size_t claimed = 0;
+
+	memset(magic, 0, sizeof(magic));
+	if (size < 4) return 0;
+	if (read_at( fd, (char *)magic, (size < sizeof(magic)) ? size : sizeof(magic), 0 )) return 0;
+
+	if ((magic[0] == 0x1F) && (magic[1] == 0x8B)) {
+		unsigned char isize[4];
+
+		r->compression = COMPRESSION_GZIP;
+		if (read_at( fd, (char *)isize, 4, size -4 ) == 0) {
+			claimed = isize[0] | (isize[1] << 8) | (isize[2] << 16) | ((size_t)isize[3] << 24);
+		}
+	} else if ((magic[0] == 0x28) && (magic[1] == 0xB5) && (magic[2] == 0x2F) && (magic[3] == 0xFD)) {
+		r->compression = COMPRESSION_ZSTD;
+#ifdef UNDARK_ZSTD
+		{
+			unsigned long long fcs = ZSTD_getFrameContentSize( magic, sizeof(magic) );
+			if ((fcs != ZSTD_CONTENTSIZE_UNKNOWN) && (fcs != ZSTD_CONTENTSIZE_ERROR)) claimed = fcs;
+		}
+#endif
+	} else {
+		return 0;
+	}
+
+#ifndef UNDARK_ZLIB
+	if (r->compression == COMPRESSION_GZIP) return 1;
+#endif
+#ifndef UNDARK_ZSTD
+	if (r->compression == COMPRESSION_ZSTD) return 1;
+#endif
+
+	r->backend = READER_DECOMPRESS;
+	r->compressed_size = size;
+	if (r->reserve == 0) {
+#ifdef READER_HAVE_MEMFD
+		r->reserve = READER_RESERVE_SPAN;
+#else
+		r->reserve = size *READER_RESERVE_RATIO;
+#endif
+		if (claimed > r->reserve) r->reserve = claimed;
+	}
+	r->reserve = (r->reserve +0xFFFF) & ~(size_t)0xFFFF;
+
+	return 0;
+}
+
+
+
+
+size_t page_reader_size( struct page_reader *r ) {
+	size_t size;
+
+	if (r->backend != READER_DECOMPRESS) return r->size;
+
+	pthread_mutex_lock( &(r->lock) );
+	size = r->size;
+	pthread_mutex_unlock( &(r->lock) );
+
+	return size;
+}
+
+
+
+
+/**
+ * page_reader_wait() for a decompressed image.
+ */
+static int decompress_wait( struct page_reader *r, size_t end ) {
+	size_t first, last;
+
+	pthread_mutex_lock( &(r->lock) );
+	if (r->pool_fd < 0) {
+		decompress_front( r, end );
+		pthread_mutex_unlock( &(r->lock) );
+		return 0;
+	}
+
+	if (end > r->size) end = r->size;
+	move_window( r, end );
+	r->next_submit = r->window_end +r->depth;
+	pthread_cond_broadcast( &(r->cond) );
+	decompress_front( r, end );
+	first = r->window;
+	last = r->window_end;
+	pthread_mutex_unlock( &(r->lock) );
+
+	if (last == first) return 0;
+
+	return decompress_fill( r, first, last -1 );
+}
+
+
+
+
+/**
+ * page_reader_fetch()/page_reader_hold() for a decompressed image,
+ * keep as for fetch_range().
+ */
+static int decompress_fetch( struct page_reader *r, size_t offset, size_t l, int keep ) {
+	size_t first, last, c;
+
+	pthread_mutex_lock( &(r->lock) );
+	if (r->pool_fd < 0) {
+		decompress_front( r, (l > SIZE_MAX -offset) ? SIZE_MAX : offset +l );
+		pthread_mutex_unlock( &(r->lock) );
+		return 0;
+	}
+
+	if (offset >= r->size) {
+		pthread_mutex_unlock( &(r->lock) );
+		return 1;
+	}
+	if (l > r->size -offset) l = r->size -offset;
+	if (l == 0) {
+		pthread_mutex_unlock( &(r->lock) );
+		return 0;
+	}
+	first = offset /r->chunk;
+	last = (offset +l -1) /r->chunk;
+	r->fetch_first = first;
+	r->fetch_last = last;
+	if ((!r->finished) && (r->front < offset +l) && (last < r->next_submit +READER_RETAIN /r->chunk)) {
+		/* close enough ahead that the decompressor may as well get there */
+		r->want = last +1;
+		pthread_cond_broadcast( &(r->cond) );
+		decompress_front( r, offset +l );
+		r->want = 0;
+	}
+	pthread_mutex_unlock( &(r->lock) );
+
+	if (decompress_fill( r, first, last )) return 1;
+
+	if (keep) {
+		pthread_mutex_lock( &(r->lock) );
+		r->clock++;
+		for (c = first; c <= last; c++) {
+			uint32_t s = r->chunk_slot[c];
+
+			if ((s != READER_NO_SLOT) && ((c < r->window) || (c >= r->window_end))) r->slots[s].used = r->clock;
+		}
+		pthread_mutex_unlock( &(r->lock) );
+	}
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-122210
+  Function Name	: page_reader_init
+  Returns Type	: int
+  ----Parameter List
+  1. struct page_reader *r ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int page_reader_init( struct page_reader *r ) {
+	memset(r, 0, sizeof(struct page_reader));
+	r->backend = READER_MMAP;
+	r->fd = -1;
+	r->chunk = READER_CHUNK_DEFAULT;
+	r->depth = READER_DEPTH_DEFAULT;
+	r->pool_fd = -1;
+	r->hold_first = 1; // nothing held
+	r->hold_last = 0;
+	r->fetch_first = 1;
+	r->fetch_last = 0;
+
+	return 0;
+}
+
+
+
+
+int page_reader_parse_backend( struct page_reader *r, const char *name ) {
+	if (strcmp(name, "mmap")==0) r->backend = READER_MMAP;
+	else if (strcmp(name, "pread")==0) r->backend = READER_PREAD;
+	else if (strcmp(name, "uring")==0) r->backend = READER_URING;
+	else return 1;
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-122305
+  Function Name	: *page_reader_open
+  Returns Type	: char
+  ----Parameter List
+  1. struct page_reader *r,
+  2.  int fd,
+  3.  size_t size ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Sets up the image's address range and the read pool, and starts
+the first reads.  If io_uring isn't available we quietly drop back
+to pread.
+
+Returns NULL on failure.
+
+--------------------------------------------------------------------
+Changes:
+20261018: reads go in to a bounded pool of chunk buffers mapped in
+to the image, the pool is what gets registered with io_uring.  Only
+an image the pool would cover, or no memfd, is read in whole.
+20261018: a compressed image is decompressed in to the same kind of
+pool, used as a ring, rather than kept whole in reserved memory.
+
+\------------------------------------------------------------------*/
+char *page_reader_open( struct page_reader *r, int fd, size_t size ) {
+	int flags = MAP_PRIVATE|MAP_ANONYMOUS;
+	int protection = PROT_READ|PROT_WRITE;
+	void *m;
+
+	r->fd = fd;
+	r->size = size;
+#ifdef MAP_NORESERVE
+	flags |= MAP_NORESERVE;
+#endif
+
+	if (r->backend == READER_DECOMPRESS) {
+		r->chunk = READER_CHUNK_DEFAULT; // --read-chunk is for reads, not the ring
+		r->size = size = r->reserve; // until the decompressor tells us otherwise
+#ifdef READER_HAVE_MEMFD
+		protection = PROT_READ; // only the ring's slots are written, the rest reads as zeros
+#endif
+	}
+	if (r->chunk < 4096) r->chunk = 4096;
+	if (r->depth < 1) r->depth = 1;
+#ifdef READER_HAVE_MEMFD
+	{
+		size_t page = sysconf( _SC_PAGESIZE );
+
+		r->chunk = (r->chunk +page -1) /page *page; // slots are mapped a chunk at a time
+	}
+#endif
+	r->chunk_count = (size +r->chunk -1) /r->chunk;
+
+	m = mmap( NULL, r->chunk_count *r->chunk, protection, flags, -1, 0 );
+	if (m == MAP_FAILED) return NULL;
+	r->buf = m;
+
+	/**
+	 * Enough slots for the scanner's window, the reads ahead of it, a
+	 * held range, a fetch and some overflow chunks all at once.
+	 */
+	r->slot_count = r->depth +3 *(READER_RETAIN /r->chunk +2) +READER_OVERFLOW_CHUNKS;
+#ifdef READER_HAVE_MEMFD
+	if (r->slot_count < r->chunk_count) {
+		r->pool_fd = syscall( SYS_memfd_create, "undark-read-pool", 0 );
+		if ((r->pool_fd >= 0) && (ftruncate( r->pool_fd, (off_t)r->slot_count *r->chunk ) == 0)) {
+			m = mmap( NULL, r->slot_count *r->chunk, PROT_READ|PROT_WRITE, MAP_SHARED, r->pool_fd, 0 );
+			if (m != MAP_FAILED) r->pool = m;
+		}
+		if ((!r->pool) && (r->pool_fd >= 0)) {
+			close( r->pool_fd );
+			r->pool_fd = -1;
+		}
+	}
+#endif
+	if (r->pool_fd < 0) {
+#ifdef READER_HAVE_MEMFD
+		if (protection != (PROT_READ|PROT_WRITE)) mprotect( r->buf, r->chunk_count *r->chunk, PROT_READ|PROT_WRITE );
+#endif
+		r->pool = r->buf;
+		r->slot_count = r->chunk_count;
+	}
+
+	r->chunk_slot = malloc( (r->chunk_count +1) *sizeof(uint32_t) );
+	r->slots = calloc( r->slot_count +1, sizeof(struct reader_slot) );
+	r->free_slots = malloc( (r->slot_count +1) *sizeof(uint32_t) );
+	if ((!r->chunk_slot) || (!r->slots) || (!r->free_slots)) {
+		if (r->backend == READER_DECOMPRESS) r->backend = READER_PREAD; // no thread to stop yet
+		page_reader_close( r );
+		return NULL;
+	}
+	memset( r->chunk_slot, 0xFF, (r->chunk_count +1) *sizeof(uint32_t) ); // READER_NO_SLOT
+	if (r->pool_fd >= 0) {
+		size_t s;
+
+		for (s = r->slot_count; s > 0; s--) r->free_slots[r->free_count++] = s -1;
+	}
+
+	if (r->backend == READER_DECOMPRESS) {
+		r->checkpoint_span = 1;
+		r->checkpoints = calloc( READER_CHECKPOINTS, sizeof(struct decoder_checkpoint *) );
+		pthread_mutex_init( &(r->lock), NULL );
+		pthread_cond_init( &(r->cond), NULL );
+		if (pthread_create( &(r->thread), NULL, decompress_main, r ) != 0) {
+			pthread_mutex_destroy( &(r->lock) );
+			pthread_cond_destroy( &(r->cond) );
+			r->backend = READER_PREAD; // so close doesn't join it
+			page_reader_close( r );
+			return NULL;
+		}
+
+		return r->buf;
+	}
+
+	if (r->backend == READER_URING) {
+#ifdef READER_HAVE_URING
+		r->ring = uring_setup( r->depth *2 );
+		if (r->ring) {
+			struct iovec *iov;
+
+			/* registered buffers save the per-read page pinning, but are
+			 * limited by RLIMIT_MEMLOCK so it's fine if this fails */
+			iov = malloc( r->slot_count *sizeof(struct iovec) );
+			if ((iov) && (r->slot_count <= 16384)) {
+				size_t s;
+
+				for (s = 0; s < r->slot_count; s++) {
+					iov[s].iov_base = slot_buffer( r, s );
+					iov[s].iov_len = r->chunk;
+				}
+				if (syscall( __NR_io_uring_register, r->ring->fd, IORING_REGISTER_BUFFERS, iov, r->slot_count ) == 0) {
+					r->fixed_buffers = 1;
+				}
+			}
+			free( iov );
+		}
+#endif
+		if (!r->ring) r->backend = READER_PREAD;
+	}
+
+	page_reader_wait( r, 0 );
+
+	return r->buf;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-122511
+  Function Name	: page_reader_wait
+  Returns Type	: int
+  ----Parameter List
+  1. struct page_reader *r,
+  2.  size_t end ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Blocks until [end -READER_RETAIN, end) is loaded, and keeps the
+queue of reads ahead of the front topped up.  Chunks the window
+has moved past go back to the pool.
+
+--------------------------------------------------------------------
+Changes:
+20261018: only READER_RETAIN behind end is kept, not everything
+from the start of the image, and read ahead is bounded by the depth
+past end rather than by what's in flight.
+
+\------------------------------------------------------------------*/
+int page_reader_wait( struct page_reader *r, size_t end ) {
+	size_t c;
+
+	if (r->backend == READER_MMAP) return 0;
+	if (r->backend == READER_DECOMPRESS) return decompress_wait( r, end );
+	if (end > r->size) end = r->size;
+
+	if (move_window( r, end )) {
+		/* gone back ( a second carve ), what was behind may be gone */
+		r->front = r->window *r->chunk;
+		r->next_submit = r->window;
+	}
+	if (r->front < r->window *r->chunk) r->front = r->window *r->chunk;
+	if (r->next_submit < r->window) r->next_submit = r->window;
+
+	for (;;) {
+
+		/* move the front over whatever has completed */
+		c = r->front /r->chunk;
+		while ((c < r->chunk_count) && (chunk_state( r, c ) == CHUNK_DONE)) c++;
+		r->front = (c *r->chunk < r->size) ? c *r->chunk : r->size;
+
+#ifdef READER_HAVE_URING
+		if (r->backend == READER_URING) {
+			while ((r->inflight < r->depth) && (r->next_submit < r->chunk_count) && (r->next_submit < r->window_end +r->depth)) {
+				if (chunk_state( r, r->next_submit ) == CHUNK_EMPTY) {
+					if (uring_queue_chunk( r, r->next_submit, 0, r->window, r->window_end )) break;
+				}
+				r->next_submit++;
+			}
+
+			if (r->front >= end) {
+				if (r->ring->pending) uring_enter( r->ring, 0 );
+				uring_reap( r );
+				return 0;
+			}
+
+			if (r->inflight > 0) {
+				r->front_waits++;
+				if (uring_enter( r->ring, 1 )) {
+					fprintf(stderr,"ERROR: io_uring_enter failed ( %s )\n", strerror(errno));
+					return 1;
+				}
+				uring_reap( r );
+				continue;
+			}
+			/* nothing in flight and the ring won't take more, read it ourselves */
+		}
+#endif
+
+		if (r->front >= end) return 0;
+
+		/* pread, one chunk at a time */
+		if (read_chunk( r, r->front /r->chunk, r->window, r->window_end )) return 1;
+	}
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-122648
+  Function Name	: fetch_range
+  Returns Type	: int
+  ----Parameter List
+  1. struct page_reader *r,
+  2.  size_t offset,
+  3.  size_t l,
+  4.  int keep ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Random access, blocks until [offset, offset +l) is loaded.  Chunks
+that aren't already on their way are queued straight away at a
+higher I/O priority than the sequential reads.  With keep, chunks
+outside the scanner's window are marked as wanted now so they stay
+in the pool for a while.
+
+--------------------------------------------------------------------
+Changes:
+20261018: chunks the ring won't take are read synchronously, they
+used to be left empty and the wait for them never returned.
+20261018: was page_reader_fetch, now behind it and page_reader_hold.
+
+\------------------------------------------------------------------*/
+static int fetch_range( struct page_reader *r, size_t offset, size_t l, int keep ) {
+	size_t first, last, c;
+	int waiting = 0;
+
+	if (offset >= r->size) return 1;
+	if (l > r->size -offset) l = r->size -offset;
+	if (l == 0) return 0;
+
+	first = offset /r->chunk;
+	last = (offset +l -1) /r->chunk;
+
+	for (c = first; c <= last; c++) {
+		int state = chunk_state( r, c );
+
+		if (state == CHUNK_INFLIGHT) waiting = 1;
+		if (state != CHUNK_EMPTY) continue;
+
+#ifdef READER_HAVE_URING
+		/* a full ring would leave it empty and the wait below would
+		 * never end, so what it won't take we read ourselves */
+		if ((r->backend == READER_URING) && (uring_queue_chunk( r, c, URING_PRIO_RANDOM, first, last ) == 0)) {
+			waiting = 1;
+		} else
+#endif
+		if (read_chunk( r, c, first, last )) return 1;
+		r->random_reads++;
+	}
+
+#ifdef READER_HAVE_URING
+	while (waiting) {
+		if (uring_enter( r->ring, 1 )) return 1;
+		uring_reap( r );
+		waiting = 0;
+		for (c = first; c <= last; c++) {
+			if (chunk_state( r, c ) != CHUNK_DONE) waiting = 1;
+		}
+	}
+#endif
+
+	if (keep) {
+		r->clock++;
+		for (c = first; c <= last; c++) {
+			if ((c < r->window) || (c >= r->window_end)) r->slots[r->chunk_slot[c]].used = r->clock;
+		}
+	}
+
+	return 0;
+}
+
+
+
+
+/**
+ * Random access ( overflow pages ), see fetch_range().
+ */
+int page_reader_fetch( struct page_reader *r, size_t offset, size_t l ) {
+
+	if (r->backend == READER_MMAP) return 0;
+	if (r->backend == READER_DECOMPRESS) return decompress_fetch( r, offset, l, 1 );
+
+	return fetch_range( r, offset, l, 1 );
+}
+
+
+
+
+/**
+ * Loads [offset, offset +l) and keeps it until the next hold, for an
+ * out of order scan's current page, which overflow lookups while it's
+ * carved mustn't push out.
+ */
+int page_reader_hold( struct page_reader *r, size_t offset, size_t l ) {
+
+	size_t size;
+
+	if (r->backend == READER_MMAP) return 0;
+
+	if (r->backend == READER_DECOMPRESS) pthread_mutex_lock( &(r->lock) );
+	size = r->size;
+	if ((l == 0) || (offset >= size)) {
+		r->hold_first = 1;
+		r->hold_last = 0;
+	} else {
+		if (l > size -offset) l = size -offset;
+		r->hold_first = offset /r->chunk;
+		r->hold_last = (offset +l -1) /r->chunk;
+	}
+	if (r->backend == READER_DECOMPRESS) {
+		pthread_mutex_unlock( &(r->lock) );
+		return decompress_fetch( r, offset, l, 0 );
+	}
+
+	return fetch_range( r, offset, l, 0 );
+}
+
+
+
+
+/**
+ * Waits for the whole image to be decompressed, returns its size.
+ * Nothing is kept beyond what the ring holds, a read of what it
+ * dropped is decompressed again.
+ */
+size_t page_reader_finish( struct page_reader *r ) {
+
+	if (r->backend != READER_DECOMPRESS) return r->size;
+
+	pthread_mutex_lock( &(r->lock) );
+	r->draining = 1;
+	pthread_cond_broadcast( &(r->cond) );
+	decompress_front( r, SIZE_MAX );
+	pthread_mutex_unlock( &(r->lock) );
+
+	return page_reader_size( r );
+}
+
+
+
+
+int page_reader_close( struct page_reader *r ) {
+
+	if (r->backend == READER_MMAP) return 0;
+
+	if (r->backend == READER_DECOMPRESS) {
+		pthread_mutex_lock( &(r->lock) );
+		r->stop = 1;
+		pthread_cond_broadcast( &(r->cond) );
+		pthread_mutex_unlock( &(r->lock) );
+		pthread_join( r->thread, NULL );
+		pthread_mutex_destroy( &(r->lock) );
+		pthread_cond_destroy( &(r->cond) );
+		if (r->second) {
+			decoder_end( r->second );
+			free( r->second );
+			r->second = NULL;
+		}
+		free( r->scratch );
+		r->scratch = NULL;
+		while (r->checkpoint_count > 0) checkpoint_free( r->checkpoints[--r->checkpoint_count] );
+		free( r->checkpoints );
+		r->checkpoints = NULL;
+	}
+
+#ifdef READER_HAVE_URING
+	if (r->ring) {
+		/* nothing may still be writing in to the pool when it goes */
+		while (r->inflight > 0) {
+			if (uring_enter( r->ring, 1 )) break;
+			uring_reap( r );
+		}
+		uring_destroy( r->ring );
+		r->ring = NULL;
+	}
+#endif
+
+	if (r->buf) munmap( r->buf, r->chunk_count *r->chunk );
+	if (r->pool_fd >= 0) {
+		if (r->pool) munmap( r->pool, r->slot_count *r->chunk );
+		close( r->pool_fd );
+		r->pool_fd = -1;
+	}
+	free( r->chunk_slot );
+	free( r->slots );
+	free( r->free_slots );
+	r->buf = r->pool = NULL;
+	r->chunk_slot = NULL;
+	r->slots = NULL;
+	r->free_slots = NULL;
+
+	return 0;
+}
+
+
+
+
+int page_reader_stats( struct page_reader *r, FILE *f ) {
+	static const char *names[] = { "mmap", "pread", "uring", "decompress" };
+	static const char *compressions[] = { "none", "gzip", "zstd" };
+
+	fprintf(f,"input-backend: %s%s\n", names[r->backend], r->fixed_buffers ? " (registered buffers)" : "");
+	if (r->backend == READER_MMAP) return 0;
+
+	if (r->backend == READER_DECOMPRESS) {
+		fprintf(f,"input-decompress: %s, %lu bytes in, %llu bytes out, %lu reserved\n"
+				, compressions[r->compression]
+				, (unsigned long)r->compressed_size
+				, (unsigned long long)r->read_bytes
+				, (unsigned long)r->reserve
+				);
+		if (r->pool_fd >= 0) {
+			fprintf(f,"input-ring: %lu chunks of %lu, %llu recycled behind the front, %llu pushed out, %llu dropped, %llu decompressed again ( %llu from a checkpoint, %llu from the top )\n"
+					, (unsigned long)r->slot_count
+					, (unsigned long)r->chunk
+					, (unsigned long long)r->recycled
+					, (unsigned long long)r->evicted
+					, (unsigned long long)r->dropped
+					, (unsigned long long)r->second_chunks
+					, (unsigned long long)r->second_resumes
+					, (unsigned long long)r->second_restarts
+					);
+		}
+		fprintf(f,"input-front-waits: %llu\n", (unsigned long long)r->front_waits);
+		return 0;
+	}
+
+	fprintf(f,"input-reads: %llu ( %llu random ), %llu bytes, chunk %lu, depth %d\n"
+			, (unsigned long long)r->reads
+			, (unsigned long long)r->random_reads
+			, (unsigned long long)r->read_bytes
+			, (unsigned long)r->chunk
+			, r->depth
+			);
+	fprintf(f,"input-pool: %lu chunks%s, %llu recycled behind the front, %llu pushed out\n"
+			, (unsigned long)r->slot_count
+			, (r->pool_fd < 0) ? " ( the whole image )" : ""
+			, (unsigned long long)r->recycled
+			, (unsigned long long)r->evicted
+			);
+	fprintf(f,"input-front-waits: %llu\n", (unsigned long long)r->front_waits);
+
+	return 0;
+}
@@ -0,0 +1,136 @@
+#ifndef UNDARK_PAGEREADER_H
+#define UNDARK_PAGEREADER_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define READER_MMAP 0 // no reader, the image is mmap'd ( see iopolicy )
+#define READER_PREAD 1
+#define READER_URING 2
+#define READER_DECOMPRESS 3 // gzip/zstd image, decompressed by a worker thread
+
+#define COMPRESSION_NONE 0
+#define COMPRESSION_GZIP 1
+#define COMPRESSION_ZSTD 2
+
+#define READER_CHUNK_DEFAULT (1024 *1024)
+#define READER_DEPTH_DEFAULT 32
+#define READER_RESERVE_RATIO 20 // decompressed size guess without a ring, when the stream doesn't tell us
+#if SIZE_MAX > 0xFFFFFFFFUL
+#define READER_RESERVE_SPAN ((size_t)1 << 40) // address space for a decompressed image, the ring holds the data
+#else
+#define READER_RESERVE_SPAN ((size_t)1 << 30)
+#endif
+#define READER_CHECKPOINTS 256 // decompressor states kept for a second pass to start from, at most
+#define READER_PUBLISH_STEP (256 *1024) // how often the decompressor moves the front
+#define READER_RETAIN (4 *1024 *1024) // kept loaded behind the end page_reader_wait was asked for
+#define READER_OVERFLOW_CHUNKS 16 // chunks fetched at random ( overflow pages ) kept in the pool
+
+#define CHUNK_EMPTY 0
+#define CHUNK_INFLIGHT 1
+#define CHUNK_DONE 2
+
+#define READER_NO_SLOT UINT32_MAX
+
+struct uring; // private to pagereader.c
+struct decoder;
+struct decoder_checkpoint;
+
+struct reader_slot {
+	size_t chunk; // the chunk in it
+	uint64_t used; // fetch clock when last asked for at random, 0 if only the front wanted it
+	uint8_t state; // CHUNK_*
+};
+
+/**
+ * Loads the image in to memory with explicit reads rather than
+ * page faults, in chunk sized reads.  The scanner asks for a
+ * contiguous front ( page_reader_wait ) which is kept topped up with
+ * a deep queue of reads, overflow lookups ask for random ranges
+ * ( page_reader_fetch ) which jump the queue.
+ *
+ * The image is an address range with nothing behind it, reads land
+ * in a fixed pool of chunk buffers ( the ones registered with
+ * io_uring ) which are mapped in at their chunk's place in the
+ * image.  Once the front is READER_RETAIN past a chunk its buffer
+ * goes back to the pool, unless an overflow lookup wanted it, those
+ * are kept until the pool runs short and then the least recently
+ * fetched goes.  An image no bigger than the pool, or a system with
+ * no memfd, just reads straight in to the address range.
+ *
+ * Compressed images are decompressed by a worker thread, the front
+ * being however far it has got, in to the same kind of pool used as
+ * a ring: the decompressor stays at most depth chunks ahead of what
+ * the scanner has asked for and the chunks it leaves behind are
+ * recycled.  Random lookups in the retained window are free, ones
+ * ahead of the front wait for the decompressor to get there ( it
+ * drops what it can't keep on the way ), ones for a chunk that's
+ * gone are decompressed again by a second pass that carries on
+ * forwards from wherever the last one got to, or from the nearest
+ * checkpoint the decompressor left behind it.  Without a memfd the
+ * whole image is kept, in READER_RESERVE_RATIO times the compressed
+ * size if the stream doesn't say.
+ */
+struct page_reader {
+	int backend;
+	int fd;
+	char *buf;
+	size_t size;
+
+	size_t chunk; // bytes per read request
+	int depth; // reads kept in flight ahead of the front
+	size_t chunk_count;
+	uint32_t *chunk_slot; // per chunk, READER_NO_SLOT if it has none
+	size_t next_submit; // next chunk to queue for the sequential front
+	size_t front; // [window chunk, front) is loaded
+	size_t window, window_end; // chunks the scanner is on, from its last page_reader_wait
+	size_t hold_first, hold_last; // chunks of page_reader_hold's range
+	size_t fetch_first, fetch_last; // chunks of the last page_reader_fetch
+	int inflight;
+
+	char *pool; // slot_count chunks, the image itself if pool_fd is -1
+	int pool_fd; // memfd behind the pool, mapped in to the image chunk by chunk
+	struct reader_slot *slots;
+	size_t slot_count;
+	uint32_t *free_slots;
+	size_t free_count;
+	uint64_t clock; // page_reader_fetch calls
+
+	struct uring *ring;
+
+	int compression; // COMPRESSION_* of the input file
+	size_t compressed_size;
+	size_t reserve; // address space set aside for the decompressed image
+	int finished, failed; // decompressor state, under lock
+	int stop, draining; // close wants the decompressor gone, page_reader_finish wants it at the end
+	size_t want; // a fetch is waiting on chunks before this
+	struct decoder *second; // second pass, for chunks the ring has recycled
+	char *scratch; // a chunk the second pass skips through
+	struct decoder_checkpoint **checkpoints; // in order, under lock
+	size_t checkpoint_count, checkpoint_span; // one every checkpoint_span chunks
+	uint64_t dropped, second_chunks, second_resumes, second_restarts;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	uint64_t reads, read_bytes;
+	uint64_t random_reads, front_waits;
+	uint64_t recycled, evicted; // slots given back behind the front, overflow chunks pushed out
+	int fixed_buffers; // io_uring using registered buffers
+};
+
+int page_reader_init( struct page_reader *r );
+int page_reader_parse_backend( struct page_reader *r, const char *name );
+int page_reader_detect( struct page_reader *r, int fd, size_t size );
+size_t page_reader_size( struct page_reader *r );
+char *page_reader_open( struct page_reader *r, int fd, size_t size );
+int page_reader_wait( struct page_reader *r, size_t end );
+int page_reader_fetch( struct page_reader *r, size_t offset, size_t l );
+int page_reader_hold( struct page_reader *r, size_t offset, size_t l );
+size_t page_reader_finish( struct page_reader *r );
+int page_reader_close( struct page_reader *r );
+int page_reader_stats( struct page_reader *r, FILE *f );
+
+#endif
@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "recindex.h"
+
+
+static void put16( unsigned char *p, uint16_t v ) {
+	p[0] = v; p[1] = v >> 8;
+}
+
+static void put32( unsigned char *p, uint32_t v ) {
+	put16( p, v ); put16( p +2, v >> 16 );
+}
+
+static void put64( unsigned char *p, uint64_t v ) {
+	put32( p, v ); put32( p +4, v >> 32 );
+}
+
+static uint16_t get16( const unsigned char *p ) {
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32( const unsigned char *p ) {
+	return get16( p ) | ((uint32_t)get16( p +2 ) << 16);
+}
+
+static uint64_t get64( const unsigned char *p ) {
+	return get32( p ) | ((uint64_t)get32( p +4 ) << 32);
+}
+
+
+
+
+uint64_t recindex_image_hash( const unsigned char *p, size_t l ) {
+	uint64_t h = 14695981039346656037ULL;
+
+	while (l--) {
+		h ^= *p++;
+		h *= 1099511628211ULL;
+	}
+
+	return h;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-154730
+  Function Name	: recindex_create
+  Returns Type	: int
+  ----Parameter List
+  1. struct recindex *x,
+  2.  const char *file,
+  3.  const struct recindex_header *h ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Creates ( truncating ) file and writes the header.  Returns 1 if
+it can't be, errno says why.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int recindex_create( struct recindex *x, const char *file, const struct recindex_header *h ) {
+	unsigned char b[RECINDEX_HEADER_SIZE];
+
+	memset(x, 0, sizeof(struct recindex));
+	x->f = fopen( file, "wb" );
+	if (!x->f) return 1;
+	x->writing = 1;
+
+	memset(b, 0, sizeof(b));
+	memcpy(b, RECINDEX_MAGIC, 8);
+	put32( b +8, RECINDEX_VERSION );
+	put32( b +12, h->page_size );
+	put64( b +16, h->image_hash );
+	put32( b +24, RECINDEX_RECORD_SIZE );
+
+	if (fwrite( b, sizeof(b), 1, x->f ) != 1) return 1;
+
+	return 0;
+}
+
+
+
+
+int recindex_append( struct recindex *x, const struct recindex_record *r ) {
+	unsigned char b[RECINDEX_RECORD_SIZE];
+
+	memset(b, 0, sizeof(b));
+	put64( b, r->offset );
+	put64( b +8, r->rowid );
+	put64( b +16, r->length );
+	put32( b +24, r->page );
+	put32( b +28, r->overflow );
+	put32( b +32, r->signature );
+	put32( b +36, r->forced_length );
+	put16( b +40, r->cell_count );
+	b[42] = r->freespace;
+	b[43] = r->confidence;
+
+	if (fwrite( b, sizeof(b), 1, x->f ) != 1) return 1;
+	x->records++;
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-154902
+  Function Name	: recindex_open
+  Returns Type	: int
+  ----Parameter List
+  1. struct recindex *x,
+  2.  const char *file,
+  3.  struct recindex_header *h ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Opens an index for reading and fills in h from its header.
+Returns 1 if the file can't be opened or read ( errno says why ),
+2 if it isn't an index of a version/record size we know.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int recindex_open( struct recindex *x, const char *file, struct recindex_header *h ) {
+	unsigned char b[RECINDEX_HEADER_SIZE];
+
+	memset(x, 0, sizeof(struct recindex));
+	x->f = fopen( file, "rb" );
+	if (!x->f) return 1;
+
+	if (fread( b, sizeof(b), 1, x->f ) != 1) {
+		return ferror( x->f ) ? 1 : 2;
+	}
+	if (memcmp( b, RECINDEX_MAGIC, 8 ) != 0) return 2;
+
+	h->version = get32( b +8 );
+	h->page_size = get32( b +12 );
+	h->image_hash = get64( b +16 );
+	if ((h->version != RECINDEX_VERSION) || (get32( b +24 ) != RECINDEX_RECORD_SIZE)) return 2;
+
+	return 0;
+}
+
+
+
+
+/**
+ * The next record, 1 if there was one, 0 at the end of the index
+ * and -1 if it stops part way through a record or can't be read.
+ */
+int recindex_next( struct recindex *x, struct recindex_record *r ) {
+	unsigned char b[RECINDEX_RECORD_SIZE];
+	size_t got;
+
+	got = fread( b, 1, sizeof(b), x->f );
+	if (got == 0) return ferror( x->f ) ? -1 : 0;
+	if (got != sizeof(b)) return -1;
+
+	r->offset = get64( b );
+	r->rowid = get64( b +8 );
+	r->length = get64( b +16 );
+	r->page = get32( b +24 );
+	r->overflow = get32( b +28 );
+	r->signature = get32( b +32 );
+	r->forced_length = get32( b +36 );
+	r->cell_count = get16( b +40 );
+	r->freespace = b[42];
+	r->confidence = b[43];
+	x->records++;
+
+	return 1;
+}
+
+
+
+
+/**
+ * Pushes what's been appended out to the file, 1 if it can't be.
+ */
+int recindex_flush( struct recindex *x ) {
+
+	if ((fflush( x->f ) != 0) || (ferror( x->f ))) return 1;
+
+	return 0;
+}
+
+
+
+
+/**
+ * Closes the index, 1 if anything written to it didn't make it
+ * to disk.
+ */
+int recindex_close( struct recindex *x ) {
+	int r = 0;
+
+	if (!x->f) return 0;
+	if ((x->writing) && (ferror( x->f ))) r = 1;
+	if ((fclose( x->f ) != 0) && (x->writing)) r = 1;
+	x->f = NULL;
+
+	return r;
+}
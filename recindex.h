@@ -0,0 +1,72 @@
+#ifndef UNDARK_RECINDEX_H
+#define UNDARK_RECINDEX_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define RECINDEX_MAGIC "UNDARKIX"
+#define RECINDEX_VERSION 1
+#define RECINDEX_HEADER_SIZE 64
+#define RECINDEX_RECORD_SIZE 48
+
+/**
+ * On-disk carve index ( --write-index / --from-index ).
+ *
+ * A fixed size header identifying the image it was written from,
+ * then one fixed size record per accepted record, in the order the
+ * carve found them.  Everything is little-endian whatever the host,
+ * the record count is just what the file size works out to.
+ *
+ *	header	0  magic "UNDARKIX"
+ *		8  version
+ *		12 page size
+ *		16 FNV-1a 64 of the image's first 100 bytes ( SQLite header )
+ *		24 record size
+ *		28 reserved, 0
+ *
+ *	record	0  offset of the record in the image
+ *		8  rowid
+ *		16 payload length
+ *		24 page the record starts in
+ *		28 first overflow page, 0 for none
+ *		32 FNV-1a 32 of the serial types, to spot a changed image
+ *		36 forced length the freeblock decode was given
+ *		40 cell count
+ *		42 freespace ( 1 ) or normal ( 0 ) decode
+ *		43 confidence
+ *		44 reserved, 0
+ */
+struct recindex_header {
+	uint32_t version;
+	uint32_t page_size;
+	uint64_t image_hash;
+};
+
+struct recindex_record {
+	uint64_t offset;
+	uint64_t rowid;
+	uint64_t length;
+	uint32_t page;
+	uint32_t overflow;
+	uint32_t signature;
+	uint32_t forced_length;
+	uint16_t cell_count;
+	uint8_t freespace;
+	uint8_t confidence;
+};
+
+struct recindex {
+	FILE *f;
+	int writing;
+	uint64_t records;
+};
+
+uint64_t recindex_image_hash( const unsigned char *p, size_t l );
+int recindex_create( struct recindex *x, const char *file, const struct recindex_header *h );
+int recindex_append( struct recindex *x, const struct recindex_record *r );
+int recindex_open( struct recindex *x, const char *file, struct recindex_header *h );
+int recindex_flush( struct recindex *x );
+int recindex_next( struct recindex *x, struct recindex_record *r );
+int recindex_close( struct recindex *x );
+
+#endif
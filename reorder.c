@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "reorder.h"
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-182204
+  Function Name	: reorder_init
+  Returns Type	: int
+  ----Parameter List
+  1. struct reorder *r ,
+  ------------------
+  Exit Codes	: 1 if the spool can't be created
+  Side Effects	: a temporary file in TMPDIR, gone once it's closed
+  --------------------------------------------------------------------
+Comments:
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int reorder_init( struct reorder *r ) {
+
+	memset( r, 0, sizeof(struct reorder) );
+	r->fd = -1;
+
+#ifndef _WIN32
+	{
+		const char *tmp = getenv( "TMPDIR" );
+		char spool[1024];
+
+		snprintf(spool, sizeof(spool), "%s/undark-reorder-XXXXXX", (tmp && *tmp) ? tmp : "/tmp");
+		r->fd = mkstemp( spool );
+		if (r->fd >= 0) unlink( spool );
+	}
+#else
+	{
+		FILE *f = tmpfile();
+
+		if (f) r->fd = dup( fileno( f ) );
+		if (f) fclose( f );
+	}
+#endif
+	if (r->fd < 0) {
+		fprintf(stderr,"ERROR: Cannot create the reorder spool ( %s )\n", strerror(errno));
+		return 1;
+	}
+	outbuf_init( &(r->spool), r->fd );
+
+	return 0;
+}
+
+
+
+
+/**
+ * Notes a row about to be written to the spool, from page.
+ */
+int reorder_row( struct reorder *r, uint32_t page ) {
+	struct reorder_span *s;
+
+	if (r->count >= r->allocated) {
+		size_t allocated = r->allocated ? r->allocated *2 : REORDER_ROWS_INITIAL;
+		struct reorder_span *spans = realloc( r->spans, allocated *sizeof(struct reorder_span) );
+
+		if (!spans) {
+			fprintf(stderr,"ERROR: Cannot allocate memory to reorder the output\n");
+			r->failed = 1;
+			return 1;
+		}
+		r->spans = spans;
+		r->allocated = allocated;
+	}
+
+	s = &(r->spans[r->count++]);
+	s->page = page;
+	s->start = r->spool.bytes_written +r->spool.pending;
+	s->end = 0;
+
+	return 0;
+}
+
+
+
+
+/**
+ * qsort() order, by page, then where in the spool ( the order
+ * the page's rows came out in ).
+ */
+static int span_order( const void *a, const void *b ) {
+	const struct reorder_span *x = a, *y = b;
+
+	if (x->page != y->page) return (x->page < y->page) ? -1 : 1;
+	if (x->start != y->start) return (x->start < y->start) ? -1 : 1;
+
+	return 0;
+}
+
+
+
+
+/**
+ * Copies [start, end) of the spool to out, through its scratch
+ * buffer.
+ */
+static int copy_span( struct reorder *r, struct outbuf *out, uint64_t start, uint64_t end ) {
+
+	if (lseek( r->fd, (off_t)start, SEEK_SET ) == (off_t)-1) return 1;
+
+	while (start < end) {
+		size_t chunk = (end -start > OUTBUF_SCRATCH_SIZE) ? OUTBUF_SCRATCH_SIZE : (size_t)(end -start);
+		char *d = outbuf_reserve( out, chunk );
+		size_t got = 0;
+
+		if (!d) return 1;
+		while (got < chunk) {
+			ssize_t l = read( r->fd, d +got, chunk -got );
+
+			if ((l < 0) && (errno == EINTR)) continue;
+			if (l <= 0) return 1;
+			got += l;
+		}
+		start += chunk;
+	}
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-182431
+  Function Name	: reorder_write
+  Returns Type	: int
+  ----Parameter List
+  1. struct reorder *r,
+  2.  struct outbuf *out ,
+  ------------------
+  Exit Codes	: 1 if the spool couldn't be written or read back
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Once the carve is done, every row to out in page order.  out
+isn't flushed.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int reorder_write( struct reorder *r, struct outbuf *out ) {
+	uint64_t total;
+	size_t i;
+
+	if ((outbuf_flush( &(r->spool) )) || (r->failed)) return 1;
+
+	total = r->spool.bytes_written;
+	for (i = 0; i < r->count; i++) r->spans[i].end = (i +1 < r->count) ? r->spans[i +1].start : total;
+	if (r->count) qsort( r->spans, r->count, sizeof(struct reorder_span), span_order );
+
+	for (i = 0; i < r->count; ) {
+		uint64_t start = r->spans[i].start, end = r->spans[i].end;
+
+		for (i++; (i < r->count) && (r->spans[i].start == end); i++) end = r->spans[i].end;
+		if (copy_span( r, out, start, end )) {
+			if (!out->failed) fprintf(stderr,"ERROR: Cannot read back the reorder spool ( %s )\n", strerror(errno));
+			r->failed = 1;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+
+
+
+int reorder_close( struct reorder *r ) {
+
+	if (r->fd >= 0) close( r->fd );
+	r->fd = -1;
+	if (r->spans) free( r->spans );
+	r->spans = NULL;
+	r->count = r->allocated = 0;
+
+	return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef UNDARK_REORDER_H
+#define UNDARK_REORDER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "libundark.h"
+#include "outbuf.h"
+
+#define REORDER_ROWS_INITIAL 4096
+
+/**
+ * File order output for an out of order carve ( --scan-reorder ).
+ *
+ * While the carve runs rows are written, exactly as they'd go to
+ * stdout, to a spool file in TMPDIR ( removed as soon as it's
+ * created ) and where each row landed is noted with the page it
+ * came from.  At the end the spans are sorted by page, keeping
+ * the order rows came out of each page in, and copied from the
+ * spool to the real output, runs of spans that were already next
+ * to each other in one read.  A page is carved the same whichever
+ * order the pages are visited in, so the result is what a file
+ * order carve would have written.
+ */
+struct reorder_span {
+	uint32_t page;
+	uint64_t start, end; // in the spool, end filled in by reorder_write
+};
+
+struct reorder {
+	int fd; // the spool, -1 until reorder_init
+	struct outbuf spool; // dump_row writes here during the carve
+
+	struct reorder_span *spans;
+	size_t count, allocated;
+	int failed; // out of memory, or a spool write/read failed
+};
+
+int reorder_init( struct reorder *r );
+int reorder_row( struct reorder *r, uint32_t page );
+int reorder_write( struct reorder *r, struct outbuf *out );
+int reorder_close( struct reorder *r );
+
+#endif
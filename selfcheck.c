@@ -0,0 +1,714 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "selfcheck.h"
+#include "pagehash.h"
+#include "textesc.h"
+#include "blobenc.h"
+
+/**
+ * What a pass's row callback needs.
+ */
+struct selfcheck_pass {
+	struct selfcheck *c;
+	struct selfcheck_rows *rows;
+	int reference; // decode each row again and run the kernels over it
+};
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-173015
+  Function Name	: selfcheck_init
+  Returns Type	: int
+  ----Parameter List
+  1. struct selfcheck *c,
+  2.  const struct undark_options *opt,
+  3.  const char *input_file,
+  4.  FILE *report ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+The options are used for every pass, they and the file name must
+stay valid until selfcheck_close().  Results and differences go to
+report.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int selfcheck_init( struct selfcheck *c, const struct undark_options *opt, const char *input_file, FILE *report ) {
+
+	memset(c, 0, sizeof(struct selfcheck));
+	c->opt = opt;
+	c->input_file = input_file;
+	c->report = report;
+	c->fd = -1;
+
+	return 0;
+}
+
+
+
+
+/**
+ * Counts a difference, describing the first SELFCHECK_DETAIL_MAX.
+ */
+static void difference( struct selfcheck *c, uint32_t page, size_t offset, const char *what, const char *pass ) {
+
+	c->differences++;
+	if (c->described >= SELFCHECK_DETAIL_MAX) return;
+	c->described++;
+	fprintf(c->report,"self-check: page %u offset %lu: %s%s%s\n", page, (unsigned long)offset, what, pass ? " " : "", pass ? pass : "");
+	if (c->described == SELFCHECK_DETAIL_MAX) fprintf(c->report,"self-check: ( further differences only counted )\n");
+}
+
+
+
+
+/**
+ * SQLite's varint as documented, a byte at a time, the ninth byte
+ * giving all 8 bits.  Bytes used, 0 if it runs past end.
+ */
+static int reference_varint( const unsigned char *p, const unsigned char *end, uint64_t *v ) {
+	uint64_t x = 0;
+	int i;
+
+	for (i = 0; i < 9; i++) {
+		if (p +i >= end) return 0;
+		if (i == 8) {
+			*v = (x << 8) | p[i];
+			return 9;
+		}
+		x = (x << 7) | (p[i] & 0x7f);
+		if (!(p[i] & 0x80)) {
+			*v = x;
+			return i +1;
+		}
+	}
+
+	return 0;
+}
+
+
+
+
+/**
+ * Cell type ( as libundark folds them ) and size of serial type s,
+ * type -1 for the reserved 10 and 11.
+ */
+static size_t reference_serial( uint64_t s, int *type ) {
+	static const size_t sizes[10] = { 0, 1, 2, 3, 4, 6, 8, 8, 0, 0 };
+
+	if (s < 10) {
+		*type = (int)s;
+		return sizes[s];
+	}
+	if (s < 12) {
+		*type = -1;
+		return 0;
+	}
+	*type = (s & 1) ? UNDARK_CELL_TEXT : UNDARK_CELL_BLOB;
+
+	return (s -12) /2;
+}
+
+
+
+
+/**
+ * Reads up to l bytes at offset of the image, fewer at the end of
+ * the file.
+ */
+static size_t read_at( int fd, unsigned char *p, size_t l, size_t offset ) {
+	size_t got = 0;
+
+	if (lseek( fd, (off_t)offset, SEEK_SET ) == (off_t)-1) return 0;
+	while (got < l) {
+		ssize_t r = read( fd, p +got, l -got );
+
+		if (r < 0) {
+			if (errno == EINTR) continue;
+			break;
+		}
+		if (r == 0) break;
+		got += r;
+	}
+
+	return got;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-173240
+  Function Name	: check_record
+  Returns Type	: int
+  ----Parameter List
+  1. struct selfcheck *c,
+  2.  const struct undark_row *row ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Decodes the record at row->offset from the file with the reference
+decoder and compares it to what libundark delivered.  A record
+with an overflow chain only has its local part compared, the
+header and the cells held entirely in it, that being as far as
+the record format alone says where the bytes are.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int check_record( struct selfcheck *c, const struct undark_row *row ) {
+	const unsigned char *p, *end, *h, *hend, *q;
+	uint64_t length, rowid, header_size;
+	size_t got, offset = 0, local;
+	int n, cells = 0;
+
+	if (c->fd < 0) {
+		c->records_unchecked++;
+		return 0;
+	}
+
+	got = read_at( c->fd, c->window, c->window_size, row->offset );
+	p = c->window;
+	end = c->window +got;
+
+	/**
+	 * A record in a freeblock has lost its length and rowid to the
+	 * freeblock header, it starts at the header size
+	 */
+	if (!row->freespace) {
+		n = reference_varint( p, end, &length );
+		if (!n) goto differs;
+		p += n;
+		n = reference_varint( p, end, &rowid );
+		if (!n) goto differs;
+		p += n;
+		if ((length != row->length) || (rowid != row->rowid)) {
+			difference( c, row->page, row->offset, "payload length or rowid differs from the reference", NULL );
+			return 1;
+		}
+	} else length = row->length;
+
+	/**
+	 * Local part of an overflowing payload, as SQLite works it out
+	 * for a table leaf.  A freeblock record's length is only a guess,
+	 * none of it's compared.
+	 */
+	local = length;
+	if (row->freespace && row->overflow) local = 0;
+	else if (row->overflow) {
+		size_t u = c->usable, x = u -35, m = ((u -12) *32 /255) -23;
+		size_t k = m +((length -m) %(u -4));
+
+		local = (k <= x) ? k : m;
+	}
+
+	h = p;
+	n = reference_varint( h, end, &header_size );
+	if ((!n) || ((!row->freespace) && (header_size > length))) goto differs;
+	hend = h +header_size;
+	q = h +n;
+	while (q < hend) {
+		const struct undark_cell *cell;
+		uint64_t s;
+		size_t size, o, l;
+		int type;
+
+		n = reference_varint( q, end, &s );
+		if (!n) goto differs;
+		q += n;
+		size = reference_serial( s, &type );
+
+		if (cells >= row->cell_count) {
+			difference( c, row->page, row->offset, "reference decoder finds more columns", NULL );
+			return 1;
+		}
+		cell = &(row->cells[cells]);
+		o = header_size +offset;
+		offset += size;
+		cells++;
+
+		if (row->overflow) {
+			if ((cell->type != type) || (cell->length != size)) goto differs;
+			if ((o +size <= local) && ((h -c->window) +o +size <= got) && (memcmp( cell->data, h +o, size ) != 0)) goto differs;
+			continue;
+		}
+
+		/* clipped to the end of the image the same way libundark does */
+		l = size;
+		if ((size_t)(h -c->window) +o >= got) l = 0;
+		else if (l > got -(h -c->window) -o) l = got -(h -c->window) -o;
+		if ((cell->type != type) || (cell->length != l) || (memcmp( cell->data, h +o, l ) != 0)) goto differs;
+	}
+	if (cells != row->cell_count) goto differs;
+
+	if (row->overflow) c->records_local++;
+	else c->records_full++;
+	if (row->freespace) c->records_freespace++;
+
+	return 0;
+
+differs:
+	difference( c, row->page, row->offset, "columns differ from the reference decoder", NULL );
+
+	return 1;
+}
+
+
+
+
+/**
+ * Makes sure both kernel output buffers hold l bytes.
+ */
+static int kernel_space( struct selfcheck *c, size_t l ) {
+	char *a, *b;
+
+	if (l <= c->ab_allocated) return 0;
+	a = realloc( c->a, l );
+	if (!a) return 1;
+	c->a = a;
+	b = realloc( c->b, l );
+	if (!b) return 1;
+	c->b = b;
+	c->ab_allocated = l;
+
+	return 0;
+}
+
+
+
+
+/**
+ * The CSV text scan, SIMD against scalar, stepping over each byte
+ * that needs escaping the way dump_row does.
+ */
+static int check_clean_runs( const unsigned char *p, size_t l ) {
+	size_t i = 0;
+
+	while (i < l) {
+		size_t fast = textesc_clean_run( p +i, l -i );
+
+		if (fast != textesc_clean_run_scalar( p +i, l -i )) return 1;
+		i += fast +1;
+	}
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-173512
+  Function Name	: check_kernels
+  Returns Type	: int
+  ----Parameter List
+  1. struct selfcheck *c,
+  2.  const struct undark_row *row ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Runs the row's text and blob cells through the output kernels,
+the SIMD ones have to give exactly what the scalar ones do.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int check_kernels( struct selfcheck *c, const struct undark_row *row ) {
+	int t;
+
+	for (t = 0; t < row->cell_count; t++) {
+		const struct undark_cell *cell = &(row->cells[t]);
+		const unsigned char *p = (const unsigned char *)cell->data;
+		size_t l = cell->length;
+
+		if (cell->type == UNDARK_CELL_TEXT) {
+			c->text_cells++;
+			if (c->text_encoding == UNDARK_TEXT_UTF8) {
+				if (check_clean_runs( p, l )) difference( c, row->page, row->offset, "text scan kernel differs from scalar", NULL );
+
+			} else {
+				int big_endian = (c->text_encoding == UNDARK_TEXT_UTF16BE);
+				size_t fast, slow;
+
+				if (kernel_space( c, TEXTESC_UTF16_LENGTH( l ) )) {
+					c->failed = 1;
+					return 1;
+				}
+				fast = textesc_utf16_to_utf8( c->a, p, l, big_endian );
+				slow = textesc_utf16_to_utf8_scalar( c->b, p, l, big_endian );
+				if ((fast != slow) || (memcmp( c->a, c->b, fast ) != 0)) difference( c, row->page, row->offset, "UTF-16 transcode kernel differs from scalar", NULL );
+				else if (check_clean_runs( (unsigned char *)c->a, fast )) difference( c, row->page, row->offset, "text scan kernel differs from scalar", NULL );
+			}
+
+		} else if (cell->type == UNDARK_CELL_BLOB) {
+			size_t fast, slow;
+
+			c->blob_cells++;
+			if (kernel_space( c, BLOBENC_HEX_LENGTH( l ) +1 )) {
+				c->failed = 1;
+				return 1;
+			}
+			fast = blobenc_hex( c->a, p, l );
+			slow = blobenc_hex_scalar( c->b, p, l );
+			if ((fast != slow) || (memcmp( c->a, c->b, fast ) != 0)) difference( c, row->page, row->offset, "hex blob kernel differs from scalar", NULL );
+		}
+	}
+
+	return 0;
+}
+
+
+
+
+/**
+ * Identity of a row for comparing passes, everything delivered
+ * bar where it was ( kept alongside ) and the confidence.
+ */
+static uint64_t row_fingerprint( const struct undark_row *row ) {
+	uint64_t h = pagehash_bytes( &(row->rowid), sizeof(row->rowid), row->cell_count );
+	int t;
+
+	h = pagehash_bytes( &(row->length), sizeof(row->length), h +row->freespace *2 +row->overflow );
+	for (t = 0; t < row->cell_count; t++) {
+		const struct undark_cell *cell = &(row->cells[t]);
+
+		h = pagehash_bytes( cell->data, cell->length, h +cell->type );
+	}
+
+	return h;
+}
+
+
+
+
+static int pass_row( struct undark_row *row, void *arg ) {
+	struct selfcheck_pass *p = arg;
+	struct selfcheck_rows *rows = p->rows;
+
+	if (rows->count >= rows->allocated) {
+		size_t n = rows->allocated ? rows->allocated *2 : 4096;
+		struct selfcheck_row *r = realloc( rows->rows, n *sizeof(struct selfcheck_row) );
+
+		if (!r) {
+			p->c->failed = 1;
+			return 1;
+		}
+		rows->rows = r;
+		rows->allocated = n;
+	}
+	rows->rows[rows->count].hash = row_fingerprint( row );
+	rows->rows[rows->count].page = row->page;
+	rows->rows[rows->count].offset = row->offset;
+	rows->count++;
+
+	if (p->reference) {
+		p->c->records++;
+		check_record( p->c, row );
+		if (check_kernels( p->c, row )) return 1;
+	}
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-173747
+  Function Name	: carve_pass
+  Returns Type	: int
+  ----Parameter List
+  1. struct selfcheck *c,
+  2.  int backend,
+  3.  int plain,
+  4.  const char *index,
+  5.  int from_index,
+  6.  struct selfcheck_rows *rows ,
+  ------------------
+  Exit Codes	: 1 if the pass couldn't be run to the end
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Carves the image with the given input backend in to rows, plain
+with none of the decode fast paths.  The reference pass ( rows is c->reference ) also writes the carve index
+to index, if there is one, and checks each row as it comes,
+from_index carves from that index instead.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int carve_pass( struct selfcheck *c, int backend, int plain, const char *index, int from_index, struct selfcheck_rows *rows ) {
+	struct undark_options o = *(c->opt);
+	struct selfcheck_pass p;
+	struct undark *u;
+	int result;
+
+	o.input_backend = backend;
+	o.plain_decode = plain;
+	p.c = c;
+	p.rows = rows;
+	p.reference = (rows == &(c->reference));
+
+	u = UNDARK_new( &o );
+	if (!u) {
+		fprintf(c->report,"ERROR: Cannot allocate memory for the carving context\n");
+		return 1;
+	}
+	if (((c->grep_file) && (UNDARK_grep_load( u, c->grep_file ) != UNDARK_OK))
+			|| ((c->signatures) && (UNDARK_signature_add( u, c->signatures ) != UNDARK_OK))
+			|| (UNDARK_open( u, c->input_file ) != UNDARK_OK)
+			|| ((p.reference) && (index) && (UNDARK_index_write( u, index ) != UNDARK_OK))) {
+		fprintf(c->report,"ERROR: %s\n", UNDARK_error( u ));
+		UNDARK_close( u );
+		return 1;
+	}
+
+	if (p.reference) {
+		unsigned char h[100];
+
+		c->page_size = UNDARK_page_size( u );
+		c->text_encoding = UNDARK_text_encoding( u );
+		c->usable = c->page_size;
+		if ((c->fd >= 0) && (read_at( c->fd, h, sizeof(h), 0 ) == sizeof(h))) c->usable -= h[20]; // reserved bytes per page
+
+		/* a record's prefix, header and local part all fit in a page */
+		c->window_size = (size_t)c->page_size *2;
+		c->window = malloc( c->window_size );
+		if (!c->window) {
+			fprintf(c->report,"ERROR: Cannot allocate memory for the self check\n");
+			UNDARK_close( u );
+			return 1;
+		}
+	}
+
+	if (from_index) result = UNDARK_carve_index( u, index, pass_row, &p );
+	else result = UNDARK_carve( u, pass_row, &p );
+	if (result == UNDARK_ERROR) fprintf(c->report,"ERROR: %s\n", UNDARK_error( u ));
+	UNDARK_close( u );
+
+	if (c->failed) fprintf(c->report,"ERROR: Cannot allocate memory for the self check\n");
+
+	return ((result == UNDARK_ERROR) || (c->failed)) ? 1 : 0;
+}
+
+
+
+
+static int row_order( const void *x, const void *y ) {
+	const struct selfcheck_row *a = x, *b = y;
+
+	if (a->page != b->page) return (a->page < b->page) ? -1 : 1;
+	if (a->offset != b->offset) return (a->offset < b->offset) ? -1 : 1;
+	if (a->hash != b->hash) return (a->hash < b->hash) ? -1 : 1;
+
+	return 0;
+}
+
+
+
+
+/**
+ * Compares a pass's rows with the reference's ( already sorted ),
+ * reporting the rows only one of them found.
+ */
+static int compare_rows( struct selfcheck *c, const char *name, struct selfcheck_rows *rows ) {
+	struct selfcheck_rows *r = &(c->reference);
+	size_t i = 0, j = 0;
+	uint64_t missing = 0, extra = 0;
+
+	if (rows->count) qsort( rows->rows, rows->count, sizeof(struct selfcheck_row), row_order );
+
+	while ((i < r->count) || (j < rows->count)) {
+		int order;
+
+		if (i >= r->count) order = 1;
+		else if (j >= rows->count) order = -1;
+		else order = row_order( &(r->rows[i]), &(rows->rows[j]) );
+
+		if (order == 0) {
+			i++;
+			j++;
+		} else if (order < 0) {
+			difference( c, r->rows[i].page, r->rows[i].offset, "row not found, or different, with", name );
+			missing++;
+			i++;
+		} else {
+			difference( c, rows->rows[j].page, rows->rows[j].offset, "row only found with", name );
+			extra++;
+			j++;
+		}
+	}
+
+	if ((missing) || (extra)) fprintf(c->report,"self-check: %s, %lu rows, %llu missing, %llu extra\n", name, (unsigned long)rows->count, (unsigned long long)missing, (unsigned long long)extra);
+	else fprintf(c->report,"self-check: %s, %lu rows, same\n", name, (unsigned long)rows->count);
+
+	return ((missing) || (extra)) ? 1 : 0;
+}
+
+
+
+
+/**
+ * Opens the image for the reference decoder, unless it's gzip/zstd
+ * compressed, its offsets are then in to the decompressed image.
+ */
+static int reference_open( struct selfcheck *c ) {
+	unsigned char h[4];
+
+	c->fd = open( c->input_file, O_RDONLY );
+	if (c->fd < 0) {
+		fprintf(c->report,"ERROR: Cannot open input file '%s' ( %s )\n", c->input_file, strerror(errno));
+		return 1;
+	}
+	if ((read_at( c->fd, h, 4, 0 ) == 4) && (((h[0] == 0x1f) && (h[1] == 0x8b)) || ((h[0] == 0x28) && (h[1] == 0xb5) && (h[2] == 0x2f) && (h[3] == 0xfd)))) {
+		close( c->fd );
+		c->fd = -1;
+	}
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-174103
+  Function Name	: selfcheck_run
+  Returns Type	: int
+  ----Parameter List
+  1. struct selfcheck *c ,
+  ------------------
+  Exit Codes	: 0 all agree, 1 differences found or a pass failed
+  Side Effects	: writes, then removes, a carve index in TMPDIR
+  --------------------------------------------------------------------
+Comments:
+
+Runs the reference pass, then the others against it, see
+selfcheck.h.  A compressed image is always decompressed the one
+way, so it only gets the index round trip and the kernel checks.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int selfcheck_run( struct selfcheck *c ) {
+	static const struct {
+		int backend;
+		const char *name;
+	} backends[] = {
+		{ UNDARK_INPUT_MMAP, "mmap" },
+		{ UNDARK_INPUT_PREAD, "pread" },
+		{ UNDARK_INPUT_URING, "uring" }
+	};
+	char index[1024] = "";
+	int failed = 0;
+	size_t i;
+
+	if (reference_open( c )) return 1;
+
+#ifndef _WIN32
+	{
+		const char *tmp = getenv( "TMPDIR" );
+		int fd;
+
+		snprintf(index, sizeof(index), "%s/undark-self-check-XXXXXX", (tmp && *tmp) ? tmp : "/tmp");
+		fd = mkstemp( index );
+		if (fd < 0) {
+			fprintf(c->report,"self-check: cannot create a carve index ( %s ), no index round trip\n", strerror(errno));
+			index[0] = '\0';
+		} else close( fd );
+	}
+#endif
+
+	/**
+	 * Reference pass, the options as given
+	 */
+	if (carve_pass( c, c->opt->input_backend, 0, index[0] ? index : NULL, 0, &(c->reference) )) {
+		failed = 1;
+		goto done;
+	}
+	fprintf(c->report,"self-check: reference decoder, %llu records ( %llu in freeblocks ), %llu checked in full, %llu by their local part, %llu not checked%s\n"
+			, (unsigned long long)c->records, (unsigned long long)c->records_freespace, (unsigned long long)c->records_full, (unsigned long long)c->records_local, (unsigned long long)c->records_unchecked
+			, (c->fd < 0) ? " ( compressed image )" : "");
+	fprintf(c->report,"self-check: output kernels ( text %s, hex %s ), %llu text cells, %llu blob cells\n"
+			, textesc_kernel_name(), blobenc_kernel_name(), (unsigned long long)c->text_cells, (unsigned long long)c->blob_cells);
+	if (c->reference.count) qsort( c->reference.rows, c->reference.count, sizeof(struct selfcheck_row), row_order );
+
+	/**
+	 * The reference decoder only sees the rows that were found, a
+	 * fast path wrongly rejecting a candidate shows up here
+	 */
+	{
+		struct selfcheck_rows rows;
+
+		memset(&rows, 0, sizeof(rows));
+		if (carve_pass( c, c->opt->input_backend, 1, NULL, 0, &rows )) failed = 1;
+		else compare_rows( c, "plain decode", &rows );
+		if (rows.rows) free( rows.rows );
+	}
+
+	for (i = 0; (c->fd >= 0) && (i < sizeof(backends) /sizeof(backends[0])); i++) {
+		struct selfcheck_rows rows;
+
+		if (backends[i].backend == c->opt->input_backend) continue;
+		memset(&rows, 0, sizeof(rows));
+		if (carve_pass( c, backends[i].backend, 0, NULL, 0, &rows )) failed = 1;
+		else compare_rows( c, backends[i].name, &rows );
+		if (rows.rows) free( rows.rows );
+	}
+
+	if (index[0]) {
+		struct selfcheck_rows rows;
+
+		memset(&rows, 0, sizeof(rows));
+		if (carve_pass( c, c->opt->input_backend, 0, index, 1, &rows )) failed = 1;
+		else compare_rows( c, "carve index", &rows );
+		if (rows.rows) free( rows.rows );
+	}
+
+done:
+	if (index[0]) unlink( index );
+
+	if (failed) fprintf(c->report,"self-check: FAILED, a pass could not be completed\n");
+	else if (c->differences) fprintf(c->report,"self-check: FAILED, %llu differences\n", (unsigned long long)c->differences);
+	else fprintf(c->report,"self-check: passed\n");
+
+	return ((failed) || (c->differences)) ? 1 : 0;
+}
+
+
+
+
+int selfcheck_close( struct selfcheck *c ) {
+
+	if (c->fd >= 0) close( c->fd );
+	if (c->window) free( c->window );
+	if (c->a) free( c->a );
+	if (c->b) free( c->b );
+	if (c->reference.rows) free( c->reference.rows );
+	memset(c, 0, sizeof(struct selfcheck));
+	c->fd = -1;
+
+	return 0;
+}
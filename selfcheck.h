@@ -0,0 +1,74 @@
+#ifndef UNDARK_SELFCHECK_H
+#define UNDARK_SELFCHECK_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "libundark.h"
+
+#define SELFCHECK_DETAIL_MAX 20 // differences described, the rest are only counted
+
+/**
+ * Differential self check ( --self-check ).
+ *
+ * The image is carved with the options given and every record
+ * libundark hands back is decoded again, from the file itself,
+ * by a deliberately plain reference decoder: SQLite's varint and
+ * record format as documented, one byte at a time, none of the
+ * varint map, prefix checks or signature matchers the carve uses.
+ * The rowid, columns, serial types, lengths and cell bytes have to
+ * agree.  Overflowing records are checked as far as their local
+ * part goes, records in freeblocks from their header on.  A gzip/
+ * zstd image can't be read back by offset, its records aren't
+ * checked.
+ *
+ * Every text and blob cell is also run through the SIMD CSV text
+ * scanner, UTF-16 transcoder and hex encoder, and the result has to
+ * be what their scalar versions give.
+ *
+ * Then the image is carved again with the decode fast paths off
+ * ( plain_decode, every candidate decoded in full ), with each of
+ * the other input backends, and once more from a carve index
+ * written on the first pass, and each of those has to find exactly
+ * the same rows in the same places.
+ */
+struct selfcheck_row {
+	uint64_t hash;
+	uint32_t page;
+	size_t offset;
+};
+
+struct selfcheck_rows {
+	struct selfcheck_row *rows;
+	size_t count, allocated;
+};
+
+struct selfcheck {
+	const struct undark_options *opt;
+	const char *input_file;
+	const char *grep_file; // applied to every pass, NULL for none
+	const char *signatures;
+	FILE *report;
+
+	int fd; // the image again, for the reference decoder, -1 if it's compressed
+	uint32_t page_size, usable;
+	int text_encoding;
+	unsigned char *window; // the record as the reference sees it
+	size_t window_size;
+	char *a, *b; // kernel outputs, fast and scalar
+	size_t ab_allocated;
+
+	uint64_t records, records_full, records_local, records_unchecked, records_freespace;
+	uint64_t text_cells, blob_cells;
+	uint64_t differences;
+	int described;
+	int failed; // out of memory part way through a pass
+
+	struct selfcheck_rows reference;
+};
+
+int selfcheck_init( struct selfcheck *c, const struct undark_options *opt, const char *input_file, FILE *report );
+int selfcheck_run( struct selfcheck *c );
+int selfcheck_close( struct selfcheck *c );
+
+#endif
@@ -0,0 +1,774 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include "serve.h"
+#include "numfmt.h"
+#include "blobenc.h"
+#include "textesc.h"
+
+#define BASE64_CHUNK 49152 // input bytes per base64 step, a multiple of 3
+
+static volatile sig_atomic_t serve_stop = 0;
+
+/**
+ * What a query's row callback needs to write the row out.
+ */
+struct serve_query {
+	struct serve *s;
+	struct serve_db *d;
+	int match_rowid; // only rows with this rowid
+	uint64_t rowid;
+	uint64_t rows;
+	int failed;
+	int hangup; // the client went away mid reply
+};
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-153012
+  Function Name	: serve_init
+  Returns Type	: int
+  ----Parameter List
+  1. struct serve *s,
+  2.  const char *path,
+  3.  const struct undark_options *opt ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+The options are used for every database opened, they must stay
+valid until serve_close().  Returns 1 if we're out of memory.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int serve_init( struct serve *s, const char *path, const struct undark_options *opt ) {
+
+	memset(s, 0, sizeof(struct serve));
+	s->opt = opt;
+	s->listen_fd = -1;
+	s->path = strdup( path );
+	if (!s->path) {
+		fprintf(stderr,"ERROR: Cannot allocate memory for the server\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+
+
+
+/**
+ * Closes the database in slot i, anyone who had it selected will
+ * have to select it again.
+ */
+static int db_shut( struct serve *s, int i ) {
+	struct serve_db *d = &(s->dbs[i]);
+	int c;
+
+	UNDARK_close( d->u );
+	free( d->path );
+	if (d->rowids) free( d->rowids );
+	memset(d, 0, sizeof(struct serve_db));
+
+	for (c = 0; c < s->client_count; c++) {
+		if (s->clients[c].db == i) s->clients[c].db = -1;
+	}
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-153140
+  Function Name	: serve_open
+  Returns Type	: int
+  ----Parameter List
+  1. struct serve *s,
+  2.  const char *db ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Slot of the database, opening it ( in place of the least recently
+used one if we're full ) if it isn't open already.  -1 if it can't
+be opened, the reason is on stderr.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int serve_open( struct serve *s, const char *db ) {
+	struct serve_db *d;
+	struct undark *u;
+	int i, slot;
+
+	for (i = 0; i < s->db_count; i++) {
+		if (strcmp( s->dbs[i].path, db ) == 0) {
+			s->dbs[i].last_used = ++s->tick;
+			return i;
+		}
+	}
+
+	u = UNDARK_new( s->opt );
+	if (!u) {
+		fprintf(stderr,"ERROR: Cannot allocate memory for the carving context\n");
+		return -1;
+	}
+	if ((s->grep_file) && (UNDARK_grep_load( u, s->grep_file ) != UNDARK_OK)) {
+		fprintf(stderr,"ERROR: %s\n", UNDARK_error( u ));
+		UNDARK_close( u );
+		return -1;
+	}
+	if ((s->signatures) && (UNDARK_signature_add( u, s->signatures ) != UNDARK_OK)) {
+		fprintf(stderr,"ERROR: %s\n", UNDARK_error( u ));
+		UNDARK_close( u );
+		return -1;
+	}
+	if (UNDARK_open( u, db ) != UNDARK_OK) {
+		fprintf(stderr,"ERROR: %s\n", UNDARK_error( u ));
+		UNDARK_close( u );
+		return -1;
+	}
+
+	if (s->db_count < SERVE_DB_MAX) {
+		slot = s->db_count++;
+	} else {
+		slot = 0;
+		for (i = 1; i < s->db_count; i++) {
+			if (s->dbs[i].last_used < s->dbs[slot].last_used) slot = i;
+		}
+		db_shut( s, slot );
+	}
+
+	d = &(s->dbs[slot]);
+	d->path = strdup( db );
+	if (!d->path) {
+		fprintf(stderr,"ERROR: Cannot allocate memory for the server\n");
+		UNDARK_close( u );
+		if (slot == s->db_count -1) s->db_count--;
+		return -1;
+	}
+	d->u = u;
+	d->text_encoding = UNDARK_text_encoding( u );
+	d->last_used = ++s->tick;
+
+	return slot;
+}
+
+
+
+
+/**
+ * A JSON string, valid UTF-8 goes out as is, stray bytes become
+ * U+FFFD.
+ */
+static int json_string( struct outbuf *ob, const unsigned char *p, size_t l ) {
+	size_t i = 0;
+
+	outbuf_putc( ob, '"' );
+	while (i < l) {
+		size_t run = textesc_clean_run( p +i, l -i );
+		const unsigned char *bs;
+
+		/* the clean run lets backslashes through, JSON doesn't */
+		while ((run > 0) && ((bs = memchr( p +i, '\\', run )) != NULL)) {
+			outbuf_copy( ob, (const char *)p +i, bs -(p +i) );
+			outbuf_copy( ob, "\\\\", 2 );
+			run -= (bs -(p +i)) +1;
+			i = (bs -p) +1;
+		}
+		outbuf_copy( ob, (const char *)p +i, run );
+		i += run;
+		if (i >= l) break;
+
+		switch (p[i]) {
+			case '"': outbuf_copy( ob, "\\\"", 2 ); break;
+			case '\n': outbuf_copy( ob, "\\n", 2 ); break;
+			case '\r': outbuf_copy( ob, "\\r", 2 ); break;
+			case '\t': outbuf_copy( ob, "\\t", 2 ); break;
+			default:
+				if (p[i] < 0x80) outbuf_printf( ob, "\\u%04x", p[i] );
+				else outbuf_copy( ob, "\\ufffd", 6 );
+				break;
+		}
+		i++;
+	}
+	outbuf_putc( ob, '"' );
+
+	return 0;
+}
+
+
+
+
+static int json_blob( struct outbuf *ob, const unsigned char *p, size_t l ) {
+
+	outbuf_copy( ob, "{\"blob\":\"", 9 );
+	while (l > 0) {
+		size_t chunk = (l > BASE64_CHUNK) ? BASE64_CHUNK : l;
+		char *d = outbuf_reserve( ob, BLOBENC_BASE64_LENGTH(chunk) );
+
+		if (!d) return 1;
+		blobenc_base64( d, p, chunk );
+		p += chunk;
+		l -= chunk;
+	}
+	outbuf_copy( ob, "\"}", 2 );
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-153420
+  Function Name	: json_row
+  Returns Type	: int
+  ----Parameter List
+  1. struct undark_row *row,
+  2.  void *arg ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Row callback, writes the row as a JSON object in to the reply.
+Everything is copied, overflow rows are freed once we return.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int json_row( struct undark_row *row, void *arg ) {
+	struct serve_query *q = arg;
+	struct serve *s = q->s;
+	struct outbuf *ob = &(s->reply);
+	int t;
+
+	if ((q->match_rowid) && ((row->freespace) || (row->rowid != q->rowid))) return 0;
+
+	if (q->rows++) outbuf_putc( ob, ',' );
+	if (row->freespace) outbuf_copy( ob, "{\"rowid\":null", 13 );
+	else outbuf_printf( ob, "{\"rowid\":%llu", (unsigned long long)row->rowid );
+	outbuf_printf( ob, ",\"page\":%u,\"offset\":%llu,\"length\":%llu,\"confidence\":%d,\"freespace\":%s,\"overflow\":%s,\"cells\":["
+			, row->page, (unsigned long long)row->offset, (unsigned long long)row->length, row->confidence
+			, row->freespace ? "true" : "false", row->overflow ? "true" : "false" );
+
+	for (t = 0; t < row->cell_count; t++) {
+		struct undark_cell *c = &(row->cells[t]);
+		char n[NUMFMT_BUFFER_SIZE];
+
+		if (t) outbuf_putc( ob, ',' );
+
+		switch (c->type) {
+			case UNDARK_CELL_NULL:
+				outbuf_copy( ob, "null", 4 );
+				break;
+
+			case UNDARK_CELL_REAL:
+				{
+					double v = UNDARK_cell_real( c );
+
+					if (!isfinite(v)) {
+						outbuf_copy( ob, "null", 4 );
+						break;
+					}
+					outbuf_copy( ob, n, numfmt_double( n, v ) );
+				}
+				break;
+
+			case UNDARK_CELL_BLOB:
+				json_blob( ob, (const unsigned char *)c->data, c->length );
+				break;
+
+			case UNDARK_CELL_TEXT:
+				if (q->d->text_encoding == UNDARK_TEXT_UTF8) {
+					json_string( ob, (const unsigned char *)c->data, c->length );
+				} else {
+					size_t need = TEXTESC_UTF16_LENGTH(c->length);
+					size_t tl;
+
+					if (need > s->text_allocated) {
+						char *text = realloc( s->text, need );
+
+						if (!text) {
+							q->failed = 1;
+							return 1;
+						}
+						s->text = text;
+						s->text_allocated = need;
+					}
+					tl = textesc_utf16_to_utf8( s->text, (const unsigned char *)c->data, c->length, (q->d->text_encoding == UNDARK_TEXT_UTF16BE) );
+					json_string( ob, (const unsigned char *)s->text, tl );
+				}
+				break;
+
+			default:
+				outbuf_copy( ob, n, numfmt_int64( n, UNDARK_cell_integer( c ) ) );
+				break;
+		}
+	}
+	outbuf_copy( ob, "]}", 2 );
+
+	if (ob->failed) {
+		q->hangup = 1;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+
+
+static int reply_error( struct serve *s, const char *fmt, ... ) {
+	char msg[1024];
+	va_list ap;
+
+	va_start( ap, fmt );
+	vsnprintf( msg, sizeof(msg), fmt, ap );
+	va_end( ap );
+
+	outbuf_copy( &(s->reply), "{\"ok\":false,\"error\":", 20 );
+	json_string( &(s->reply), (const unsigned char *)msg, strlen(msg) );
+	outbuf_copy( &(s->reply), "}\n", 2 );
+
+	return 0;
+}
+
+
+
+
+static int rowid_compare( const void *a, const void *b ) {
+	const struct serve_rowid *x = a, *y = b;
+
+	if (x->rowid != y->rowid) return (x->rowid < y->rowid) ? -1 : 1;
+	if (x->page != y->page) return (x->page < y->page) ? -1 : 1;
+	return 0;
+}
+
+
+
+
+static int index_row( struct undark_row *row, void *arg ) {
+	struct serve_db *d = arg;
+	struct serve_rowid *r;
+
+	if (row->freespace) return 0;
+	if ((d->rowid_count) && (d->rowids[d->rowid_count -1].rowid == row->rowid) && (d->rowids[d->rowid_count -1].page == row->page)) return 0;
+
+	if (d->rowid_count == d->rowid_allocated) {
+		size_t allocated = d->rowid_allocated ? d->rowid_allocated *2 : 1024;
+
+		r = realloc( d->rowids, allocated *sizeof(struct serve_rowid) );
+		if (!r) return 1;
+		d->rowids = r;
+		d->rowid_allocated = allocated;
+	}
+
+	r = &(d->rowids[d->rowid_count++]);
+	r->rowid = row->rowid;
+	r->page = row->page;
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-153705
+  Function Name	: query_rowid
+  Returns Type	: int
+  ----Parameter List
+  1. struct serve *s,
+  2.  struct serve_query *q ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Builds the rowid -> page index with one full carve if this is the
+first rowid question for the database, then carves just the pages
+the rowid was seen in.  Rowids aren't unique across tables ( or
+across old copies of a row ), every match is returned.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int query_rowid( struct serve *s, struct serve_query *q ) {
+	struct serve_db *d = q->d;
+	size_t lo = 0, hi;
+
+	if (!d->indexed) {
+		if (UNDARK_carve( d->u, index_row, d ) != UNDARK_OK) {
+			d->rowid_count = 0;
+			return 1;
+		}
+		qsort( d->rowids, d->rowid_count, sizeof(struct serve_rowid), rowid_compare );
+		d->indexed = 1;
+	}
+
+	hi = d->rowid_count;
+	while (lo < hi) {
+		size_t mid = lo +(hi -lo) /2;
+
+		if (d->rowids[mid].rowid < q->rowid) lo = mid +1;
+		else hi = mid;
+	}
+
+	for (; (lo < d->rowid_count) && (d->rowids[lo].rowid == q->rowid); lo++) {
+		uint32_t page = d->rowids[lo].page;
+
+		if (UNDARK_carve_pages( d->u, page, page, json_row, q ) == UNDARK_ERROR) return 1;
+		if (q->failed) return 1;
+	}
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-153921
+  Function Name	: serve_request
+  Returns Type	: int
+  ----Parameter List
+  1. struct serve *s,
+  2.  struct serve_client *c,
+  3.  char *line ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Answers one request line.  Returns 1 if the connection should be
+closed.
+
+--------------------------------------------------------------------
+Changes:
+20261018: offset past the last page number a uint32_t holds is an error
+
+\------------------------------------------------------------------*/
+static int serve_request( struct serve *s, struct serve_client *c, char *line ) {
+	struct serve_query q;
+	struct serve_db *d;
+	char *verb, *args;
+	unsigned long long a, b;
+	int n = 0, r = UNDARK_OK;
+
+	outbuf_init( &(s->reply), c->fd );
+	s->queries++;
+
+	while ((*line == ' ') || (*line == '\t')) line++;
+	verb = line;
+	while ((*line) && (*line != ' ') && (*line != '\t')) line++;
+	if (*line) *line++ = '\0';
+	while ((*line == ' ') || (*line == '\t')) line++;
+	args = line;
+
+	if (*verb == '\0') return 0;
+	if (strcmp( verb, "quit" ) == 0) return 1;
+
+	if (strcmp( verb, "db" ) == 0) {
+		if (*args == '\0') {
+			reply_error( s, "db needs a path" );
+			return outbuf_flush( &(s->reply) );
+		}
+		n = serve_open( s, args );
+		if (n < 0) {
+			reply_error( s, "Cannot open '%s'", args );
+			return outbuf_flush( &(s->reply) );
+		}
+		c->db = n;
+		verb = "info";
+	}
+
+	if ((c->db < 0) && (s->default_db)) c->db = serve_open( s, s->default_db );
+	if (c->db < 0) {
+		reply_error( s, "No database selected" );
+		return outbuf_flush( &(s->reply) );
+	}
+	d = &(s->dbs[c->db]);
+	d->last_used = ++s->tick;
+
+	if (strcmp( verb, "info" ) == 0) {
+		outbuf_copy( &(s->reply), "{\"ok\":true,\"db\":", 16 );
+		json_string( &(s->reply), (const unsigned char *)d->path, strlen(d->path) );
+		outbuf_printf( &(s->reply), ",\"page_size\":%u,\"page_count\":%u,\"text_encoding\":\"%s\",\"rowid_index\":%s}\n"
+				, UNDARK_page_size( d->u ), UNDARK_page_count( d->u )
+				, (d->text_encoding == UNDARK_TEXT_UTF8) ? "utf8" : (d->text_encoding == UNDARK_TEXT_UTF16LE) ? "utf16le" : "utf16be"
+				, d->indexed ? "true" : "false" );
+		return outbuf_flush( &(s->reply) );
+	}
+
+	memset(&q, 0, sizeof(q));
+	q.s = s;
+	q.d = d;
+	outbuf_copy( &(s->reply), "{\"ok\":true,\"rows\":[", 19 );
+
+	if (strcmp( verb, "pages" ) == 0) {
+		n = sscanf( args, "%llu %llu", &a, &b );
+		if (n == 1) b = a;
+		if ((n < 1) || (a < 1) || (b < a) || (b > UINT32_MAX)) {
+			outbuf_init( &(s->reply), c->fd );
+			reply_error( s, "pages needs <first> [<last>]" );
+			return outbuf_flush( &(s->reply) );
+		}
+		r = UNDARK_carve_pages( d->u, a, b, json_row, &q );
+
+	} else if (strcmp( verb, "offset" ) == 0) {
+		if ((sscanf( args, "%llu", &a ) != 1) || (a /UNDARK_page_size( d->u ) >= UINT32_MAX)) {
+			outbuf_init( &(s->reply), c->fd );
+			reply_error( s, "offset needs <byte>" );
+			return outbuf_flush( &(s->reply) );
+		}
+		a = a /UNDARK_page_size( d->u ) +1;
+		r = UNDARK_carve_pages( d->u, a, a, json_row, &q );
+
+	} else if (strcmp( verb, "rowid" ) == 0) {
+		if (sscanf( args, "%llu", &a ) != 1) {
+			outbuf_init( &(s->reply), c->fd );
+			reply_error( s, "rowid needs <n>" );
+			return outbuf_flush( &(s->reply) );
+		}
+		q.match_rowid = 1;
+		q.rowid = a;
+		if (query_rowid( s, &q )) r = UNDARK_ERROR;
+
+	} else {
+		outbuf_init( &(s->reply), c->fd );
+		reply_error( s, "Unknown request '%s' ( db, info, pages, offset, rowid, quit )", verb );
+		return outbuf_flush( &(s->reply) );
+	}
+
+	if (q.hangup) return 1;
+
+	/**
+	 * Rows already queued can't be taken back, so a failure part way
+	 * through ends the row list and says so.
+	 */
+	if ((r == UNDARK_ERROR) || (q.failed)) {
+		const char *why = q.failed ? "Out of memory" : UNDARK_error( d->u );
+
+		outbuf_printf( &(s->reply), "],\"count\":%llu,\"truncated\":true,\"error\":", (unsigned long long)q.rows );
+		json_string( &(s->reply), (const unsigned char *)why, strlen(why) );
+		outbuf_copy( &(s->reply), "}\n", 2 );
+	} else {
+		outbuf_printf( &(s->reply), "],\"count\":%llu}\n", (unsigned long long)q.rows );
+	}
+
+	return outbuf_flush( &(s->reply) );
+}
+
+
+
+
+static void serve_signal( int sig ) {
+	serve_stop = 1;
+}
+
+
+
+
+#ifndef _WIN32
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-154230
+  Function Name	: serve_run
+  Returns Type	: int
+  ----Parameter List
+  1. struct serve *s ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Binds the socket and answers requests until SIGINT/SIGTERM.  One
+request is answered at a time, they're meant to be small.  Returns
+1 if the socket can't be set up.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int serve_run( struct serve *s ) {
+	struct sockaddr_un addr;
+	struct pollfd fds[SERVE_CLIENTS_MAX +1];
+	int i;
+
+	if (strlen( s->path ) >= sizeof(addr.sun_path)) {
+		fprintf(stderr,"ERROR: Socket path '%s' is too long\n", s->path);
+		return 1;
+	}
+
+	s->listen_fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+	if (s->listen_fd < 0) {
+		fprintf(stderr,"ERROR: Cannot create socket ( %s )\n", strerror(errno));
+		return 1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy( addr.sun_path, s->path );
+	unlink( s->path );
+	if ((bind( s->listen_fd, (struct sockaddr *)&addr, sizeof(addr) ) != 0) || (listen( s->listen_fd, 16 ) != 0)) {
+		fprintf(stderr,"ERROR: Cannot listen on '%s' ( %s )\n", s->path, strerror(errno));
+		return 1;
+	}
+
+	signal( SIGPIPE, SIG_IGN ); // a client hanging up mid reply is just a failed write
+	signal( SIGINT, serve_signal );
+	signal( SIGTERM, serve_signal );
+
+	while (!serve_stop) {
+		int n;
+
+		fds[0].fd = s->listen_fd;
+		fds[0].events = POLLIN;
+		for (i = 0; i < s->client_count; i++) {
+			fds[i +1].fd = s->clients[i].fd;
+			fds[i +1].events = POLLIN;
+			fds[i +1].revents = 0;
+		}
+
+		n = poll( fds, s->client_count +1, -1 );
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			fprintf(stderr,"ERROR: poll failed ( %s )\n", strerror(errno));
+			break;
+		}
+
+		/* clients first, accepting can move them about */
+		for (i = s->client_count -1; i >= 0; i--) {
+			struct serve_client *c = &(s->clients[i]);
+			int drop = 0;
+			ssize_t got;
+			char *nl;
+
+			if (!(fds[i +1].revents & (POLLIN|POLLHUP|POLLERR))) continue;
+
+			got = read( c->fd, c->line +c->used, SERVE_LINE_MAX -c->used );
+			if (got <= 0) {
+				if ((got < 0) && (errno == EINTR)) continue;
+				drop = 1;
+			} else {
+				c->used += got;
+			}
+
+			while ((!drop) && ((nl = memchr( c->line, '\n', c->used )) != NULL)) {
+				size_t l = nl -c->line;
+
+				*nl = '\0';
+				if ((l > 0) && (c->line[l -1] == '\r')) c->line[l -1] = '\0';
+				if (serve_request( s, c, c->line )) drop = 1;
+				c->used -= l +1;
+				memmove( c->line, nl +1, c->used );
+			}
+
+			if ((!drop) && (c->used == SERVE_LINE_MAX)) {
+				outbuf_init( &(s->reply), c->fd );
+				reply_error( s, "Request longer than %d bytes", SERVE_LINE_MAX );
+				outbuf_flush( &(s->reply) );
+				drop = 1;
+			}
+
+			if (drop) {
+				close( c->fd );
+				*c = s->clients[--s->client_count];
+			}
+		}
+
+		if (fds[0].revents & POLLIN) {
+			int fd = accept( s->listen_fd, NULL, NULL );
+
+			if (fd >= 0) {
+				if (s->client_count >= SERVE_CLIENTS_MAX) {
+					close( fd );
+				} else {
+					struct serve_client *c = &(s->clients[s->client_count++]);
+
+					c->fd = fd;
+					c->db = -1;
+					c->used = 0;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+#else
+int serve_run( struct serve *s ) {
+	fprintf(stderr,"ERROR: --serve needs Unix domain sockets, not available in this build\n");
+	return 1;
+}
+#endif
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-154512
+  Function Name	: serve_close
+  Returns Type	: int
+  ----Parameter List
+  1. struct serve *s ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Hangs up on everyone, closes the databases and removes the socket.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int serve_close( struct serve *s ) {
+	int i;
+
+	for (i = 0; i < s->client_count; i++) close( s->clients[i].fd );
+	s->client_count = 0;
+	for (i = s->db_count -1; i >= 0; i--) db_shut( s, i );
+	s->db_count = 0;
+
+	if (s->listen_fd >= 0) {
+		close( s->listen_fd );
+		unlink( s->path );
+	}
+	if (s->text) free( s->text );
+	if (s->path) free( s->path );
+	s->text = NULL;
+	s->path = NULL;
+
+	return 0;
+}
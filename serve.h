@@ -0,0 +1,84 @@
+#ifndef UNDARK_SERVE_H
+#define UNDARK_SERVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "libundark.h"
+#include "outbuf.h"
+
+#define SERVE_DB_MAX 16 // databases kept open, least recently used is closed first
+#define SERVE_CLIENTS_MAX 64
+#define SERVE_LINE_MAX 4096 // longest request line
+
+/**
+ * Carve query daemon ( --serve=<socket> ).
+ *
+ * Listens on a Unix socket, each connection sends one request per
+ * line and gets one line of JSON back.  Databases stay open ( and
+ * mapped ) between requests, so a question about a few pages only
+ * costs carving those pages.  The rowid index is built by one full
+ * carve the first time a database is asked for a rowid, and kept.
+ *
+ *	db <path>		select ( opening if need be ) a database,
+ *				otherwise the one given with -i is used
+ *	info			page size/count and text encoding
+ *	pages <first> [<last>]	rows carved from those pages
+ *	offset <byte>		rows carved from the page holding byte
+ *	rowid <n>		rows with that rowid
+ *	quit
+ *
+ * Rows come back as {"ok":true,"rows":[...],"count":n}, failures
+ * as {"ok":false,"error":"..."}.  A carve failing part way adds
+ * "truncated":true and the error after the rows it did get.
+ */
+struct serve_rowid {
+	uint64_t rowid;
+	uint32_t page;
+};
+
+struct serve_db {
+	char *path;
+	struct undark *u;
+	int text_encoding;
+	uint64_t last_used;
+
+	struct serve_rowid *rowids; // sorted by rowid then page
+	size_t rowid_count, rowid_allocated;
+	int indexed;
+};
+
+struct serve_client {
+	int fd;
+	int db; // index in to dbs, -1 until a db is selected
+	size_t used;
+	char line[SERVE_LINE_MAX];
+};
+
+struct serve {
+	char *path; // of the socket
+	const struct undark_options *opt;
+	const char *grep_file; // loaded in to every database opened, NULL for none
+	const char *signatures; // --signature list, likewise
+	const char *default_db; // selected for new connections, NULL for none
+	int listen_fd;
+
+	struct serve_db dbs[SERVE_DB_MAX];
+	int db_count;
+	struct serve_client clients[SERVE_CLIENTS_MAX];
+	int client_count;
+
+	uint64_t tick;
+	uint64_t queries;
+	char *text; // UTF-16 transcoding scratch
+	size_t text_allocated;
+
+	struct outbuf reply;
+};
+
+int serve_init( struct serve *s, const char *path, const struct undark_options *opt );
+int serve_open( struct serve *s, const char *db );
+int serve_run( struct serve *s );
+int serve_close( struct serve *s );
+
+#endif
@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sigmatch.h"
+#include "varint.h"
+
+#define CLASS_NULL 0x01
+#define CLASS_INT 0x02
+#define CLASS_REAL 0x04
+#define CLASS_TEXT 0x08
+#define CLASS_BLOB 0x10
+#define CLASS_ANY (CLASS_NULL|CLASS_INT|CLASS_REAL|CLASS_TEXT|CLASS_BLOB)
+
+#ifdef __GNUC__
+#define SIGMATCH_INLINE static inline __attribute__((always_inline))
+#else
+#define SIGMATCH_INLINE static inline
+#endif
+
+static const uint8_t class_mask[128] = {
+	['n'] = CLASS_NULL, ['i'] = CLASS_INT, ['r'] = CLASS_REAL|CLASS_INT, ['t'] = CLASS_TEXT, ['b'] = CLASS_BLOB,
+	['N'] = CLASS_NULL, ['I'] = CLASS_INT|CLASS_NULL, ['R'] = CLASS_REAL|CLASS_INT|CLASS_NULL, ['T'] = CLASS_TEXT|CLASS_NULL, ['B'] = CLASS_BLOB|CLASS_NULL,
+	['*'] = CLASS_ANY
+};
+
+/* serial types 0..11, 10 and 11 are reserved and never match */
+static const uint8_t serial_classes[12] = {
+	CLASS_NULL, CLASS_INT, CLASS_INT, CLASS_INT, CLASS_INT, CLASS_INT, CLASS_INT,
+	CLASS_REAL, CLASS_INT, CLASS_INT, 0, 0
+};
+
+
+SIGMATCH_INLINE int serial_class( uint64_t s ) {
+	if (s >= 12) return (s & 1) ? CLASS_TEXT : CLASS_BLOB;
+	return serial_classes[s];
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-161507
+  Function Name	: match_classes
+  Returns Type	: int
+  ----Parameter List
+  1. const char *classes,
+  2.  int count,
+  3.  int more,
+  4.  unsigned char *h,
+  5.  size_t l,
+  6.  uint64_t *types,
+  7.  int max ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Does the record header's serial types ( the l bytes at h, after
+the header size varint ) fit classes?  Returns the number of
+columns, with their serial types in types, or 0.  The header has
+to end exactly after the last column.
+
+Always inlined, so each built in signature's matcher is this with
+its classes and count as constants, the loop unrolled and each
+class mask folded in to a single test per header byte.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+SIGMATCH_INLINE int match_classes( const char *classes, int count, int more, unsigned char *h, size_t l, uint64_t *types, int max ) {
+	unsigned char *p = h, *end = h +l;
+	int i;
+
+	if ((count > max) || (l < (size_t)count)) return 0;
+	if ((!more) && (l > (size_t)count *9)) return 0;
+
+	for (i = 0; i < count; i++) {
+		uint64_t s;
+
+		if (p >= end) return 0;
+		if (*p < 0x80) s = *p++;
+		else varint_decode( &s, (char *)p, (char **)&p );
+		if (!(serial_class( s ) & class_mask[(unsigned char)classes[i] & 0x7F])) return 0;
+		types[i] = s;
+	}
+
+	if (more) {
+		while (p < end) {
+			uint64_t s;
+
+			if (i >= max) return 0;
+			if (*p < 0x80) s = *p++;
+			else varint_decode( &s, (char *)p, (char **)&p );
+			if (!serial_class( s )) return 0;
+			types[i++] = s;
+		}
+	}
+
+	return (p == end) ? i : 0;
+}
+
+
+
+
+/* run time class strings */
+static int match_spec( const char *classes, int count, int more, unsigned char *h, size_t l, uint64_t *types, int max ) {
+	return match_classes( classes, count, more, h, l, types, max );
+}
+
+
+#define SIG_MORE( classes ) (classes[sizeof(classes) -2] == '+')
+#define SIGNATURE( name, classes ) \
+	static int match_##name( const char *c, int count, int more, unsigned char *h, size_t l, uint64_t *types, int max ) { \
+		return match_classes( classes, sizeof(classes) -1 -SIG_MORE( classes ), SIG_MORE( classes ), h, l, types, max ); \
+	}
+#include "signatures.def"
+#undef SIGNATURE
+
+static const struct {
+	const char *name;
+	const char *classes;
+	sigmatch_fn match;
+} builtins[] = {
+#define SIGNATURE( name, classes ) { #name, classes, match_##name },
+#include "signatures.def"
+#undef SIGNATURE
+	{ NULL, NULL, NULL }
+};
+
+
+
+
+int sigmatch_init( struct sigmatch *m ) {
+	memset(m, 0, sizeof(struct sigmatch));
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-161822
+  Function Name	: sigmatch_add
+  Returns Type	: int
+  ----Parameter List
+  1. struct sigmatch *m,
+  2.  const char *spec ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+spec is the name of a built in signature or a class string.
+Returns 1 if it's neither ( or we're out of memory ), 2 if there
+are already SIGMATCH_MAX signatures.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int sigmatch_add( struct sigmatch *m, const char *spec ) {
+	struct signature *s;
+	size_t l = strlen( spec );
+	size_t i;
+
+	if (m->count >= SIGMATCH_MAX) return 2;
+	s = &(m->sigs[m->count]);
+	memset(s, 0, sizeof(struct signature));
+
+	for (i = 0; builtins[i].name; i++) {
+		if (strcmp( spec, builtins[i].name ) == 0) {
+			s->name = builtins[i].name;
+			s->classes = builtins[i].classes;
+			s->match = builtins[i].match;
+			l = strlen( s->classes );
+			s->more = (s->classes[l -1] == '+');
+			s->count = l -s->more;
+			m->count++;
+			return 0;
+		}
+	}
+
+	if ((l == 0) || (l > SIGMATCH_CLASSES_MAX)) return 1;
+	s->more = (spec[l -1] == '+');
+	s->count = l -s->more;
+	if (s->count == 0) return 1;
+	for (i = 0; i < (size_t)s->count; i++) {
+		if ((spec[i] & 0x80) || (!class_mask[(unsigned char)spec[i]])) return 1;
+	}
+
+	m->owned[m->count] = strdup( spec );
+	if (!m->owned[m->count]) return 1;
+	s->name = s->classes = m->owned[m->count];
+	s->match = match_spec;
+	m->count++;
+
+	return 0;
+}
+
+
+
+
+/**
+ * Columns in the header at h ( l bytes of serial types ) if it fits
+ * one of the signatures, their serial types in types.  0 if none.
+ */
+int sigmatch_find( struct sigmatch *m, unsigned char *h, size_t l, uint64_t *types, int max ) {
+	int i, n;
+
+	for (i = 0; i < m->count; i++) {
+		struct signature *s = &(m->sigs[i]);
+
+		n = s->match( s->classes, s->count, s->more, h, l, types, max );
+		if (n) {
+			s->matched++;
+			return n;
+		}
+	}
+
+	return 0;
+}
+
+
+
+
+/**
+ * Name of the i'th built in signature, NULL past the last.
+ */
+const char *sigmatch_builtin( int i ) {
+	if ((i < 0) || (i >= (int)(sizeof(builtins) /sizeof(builtins[0])) -1)) return NULL;
+
+	return builtins[i].name;
+}
+
+
+
+
+int sigmatch_free( struct sigmatch *m ) {
+	int i;
+
+	for (i = 0; i < m->count; i++) {
+		if (m->owned[i]) free(m->owned[i]);
+		m->owned[i] = NULL;
+	}
+	m->count = 0;
+
+	return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef UNDARK_SIGMATCH_H
+#define UNDARK_SIGMATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SIGMATCH_MAX 32 // signatures in force at once
+#define SIGMATCH_CLASSES_MAX 256 // columns in a --signature spec
+
+typedef int (*sigmatch_fn)( const char *classes, int count, int more, unsigned char *h, size_t l, uint64_t *types, int max );
+
+/**
+ * Record signatures ( --signature ), see signatures.def for the
+ * class letters.
+ *
+ * A carve with signatures only decodes records whose header has a
+ * serial type of the right class for every column, checked on the
+ * header bytes before anything else of the record is looked at.
+ * Built in signatures each have a matcher compiled for their own
+ * classes and column count, ones given as a class string at run
+ * time share the general one.
+ */
+struct signature {
+	const char *name;
+	const char *classes;
+	int count; // columns, not counting a trailing +
+	int more; // a trailing +, further columns of any type may follow
+	sigmatch_fn match;
+	uint64_t matched;
+};
+
+struct sigmatch {
+	struct signature sigs[SIGMATCH_MAX];
+	int count;
+	char *owned[SIGMATCH_MAX]; // copies of run time class strings
+};
+
+int sigmatch_init( struct sigmatch *m );
+int sigmatch_add( struct sigmatch *m, const char *spec );
+int sigmatch_find( struct sigmatch *m, unsigned char *h, size_t l, uint64_t *types, int max );
+const char *sigmatch_builtin( int i );
+int sigmatch_free( struct sigmatch *m );
+
+#endif
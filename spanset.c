@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "spanset.h"
+
+
+int spanset_init( struct spanset *s ) {
+	memset(s, 0, sizeof(struct spanset));
+
+	return 0;
+}
+
+
+
+
+int spanset_clear( struct spanset *s ) {
+	s->count = 0;
+	s->reach = 0;
+
+	return 0;
+}
+
+
+
+
+/**
+ * Index of the last span starting at or before offset, -1 if
+ * there isn't one.
+ */
+static int last_at_or_before( struct spanset *s, uint32_t offset ) {
+	int lo = 0, hi = s->count -1, found = -1;
+
+	while (lo <= hi) {
+		int mid = lo +(hi -lo) /2;
+
+		if (s->spans[mid].start <= offset) {
+			found = mid;
+			lo = mid +1;
+		} else {
+			hi = mid -1;
+		}
+	}
+
+	return found;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-141022
+  Function Name	: spanset_add
+  Returns Type	: int
+  ----Parameter List
+  1. struct spanset *s,
+  2.  uint32_t start,
+  3.  uint32_t end,
+  4.  int score ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Inserts in start order.  Spans normally arrive in order so this is
+an append, but anything is accepted.  The caller is responsible for
+not adding overlapping spans.  Returns 1 if we're out of memory.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int spanset_add( struct spanset *s, uint32_t start, uint32_t end, int score ) {
+	int i;
+
+	if (s->count == s->allocated) {
+		int allocated = s->allocated ? s->allocated *2 : 32;
+		struct span *spans = realloc( s->spans, allocated *sizeof(struct span) );
+
+		if (!spans) return 1;
+		s->spans = spans;
+		s->allocated = allocated;
+	}
+
+	i = last_at_or_before( s, start ) +1;
+	if (i < s->count) memmove( s->spans +i +1, s->spans +i, (s->count -i) *sizeof(struct span) );
+	s->spans[i].start = start;
+	s->spans[i].end = end;
+	s->spans[i].score = score;
+	s->count++;
+	if (end > s->reach) s->reach = end;
+
+	return 0;
+}
+
+
+
+
+int spanset_remove( struct spanset *s, uint32_t start ) {
+	int i = last_at_or_before( s, start );
+
+	if ((i < 0) || (s->spans[i].start != start)) return 1;
+	memmove( s->spans +i, s->spans +i +1, (s->count -i -1) *sizeof(struct span) );
+	s->count--;
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-141210
+  Function Name	: *spanset_find
+  Returns Type	: struct span
+  ----Parameter List
+  1. struct spanset *s,
+  2.  uint32_t offset ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+The span covering offset, or NULL.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+struct span *spanset_find( struct spanset *s, uint32_t offset ) {
+	int i = last_at_or_before( s, offset );
+
+	if ((i < 0) || (offset >= s->spans[i].end)) return NULL;
+
+	return &(s->spans[i]);
+}
+
+
+
+
+int spanset_free( struct spanset *s ) {
+	if (s->spans) free(s->spans);
+	spanset_init( s );
+
+	return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef UNDARK_SPANSET_H
+#define UNDARK_SPANSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A set of non-overlapping [start, end) byte ranges kept sorted by
+ * start, each with a score.  Used to remember which parts of a page
+ * have already been claimed by an accepted record.
+ */
+struct span {
+	uint32_t start, end;
+	int score;
+};
+
+struct spanset {
+	struct span *spans;
+	int count, allocated;
+	uint32_t reach; // no span ends beyond this, a cheap test before spanset_find()
+};
+
+int spanset_init( struct spanset *s );
+int spanset_clear( struct spanset *s );
+int spanset_add( struct spanset *s, uint32_t start, uint32_t end, int score );
+int spanset_remove( struct spanset *s, uint32_t start );
+struct span *spanset_find( struct spanset *s, uint32_t offset );
+int spanset_free( struct spanset *s );
+
+#endif
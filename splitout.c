@@ -0,0 +1,393 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "splitout.h"
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-143012
+  Function Name	: splitout_init
+  Returns Type	: int
+  ----Parameter List
+  1. struct splitout *s,
+  2.  const char *dir,
+  3.  int key,
+  4.  int max_open ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Creates the output directory if it isn't there.  Returns 1 if it
+can't be created or we're out of memory.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int splitout_init( struct splitout *s, const char *dir, int key, int max_open ) {
+	int r;
+
+	memset(s, 0, sizeof(struct splitout));
+	s->key = key;
+	s->max_open = (max_open > 0) ? max_open : SPLIT_MAX_OPEN_DEFAULT;
+
+#ifndef _WIN32
+	r = mkdir( dir, 0755 );
+#else
+	r = mkdir( dir );
+#endif
+	if ((r != 0) && (errno != EEXIST)) {
+		fprintf(stderr,"ERROR: Cannot create split output directory '%s' ( %s )\n", dir, strerror(errno));
+		return 1;
+	}
+
+	s->dir = strdup( dir );
+	s->open = malloc( s->max_open *sizeof(int) );
+	if ((!s->dir) || (!s->open)) {
+		fprintf(stderr,"ERROR: Cannot allocate memory for split output\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+
+
+
+static uint32_t name_hash( const char *p ) {
+	uint32_t h = 2166136261u;
+
+	while (*p) {
+		h ^= (unsigned char)*p++;
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+
+
+
+/**
+ * The file name a row goes to.  Type signatures longer than
+ * SPLIT_SIGNATURE_MAX cells are cut short and finished off with a
+ * hash of the whole thing.
+ */
+static int sink_name( struct splitout *s, const struct undark_row *row, char *name, size_t l ) {
+	char sig[SPLIT_SIGNATURE_MAX +1];
+	uint32_t h = 2166136261u;
+	int t;
+
+	if (s->key == SPLIT_KEY_COLUMNS) {
+		snprintf(name, l, "columns-%d.csv", row->cell_count);
+		return 0;
+	}
+
+	for (t = 0; t < row->cell_count; t++) {
+		char c;
+
+		switch (row->cells[t].type) {
+			case UNDARK_CELL_NULL: c = 'n'; break;
+			case UNDARK_CELL_REAL: c = 'r'; break;
+			case UNDARK_CELL_BLOB: c = 'b'; break;
+			case UNDARK_CELL_TEXT: c = 't'; break;
+			default: c = 'i'; break;
+		}
+		if (t < SPLIT_SIGNATURE_MAX) sig[t] = c;
+		h ^= (unsigned char)c;
+		h *= 16777619u;
+	}
+	sig[(t < SPLIT_SIGNATURE_MAX) ? t : SPLIT_SIGNATURE_MAX] = '\0';
+
+	if (t <= SPLIT_SIGNATURE_MAX) snprintf(name, l, "types-%s.csv", sig);
+	else snprintf(name, l, "types-%s-%08x.csv", sig, h);
+
+	return 0;
+}
+
+
+
+
+/**
+ * Doubles the hash table and puts every sink back in to it.
+ */
+static int table_grow( struct splitout *s ) {
+	int size = s->table_size ? s->table_size *2 : 64;
+	int *table;
+	int i;
+
+	table = calloc( size, sizeof(int) );
+	if (!table) return 1;
+
+	for (i = 0; i < s->count; i++) {
+		int slot = s->sinks[i].hash & (size -1);
+
+		while (table[slot]) slot = (slot +1) & (size -1);
+		table[slot] = i +1;
+	}
+
+	if (s->table) free(s->table);
+	s->table = table;
+	s->table_size = size;
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-143240
+  Function Name	: sink_find
+  Returns Type	: int
+  ----Parameter List
+  1. struct splitout *s,
+  2.  const char *name ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Index of the sink for name, adding a ( closed ) one if this is
+the first row we've seen for it.  -1 if we're out of memory.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int sink_find( struct splitout *s, const char *name ) {
+	uint32_t h = name_hash( name );
+	struct split_sink *k;
+	int slot;
+
+	if ((s->count +1) *2 > s->table_size) {
+		if (table_grow( s )) return -1;
+	}
+
+	slot = h & (s->table_size -1);
+	while (s->table[slot]) {
+		k = &(s->sinks[s->table[slot] -1]);
+		if ((k->hash == h) && (strcmp( k->name, name ) == 0)) return s->table[slot] -1;
+		slot = (slot +1) & (s->table_size -1);
+	}
+
+	if (s->count == s->allocated) {
+		int allocated = s->allocated ? s->allocated *2 : 32;
+		struct split_sink *sinks = realloc( s->sinks, allocated *sizeof(struct split_sink) );
+
+		if (!sinks) return -1;
+		s->sinks = sinks;
+		s->allocated = allocated;
+	}
+
+	k = &(s->sinks[s->count]);
+	memset(k, 0, sizeof(struct split_sink));
+	k->name = strdup( name );
+	if (!k->name) return -1;
+	k->hash = h;
+	s->table[slot] = ++s->count;
+
+	return s->count -1;
+}
+
+
+
+
+/**
+ * Flushes and closes the n'th open sink.
+ */
+static int sink_shut( struct splitout *s, int n ) {
+	struct split_sink *k = &(s->sinks[s->open[n]]);
+
+	outbuf_flush( k->out );
+	close( k->out->fd );
+	free( k->out );
+	k->out = NULL;
+	s->open[n] = s->open[--s->open_count];
+
+	return 0;
+}
+
+
+
+
+/**
+ * Shuts the least recently written open sink, 1 if none are open.
+ */
+static int sink_evict( struct splitout *s ) {
+	int i, lru = 0;
+
+	if (s->open_count == 0) return 1;
+
+	for (i = 1; i < s->open_count; i++) {
+		if (s->sinks[s->open[i]].last_used < s->sinks[s->open[lru]].last_used) lru = i;
+	}
+	sink_shut( s, lru );
+	s->evictions++;
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-143417
+  Function Name	: sink_open
+  Returns Type	: int
+  ----Parameter List
+  1. struct splitout *s,
+  2.  int i ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+First open truncates, later ones ( after an eviction ) append.
+If we run out of descriptors with sinks still open we give one
+of those up and try again.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static int sink_open( struct splitout *s, int i ) {
+	struct split_sink *k = &(s->sinks[i]);
+	char path[4096];
+	int fd;
+
+	if (s->open_count >= s->max_open) sink_evict( s );
+
+	snprintf(path, sizeof(path), "%s/%s", s->dir, k->name);
+	do {
+		fd = open( path, O_WRONLY|O_CREAT|(k->created ? O_APPEND : O_TRUNC), S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH );
+	} while ((fd < 0) && ((errno == EMFILE) || (errno == ENFILE)) && (sink_evict( s ) == 0));
+
+	if (fd < 0) {
+		fprintf(stderr,"ERROR: Cannot open split output '%s' ( %s )\n", path, strerror(errno));
+		return 1;
+	}
+
+	k->out = malloc( sizeof(struct outbuf) );
+	if (!k->out) {
+		fprintf(stderr,"ERROR: Cannot allocate memory for split output '%s'\n", path);
+		close(fd);
+		return 1;
+	}
+	outbuf_init( k->out, fd );
+	k->out->unbuffered = s->unbuffered;
+	k->created = 1;
+
+	s->open[s->open_count++] = i;
+	s->opens++;
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-143605
+  Function Name	: splitout_route
+  Returns Type	: struct outbuf *
+  ----Parameter List
+  1. struct splitout *s,
+  2.  const struct undark_row *row ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+The outbuf the row should be written to, opening its file if
+need be.  NULL if that can't be done.  The sink isn't flushed till
+it's evicted, so the caller copies text in unless the image is
+mapped whole.
+
+--------------------------------------------------------------------
+Changes:
+20261018: Says the caller copies, sinks outlive the reader's chunks
+
+\------------------------------------------------------------------*/
+struct outbuf *splitout_route( struct splitout *s, const struct undark_row *row ) {
+	char name[SPLIT_NAME_MAX];
+	struct split_sink *k;
+	int i;
+
+	sink_name( s, row, name, sizeof(name) );
+	i = sink_find( s, name );
+	if (i < 0) {
+		fprintf(stderr,"ERROR: Cannot allocate memory for split output\n");
+		return NULL;
+	}
+
+	k = &(s->sinks[i]);
+	if ((!k->out) && (sink_open( s, i ))) return NULL;
+
+	k->last_used = ++s->tick;
+	k->rows++;
+
+	return k->out;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-143711
+  Function Name	: splitout_close
+  Returns Type	: int
+  ----Parameter List
+  1. struct splitout *s ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Flushes and closes everything still open, frees the lot.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int splitout_close( struct splitout *s ) {
+	int i;
+
+	while (s->open_count) sink_shut( s, s->open_count -1 );
+
+	for (i = 0; i < s->count; i++) free( s->sinks[i].name );
+	if (s->sinks) free(s->sinks);
+	if (s->table) free(s->table);
+	if (s->open) free(s->open);
+	if (s->dir) free(s->dir);
+	s->sinks = NULL;
+	s->table = NULL;
+	s->open = NULL;
+	s->dir = NULL;
+	s->count = 0;
+
+	return 0;
+}
+
+
+
+
+int splitout_stats( struct splitout *s, FILE *f ) {
+	fprintf(f,"split-output: %d files, %llu opens, %llu evictions ( max %d open )\n", s->count
+			, (unsigned long long)s->opens, (unsigned long long)s->evictions, s->max_open);
+
+	return 0;
+}
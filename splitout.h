@@ -0,0 +1,61 @@
+#ifndef UNDARK_SPLITOUT_H
+#define UNDARK_SPLITOUT_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "libundark.h"
+#include "outbuf.h"
+
+#define SPLIT_KEY_COLUMNS 0 // columns-<count>.csv
+#define SPLIT_KEY_TYPES 1 // types-<signature>.csv, one letter per cell
+#define SPLIT_MAX_OPEN_DEFAULT 64
+#define SPLIT_NAME_MAX 256
+#define SPLIT_SIGNATURE_MAX 200 // cells spelt out in a types name before we fall back to a hash
+
+/**
+ * Per-signature output files.
+ *
+ * Rows are routed to a file in the output directory named after
+ * their column count or their storage class signature ( n, i, r,
+ * t, b per cell ).  Each file gets its own outbuf while it's open,
+ * at most max_open are open at a time, the least recently written
+ * one is flushed and closed to make room and reopened for append
+ * if it's needed again.
+ *
+ * A sink can sit on queued rows until it's evicted or the run ends,
+ * so what goes into one follows outbuf.h, text only by reference
+ * from an image UNDARK_image_mapped() says is mapped whole.
+ */
+struct split_sink {
+	char *name; // file name in the directory, also the key
+	uint32_t hash;
+	struct outbuf *out; // NULL while the file is closed
+	int created; // the file's been started, reopen with O_APPEND
+	uint64_t last_used;
+	uint64_t rows;
+};
+
+struct splitout {
+	char *dir;
+	int key; // SPLIT_KEY_*
+	int max_open;
+	int unbuffered; // passed on to each sink's outbuf
+
+	struct split_sink *sinks;
+	int count, allocated;
+	int *table; // open addressing over sinks, index +1, 0 for empty
+	int table_size;
+	int *open; // sinks with a descriptor
+	int open_count;
+
+	uint64_t tick;
+	uint64_t opens, evictions;
+};
+
+int splitout_init( struct splitout *s, const char *dir, int key, int max_open );
+struct outbuf *splitout_route( struct splitout *s, const struct undark_row *row );
+int splitout_close( struct splitout *s );
+int splitout_stats( struct splitout *s, FILE *f );
+
+#endif
@@ -0,0 +1,232 @@
+#!/usr/bin/env python3
+#
+# Builds the test databases in tests/fixtures.  They're checked in, as
+# the bytes SQLite writes can change between versions and the expected
+# CSVs are frozen against these exact files; run this only to add a
+# fixture, then refreeze with run.sh --freeze and check the diff.
+#
+#	python3 mkfixtures.py [fixtures dir]
+#
+
+import gzip
+import os
+import random
+import sqlite3
+import struct
+import sys
+
+OUT = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(os.path.abspath(__file__)), "fixtures")
+
+
+def open_db(name, page_size=1024, encoding=None):
+	path = os.path.join(OUT, name)
+	if os.path.exists(path):
+		os.remove(path)
+	c = sqlite3.connect(path)
+	c.execute("PRAGMA page_size=%d" % page_size)
+	c.execute("PRAGMA secure_delete=OFF")
+	c.execute("PRAGMA journal_mode=DELETE")
+	if encoding:
+		c.execute("PRAGMA encoding='%s'" % encoding)
+	return c, path
+
+
+def gzip_copy(path):
+	with open(path, "rb") as f:
+		data = f.read()
+	with open(path + ".gz", "wb") as f:
+		f.write(gzip.compress(data, 9, mtime=0))
+
+
+def double(bits):
+	return struct.unpack(">d", struct.pack(">Q", bits))[0]
+
+
+# Every serial type: NULL, 1/2/3/4/6/8 byte ints either side of each
+# boundary, the schema 4 constants 0 and 1, doubles that need all 17
+# digits, negative zero, the extremes and denormals, then text and blobs
+NUMBERS = [
+	None, 0, 1, -1,
+	127, -128, 128, -129,
+	32767, -32768, 32768, -32769,
+	8388607, -8388608, 8388608, -8388609,
+	2147483647, -2147483648, 2147483648, -2147483649,
+	140737488355327, -140737488355328, 140737488355328, -140737488355329,
+	9223372036854775807, -9223372036854775808,
+	0.1, 1.0 / 3, -0.0, 0.5, -1.5, 3.0, 100.0, 1e21, 1e22, 1e-7, 123456.789,
+	1.7976931348623157e308, -1.7976931348623157e308,
+	double(1), double(2), double(0x000FFFFFFFFFFFFF), double(0x0010000000000000),
+	double(0x8000000000000001), 2.2250738585072014e-308, 4.9406564584124654e-320,
+]
+
+TEXTS = [
+	"", "plain", "comma, and \"quotes\"", "line\nbreak", "café ☺ 日本",
+	"x" * 300,
+]
+
+BLOBS = [
+	b"", b"\x00\x01\xff", bytes(range(256)), b"\xde\xad\xbe\xef" * 40,
+]
+
+
+# ( label, value ) for large.db's ev table
+EVENTS = [
+	("unix seconds 2023", 1700000000),
+	("unix seconds 1999", 915148800),
+	("unix milliseconds 2005", 1104537600000),
+	("unix milliseconds 2023", 1700000000000),
+	("phone number", 4155551234),
+	("cocoa seconds 2023", 720000000.5),
+	("cocoa nanoseconds 2023", 720000000000000000),
+	("webkit microseconds 2023", 13340000000000000),
+	("counter", 123456),
+	("unix seconds 2019", 1577750400),
+	("unix seconds 2031", 1924992000),
+]
+
+
+def types_db():
+	c, path = open_db("types.db")
+	c.execute("create table num(id integer primary key, v, note text)")
+	c.execute("create table str(id integer primary key, t text, b blob, n)")
+	c.execute("create table gone(id integer primary key, v, t text, b blob)")
+	for i, v in enumerate(NUMBERS):
+		c.execute("insert into num values(?,?,?)", (i +1, v, "n%d" % i))
+		c.execute("insert into gone values(?,?,?,?)", (i +1, v, TEXTS[i % len(TEXTS)][:40], BLOBS[i % len(BLOBS)][:20]))
+	for i, t in enumerate(TEXTS):
+		c.execute("insert into str values(?,?,?,?)", (i +1, t, BLOBS[i % len(BLOBS)], i))
+	c.commit()
+	# deleted rows, their space becomes freeblocks on a page still in use
+	c.execute("delete from gone where id % 3 = 0")
+	c.commit()
+	c.close()
+	gzip_copy(path)
+
+
+def overflow_db():
+	c, path = open_db("overflow.db")
+	c.execute("create table msg(id integer primary key, body text, att blob, flag)")
+	c.execute("create table scratch(id integer primary key, junk text)")
+	for i in range(40):
+		body = ("message %d " % i) * (1 +(i % 7) *60)
+		att = bytes((i *7 +j) & 0xFF for j in range(200 +(i % 5) *900))
+		c.execute("insert into msg values(?,?,?,?)", (i +1, body, att, i % 2))
+		c.execute("insert into scratch values(?,?)", (i +1, "scratch %d " % i * 20))
+	c.commit()
+	# whole pages to the freelist, then rows off the remaining pages
+	c.execute("drop table scratch")
+	c.execute("delete from msg where id % 6 = 0")
+	c.commit()
+	c.close()
+	gzip_copy(path)
+
+	# cut off part way through a page, as a partial copy would be
+	with open(path, "rb") as f:
+		data = f.read()
+	with open(os.path.join(OUT, "truncated.db"), "wb") as f:
+		f.write(data[:len(data) *3 //5 +333])
+
+
+def rowid_db():
+	# rowids either side of each varint length up to the 8/9 byte
+	# boundary ( 2^56 ), and the ends of the range, which take all 9
+	c, path = open_db("rowid.db")
+	c.execute("create table r(id integer primary key, v, s text)")
+	c.execute("create table gone(id integer primary key, v, s text)")
+	ids = []
+	for bits in (7, 14, 21, 28, 35, 42, 49, 56):
+		ids += [(1 << bits) -1, 1 << bits]
+	ids += [(1 << 63) -1, -1, -(1 << 63), -(1 << 56)]
+	for i in ids:
+		c.execute("insert into r values(?,?,?)", (i, i, "id %d" % i))
+		c.execute("insert into gone values(?,?,?)", (i, -i if i > -(1 << 63) else i, "gone %d" % i))
+	c.commit()
+	c.execute("delete from gone where id in (?, ?, ?, ?)", ((1 << 56) -1, (1 << 56), (1 << 63) -1, -1))
+	c.commit()
+	c.close()
+	gzip_copy(path)
+
+
+def overlap_db():
+	# rows deleted and their space taken again by shorter ones, the
+	# tails of the old records left behind next to the new ones
+	c, path = open_db("overlap.db")
+	c.execute("create table o(id integer primary key, a text, b integer, c text)")
+	for i in range(60):
+		c.execute("insert into o values(?,?,?,?)", (i +1, "first %d " % i * 4, i *i, "tail %d" % i))
+	c.commit()
+	c.execute("delete from o where id % 3 = 0")
+	c.commit()
+	for i in range(20):
+		c.execute("insert into o values(?,?,?,?)", (1000 +i, "again %d" % i, -i, "t%d" % i))
+	c.commit()
+	c.execute("delete from o where id % 4 = 1")
+	c.commit()
+	# short rows ending in random blobs, on pages of their own with
+	# nothing deleted; the normal scan steps to just short of each
+	# record's end, and in this set one of those tails decodes as a
+	# record that covers the real one after it
+	c.execute("create table t(id integer primary key, a text, n integer, b blob)")
+	r = random.Random(12)
+	for i in range(40):
+		c.execute("insert into t values(?,?,?,?)", (i +1, "row %d" % i, r.randint(-300, 300), bytes(r.randint(0, 255) for j in range(r.randint(0, 12)))))
+	c.commit()
+	c.close()
+
+
+def large_db():
+	# bigger than the pread/uring pool at --read-chunk=4096, with the
+	# rows the sparse modes pick out at the start and the end and bulk
+	# in between, so what they matched early has been recycled by the
+	# time it's written.  Only the .gz is kept, run.sh unpacks it, and
+	# large-base.db.gz is the image before the late rows went in, for
+	# --baseline
+	c, path = open_db("large.db", page_size=4096)
+	c.execute("create table early(id integer primary key, word text, n integer, tag text)")
+	c.execute("create table bulk(id integer primary key, body text, k integer)")
+	c.execute("create table ev(id integer primary key, label text, ts)")
+	for i in range(5):
+		c.execute("insert into early values(?,?,?,?)", (i +1, "needle early %d, the first rows in the image" % i, i, "e%d" % i))
+	for i in range(8000):
+		c.execute("insert into bulk values(?,?,?)", (i +1, "bulk %06d " % i + "x" * 2000, i % 7))
+	# timestamps a date window has to tell apart from each other and
+	# from numbers that only look like one under some reading
+	for i, (label, ts) in enumerate(EVENTS):
+		c.execute("insert into ev values(?,?,?)", (i +1, label, ts))
+	c.commit()
+	c.close()
+	with open(path, "rb") as f:
+		base = f.read()
+
+	c = sqlite3.connect(path)
+	c.execute("create table late(id integer primary key, word text, n integer)")
+	for i in range(5):
+		c.execute("insert into late values(?,?,?)", (i +1, "needle late %d, the last rows in the image" % i, -i))
+	c.commit()
+	c.close()
+
+	gzip_copy(path)
+	os.remove(path)
+	with open(os.path.join(OUT, "large-base.db.gz"), "wb") as f:
+		f.write(gzip.compress(base, 9, mtime=0))
+
+
+def utf16_db(name, encoding):
+	c, path = open_db(name, encoding=encoding)
+	c.execute("create table t(id integer primary key, a text, b text, n)")
+	for i, t in enumerate(TEXTS *3):
+		c.execute("insert into t values(?,?,?,?)", (i +1, t, "ü%dß€𝄞" % i, i *1000))
+	c.commit()
+	c.execute("delete from t where id % 4 = 1")
+	c.commit()
+	c.close()
+
+
+os.makedirs(OUT, exist_ok=True)
+types_db()
+overflow_db()
+utf16_db("utf16le.db", "UTF-16le")
+utf16_db("utf16be.db", "UTF-16be")
+rowid_db()
+overlap_db()
+large_db()
@@ -0,0 +1,126 @@
+/**
+ * make check: numfmt_serial() against a table of cells and the text
+ * they have to come out as, the bytes as they sit in a record.  Each
+ * double is also read back to check it round trips.
+ *
+ *	numfmt_check
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "numfmt.h"
+
+struct numfmt_case {
+	int serial_type;
+	unsigned char bytes[8];
+	const char *want;
+};
+
+static const struct numfmt_case cases[] = {
+	/* 1 byte */
+	{ 1, { 0x00 }, "0" },
+	{ 1, { 0x7F }, "127" },
+	{ 1, { 0x80 }, "-128" },
+	{ 1, { 0xFF }, "-1" },
+
+	/* 2 bytes */
+	{ 2, { 0x00, 0x80 }, "128" },
+	{ 2, { 0x7F, 0xFF }, "32767" },
+	{ 2, { 0x80, 0x00 }, "-32768" },
+	{ 2, { 0xFF, 0x7F }, "-129" },
+
+	/* 3 bytes */
+	{ 3, { 0x00, 0x80, 0x00 }, "32768" },
+	{ 3, { 0x7F, 0xFF, 0xFF }, "8388607" },
+	{ 3, { 0x80, 0x00, 0x00 }, "-8388608" },
+	{ 3, { 0xFF, 0x7F, 0xFF }, "-32769" },
+
+	/* 4 bytes */
+	{ 4, { 0x00, 0x80, 0x00, 0x00 }, "8388608" },
+	{ 4, { 0x7F, 0xFF, 0xFF, 0xFF }, "2147483647" },
+	{ 4, { 0x80, 0x00, 0x00, 0x00 }, "-2147483648" },
+	{ 4, { 0xFF, 0xFF, 0xFF, 0xFF }, "-1" },
+
+	/* 6 bytes, the 48 bit values */
+	{ 5, { 0x00, 0x00, 0x80, 0x00, 0x00, 0x00 }, "2147483648" },
+	{ 5, { 0x00, 0x01, 0x00, 0x00, 0x00, 0x00 }, "4294967296" },
+	{ 5, { 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC }, "20015998343868" },
+	{ 5, { 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, "140737488355327" },
+	{ 5, { 0x80, 0x00, 0x00, 0x00, 0x00, 0x00 }, "-140737488355328" },
+	{ 5, { 0xFF, 0xFF, 0x7F, 0xFF, 0xFF, 0xFF }, "-2147483649" },
+	{ 5, { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, "-1" },
+
+	/* 8 bytes */
+	{ 6, { 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00 }, "140737488355328" },
+	{ 6, { 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, "9223372036854775807" },
+	{ 6, { 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, "-9223372036854775808" },
+	{ 6, { 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 }, "-9223372036854775807" },
+	{ 6, { 0xFF, 0xFF, 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, "-140737488355329" },
+	{ 6, { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, "-1" },
+
+	/* the schema format 4 constants */
+	{ 8, { 0x00 }, "0" },
+	{ 9, { 0x00 }, "1" },
+
+	/* doubles */
+	{ 7, { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, "0.0" },
+	{ 7, { 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, "-0.0" },
+	{ 7, { 0x3F, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, "1.0" },
+	{ 7, { 0xBF, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, "-1.5" },
+	{ 7, { 0x3F, 0xB9, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A }, "0.1" },
+	{ 7, { 0x3F, 0xD5, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55 }, "0.3333333333333333" },
+	{ 7, { 0x3F, 0xE5, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55 }, "0.6666666666666666" },
+	{ 7, { 0x40, 0xFE, 0x24, 0x0C, 0x9F, 0xBE, 0x76, 0xC9 }, "123456.789" },
+	{ 7, { 0x43, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, "9007199254740992" },
+	{ 7, { 0x44, 0x4B, 0x1A, 0xE4, 0xD6, 0xE2, 0xEF, 0x50 }, "1e+21" },
+	{ 7, { 0x3E, 0x7A, 0xD7, 0xF2, 0x9A, 0xBC, 0xAF, 0x48 }, "1e-07" },
+	{ 7, { 0x7F, 0xEF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, "1.7976931348623157e+308" },
+	{ 7, { 0xFF, 0xEF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, "-1.7976931348623157e+308" },
+	{ 7, { 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, "2.2250738585072014e-308" },
+	{ 7, { 0x00, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }, "2.225073858507201e-308" },
+	{ 7, { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x27, 0x10 }, "4.9407e-320" },
+	{ 7, { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02 }, "1e-323" },
+	{ 7, { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 }, "5e-324" },
+	{ 7, { 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 }, "-5e-324" },
+	{ 7, { 0x7F, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, "Inf" },
+	{ 7, { 0xFF, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, "-Inf" },
+	{ 7, { 0x7F, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, "NaN" },
+};
+
+
+
+
+int main( void ) {
+	size_t i, count = sizeof(cases) /sizeof(cases[0]);
+	int failed = 0;
+
+	for (i = 0; i < count; i++) {
+		const struct numfmt_case *c = &(cases[i]);
+		char got[NUMFMT_BUFFER_SIZE +1];
+		size_t l;
+
+		l = numfmt_serial( got, c->serial_type, c->bytes );
+		got[l] = '\0';
+		if (strcmp( got, c->want )) {
+			fprintf(stderr,"FAIL: numfmt serial type %d, case %lu, got %s, wanted %s\n", c->serial_type, (unsigned long)i, got, c->want);
+			failed++;
+			continue;
+		}
+
+		if (c->serial_type == 7) {
+			double d = numfmt_be_double( c->bytes );
+
+			if ((!isnan( d )) && (!isinf( d )) && (strtod( got, NULL ) != d)) {
+				fprintf(stderr,"FAIL: numfmt %s doesn't read back as the same double\n", got);
+				failed++;
+			}
+		}
+	}
+
+	fprintf(stdout,"numfmt: %lu cases, %d failed\n", (unsigned long)count, failed);
+
+	return failed ? 1 : 0;
+}
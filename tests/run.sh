@@ -0,0 +1,216 @@
+#!/bin/sh
+#
+# make check: carves every case in cases from the databases in
+# fixtures and diffs the rows against the CSV frozen in expected.
+#
+#	sh run.sh <undark> [--freeze]
+#
+# Each case is carved with every input backend, pread and uring in
+# 4K reads as well so an image bigger than their pool gets recycled,
+# and from the fixture's .gz when there is one.  A fixture's plain
+# case is also carved in yield order reordered back, with page dedup,
+# through the gzip output, and written to then replayed from a carve
+# index, all of which must give the same CSV.  Every case has to pass
+# --self-check too, bar those using an option it can't be run with.
+# Files a case leaves in a directory ( --split-output ) are diffed
+# along with its rows.
+#
+# A fixture only checked in as a .gz is unpacked to the scratch
+# directory first.  @/ in a case's arguments is the fixtures
+# directory, for pattern files and the like.
+#
+# --freeze rewrites expected from the mmap carves; check the diff
+# by eye before committing it.
+#
+
+UNDARK=$1
+FREEZE=$2
+HERE=$(cd "$(dirname "$0")" && pwd)
+SCRATCH=${TMPDIR:-/tmp}/undark-check.$$
+
+if [ -z "$UNDARK" ] || [ ! -x "$UNDARK" ]; then
+	echo "usage: sh run.sh <undark> [--freeze]" >&2
+	exit 2
+fi
+case "$UNDARK" in
+	/*) ;;
+	*) UNDARK=$(pwd)/$UNDARK ;;
+esac
+
+passed=0
+failed=0
+
+rm -rf "$SCRATCH"
+mkdir -p "$SCRATCH" || exit 2
+trap 'rm -rf "$SCRATCH"' 0
+trap 'exit 1' INT TERM
+
+FIXTURES=$SCRATCH/fixtures
+mkdir "$FIXTURES"
+for f in "$HERE"/fixtures/*; do
+	ln -s "$f" "$FIXTURES/"
+	case "$f" in
+		*.gz) [ -f "${f%.gz}" ] || gzip -dc < "$f" > "$FIXTURES/$(basename "${f%.gz}")" ;;
+	esac
+done
+
+
+# carve <out> <undark arguments>
+#   runs undark in an empty directory, so the .blob files it leaves
+#   are this run's alone, and lists them after the rows with cksum,
+#   then the files in any directory it made ( --split-output ) whole
+carve() {
+	out=$1
+	shift
+	rm -rf "$SCRATCH/run"
+	mkdir "$SCRATCH/run"
+	(cd "$SCRATCH/run" && "$UNDARK" "$@" < /dev/null > "$out" 2> "$SCRATCH/stderr")
+	for b in $(cd "$SCRATCH/run" && ls | sort -n); do
+		if [ -d "$SCRATCH/run/$b" ]; then
+			for f in $(cd "$SCRATCH/run/$b" && ls); do
+				echo "== $b/$f"
+				cat "$SCRATCH/run/$b/$f"
+			done
+		else
+			echo "$b $(cksum < "$SCRATCH/run/$b")"
+		fi
+	done >> "$out"
+}
+
+
+# same <case> <what> <expected> <got>
+same() {
+	if cmp -s "$3" "$4"; then
+		passed=$((passed +1))
+	else
+		failed=$((failed +1))
+		echo "FAIL: $1 ( $2 )"
+		diff "$3" "$4" | head -20
+	fi
+}
+
+
+while read -r name fixture args; do
+	case "$name" in
+		""|\#*) continue ;;
+	esac
+
+	db=$FIXTURES/$fixture
+	args=$(echo "$args" | sed "s|@/|$FIXTURES/|g")
+	expected=$HERE/expected/$name.csv
+	got=$SCRATCH/got.csv
+
+	if [ "$FREEZE" = "--freeze" ]; then
+		mkdir -p "$HERE/expected"
+		carve "$expected" -i "$db" $args
+		echo "froze $name"
+		continue
+	fi
+	if [ ! -f "$expected" ]; then
+		failed=$((failed +1))
+		echo "FAIL: $name ( no expected/$name.csv, run with --freeze )"
+		continue
+	fi
+
+	for backend in mmap pread "pread --read-chunk=4096" uring "uring --read-chunk=4096"; do
+		carve "$got" -i "$db" --input-backend=$backend $args
+		same "$name" "$backend" "$expected" "$got"
+	done
+	if [ -f "$db.gz" ]; then
+		carve "$got" -i "$db.gz" $args
+		same "$name" "gzip input" "$expected" "$got"
+	fi
+
+	if [ -z "$args" ]; then
+		carve "$got" -i "$db" --scan-order=yield --scan-reorder
+		same "$name" "yield order, reordered" "$expected" "$got"
+		carve "$got" -i "$db" --dedup-pages
+		same "$name" "dedup pages" "$expected" "$got"
+
+		carve "$SCRATCH/got.gz" -i "$db" --output-compress=gzip
+		gzip -dc < "$SCRATCH/got.gz" > "$got" 2>/dev/null
+		same "$name" "gzip output" "$expected" "$got"
+
+		carve "$got" -i "$db" --write-index="$SCRATCH/index"
+		same "$name" "writing the index" "$expected" "$got"
+		carve "$got" -i "$db" --from-index="$SCRATCH/index"
+		same "$name" "from the index" "$expected" "$got"
+		rm -f "$SCRATCH/index"
+	fi
+
+	case " $args" in
+		*" --split-output"*|*" --baseline"*|*" --scan-reorder"*) continue ;;
+	esac
+	carve "$got" -i "$db" --self-check $args
+	if grep -q "^self-check: passed" "$SCRATCH/stderr"; then
+		passed=$((passed +1))
+	else
+		failed=$((failed +1))
+		echo "FAIL: $name ( self-check )"
+		grep "^self-check:" "$SCRATCH/stderr" | tail -5
+	fi
+done < "$HERE/cases"
+
+
+# --serve: the requests below against large.db on every backend, the
+# JSON replies diffed against expected/serve-large.json.  Needs python3
+# to talk to the socket, skipped without it.
+SERVE_REQUESTS='info
+pages 2
+offset 16384
+pages 4013 4014
+rowid 3
+offset 17592186044416000
+quit'
+
+# ask <socket>, sends SERVE_REQUESTS and prints each reply line
+ask() {
+	echo "$SERVE_REQUESTS" | python3 -c '
+import socket, sys
+s = socket.socket(socket.AF_UNIX)
+s.connect(sys.argv[1])
+f = s.makefile("rwb")
+for line in sys.stdin.buffer:
+	f.write(line)
+	f.flush()
+	if line.strip() == b"quit":
+		break
+	sys.stdout.buffer.write(f.readline())
+' "$1"
+}
+
+# serve <out> <undark arguments>, daemon run from the fixtures directory
+# so the db path in its replies is the same every time
+serve() {
+	out=$1
+	shift
+	rm -f "$SCRATCH/sock"
+	(cd "$FIXTURES" && exec "$UNDARK" -i large.db --serve="$SCRATCH/sock" "$@" 2> "$SCRATCH/stderr") &
+	pid=$!
+	n=0
+	while [ ! -S "$SCRATCH/sock" ] && [ $n -lt 100 ]; do
+		sleep 0.1
+		n=$((n +1))
+	done
+	ask "$SCRATCH/sock" > "$out" 2>&1
+	kill $pid
+	wait $pid
+}
+
+if ! command -v python3 > /dev/null; then
+	echo "skipped serve-large ( no python3 )"
+elif [ "$FREEZE" = "--freeze" ]; then
+	serve "$HERE/expected/serve-large.json"
+	echo "froze serve-large"
+else
+	for backend in mmap pread "pread --read-chunk=4096" uring "uring --read-chunk=4096"; do
+		serve "$SCRATCH/got.json" --input-backend=$backend
+		same serve-large "$backend" "$HERE/expected/serve-large.json" "$SCRATCH/got.json"
+	done
+fi
+
+if [ "$FREEZE" = "--freeze" ]; then exit 0; fi
+
+echo "check: $passed passed, $failed failed"
+if [ $failed -ne 0 ]; then exit 1; fi
+exit 0
@@ -0,0 +1,464 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "textesc.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#include <immintrin.h>
+#define TEXTESC_X86 1
+#endif
+
+static size_t special_scalar( const unsigned char *p, size_t l );
+static size_t (*special_scan)( const unsigned char *, size_t ) = NULL;
+static const char *special_scan_name = "scalar";
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-101204
+  Function Name	: textesc_utf8_sequence
+  Returns Type	: int
+  ----Parameter List
+  1. const unsigned char *p,
+  2.  size_t l ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Returns the length (2..4) of the valid UTF-8 sequence starting at p,
+or 0 if it's not one.  Overlong forms, surrogates and anything past
+U+10FFFF are rejected, as are sequences cut short by the cell end.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int textesc_utf8_sequence( const unsigned char *p, size_t l ) {
+	unsigned char c = p[0];
+
+	if ((c >= 0xC2) && (c <= 0xDF)) {
+		if ((l < 2) || ((p[1] & 0xC0) != 0x80)) return 0;
+		return 2;
+	}
+
+	if ((c >= 0xE0) && (c <= 0xEF)) {
+		if ((l < 3) || ((p[1] & 0xC0) != 0x80) || ((p[2] & 0xC0) != 0x80)) return 0;
+		if ((c == 0xE0) && (p[1] < 0xA0)) return 0; // overlong
+		if ((c == 0xED) && (p[1] > 0x9F)) return 0; // surrogates
+		return 3;
+	}
+
+	if ((c >= 0xF0) && (c <= 0xF4)) {
+		if ((l < 4) || ((p[1] & 0xC0) != 0x80) || ((p[2] & 0xC0) != 0x80) || ((p[3] & 0xC0) != 0x80)) return 0;
+		if ((c == 0xF0) && (p[1] < 0x90)) return 0; // overlong
+		if ((c == 0xF4) && (p[1] > 0x8F)) return 0; // > U+10FFFF
+		return 4;
+	}
+
+	return 0;
+}
+
+
+
+
+/**
+ * Finds the first byte that isn't plain printable ASCII, or isn't
+ * the quote character.  Non-ASCII bytes stop the scan too, they get
+ * handed to the UTF-8 validator.
+ */
+static size_t special_scalar( const unsigned char *p, size_t l ) {
+	size_t i;
+
+	for (i = 0; i < l; i++) {
+		if ((p[i] < 0x20) || (p[i] >= 0x7F) || (p[i] == '"')) break;
+	}
+
+	return i;
+}
+
+#ifdef TEXTESC_X86
+static size_t special_sse2( const unsigned char *p, size_t l ) {
+	const __m128i space = _mm_set1_epi8(0x20);
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i del = _mm_set1_epi8(0x7F);
+	size_t i = 0;
+
+	/* signed compare, so 0x80-0xFF land below 0x20 along with the control bytes */
+	while (i +16 <= l) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p +i));
+		__m128i m = _mm_or_si128( _mm_cmplt_epi8(v, space), _mm_or_si128( _mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, del) ) );
+		int mask = _mm_movemask_epi8(m);
+
+		if (mask) return i +__builtin_ctz(mask);
+		i += 16;
+	}
+
+	return i +special_scalar( p +i, l -i );
+}
+
+__attribute__((target("avx2")))
+static size_t special_avx2( const unsigned char *p, size_t l ) {
+	const __m256i space = _mm256_set1_epi8(0x20);
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i del = _mm256_set1_epi8(0x7F);
+	size_t i = 0;
+
+	while (i +32 <= l) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p +i));
+		__m256i m = _mm256_or_si256( _mm256_cmpgt_epi8(space, v), _mm256_or_si256( _mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, del) ) );
+		unsigned int mask = (unsigned int)_mm256_movemask_epi8(m);
+
+		if (mask) return i +__builtin_ctz(mask);
+		i += 32;
+	}
+
+	return i +special_sse2( p +i, l -i );
+}
+#endif
+
+
+
+
+/**
+ * UTF-16 to UTF-8 for the ASCII units only.  Converts from the
+ * start of src until the first unit that's 0x80 or above, returns
+ * how many were converted ( one byte each in dst ).
+ */
+static size_t ascii16_scalar( char *dst, const unsigned char *src, size_t units, int big_endian ) {
+	size_t i;
+
+	for (i = 0; i < units; i++) {
+		unsigned int c = big_endian ? (src[i *2] << 8) | src[i *2 +1] : src[i *2] | (src[i *2 +1] << 8);
+
+		if (c >= 0x80) break;
+		dst[i] = c;
+	}
+
+	return i;
+}
+
+#ifdef TEXTESC_X86
+/*
+ * Units are read as little-endian 16 bit lanes, so for big-endian
+ * text the ASCII test is on the other byte and the character has to
+ * be shifted down before the pack.  The pack stores a full 8/16
+ * bytes even when only some of them are ASCII, the caller's buffer
+ * always has room for it ( 3 bytes per unit left ).
+ */
+static size_t ascii16_sse2( char *dst, const unsigned char *src, size_t units, int big_endian ) {
+	const __m128i high = _mm_set1_epi16( big_endian ? 0x80FF : 0xFF80 );
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+
+	while (i +8 <= units) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src +i *2));
+		unsigned int mask = _mm_movemask_epi8( _mm_cmpeq_epi16( _mm_and_si128(v, high), zero ) );
+
+		if (big_endian) v = _mm_srli_epi16(v, 8);
+		_mm_storel_epi64((__m128i *)(dst +i), _mm_packus_epi16(v, v));
+		if (mask != 0xFFFF) return i +__builtin_ctz(~mask) /2;
+		i += 8;
+	}
+
+	return i +ascii16_scalar( dst +i, src +i *2, units -i, big_endian );
+}
+
+__attribute__((target("avx2")))
+static size_t ascii16_avx2( char *dst, const unsigned char *src, size_t units, int big_endian ) {
+	const __m256i high = _mm256_set1_epi16( big_endian ? 0x80FF : 0xFF80 );
+	const __m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+
+	while (i +16 <= units) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(src +i *2));
+		unsigned int mask = (unsigned int)_mm256_movemask_epi8( _mm256_cmpeq_epi16( _mm256_and_si256(v, high), zero ) );
+
+		if (big_endian) v = _mm256_srli_epi16(v, 8);
+		/* the pack works per 128 bit lane, pull the two halves together */
+		v = _mm256_permute4x64_epi64( _mm256_packus_epi16(v, v), 0xD8 );
+		_mm_storeu_si128((__m128i *)(dst +i), _mm256_castsi256_si128(v));
+		if (mask != 0xFFFFFFFF) return i +__builtin_ctz(~mask) /2;
+		i += 16;
+	}
+
+	return i +ascii16_sse2( dst +i, src +i *2, units -i, big_endian );
+}
+#endif
+
+static size_t (*ascii16)( char *, const unsigned char *, size_t, int ) = NULL;
+
+
+
+
+static void special_scan_select( void ) {
+
+	special_scan = special_scalar;
+	ascii16 = ascii16_scalar;
+	special_scan_name = "scalar";
+
+#ifdef TEXTESC_X86
+	special_scan = special_sse2;
+	ascii16 = ascii16_sse2;
+	special_scan_name = "sse2";
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		special_scan = special_avx2;
+		ascii16 = ascii16_avx2;
+		special_scan_name = "avx2";
+	}
+#endif
+}
+
+
+
+
+const char *textesc_kernel_name( void ) {
+	if (!special_scan) special_scan_select();
+	return special_scan_name;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-101355
+  Function Name	: textesc_clean_run
+  Returns Type	: size_t
+  ----Parameter List
+  1. const unsigned char *p,
+  2.  size_t l ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Returns how many bytes from p can go out unchanged.  ASCII runs are
+skipped 16/32 bytes at a time, multibyte UTF-8 is validated inline
+and doesn't terminate the run.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+size_t textesc_clean_run( const unsigned char *p, size_t l ) {
+	size_t i = 0;
+
+	if (!special_scan) special_scan_select();
+
+	while (i < l) {
+		int n;
+
+		i += special_scan( p +i, l -i );
+		if (i >= l) break;
+		if (p[i] < 0x80) break;
+
+		n = textesc_utf8_sequence( p +i, l -i );
+		if (n == 0) break;
+		i += n;
+	}
+
+	return i;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-101422
+  Function Name	: textesc_clean_run_scalar
+  Returns Type	: size_t
+  ----Parameter List
+  1. const unsigned char *p,
+  2.  size_t l ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Byte at a time reference for textesc_clean_run(), the two must
+always agree.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+size_t textesc_clean_run_scalar( const unsigned char *p, size_t l ) {
+	size_t i = 0;
+
+	while (i < l) {
+		if (p[i] >= 0x80) {
+			int n = textesc_utf8_sequence( p +i, l -i );
+			if (n == 0) break;
+			i += n;
+			continue;
+		}
+		if ((p[i] < 0x20) || (p[i] == 0x7F) || (p[i] == '"')) break;
+		i++;
+	}
+
+	return i;
+}
+
+
+
+
+#define UNIT16(p, be) ((be) ? ((p)[0] << 8) | (p)[1] : (p)[0] | ((p)[1] << 8))
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-145210
+  Function Name	: utf16_convert
+  Returns Type	: size_t
+  ----Parameter List
+  1. char *dst,
+  2.  const unsigned char *src,
+  3.  size_t l,
+  4.  int big_endian,
+  5.  kernel ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+ASCII runs go through the kernel, everything else a unit at a time
+here.  Unpaired surrogates and an odd trailing byte come out as
+'.', the same as sqltdump() does for bad UTF-8.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+static size_t utf16_convert( char *dst, const unsigned char *src, size_t l, int big_endian, size_t (*kernel)( char *, const unsigned char *, size_t, int ) ) {
+	unsigned char *d = (unsigned char *)dst;
+	size_t units = l /2;
+	size_t i = 0, o = 0;
+
+	while (i < units) {
+		uint32_t c;
+		size_t n;
+
+		n = kernel( dst +o, src +i *2, units -i, big_endian );
+		i += n;
+		o += n;
+		if (i >= units) break;
+
+		c = UNIT16( src +i *2, big_endian );
+		i++;
+
+		if (c < 0x800) {
+			d[o++] = 0xC0 | (c >> 6);
+			d[o++] = 0x80 | (c & 0x3F);
+
+		} else if ((c >= 0xD800) && (c <= 0xDBFF) && (i < units) && ((UNIT16( src +i *2, big_endian ) & 0xFC00) == 0xDC00)) {
+			c = 0x10000 +((c -0xD800) << 10) +(UNIT16( src +i *2, big_endian ) -0xDC00);
+			i++;
+			d[o++] = 0xF0 | (c >> 18);
+			d[o++] = 0x80 | ((c >> 12) & 0x3F);
+			d[o++] = 0x80 | ((c >> 6) & 0x3F);
+			d[o++] = 0x80 | (c & 0x3F);
+
+		} else if ((c >= 0xD800) && (c <= 0xDFFF)) {
+			d[o++] = '.';
+
+		} else {
+			d[o++] = 0xE0 | (c >> 12);
+			d[o++] = 0x80 | ((c >> 6) & 0x3F);
+			d[o++] = 0x80 | (c & 0x3F);
+		}
+	}
+
+	if (l & 1) d[o++] = '.';
+
+	return o;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-145331
+  Function Name	: textesc_utf16_to_utf8
+  Returns Type	: size_t
+  ----Parameter List
+  1. char *dst,
+  2.  const unsigned char *src,
+  3.  size_t l,
+  4.  int big_endian ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Transcodes l bytes of UTF-16 text, dst must have room for
+TEXTESC_UTF16_LENGTH(l) bytes.  Returns the UTF-8 length.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+size_t textesc_utf16_to_utf8( char *dst, const unsigned char *src, size_t l, int big_endian ) {
+	if (!special_scan) special_scan_select();
+	return utf16_convert( dst, src, l, big_endian, ascii16 );
+}
+
+
+
+
+/**
+ * Unit at a time reference for textesc_utf16_to_utf8(), the two
+ * must always agree.
+ */
+size_t textesc_utf16_to_utf8_scalar( char *dst, const unsigned char *src, size_t l, int big_endian ) {
+	return utf16_convert( dst, src, l, big_endian, ascii16_scalar );
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-145502
+  Function Name	: textesc_utf16_invalid
+  Returns Type	: size_t
+  ----Parameter List
+  1. const unsigned char *src,
+  2.  size_t l,
+  3.  int big_endian ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+How many of the l bytes of UTF-16 aren't believable text, control
+characters other than tab/CR/LF, unpaired surrogates and an odd
+trailing byte.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+size_t textesc_utf16_invalid( const unsigned char *src, size_t l, int big_endian ) {
+	size_t units = l /2;
+	size_t i = 0, bad = l & 1;
+
+	while (i < units) {
+		uint32_t c = UNIT16( src +i *2, big_endian );
+
+		i++;
+		if ((c >= 0xD800) && (c <= 0xDBFF) && (i < units) && ((UNIT16( src +i *2, big_endian ) & 0xFC00) == 0xDC00)) {
+			i++;
+		} else if ((c >= 0xD800) && (c <= 0xDFFF)) {
+			bad += 2;
+		} else if ((c < 0x20) && (c != '\t') && (c != '\n') && (c != '\r')) {
+			bad += 2;
+		}
+	}
+
+	return bad;
+}
@@ -0,0 +1,27 @@
+#ifndef UNDARK_TEXTESC_H
+#define UNDARK_TEXTESC_H
+
+#include <stddef.h>
+
+/**
+ * Text cell scanning for CSV output.
+ *
+ * A "clean" byte is one that can be written out as-is: printable ASCII
+ * other than the double quote, or part of a complete, valid UTF-8
+ * sequence.  Everything else ( quotes, control bytes, stray/invalid
+ * UTF-8 ) needs escaping or substitution by the caller.
+ *
+ * Text from UTF-16 databases is transcoded to UTF-8 first, ASCII
+ * runs 8/16 units at a time.
+ */
+#define TEXTESC_UTF16_LENGTH(l) (((l) /2) *3 +1) // most UTF-8 that l bytes of UTF-16 can turn in to
+
+size_t textesc_clean_run( const unsigned char *p, size_t l );
+size_t textesc_clean_run_scalar( const unsigned char *p, size_t l );
+int textesc_utf8_sequence( const unsigned char *p, size_t l );
+size_t textesc_utf16_to_utf8( char *dst, const unsigned char *src, size_t l, int big_endian );
+size_t textesc_utf16_to_utf8_scalar( char *dst, const unsigned char *src, size_t l, int big_endian );
+size_t textesc_utf16_invalid( const unsigned char *src, size_t l, int big_endian );
+const char *textesc_kernel_name( void );
+
+#endif
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "trace.h"
+
+int trace_on = 0;
+
+static FILE *trace_file = NULL;
+static uint32_t trace_sample = 1;
+static uint64_t trace_origin;
+static int trace_events, trace_threads;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread int thread_id; // 0 until the thread's first event
+static __thread uint32_t thread_tick; // sampling count
+
+
+static uint64_t now( void ) {
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return (uint64_t)ts.tv_sec *1000000000ULL +ts.tv_nsec;
+}
+
+
+
+
+/**
+ * Writes one event, comma separated from the one before.  Called
+ * with trace_lock held.
+ */
+static void emit( const char *event ) {
+	fprintf( trace_file, "%s\n%s", trace_events ? "," : "", event );
+	trace_events++;
+}
+
+
+
+
+/**
+ * This thread's track, allocated on its first event.  Called with
+ * trace_lock held.
+ */
+static int tid( void ) {
+	if (!thread_id) thread_id = ++trace_threads;
+
+	return thread_id;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-171204
+  Function Name	: trace_open
+  Returns Type	: int
+  ----Parameter List
+  1. const char *file,
+  2.  uint32_t sample ,
+  ------------------
+  Exit Codes	: 1 if file can't be created
+  Side Effects	: tracing is on for the whole process
+  --------------------------------------------------------------------
+Comments:
+
+sample records one in that many of the TRACE_SAMPLED spans, counted
+per thread, 1 ( or 0 ) for all of them.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int trace_open( const char *file, uint32_t sample ) {
+
+	trace_file = fopen( file, "w" );
+	if (!trace_file) return 1;
+
+	trace_sample = sample ? sample : 1;
+	trace_origin = now();
+	trace_events = 0;
+	fprintf( trace_file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" );
+	trace_on = 1;
+	trace_thread( "main" );
+
+	return 0;
+}
+
+
+
+
+/**
+ * Ends the JSON and closes the file, 1 if any of it failed to write.
+ */
+int trace_close( void ) {
+	int failed;
+
+	if (!trace_file) return 0;
+
+	pthread_mutex_lock( &trace_lock );
+	trace_on = 0;
+	fprintf( trace_file, "\n]}\n" );
+	failed = ferror( trace_file );
+	if (fclose( trace_file ) != 0) failed = 1;
+	trace_file = NULL;
+	pthread_mutex_unlock( &trace_lock );
+
+	return failed ? 1 : 0;
+}
+
+
+
+
+/**
+ * Start time of a span, in ns since trace_open() ( never 0 ), or 0
+ * if a sampled span has been sampled out.
+ */
+uint64_t trace_clock( int sampled ) {
+
+	if ((sampled) && (trace_sample > 1) && ((++thread_tick) %trace_sample)) return 0;
+
+	return now() -trace_origin +1;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-171436
+  Function Name	: trace_span
+  Returns Type	: void
+  ----Parameter List
+  1. uint64_t start,
+  2.  const char *name,
+  3.  const char *category,
+  4.  const char *args,
+  5.  ... ,
+  ------------------
+  Exit Codes	:
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Records a span from start ( trace_start() ) to now.  args, if it's
+not NULL, is a printf format for the members of the event's args
+object, eg "\"page\":%u".  name and category go out as they are,
+they're expected to be literals needing no escaping.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+void trace_span( uint64_t start, const char *name, const char *category, const char *args, ... ) {
+	uint64_t end = now() -trace_origin +1;
+	char a[256] = "";
+	char event[512];
+
+	if (!start) return;
+
+	if (args) {
+		va_list ap;
+
+		va_start( ap, args );
+		vsnprintf( a, sizeof(a), args, ap );
+		va_end( ap );
+	}
+
+	pthread_mutex_lock( &trace_lock );
+	if (trace_on) {
+		snprintf( event, sizeof(event), "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{%s}}"
+				, name, category, tid(), (start -1) /1000.0, (end -start) /1000.0, a );
+		emit( event );
+	}
+	pthread_mutex_unlock( &trace_lock );
+}
+
+
+
+
+/**
+ * Names the calling thread's track.
+ */
+void trace_thread( const char *name ) {
+	char event[256];
+
+	if (!trace_on) return;
+
+	pthread_mutex_lock( &trace_lock );
+	if (trace_on) {
+		snprintf( event, sizeof(event), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", tid(), name );
+		emit( event );
+	}
+	pthread_mutex_unlock( &trace_lock );
+}
@@ -0,0 +1,43 @@
+#ifndef UNDARK_TRACE_H
+#define UNDARK_TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define TRACE_ALWAYS 0 // one off phases, always recorded
+#define TRACE_SAMPLED 1 // per page/row/flush spans, 1 in trace_sample recorded
+
+/**
+ * Timeline tracing ( --trace ).
+ *
+ * Spans are written as Chrome trace event JSON ( complete, "X",
+ * events with microsecond timestamps ), load the file in to
+ * chrome://tracing or ui.perfetto.dev.  Each thread gets its own
+ * track, named with trace_thread().
+ *
+ * The tracer is process wide, the carve, the output side and the
+ * worker threads all write to the one file.  When it's off a span
+ * costs a test of trace_on, when it's on the frequent spans can be
+ * sampled to keep the clock reads and writes down.
+ *
+ *	uint64_t t = trace_start( TRACE_SAMPLED );
+ *	...
+ *	if (t) trace_span( t, "page", "carve", "\"page\":%u", n );
+ */
+extern int trace_on;
+
+int trace_open( const char *file, uint32_t sample );
+int trace_close( void );
+uint64_t trace_clock( int sampled );
+void trace_span( uint64_t start, const char *name, const char *category, const char *args, ... );
+void trace_thread( const char *name );
+
+/**
+ * Start of a span, 0 if it's not being recorded ( tracing off, or
+ * sampled out ).
+ */
+static inline uint64_t trace_start( int sampled ) {
+	return trace_on ? trace_clock( sampled ) : 0;
+}
+
+#endif
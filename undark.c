@@ -5,6 +5,9 @@
  * that the SQLite length of payload should be the same
  * as the summation of the payload cell sizes.
  *
+ * The carving itself lives in libundark, this is the CSV
+ * front end on top of it.
+ *
  * Written by Paul L Daniels (pldaniels@pldaniels.com)
  *
  * BSD Revised licence ( see LICENCE )
@@ -17,34 +20,29 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
-//#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
-//#include <arpa/inet.h>
 #include <ctype.h>
-#include <time.h>
 #include <errno.h>
-#ifndef _WIN32
-#include <arpa/inet.h>
-#include <sys/mman.h>
-#else
-#include <winsock2.h>
-#include <mman.h>
-#endif
 
-#include "varint.h"
+#include "libundark.h"
+#include "outbuf.h"
+#include "outzip.h"
+#include "reorder.h"
+#include "textesc.h"
+#include "blobenc.h"
+#include "numfmt.h"
+#include "splitout.h"
+#include "serve.h"
+#include "trace.h"
+#include "selfcheck.h"
 
 #define FL __FILE__,__LINE__
-#define VERBOSE if (g->verbose)
-#define DEBUG if (g->debug)
-
-#define DECODE_MODE_FREESPACE 1
-#define DECODE_MODE_NORMAL 0
+#define VERBOSE if (g->opt.verbose)
+#define DEBUG if (g->opt.debug)
 
-#define PAYLOAD_SIZE_MINIMUM 10
-#define PAYLOAD_CELLS_MAX 1000
 #define OVERFLOW_PAGES_MAX 10000
 
 #define PARAM_VERSION "--version"
@@ -54,6 +52,7 @@
 #define PARAM_FREESPACE_MINIMUM "--freespace-minimum="
 #define PARAM_NO_BLOBS "--no-blobs"
 #define PARAM_BLOB_SIZE_LIMIT "--blob-size-limit="
+#define PARAM_BLOB_ENCODING "--blob-encoding="
 #define PARAM_CELLCOUNT_MIN "--cellcount-min="
 #define PARAM_CELLCOUNT_MAX "--cellcount-max="
 #define PARAM_ROWSIZE_MIN "--rowsize-min="
@@ -62,79 +61,93 @@
 #define PARAM_PAGE_START "--page-start="  // add to 0.5
 #define PARAM_PAGE_END "--page-end=" // add to 0.5
 #define PARAM_REMOVED_ONLY "--removed-only"
+#define PARAM_IO_POLICY "--io-policy="
+#define PARAM_IO_WINDOW "--io-window="
+#define PARAM_STATS "--stats"
+#define PARAM_INPUT_BACKEND "--input-backend="
+#define PARAM_READ_CHUNK "--read-chunk="
+#define PARAM_READ_DEPTH "--read-depth="
+#define PARAM_DECOMPRESS_RESERVE "--decompress-reserve="
+#define PARAM_GREP "--grep="
+#define PARAM_SPLIT_OUTPUT "--split-output="
+#define PARAM_SPLIT_KEY "--split-key="
+#define PARAM_SPLIT_MAX_OPEN "--split-max-open="
+#define PARAM_TEXT_ENCODING "--text-encoding="
+#define PARAM_DATE_AFTER "--date-after="
+#define PARAM_DATE_BEFORE "--date-before="
+#define PARAM_DATE_LATEST "--date-latest="
+#define PARAM_SERVE "--serve="
+#define PARAM_WRITE_INDEX "--write-index="
+#define PARAM_FROM_INDEX "--from-index="
+#define PARAM_BASELINE "--baseline="
+#define PARAM_SIGNATURE "--signature="
+#define PARAM_DEDUP_PAGES "--dedup-pages"
+#define PARAM_DEDUP_TABLE "--dedup-table="
+#define PARAM_OUTPUT_COMPRESS "--output-compress="
+#define PARAM_OUTPUT_THREADS "--output-threads="
+#define PARAM_TRACE "--trace="
+#define PARAM_TRACE_SAMPLE "--trace-sample="
+#define PARAM_SELF_CHECK "--self-check"
+#define PARAM_ESTIMATE "--estimate"
+#define PARAM_SCAN_ORDER "--scan-order="
+#define PARAM_SCAN_REORDER "--scan-reorder"
+#define PARAM_NO_PTRMAP "--no-ptrmap"
+#define ESTIMATE_BUDGET_DEFAULT 10.0 // seconds
+
 
 
 
 struct globals {
-	uint8_t debug;
-	uint8_t verbose;
+	struct undark_options opt; // handed to libundark
 
 	char *input_file; // actual file name
-	char *db_origin;	// the mmap'd file origin
-	char *db_end; // the computed end of the mmap'd file ( based on file size )
-	char *db_cfp; // current file position
-	char *db_cpp; // current page position
-	char *db_cpp_limit; // end of the current page
-	size_t db_size;
-
-	uint32_t page_size, page_count, page_number;
-	uint32_t page_start, page_end;
-
-	uint32_t freelist_first_page, freelist_page_count;
-	uint32_t *freelist_pages;
-	uint32_t freelist_pages_current_index;
-	int freelist_space_only;
-	int removed_only;
-	size_t freespace_minimum;
-
-	time_t date_upper, date_lower; // deprecated - now that Undark has become a generic tool
-	int cc_min, cc_max;  // cell count limits
-	size_t rs_min, rs_max; // row/payload limits
 	int report_blobs; // do we even handle blob data
 	size_t blob_size_limit; // at which point do we cut over to dumping to *.blob files?
+	int blob_encoding; // BLOB_ENCODING_HEX or BLOB_ENCODING_BASE64
 
 	int blob_count;
-	int fine_search;
-};
 
+	struct outbuf *out; // row output, gathered and written with writev
+	int show_stats;
+	char *grep_file; // patterns, one per line
+	char *signatures; // --signature list, NULL to decode any record
 
+	char *split_dir; // --split-output, NULL for everything to stdout
+	int split_key; // SPLIT_KEY_*
+	int split_max_open;
+	struct splitout *split;
+	int split_failed;
 
+	int text_encoding; // UNDARK_TEXT_*, known once the image is open
+	int text_by_reference; // the image stays mapped for the run ( UNDARK_image_mapped ), text is queued in place
+	char *text; // UTF-16 cells transcoded to UTF-8
+	size_t text_allocated;
 
-struct cell {
-	int t; // serial
-	int o; // offset
-	int s; // size
-};
+	char *serve_path; // --serve socket, NULL to carve once and exit
+	char *write_index; // carve index to write as we go, NULL for none
+	char *from_index; // carve index to re-decode rather than searching the image
+	char *baseline; // earlier snapshot of the image, only what's changed since is dumped
+	int dedup; // carve repeated pages only once
+	char *dedup_table; // where the repeats were, NULL for nowhere
 
+	int compress, compress_level, compress_threads; // --output-compress, OUTZIP_*
+	struct outzip *zip;
 
+	char *trace_file; // --trace, Chrome trace event JSON, NULL for none
+	uint32_t trace_sample; // record 1 in this many page/flush spans
 
-struct sql_payload {
-	uint64_t prefix_length;
-	uint64_t length;
-	uint64_t rowid;
-	uint64_t header_size;
-	int cell_count;
-	int cell_page;
-	int cell_page_offset;
-	struct cell cells[PAYLOAD_CELLS_MAX+1];
-	uint32_t overflow_pages[OVERFLOW_PAGES_MAX+1];
-	char *mapped_data, *mapped_data_endpoint;
-};
+	int self_check; // check the carve against the reference decoder rather than dumping rows
+	double estimate; // --estimate sampling budget in seconds, 0 to carve
 
-struct sqlite_leaf_header {
-	int page_number;
-	int page_byte;
-	uint16_t freeblock_offset;
-	uint16_t freeblock_size;
-	uint16_t freeblock_next;
-	int cellcount;
-	int cell_offset;
-	int freebytes;
+	int scan_reorder; // put a --scan-order=yield carve's rows back in file order
+	struct reorder *reorder; // where rows are spooled until then, NULL writing straight out
 };
 
 
+
+
 char version[] = "undark version 0.7, by Paul L Daniels ( pldaniels@pldaniels.com )\n";
-char help[] = "-i <sqlite DB> [-d] [-v] [-V|--version] [--cellcount-min=<count>] [--cellcount-max=<count>] [--rowsize-min=<bytes>] [--rowsize-max=<bytes>] [--no-blobs] [--blob-size-limit=<bytes>] [--page-size=<bytes>] [--page-start=<number>] [--page-end=<number>] [--freespace] [--freespace-minimum=<bytes>]\n"
+char help[] = "-i <sqlite DB> [-d] [-v] [-V|--version] [--cellcount-min=<count>] [--cellcount-max=<count>] [--rowsize-min=<bytes>] [--rowsize-max=<bytes>] [--no-blobs] [--blob-size-limit=<bytes>] [--blob-encoding=hex|base64] [--page-size=<bytes>] [--page-start=<number>] [--page-end=<number>] [--freespace] [--freespace-minimum=<bytes>] [--io-policy=<list>] [--io-window=<bytes>] [--stats] [--input-backend=mmap|pread|uring] [--read-chunk=<bytes>] [--read-depth=<count>] [--decompress-reserve=<bytes>] [--grep=<pattern file>] [--split-output=<dir>] [--split-key=columns|types] [--split-max-open=<count>] [--text-encoding=auto|utf8|utf16le|utf16be] [--date-after=<when>] [--date-before=<when>] [--date-latest=<when>] [--serve=<socket>] [--write-index=<file>] [--from-index=<file>] [--baseline=<sqlite DB>] [--signature=<list>] [--dedup-pages] [--dedup-table=<file>] [--output-compress=gzip|zstd[:<level>]] [--output-threads=<count>] [--trace=<file>] [--trace-sample=<count>] [--self-check] [--estimate[=<seconds>]] [--scan-order=file|yield] [--scan-reorder] [--no-ptrmap]\n"
 "\t-i: input SQLite3 format database\n"
 "\t-d: enable debugging output (very large dumps)\n"
 "\t-v: enable verbose output\n"
@@ -146,15 +159,48 @@ char help[] = "-i <sqlite DB> [-d] [-v] [-V|--version] [--cellcount-min=<count>]
 "\t--rowsize-max: define the maximum number of bytes a row must have to be extracted\n"
 "\t--no-blobs: disable the dumping of blob data\n"
 "\t--blob-size-limit: all blobs larger than this size are dumped to .blob files\n"
+"\t--blob-encoding: how blobs are written in the CSV, hex (default) or base64\n"
 "\t--fine-search: search DB shifting one byte at a time, rather than records\n"
 "\t--page-size: hard code the page size for the DB (useful when header is damaged)\n"
 "\t--removed-only: Dumps rows that have their key set to -1\n"
 //"\t--page-start: starting page to scan in db\n"
 //"\t--page-end: ending page to scan in db\n"
 "\t--freespace: search for rows in the freespace\n"
+"\t--io-policy: comma list of sequential, willneed, prefetch-overflow, populate, hugepages, dontneed ( default none )\n"
+"\t--io-window: bytes ahead/behind the scan front for willneed/dontneed ( default 4MB )\n"
+"\t--stats: print I/O and carving statistics to stderr when finished\n"
+"\t--input-backend: mmap (default), pread or uring ( io_uring, falls back to pread )\n"
+"\t--read-chunk: bytes per read for the pread/uring backends ( default 1MB )\n"
+"\t--read-depth: reads kept in flight for the uring backend ( default 32 )\n"
+"\t--decompress-reserve: bytes of address space to set aside for a gzip/zstd input once decompressed ( default 1TB, only what's being carved is kept in memory )\n"
+"\t--grep: only dump rows containing one of the patterns in this file ( one per line )\n"
+"\t--split-output: write rows to one CSV per signature in this directory rather than stdout\n"
+"\t--split-key: what the files are split by, columns ( column count, default ) or types ( storage class of each cell )\n"
+"\t--split-max-open: most split files held open at once, the least recently written is closed first ( default 64 )\n"
+"\t--text-encoding: encoding of text cells, auto ( default, from the DB header ), utf8, utf16le or utf16be. Output is always UTF-8\n"
+"\t--date-after: only dump rows with a timestamp cell ( Unix, Cocoa or Chrome/WebKit ) at or after this, Unix seconds or YYYY-MM-DD[ HH:MM[:SS]] UTC\n"
+"\t--date-before: only dump rows with a timestamp cell before this\n"
+"\t--date-latest: the latest a cell can plausibly be as a timestamp, a day from now by default\n"
+"\t--serve: stay running and answer page/offset/rowid queries on this Unix socket, in JSON ( -i is then optional )\n"
+"\t--write-index: also record every row found in this carve index file\n"
+"\t--from-index: dump just the rows in this carve index ( written from the same DB ), without searching the DB again\n"
+"\t--baseline: an earlier copy of the DB, pages unchanged since aren't carved and rows already in it aren't dumped\n"
+"\t--signature: only decode records of these tables, comma list of built in names ( sqlite_master, chrome_urls, ios_sms_message ) or column classes, n i r t b ( upper case for or NULL ), * any, trailing + for more columns\n"
+"\t--dedup-pages: carve pages that repeat an earlier page byte for byte only once\n"
+"\t--dedup-table: with --dedup-pages, list each repeated page as page,offset,same as page in this file\n"
+"\t--output-compress: compress the output, gzip ( level 1..9, default 6 ) or zstd ( 1..22, default 3 ), in independent seekable 1MB frames\n"
+"\t--output-threads: threads compressing output frames ( default, one per CPU up to 8 )\n"
+"\t--trace: write a timeline of the carve ( open, page fetch/classify/carve, overflow, blobs, output flushes, compression ), per thread, as Chrome trace event JSON to this file\n"
+"\t--trace-sample: with --trace, record only 1 in this many of the per page, overflow, blob and flush spans ( default 1, all of them )\n"
+"\t--estimate: rather than dumping rows, carve a stratified random sample of pages for this long ( default 10s ) and estimate the rows a full carve would recover, the deleted share and the time it would take, with 95% intervals\n"
+"\t--self-check: rather than dumping rows, decode every record found again with a plain reference decoder, check the SIMD output kernels against scalar, and carve again with each input backend and from a carve index, reporting any difference\n"
+"\t--scan-order: order pages are carved in, file ( default ) or yield, freelist, unallocated and freeblock holding pages first, then leaf pages with unallocated space, then the rest\n"
+"\t--scan-reorder: with --scan-order=yield, hold the rows back and write them out in file order once the carve is done\n"
+"\t--no-ptrmap: follow overflow chains in an autovacuum DB without checking them against its pointer map ( for a damaged map )\n"
 //"\t--freespace-minimum: smallest freespace size to search in\n"
 ;
 
+
 /*-----------------------------------------------------------------\
   Date Code:	: 20131023-105927
   Function Name	: UNDARK_init
@@ -176,30 +222,48 @@ int UNDARK_init( struct globals *g ) {
 	/**
 	 * Initialise our globals 
 	 */
-	g->page_size = 0;
-	g->page_count = 0;
-	g->page_number = 1;
-	g->debug = 0;
-	g->verbose = 0;
+	UNDARK_options_init( &(g->opt) );
 	g->input_file = NULL;
-	g->date_lower = 0;
-	g->date_upper = 0;
-	g->cc_max = PAYLOAD_CELLS_MAX;
-	g->cc_min = 2;
-	g->rs_max = SIZE_MAX;
-	g->rs_min = 10;
 	g->blob_count = 0;
 	g->report_blobs = 1;
 	g->blob_size_limit = SIZE_MAX; // C99 
-	g->fine_search = 0;
-	g->freelist_space_only = 0;
-	g->removed_only = 0;
-	g->freespace_minimum = SIZE_MAX; // C99
-	g->page_start = 0;
-	g->page_end = 0;
+	g->blob_encoding = BLOB_ENCODING_HEX;
+
+	g->out = NULL;
+	g->show_stats = 0;
+	g->grep_file = NULL;
+	g->signatures = NULL;
+
+	g->split_dir = NULL;
+	g->split_key = SPLIT_KEY_COLUMNS;
+	g->split_max_open = SPLIT_MAX_OPEN_DEFAULT;
+	g->split = NULL;
+	g->split_failed = 0;
 
-	g->db_cfp = NULL;
-	g->db_cpp = NULL;
+	g->text_encoding = UNDARK_TEXT_UTF8;
+	g->text = NULL;
+	g->text_allocated = 0;
+
+	g->serve_path = NULL;
+	g->write_index = NULL;
+	g->from_index = NULL;
+	g->baseline = NULL;
+	g->dedup = 0;
+	g->dedup_table = NULL;
+
+	g->compress = OUTZIP_NONE;
+	g->compress_level = 0;
+	g->compress_threads = 0;
+	g->zip = NULL;
+
+	g->trace_file = NULL;
+	g->trace_sample = 1;
+
+	g->self_check = 0;
+	g->estimate = 0;
+
+	g->scan_reorder = 0;
+	g->reorder = NULL;
 
 	return 0;
 }
@@ -248,8 +312,8 @@ int UNDARK_parse_parameters( int argc, char **argv, struct globals *g ) {
 
 		if (strcmp(p, "-V") == 0) { fprintf(stdout,"%s", version); exit(0); }
 		if (strcmp(p, "-h") == 0) { fprintf(stdout,"%s %s", argv[0], help); exit(0); }
-		if (strcmp(p, "-d") == 0) g->debug = 1;
-		if (strcmp(p, "-v") == 0) g->verbose = 1;
+		if (strcmp(p, "-d") == 0) g->opt.debug = 1;
+		if (strcmp(p, "-v") == 0) g->opt.verbose = 1;
 		if (strcmp(p, "-i") == 0) {
 			param++; 
 			if (param < argc) { 
@@ -279,198 +343,284 @@ int UNDARK_parse_parameters( int argc, char **argv, struct globals *g ) {
 				p = p +strlen(PARAM_BLOB_SIZE_LIMIT);
 				g->blob_size_limit = strtol( p, NULL, 10 );
 
+			} else if (strncmp(p,PARAM_BLOB_ENCODING, strlen(PARAM_BLOB_ENCODING))==0) {
+				p = p +strlen(PARAM_BLOB_ENCODING);
+				if (strcmp(p, "hex")==0) g->blob_encoding = BLOB_ENCODING_HEX;
+				else if (strcmp(p, "base64")==0) g->blob_encoding = BLOB_ENCODING_BASE64;
+				else {
+					fprintf(stderr,"Unknown blob encoding \"%s\" ( hex or base64 )\n", p);
+					exit(1);
+				}
+
 			} else if (strncmp(p,PARAM_PAGE_START, strlen(PARAM_PAGE_START))==0) {
 				p = p +strlen(PARAM_PAGE_START);
-				g->page_start = strtol( p, NULL, 10 );
+				g->opt.page_start = strtol( p, NULL, 10 );
 
 			} else if (strncmp(p,PARAM_PAGE_END, strlen(PARAM_PAGE_END))==0) {
 				p = p +strlen(PARAM_PAGE_END);
-				g->page_end = strtol( p, NULL, 10 );
+				g->opt.page_end = strtol( p, NULL, 10 );
 
 			} else if (strncmp(p,PARAM_PAGE_SIZE, strlen(PARAM_PAGE_SIZE))==0) {
 				p = p +strlen(PARAM_PAGE_SIZE);
-				g->page_size = strtol( p, NULL, 10 );
+				g->opt.page_size = strtol( p, NULL, 10 );
 
 			} else if (strncmp(p,PARAM_FREESPACE_MINIMUM, strlen(PARAM_FREESPACE_MINIMUM))==0) {
 				p = p +strlen(PARAM_FREESPACE_MINIMUM);
-				g->freespace_minimum = strtol( p, NULL, 10 );
+				g->opt.freespace_minimum = strtol( p, NULL, 10 );
 
 			} else if (strncmp(p,PARAM_CELLCOUNT_MIN, strlen(PARAM_CELLCOUNT_MIN))==0) {
 				p = p +strlen(PARAM_CELLCOUNT_MIN);
-				g->cc_min = strtol( p, NULL, 10 );
+				g->opt.cc_min = strtol( p, NULL, 10 );
 
 			} else if (strncmp(p,PARAM_CELLCOUNT_MAX, strlen(PARAM_CELLCOUNT_MAX))==0) {
 				p = p +strlen(PARAM_CELLCOUNT_MAX);
-				g->cc_max = strtol( p, NULL, 10 );
+				g->opt.cc_max = strtol( p, NULL, 10 );
 
 			} else if (strncmp(p,PARAM_ROWSIZE_MIN, strlen(PARAM_ROWSIZE_MIN))==0) {
 				p = p +strlen(PARAM_ROWSIZE_MIN);
-				g->rs_min = strtol( p, NULL, 10 );
+				g->opt.rs_min = strtol( p, NULL, 10 );
 
 			} else if (strncmp(p,PARAM_ROWSIZE_MAX, strlen(PARAM_ROWSIZE_MAX))==0) {
 				p = p +strlen(PARAM_ROWSIZE_MAX);
-				g->rs_max = strtol( p, NULL, 10 );
+				g->opt.rs_max = strtol( p, NULL, 10 );
 
 			} else if (strncmp(p,PARAM_FINE_SEARCH, strlen(PARAM_FINE_SEARCH))==0) {
-				g->fine_search = 1;
+				g->opt.fine_search = 1;
 
 			} else if (strncmp(p,PARAM_FREESPACE_ONLY, strlen(PARAM_FREESPACE_ONLY))==0) {
-				g->freelist_space_only = 1;
+				g->opt.freelist_space_only = 1;
 
 			} else if (strncmp(p,PARAM_REMOVED_ONLY, strlen(PARAM_REMOVED_ONLY))==0) {
-				g->removed_only = 1;
+				g->opt.removed_only = 1;
 
-			} else {
-				fprintf(stderr,"Cannot interpret extended parameter: \"%s\"\n",p);
-				exit(1);
-			}
+			} else if (strncmp(p,PARAM_IO_POLICY, strlen(PARAM_IO_POLICY))==0) {
+				p = p +strlen(PARAM_IO_POLICY);
+				if (UNDARK_options_io_policy( &(g->opt), p )) {
+					fprintf(stderr,"Unknown I/O policy in \"%s\" ( sequential, willneed, prefetch-overflow, populate, hugepages, dontneed or none )\n", p);
+					exit(1);
+				}
 
-		}
-	}
+			} else if (strncmp(p,PARAM_IO_WINDOW, strlen(PARAM_IO_WINDOW))==0) {
+				p = p +strlen(PARAM_IO_WINDOW);
+				g->opt.io_window = strtol( p, NULL, 10 );
 
-	if (g->input_file == NULL) {
-		fprintf(stderr,"ERROR: Need input file\n");
-		exit(1);
-	}
+			} else if (strncmp(p,PARAM_STATS, strlen(PARAM_STATS))==0) {
+				g->show_stats = 1;
 
+			} else if (strncmp(p,PARAM_INPUT_BACKEND, strlen(PARAM_INPUT_BACKEND))==0) {
+				p = p +strlen(PARAM_INPUT_BACKEND);
+				if (UNDARK_options_input_backend( &(g->opt), p )) {
+					fprintf(stderr,"Unknown input backend \"%s\" ( mmap, pread or uring )\n", p);
+					exit(1);
+				}
 
-	return 0;
-}
+			} else if (strncmp(p,PARAM_READ_CHUNK, strlen(PARAM_READ_CHUNK))==0) {
+				p = p +strlen(PARAM_READ_CHUNK);
+				g->opt.read_chunk = strtol( p, NULL, 10 );
 
+			} else if (strncmp(p,PARAM_READ_DEPTH, strlen(PARAM_READ_DEPTH))==0) {
+				p = p +strlen(PARAM_READ_DEPTH);
+				g->opt.read_depth = strtol( p, NULL, 10 );
 
+			} else if (strncmp(p,PARAM_DECOMPRESS_RESERVE, strlen(PARAM_DECOMPRESS_RESERVE))==0) {
+				p = p +strlen(PARAM_DECOMPRESS_RESERVE);
+				g->opt.decompress_reserve = strtoull( p, NULL, 10 );
 
+			} else if (strncmp(p,PARAM_GREP, strlen(PARAM_GREP))==0) {
+				g->grep_file = p +strlen(PARAM_GREP);
 
-/*-----------------------------------------------------------------\
-  Date Code:	: 20131006-121932
-  Function Name	: to_signed_byte
-  Returns Type	: char
-  ----Parameter List
-  1. unsigned char value, 
-  ------------------
-  Exit Codes	: 
-  Side Effects	: 
-  --------------------------------------------------------------------
-Comments:
+			} else if (strncmp(p,PARAM_TEXT_ENCODING, strlen(PARAM_TEXT_ENCODING))==0) {
+				p = p +strlen(PARAM_TEXT_ENCODING);
+				if (UNDARK_options_text_encoding( &(g->opt), p )) {
+					fprintf(stderr,"Unknown text encoding \"%s\" ( auto, utf8, utf16le or utf16be )\n", p);
+					exit(1);
+				}
 
-Converts 2's compliment byte to signed integer
+			} else if (strncmp(p,PARAM_DATE_AFTER, strlen(PARAM_DATE_AFTER))==0) {
+				p = p +strlen(PARAM_DATE_AFTER);
+				if (UNDARK_options_date( &(g->opt.date_after), p )) {
+					fprintf(stderr,"Cannot read date \"%s\" ( Unix seconds or YYYY-MM-DD[ HH:MM[:SS]] )\n", p);
+					exit(1);
+				}
 
---------------------------------------------------------------------
-Changes:
+			} else if (strncmp(p,PARAM_DATE_BEFORE, strlen(PARAM_DATE_BEFORE))==0) {
+				p = p +strlen(PARAM_DATE_BEFORE);
+				if (UNDARK_options_date( &(g->opt.date_before), p )) {
+					fprintf(stderr,"Cannot read date \"%s\" ( Unix seconds or YYYY-MM-DD[ HH:MM[:SS]] )\n", p);
+					exit(1);
+				}
 
-\------------------------------------------------------------------*/
-char to_signed_byte(unsigned char value) {
-	int signed_value = value;
-	if (value >> 7) signed_value |= -1 << 7;
-	return signed_value;
-}
+			} else if (strncmp(p,PARAM_DATE_LATEST, strlen(PARAM_DATE_LATEST))==0) {
+				p = p +strlen(PARAM_DATE_LATEST);
+				if (UNDARK_options_date( &(g->opt.date_latest), p )) {
+					fprintf(stderr,"Cannot read date \"%s\" ( Unix seconds or YYYY-MM-DD[ HH:MM[:SS]] )\n", p);
+					exit(1);
+				}
 
-int to_signed_int( unsigned int value ) {
-	int signed_value = value;
+			} else if (strncmp(p,PARAM_SERVE, strlen(PARAM_SERVE))==0) {
+				g->serve_path = p +strlen(PARAM_SERVE);
 
-	if (value >> 15) signed_value |= -1 << 15;
-	return signed_value;
-}
+			} else if (strncmp(p,PARAM_WRITE_INDEX, strlen(PARAM_WRITE_INDEX))==0) {
+				g->write_index = p +strlen(PARAM_WRITE_INDEX);
 
-long int to_signed_long( unsigned long int value ) {
-	long int signed_value = value;
+			} else if (strncmp(p,PARAM_FROM_INDEX, strlen(PARAM_FROM_INDEX))==0) {
+				g->from_index = p +strlen(PARAM_FROM_INDEX);
 
-	if (value >> 31) signed_value |= -1 << 31;
-	return signed_value;
-}
+			} else if (strncmp(p,PARAM_SIGNATURE, strlen(PARAM_SIGNATURE))==0) {
+				g->signatures = p +strlen(PARAM_SIGNATURE);
 
+			} else if (strncmp(p,PARAM_BASELINE, strlen(PARAM_BASELINE))==0) {
+				g->baseline = p +strlen(PARAM_BASELINE);
 
+			} else if (strncmp(p,PARAM_ESTIMATE, strlen(PARAM_ESTIMATE))==0) {
+				p = p +strlen(PARAM_ESTIMATE);
+				g->estimate = ESTIMATE_BUDGET_DEFAULT;
+				if (*p == '=') g->estimate = strtod( p +1, NULL );
+				if (g->estimate <= 0) {
+					fprintf(stderr,"--estimate needs a budget of more than 0 seconds\n");
+					exit(1);
+				}
 
+			} else if (strncmp(p,PARAM_SCAN_ORDER, strlen(PARAM_SCAN_ORDER))==0) {
+				p = p +strlen(PARAM_SCAN_ORDER);
+				if (strcmp(p,"file")==0) g->opt.scan_order = UNDARK_SCAN_FILE;
+				else if (strcmp(p,"yield")==0) g->opt.scan_order = UNDARK_SCAN_YIELD;
+				else {
+					fprintf(stderr,"Unknown scan order \"%s\" ( file or yield )\n", p);
+					exit(1);
+				}
 
+			} else if (strncmp(p,PARAM_SCAN_REORDER, strlen(PARAM_SCAN_REORDER))==0) {
+				g->scan_reorder = 1;
 
-/*-----------------------------------------------------------------\
-  Date Code:	: 20131002-220244
-  Function Name	: tdump
-  Returns Type	: int
-  ----Parameter List
-  1. char *p, 
-  2.  uint16_t l , 
-  ------------------
-  Exit Codes	: 
-  Side Effects	: 
-  --------------------------------------------------------------------
-Comments:
+			} else if (strncmp(p,PARAM_NO_PTRMAP, strlen(PARAM_NO_PTRMAP))==0) {
+				g->opt.ptrmap_check = 0;
 
---------------------------------------------------------------------
-Changes:
+			} else if (strncmp(p,PARAM_SELF_CHECK, strlen(PARAM_SELF_CHECK))==0) {
+				g->self_check = 1;
 
-\------------------------------------------------------------------*/
-int tdump( char *p, uint16_t l ) {
+			} else if (strncmp(p,PARAM_DEDUP_PAGES, strlen(PARAM_DEDUP_PAGES))==0) {
+				g->dedup = 1;
 
-	while (l--) {
-		if (isprint(*p)) fprintf(stdout,"%c", *p); else fprintf(stdout,".");
-		p++;
-	}
+			} else if (strncmp(p,PARAM_DEDUP_TABLE, strlen(PARAM_DEDUP_TABLE))==0) {
+				g->dedup = 1;
+				g->dedup_table = p +strlen(PARAM_DEDUP_TABLE);
 
-	return 0;
-}
+			} else if (strncmp(p,PARAM_SPLIT_OUTPUT, strlen(PARAM_SPLIT_OUTPUT))==0) {
+				g->split_dir = p +strlen(PARAM_SPLIT_OUTPUT);
 
+			} else if (strncmp(p,PARAM_SPLIT_KEY, strlen(PARAM_SPLIT_KEY))==0) {
+				p = p +strlen(PARAM_SPLIT_KEY);
+				if (strcmp(p, "columns")==0) g->split_key = SPLIT_KEY_COLUMNS;
+				else if (strcmp(p, "types")==0) g->split_key = SPLIT_KEY_TYPES;
+				else {
+					fprintf(stderr,"Unknown split key \"%s\" ( columns or types )\n", p);
+					exit(1);
+				}
 
+			} else if (strncmp(p,PARAM_OUTPUT_COMPRESS, strlen(PARAM_OUTPUT_COMPRESS))==0) {
+				int r;
+
+				p = p +strlen(PARAM_OUTPUT_COMPRESS);
+				r = outzip_method( p, &(g->compress), &(g->compress_level) );
+				if (r == 1) {
+					fprintf(stderr,"Unknown output compression \"%s\" ( none, gzip[:1..9] or zstd[:1..22] )\n", p);
+					exit(1);
+				} else if (r == 2) {
+					fprintf(stderr,"This build of undark can't write %s output ( needs %s )\n", p, (g->compress == OUTZIP_GZIP) ? "zlib, UNDARK_ZLIB" : "libzstd, UNDARK_ZSTD");
+					exit(1);
+				}
 
+			} else if (strncmp(p,PARAM_OUTPUT_THREADS, strlen(PARAM_OUTPUT_THREADS))==0) {
+				p = p +strlen(PARAM_OUTPUT_THREADS);
+				g->compress_threads = strtol( p, NULL, 10 );
 
-/*-----------------------------------------------------------------\
-  Date Code:	: 20131006-122020
-  Function Name	: sqltdump
-  Returns Type	: int
-  ----Parameter List
-  1. char *p, 
-  2.  uint16_t l , 
-  ------------------
-  Exit Codes	: 
-  Side Effects	: 
-  --------------------------------------------------------------------
-Comments:
-Dumps text in a SQL friendly format ( doubling of single quotes )
+			} else if (strncmp(p,PARAM_TRACE_SAMPLE, strlen(PARAM_TRACE_SAMPLE))==0) {
+				p = p +strlen(PARAM_TRACE_SAMPLE);
+				g->trace_sample = strtoul( p, NULL, 10 );
 
---------------------------------------------------------------------
-Changes:
+			} else if (strncmp(p,PARAM_TRACE, strlen(PARAM_TRACE))==0) {
+				p = p +strlen(PARAM_TRACE);
+				g->trace_file = p;
 
-\------------------------------------------------------------------*/
-int sqltdump( char *p, uint16_t l ) {
+			} else if (strncmp(p,PARAM_SPLIT_MAX_OPEN, strlen(PARAM_SPLIT_MAX_OPEN))==0) {
+				p = p +strlen(PARAM_SPLIT_MAX_OPEN);
+				g->split_max_open = strtol( p, NULL, 10 );
 
-	fprintf(stdout,"\"");
-	while (l--) {
-		if (*p == '\"') fprintf(stdout,"\"");
-		if (isprint(*p)) fprintf(stdout,"%c", *p); else fprintf(stdout,".");
-		p++;
+			} else {
+				fprintf(stderr,"Cannot interpret extended parameter: \"%s\"\n",p);
+				exit(1);
+			}
+
+		}
 	}
-	fprintf(stdout,"\"");
 
-	return 0;
-}
+	if ((g->input_file == NULL) && (g->serve_path == NULL)) {
+		fprintf(stderr,"ERROR: Need input file\n");
+		exit(1);
+	}
 
 
+	return 0;
+}
 
 
 /*-----------------------------------------------------------------\
-  Date Code:	: 20131007-004650
-  Function Name	: blob_dump
+  Date Code:	: 20131006-122020
+  Function Name	: sqltdump
   Returns Type	: int
   ----Parameter List
-  1. unsigned char *p, 
-  2.  uint16_t l , 
+  1. struct outbuf *ob,
+  2.  char *p, 
+  3.  size_t l , 
+  4.  int by_reference ,
   ------------------
   Exit Codes	: 
   Side Effects	: 
   --------------------------------------------------------------------
 Comments:
+Dumps text in a SQL friendly format ( doubling of single quotes )
+
+Clean runs of text are queued by reference in to the mapped data,
+only the escapes/substitutions get written to the scratch buffer.
+Text that's been transcoded sits in a buffer we reuse, so that's
+copied instead ( by_reference 0 ), as is text from an image that
+isn't mmap'd whole, the reader reuses that memory.
+
+Valid UTF-8 is passed through untouched, control bytes and invalid
+UTF-8 are replaced with '.' ( one per byte ).
 
 --------------------------------------------------------------------
 Changes:
+20261018: length is a size_t, text over 64K was being cut short
+20261018: by reference only from an image mapped for the whole run
 
 \------------------------------------------------------------------*/
-int blob_dump( unsigned char *p, uint16_t l ) {
-
-	fprintf(stdout,"x'");
-	while (l--) {
-		fprintf(stdout,"%02X", ( unsigned char)*p);
-		p++;
+int sqltdump( struct outbuf *ob, char *p, size_t l, int by_reference ) {
+	int (*queue)( struct outbuf *, const char *, size_t ) = by_reference ? outbuf_ref : outbuf_copy;
+	unsigned char *u = (unsigned char *)p;
+	unsigned char *end = u +l;
+
+	outbuf_putc(ob, '\"');
+	while (u < end) {
+		size_t run;
+
+		run = textesc_clean_run( u, end -u );
+		if (u +run < end) {
+			if (u[run] == '\"') {
+				queue(ob, (char *)u, run +1);
+				outbuf_putc(ob, '\"');
+			} else {
+				queue(ob, (char *)u, run);
+				outbuf_putc(ob, '.');
+			}
+			run++;
+		} else {
+			queue(ob, (char *)u, run);
+		}
+		u += run;
 	}
-	fprintf(stdout,"'");
+	outbuf_putc(ob, '\"');
 
 	return 0;
 }
@@ -479,70 +629,57 @@ int blob_dump( unsigned char *p, uint16_t l ) {
 
 
 /*-----------------------------------------------------------------\
-  Date Code:	: 20131002-220250
-  Function Name	: hdump
+  Date Code:	: 20131007-004650
+  Function Name	: blob_dump
   Returns Type	: int
   ----Parameter List
-  1. char *p, 
-  2.  uint16_t l , 
+  1. struct outbuf *ob,
+  2.  unsigned char *p, 
+  3.  size_t l , 
+  4.  int encoding ,
   ------------------
   Exit Codes	: 
   Side Effects	: 
   --------------------------------------------------------------------
 Comments:
 
-Combo hex + text dump, 16 byte wide rows
+Hex output is the SQL blob literal, x'0A1B..', base64 output
+is double quoted like text.
 
 --------------------------------------------------------------------
 Changes:
+20261018: length is a size_t, blobs of 64K and over were being cut
+to length % 65536
 
 \------------------------------------------------------------------*/
-int hdump( unsigned char *p, uint16_t length, char *msg ) {
-
-	int oc = 0;
-	int ll = length;
-
-	fprintf(stdout,"%s: Hexdumping %d bytes from %p\n", msg, ll, p);
-	uint16_t c = 0;
-
-	if (p == NULL) {
-		fprintf(stdout,"ERROR: NULL passed.\n");
-		//		exit(1);
-	}
-
-	while (ll > 0) {
-		int br;
-		unsigned char *op;
-
-		fprintf(stdout,"%04X [%06d] ",oc, ll);
-		oc+=16;
-
-		br = ll;
-		op = p;
-		while (ll--) {
-			fprintf(stdout,"%02X ", *p);
-			c++;
-			p++;
-			if (c%16 == 0) break;
-		}
-
-		ll = br;
-		p = op;
-		c = 0;
-
-		fprintf(stdout, "  [%06d]", ll );
-		while (ll--) {
-			fprintf(stdout,"%c", isprint(*p)?*p:'.');
-			c++;
-			p++;
-			if (c%16 == 0)  break;
+int blob_dump( struct outbuf *ob, unsigned char *p, size_t l, int encoding ) {
+	size_t remaining = l;
+
+	if (encoding == BLOB_ENCODING_BASE64) outbuf_putc(ob, '\"');
+	else outbuf_copy(ob, "x'", 2);
+
+	while (remaining > 0) {
+		size_t chunk = remaining;
+		char *d;
+
+		if (encoding == BLOB_ENCODING_BASE64) {
+			/* chunks stay a multiple of 3 bytes so base64 only pads at the very end */
+			if (chunk > (OUTBUF_SCRATCH_SIZE /4) *3) chunk = (OUTBUF_SCRATCH_SIZE /4) *3;
+			d = outbuf_reserve(ob, BLOBENC_BASE64_LENGTH(chunk));
+			if (!d) return 1;
+			blobenc_base64(d, p, chunk);
+		} else {
+			if (chunk > OUTBUF_SCRATCH_SIZE /2) chunk = OUTBUF_SCRATCH_SIZE /2;
+			d = outbuf_reserve(ob, BLOBENC_HEX_LENGTH(chunk));
+			if (!d) return 1;
+			blobenc_hex(d, p, chunk);
 		}
-
-		fprintf(stdout," %d\n",ll);
+		p += chunk;
+		remaining -= chunk;
 	}
 
-	fprintf(stdout,"\n");
-
+	if (encoding == BLOB_ENCODING_BASE64) outbuf_putc(ob, '\"');
+	else outbuf_putc(ob, '\'');
 
 	return 0;
 }
@@ -557,7 +694,7 @@ int hdump( unsigned char *p, uint16_t length, char *msg ) {
   ----Parameter List
   1. struct globals *glob, 
   2.  char *p, 
-  3.  size_t l , 
+  3.  uint16_t l , 
   ------------------
   Exit Codes	: 
   Side Effects	: 
@@ -572,6 +709,7 @@ int blob_dump_to_file( struct globals *g, char *p, size_t l ) {
 	int f;
 	ssize_t written;
 	char fn[1024];
+	uint64_t t = trace_start( TRACE_SAMPLED );
 
 	snprintf(fn, sizeof(fn), "%d.blob", g->blob_count);
 	DEBUG fprintf(stdout,"%s:%d:DEBUG: Writing %d bytes to %s\n", FL , l, fn );
@@ -584,460 +722,126 @@ int blob_dump_to_file( struct globals *g, char *p, size_t l ) {
 		return 1;
 	}
 	close(f);
+	if (t) trace_span( t, "blob", "output", "\"bytes\":%lu", (unsigned long)l );
 	return 0;
 }
 
 
 
 
-/*-----------------------------------------------------------------\
-  Date Code:	: 20131003-223556
-  Function Name	: *bstrstr
-  Returns Type	: char
-  ----Parameter List
-  1. char *needle, 
-  2.  char *haystack, 
-  3.  char *limit , 
-  ------------------
-  Exit Codes	: 
-  Side Effects	: 
-  --------------------------------------------------------------------
-Comments:
-Searches for the needle among a haystack possibly containing
-\0 delimeted data.
-
---------------------------------------------------------------------
-Changes:
-
-\------------------------------------------------------------------*/
-char *bstrstr( char *haystack, char *needle, char *limit ) {
-
-	char *p;
-
-	if ((!needle)||(*needle == '\0')) return NULL;
-	if (!haystack) return NULL;
-	if ((limit == NULL)||(limit <=haystack)) return NULL;
-
-	p = haystack;
-	while (p < limit) {
-		char *tp;
-		char *tn;
-
-		tn = needle;
-		tp = p;
-		while ((*tn) && (tp < limit) && (*tp == *tn)) {
-			tn++;
-			tp++;
-			if (*tn == '\0') return p;
-		}
-		p++;
-	}
-
-	return NULL;
-}
-
 
 
 
-/*-----------------------------------------------------------------\
-  Date Code:	: 20131004-175721
-  Function Name	: decode_row_meta
-  Returns Type	: int
-  ----Parameter List
-  1. uint8_t *p, 
-  2.  struct sql_payload *payload , 
-  ------------------
-  Exit Codes	: 
-  Side Effects	: 
-  --------------------------------------------------------------------
-Comments:
-
-Decodes the payload header data so that we can then later
-pull the actual data from the file.
-
---------------------------------------------------------------------
-Changes:
-added 'mode',  standard, or freespace
-
-\------------------------------------------------------------------*/
-int decode_row( struct globals *g, char *p, char *data_endpoint, struct sql_payload *payload, int mode, size_t forced_length ) {
-	int t = 0, offset;
-	char *plh_ep; // payload header end point
-	char *base = p;
-
-	DEBUG {
-		fprintf(stdout,"%s:%d:DEBUG:DECODING ROW-------------------------MODE:%s\n", FL, (mode?"Freespace":"Standard"));
-		hdump((unsigned char *)p, 16, "Decode_row start data");
-	}
-
-	payload->overflow_pages[0] = 0;
-	payload->cell_count = 0;
-
-	if ( mode == DECODE_MODE_FREESPACE ) {
-		payload->length = forced_length -4; // and we still have to deduct the payload header size
-	} else {
-		varint_decode( &(payload->length), p, &p );
-	}
-
-	if (payload->length > g->db_size) return 0;
-	if (payload->length < g->rs_min) return 0;
-	if (payload->length > g->rs_max) return 0;
-
-	DEBUG fprintf(stdout,"%s:%d:DEBUG:Payload size: %lu\n", FL, (unsigned long int)payload->length);
-
-	if ( mode == DECODE_MODE_FREESPACE ) {
-		payload->rowid = 1;
-	} else {
-		varint_decode( &(payload->rowid), p, &p );
-	}
-
-	if (payload->rowid < 1) return 0;
-
-	payload->prefix_length = p -base; // store this so we know how many bytes the length + Row ID took up.
-
-	plh_ep = p; // first set up the beginning of the payload header array size.
-	varint_decode( &(payload->header_size), p, &p );
-	if (payload->header_size > g->page_size) return 0;
-
-	if (mode == DECODE_MODE_FREESPACE) {
-		payload->length -= payload->header_size;
-		DEBUG fprintf(stdout,"%s:%d:DEBUG: Looking for %lu bytes of data after the payload header\n", FL , (long unsigned int)payload->length);
-		fflush(stdout);
-	}
-
-	// If the payload size exceeds the page_size, then we have to do some more checking
-
-	if (payload->length > (g->page_size -35)) {
-		uint32_t tmp, ovp;
-		int ovpi = 1;
-
-		// get the FIRST overflow page
-		memcpy(&tmp, data_endpoint -4, 4);
-		ovp = payload->overflow_pages[0] = ntohl(tmp);
-
-		// if the page is beyond the file range, then we've just got defective input data
-		if (ovp > g->page_count) return 0;
-		DEBUG fprintf(stdout,"%s:%d:DEBUG: First overflow page = %lu\n", FL , (long unsigned int)ovp);
-		DEBUG hdump((unsigned char *)(data_endpoint -16), 16, "First overflow page start data");
-
-
-		while (ovp > 0) {
-
-			void *calculated_address;
-
-			calculated_address = g->db_origin +( (ovp -1) *g->page_size);
-			DEBUG fprintf(stdout,"%s:%d:DEBUG: Calculated address: %p\n", FL, calculated_address);
-
-			// test for seeking beyond the db limit
-			//if ((g->db_origin +((ovp -1) *g->page_size)) > (g->db_end -4)) {
-
-			if ( calculated_address > (void *)(g->db_end -4)) { //PLD:20141220-0000
-				DEBUG	fprintf(stdout,"%s:%d:ERROR: Seek beyond end of data looking for overflow page (%p > %p)\n", FL, calculated_address, g->db_end);
-				break;
-			} 
-
-			if ( calculated_address < (void *)(g->db_origin)) { //PLD:20141220-0000
-				DEBUG	fprintf(stdout,"%s:%d:ERROR: Seek before DB starts (%p < %p)\n", FL, calculated_address, g->db_origin);
-				break;
-			} 
-
-			memcpy(&tmp, calculated_address, 4);
-			ovp = payload->overflow_pages[ovpi] = ntohl(tmp);
-			DEBUG fprintf(stdout,"%s:%d:DEBUG: overflow page[%d] = %d\n", FL , ovpi, ovp);
-			DEBUG fflush(stdout);
-			ovpi++;
-			if (ovpi > OVERFLOW_PAGES_MAX) {
-				fprintf(stdout,"ERROR: No more space for overflow pages\n");
-				fflush(stdout);
-				payload->overflow_pages[0] = 0;
-				break;
-			}
-			payload->overflow_pages[ovpi] = 0;
-		}
-
-
-		DEBUG {
-			fprintf(stdout,"DEBUG: Total of %d overflow pages\n",ovpi);
-			ovpi = 0;
-			while (payload->overflow_pages[ovpi]) {
-				fprintf(stdout,"DEBUG: Overflow %d->%d\n", ovpi, payload->overflow_pages[ovpi]);
-				ovpi++;
-			}
-		}
-	}  // overflow handling
-
-	if (payload->header_size > g->page_size) return 0; // sorry, no can do with the way we're playing this decoding game.
-	if (payload->header_size < 2) return 0; // need at least 2 bytes
-
-	plh_ep += payload->header_size; // if we got a sane value, then we can use this for the full decode size ( includes the size of the first varint telling us the size )
-
-	DEBUG { fprintf(stdout,"[L:%lld][id:%lld][PLHz:%lld]", payload->length, payload->rowid, payload->header_size); }
-
-	t = 0;
-	offset = 0;
-
-
-	while (1) {
-		uint64_t s;
-		int vil;
-
-		vil = varint_decode( &s, p, &p ); 
-
-		if (vil > 8) return 0; // no var int should be bigger than 8 bytes.
-
-		payload->cells[t].t = s; // set the type
-		switch (s) {
-			case 0: s = 0; break;
-			case 1: s = 1; break;
-			case 2: s = 2; break;
-			case 3: s = 3; break;
-			case 4: s = 4; break;
-			case 5: s = 6; break;
-			case 6: case 7: s = 8; break;
-			case 8: case 9: s = 0; break;
-			case 10: case 11: DEBUG fprintf(stdout,"%s:%d:DEBUG: celltype 10/11 reserved, aborting row.\n",FL); s = 0; return 0; break;
-			default: 
-									if ((s >= 12)&&((s&0x01)==0)) { payload->cells[t].t = 12; s = (s-12)/2; }
-									else if ((s >= 13)&&((s&0x01)==1)) { payload->cells[t].t = 13; s = (s-13)/2; }
-									break;
-		}
-
-		payload->cells[t].s = s; // set the size/length
-		payload->cells[t].o = (plh_ep +offset) -base;
-		offset += payload->cells[t].s;
-		if (offset > payload->length) return 0;
-
-		DEBUG { fprintf(stdout,"[%d:%d:%d-%d(%d)]", t, payload->cells[t].t, payload->cells[t].s, payload->cells[t].o, plh_ep -p ); }
-
-		if (p >= plh_ep) break;
-		t++;
-		payload->cell_count++;
-		if ( t > g->cc_max ) return 0;
-	} // while decoding the cells
-
-	if (p == plh_ep) {
-		DEBUG {
-			fprintf(stdout,"DEBUG: Payload head size match. (%d =? %d)\n ", p -base,plh_ep -base);
-			fprintf(stdout,"DEBUG: Data size by cell meta sum = %d\n ", offset );
-		}
-	} else {
-		DEBUG {
-			fprintf(stdout,"DEBUG: Payload scan end point, and predicted end point didn't match, difference %d \n", p -plh_ep );
-		}
-	}
-
-	if ( t < g->cc_min )  {
-		DEBUG fprintf(stdout,"%s:%d:DEBUG: cell count under the minimum, so aborting\n", FL );
-		return 0;
-	}
-
-	DEBUG fprintf(stdout,"Offset [%u] + headersize [%lu] = length check [%lu]... \n", offset, (unsigned long int)payload->header_size, (unsigned long int)payload->length);
-
-	if (mode == DECODE_MODE_FREESPACE) {
-		/** there can often be multiple entries within freespace, so we have to be
-		 * a little looser with our acceptance criterion
-		 */
-		if (offset <= payload->length) {
-			DEBUG fprintf(stdout,"%s:%d:DEBUG: FREESPACE SUBMATCH FOUND ( %u of %lu used )\n", FL , offset, (long unsigned int) payload->length);
-			return (offset +payload->header_size +4);
-		}
-	}
-
-	if (offset + payload->header_size  == payload->length) {
-		DEBUG fprintf(stdout,"\nMATCH FOUND!\n");
-		return 1;
-	}
-
-	return 0;
-}
-
-
-/*-----------------------------------------------------------------\
-  Date Code:	: 20150723-210259
-  Function Name	: ntonll
-  Returns Type	: uint64_t
-  	----Parameter List
-	1. uint64_t value, 
-	------------------
-Exit Codes	: 
-Side Effects	: 
---------------------------------------------------------------------
-Comments:
-
---------------------------------------------------------------------
-Changes:
-
-\------------------------------------------------------------------*/
-uint64_t ntohll(uint64_t value) {
-
-// hdump( &value, 8, "FP: ");
-	if (1==ntohl(1)) {
-	  return value;
-	} else {
-		return ((ntohl((value) & 0xFFFFFFFF) << 32) | ntohl((value) >> 32));
-	}
-}
-
 /*-----------------------------------------------------------------\
   Date Code:	: 20131008-182215
   Function Name	: dump_row
   Returns Type	: int
   ----Parameter List
-  1. struct globals *glob, 
-  2.  char *p, 
-  3.  char *data_endpoint, 
-  4.  struct sql_payload *payload, 
-  5.  int decode , 
+  1. struct undark_row *row,
+  2.  void *arg ,
   ------------------
   Exit Codes	: 
   Side Effects	: 
   --------------------------------------------------------------------
 Comments:
 
+Row callback for libundark, writes the row out as a CSV line,
+to stdout or to its file under --split-output.
+
 --------------------------------------------------------------------
 Changes:
+20261018: the row assembly moved in to libundark, this just
+formats the cells it hands us.
 
 \------------------------------------------------------------------*/
-int dump_row( struct globals *g, char *base, char *data_endpoint, struct sql_payload *payload, int mode ) {
-	int t = 0;
-	int ovpi;
-	void *addr;
-
-
-	DEBUG fprintf(stdout,"\n-DUMPING ROW------------------\n");
-	DEBUG hdump((unsigned char *)base, 16, "Dump_row starting data");
-
-	if ( payload->length > g->db_size ) {
-		DEBUG fprintf(stdout,"%s:%d:ERROR: Nonsensical payload length of %ld requested, ignoring.\n", FL, (long int)payload->length);
-		return -1;
-	}
-
-	if (payload->overflow_pages[0] == 0) {
-		payload->mapped_data = base;
-		payload->mapped_data_endpoint = data_endpoint;
-
-	} else {
-		payload->mapped_data = malloc( (payload->length +100) *sizeof(char) );
-		if ( !payload->mapped_data ) {
-			fprintf(stderr,"%s:%d:ERROR: Cannot allocate %ld bytes for mapped data\n", FL, (long int)payload->length +100);
-			return -1;
-		}
-		DEBUG fprintf(stdout,"ALLOCATED %d bytes to mapped data\n", (int)(payload->length +100) );
-		if (!payload->mapped_data){ fprintf(stderr,"ERROR: Cannot allocate %d bytes for payload\n", (int)(payload->length +1)); return 0; }
-		memset( payload->mapped_data, 'X', payload->length +1 );
-
-		// load in the first, default page.
-		DEBUG fprintf(stdout,"Copying data for initial page\n");
-		memcpy(payload->mapped_data, base, data_endpoint -base );
-		payload->mapped_data_endpoint = payload->mapped_data +(data_endpoint -base -4);
-		//		DEBUG hdump( (unsigned char *)payload->mapped_data, payload->mapped_data_endpoint -payload->mapped_data +4  );
-
-		// Load in the overflow pages (if any)
-		ovpi = 0;
-		while (payload->overflow_pages[ovpi]) {
-			DEBUG fprintf(stdout,"Copying data from file to memory for page %d to offset [%d]\n", payload->overflow_pages[ovpi], (int)(payload->mapped_data_endpoint -payload->mapped_data));
-
-			addr = g->db_origin +((payload->overflow_pages[ovpi]-1) *g->page_size) +4; //PLD:20141221-2240 segfault fix
-			if (( addr < (void *)g->db_origin) || ( addr > (void *)g->db_end)) {
-				DEBUG fprintf(stdout,"%s:%d:dump_row:ERROR: page seek request outside of boundaries of file (%p < %p > %p)\n", FL, g->db_origin, addr, g->db_end);
-				return -1;
-			}
-
-			memcpy(payload->mapped_data_endpoint, addr, g->page_size -4);
-			payload->mapped_data_endpoint += g->page_size -4;
-
-			//	DEBUG hdump( (unsigned char *)payload->mapped_data, payload->mapped_data_endpoint -payload->mapped_data );
-
-			ovpi++;
+int dump_row( struct undark_row *row, void *arg ) {
+	struct globals *g = arg;
+	struct outbuf *out = g->out;
+	int t;
+
+	if (g->split) {
+		out = splitout_route( g->split, row );
+		if (!out) {
+			g->split_failed = 1;
+			return 1;
 		}
 	}
+	if (g->reorder) {
+		out = &(g->reorder->spool);
+		if (reorder_row( g->reorder, row->page )) return 1;
+	}
 
-	DEBUG hdump((unsigned char *)payload->mapped_data, payload->mapped_data_endpoint -payload->mapped_data, "Payload mapped data" );
-
-	if (mode == DECODE_MODE_FREESPACE) {
-		t = 0;
-		fprintf(stdout,"-1");
-
-	} else t = -1;
-
-	while (t <= payload->cell_count) {
-		long double ldf;
-		DEBUG fprintf(stdout,"%s:%d:DEBUG: Cell[%d], Type:%d, size:%d, offset:%d\n", FL , t, payload->cells[t].t, payload->cells[t].s, payload->cells[t].o);
-		if (t == -1) fprintf(stdout,"%ld", (long unsigned int) payload->rowid);
-		if (t>=0) { fprintf(stdout,",");
-			switch (payload->cells[t].t) {
-				case 0: fprintf(stdout,"NULL"); break;
-				case 1: fprintf(stdout,"x%d", to_signed_byte(*(payload->mapped_data +payload->cells[t].o)) ); break;
-				case 2: {
-							  uint16_t n;
-							  memcpy(&n, payload->mapped_data +payload->cells[t].o, 2 );
-							  fprintf(stdout,"%d" , to_signed_int(ntohs(n)));
-						  }
-						  break;
-
-				case 3: {
-							  uint32_t n;
-							  memcpy(&n, payload->mapped_data +payload->cells[t].o, 3 );
-							  fprintf(stdout,"%ld", to_signed_long(ntohl(n)));
-						  }
-						  break;
-
-				case 4: {
-							  uint32_t n;
-							  memcpy(&n, payload->mapped_data +payload->cells[t].o, 4 );
-							  fprintf(stdout,"%ld", to_signed_long(ntohl(n)));
+	if (row->freespace) outbuf_copy(out, "-1", 2);
+	else outbuf_printf(out,"%ld", (long unsigned int) row->rowid);
+
+	for (t = 0; t < row->cell_count; t++) {
+		struct undark_cell *c = &(row->cells[t]);
+
+		DEBUG fprintf(stdout,"%s:%d:DEBUG: Cell[%d], Type:%d, size:%d, offset:%d\n", FL , t, c->type, (int)c->length, (int)(c->data -row->cells[0].data));
+		outbuf_putc(out, ',');
+		switch (c->type) {
+			case 0: outbuf_copy(out, "NULL", 4); break;
+			case 1: case 2: case 3: case 4: case 5: case 6: case 7: case 8: case 9:
+					  {
+						  char num[NUMFMT_BUFFER_SIZE];
+						  size_t nl;
+
+						  nl = numfmt_serial( num, c->type, (unsigned char *)c->data );
+						  outbuf_copy(out, num, nl);
+					  }
+					  break;
+
+			case 12: 
+					  if ( g->report_blobs) {
+						  if (c->length < g->blob_size_limit) {
+							  DEBUG fprintf(stdout,"%s:%d:DEBUG:Not Dumping data to blob file, keeping in CSV\n", FL );
+							  blob_dump(out, (unsigned char *)c->data, c->length, g->blob_encoding );
+						  } else {
+							  // dump the blob to a file.
+							  DEBUG fprintf(stdout,"%s:%d:DEBUG:Dumping data to %d.blob [%d bytes]\n", FL ,g->blob_count, (int)c->length);
+							  blob_dump_to_file( g, (char *)c->data, c->length );
+							  DEBUG fprintf(stdout,"\"%d.blob\"", g->blob_count);
 						  }
-						  break;
-
-				case 5: fprintf(stdout,"%d", ntohl(*(payload->mapped_data +payload->cells[t].o))); break;
-				case 6: fprintf(stdout,"%d", ntohl(*(payload->mapped_data +payload->cells[t].o))); break;
-				case 7: 
-						  {
-						  uint64_t n;
-							memcpy(&n, payload->mapped_data +payload->cells[t].o, 8 );
-							ldf = (long double)ntohll(n);
-						  fprintf(stdout,"%LF",ldf); 
-						  }
-						  break;
-
-				case 8: fprintf(stdout,"0" ); break;
-				case 9: fprintf(stdout,"1" ); break;
-				case 12: 
-						  if ( g->report_blobs) {
-							  if (payload->cells[t].s < g->blob_size_limit) {
-								  DEBUG fprintf(stdout,"%s:%d:DEBUG:Not Dumping data to blob file, keeping in CSV\n", FL );
-								  blob_dump((unsigned char *) (payload->mapped_data +payload->cells[t].o), payload->cells[t].s );
-							  } else {
-								  // dump the blob to a file.
-								  DEBUG fprintf(stdout,"%s:%d:DEBUG:Dumping data to %d.blob [%d bytes]\n", FL ,g->blob_count, payload->cells[t].s);
-								  blob_dump_to_file( g, (payload->mapped_data +payload->cells[t].o), payload->cells[t].s );
-								  DEBUG fprintf(stdout,"\"%d.blob\"", g->blob_count);
+					  }
+					  g->blob_count++;
+					  break;
+
+			case 13:
+					  DEBUG fprintf(stdout,"%s:%d:DEBUG: Dumping text-13\n", FL );
+					  if (g->text_encoding == UNDARK_TEXT_UTF8) {
+						  sqltdump( out, (char *)c->data, c->length, g->text_by_reference );
+					  } else {
+						  size_t need = TEXTESC_UTF16_LENGTH(c->length);
+						  size_t tl;
+
+						  if (need > g->text_allocated) {
+							  char *text = realloc( g->text, need );
+
+							  if (!text) {
+								  fprintf(stderr,"ERROR: Cannot allocate %lu bytes to transcode text\n", (unsigned long)need);
+								  return 1;
 							  }
+							  g->text = text;
+							  g->text_allocated = need;
 						  }
-						  g->blob_count++;
-						  break;
-
-				case 13:
-						  DEBUG fprintf(stdout,"%s:%d:DEBUG: Dumping text-13\n", FL );
-						  sqltdump( payload->mapped_data +payload->cells[t].o, payload->cells[t].s ); 
-						  break;
-				default:
-						  fprintf(stderr,"Invalid cell type '%d'", payload->cells[t].t);
-						  DEBUG fprintf(stdout,"%s:%d:DEBUG: Invalid cell type '%d'", FL, payload->cells[t].t);
-						  DEBUG hdump( (unsigned char *) base, 128, "Invalid cell type" );
-						  return 0;
-						  break;
-			} // switch cell type
-		}
-
-		t++;
-
-	} // while decoding the cells
-
-	fprintf(stdout,"\n");
-	fflush(stdout);
-	if (payload->overflow_pages[0] != 0) {
-		free( payload->mapped_data );
+						  tl = textesc_utf16_to_utf8( g->text, (unsigned char *)c->data, c->length, (g->text_encoding == UNDARK_TEXT_UTF16BE) );
+						  sqltdump( out, g->text, tl, 0 );
+					  }
+					  break;
+			default:
+					  outbuf_flush( out );
+					  fprintf(stderr,"Invalid cell type '%d'", c->type);
+					  DEBUG fprintf(stdout,"%s:%d:DEBUG: Invalid cell type '%d'", FL, c->type);
+					  return 0;
+					  break;
+		} // switch cell type
+
+	} // while dumping the cells
+
+	outbuf_putc(out, '\n');
+	if ((row->overflow) && (g->text_by_reference)) {
+		/* the queued spans point in to the assembled copy, so they have to go out before it does */
+		outbuf_flush( out );
 	}
 
 	return 0;
@@ -1047,79 +851,47 @@ int dump_row( struct globals *g, char *base, char *data_endpoint, struct sql_pay
 
 
 /*-----------------------------------------------------------------\
-  Date Code:	: 20131004-211659
-  Function Name	: *find_next_sms
-  Returns Type	: char
+  Date Code:	: 20261018-175633
+  Function Name	: estimate_report
+  Returns Type	: int
   ----Parameter List
-  1. char *s, 
-  2.  char *end_point , 
+  1. struct undark_estimate *e,
+  2.  FILE *f ,
   ------------------
-  Exit Codes	: 
-  Side Effects	: 
+  Exit Codes	:
+  Side Effects	:
   --------------------------------------------------------------------
 Comments:
 
-Finds rows within a block.
+Writes out UNDARK_estimate()'s results, per stratum then overall,
++/- being the 95% interval.
 
 --------------------------------------------------------------------
 Changes:
 
-
 \------------------------------------------------------------------*/
-char *find_next_row( struct globals *g, char *s, char *end_point, char *global_start, int mode, size_t forced_length ) {
-
-	char *p;
-	struct sql_payload sql;
-
-	DEBUG fprintf(stdout,"find_next_row: MODE: %d\n", mode );
-	if (s == NULL) fprintf(stdout,"ERROR: NULL passed as search-space parameter\n");
-	p = s;
-	do {
-		int row;
-
-		row = decode_row( g, p, end_point, &sql, mode, forced_length );
-		if (row) {
-			DEBUG fprintf(stdout,"ROWID: %ld found [+%ld] record size: %d bytes\n", (unsigned long int)sql.rowid, p -global_start, (unsigned int)( sql.length+sql.prefix_length ));
-			fflush(stdout);
-
-			/** If we're only wanting the removed, no-key-value rows, then 
-			  * continue to the next row 
-			  */
-			if ((g->removed_only)&&(row >= 0)) {
-				p++;
-				continue;
-			}
-
-
-
-			if ((mode == DECODE_MODE_NORMAL)&&( g->freelist_space_only == 1)) {
-				// do nothing
-			} else  {
-				dump_row( g, p, end_point, &sql, mode );
-			}
-
-			fflush(stdout);
-			if (mode == DECODE_MODE_NORMAL) {
-				if (g->fine_search) p++;
-				else p+= sql.length;
-			} else {
-				if (row >= forced_length) {
-					DEBUG fprintf(stdout,"%s:%d:DEBUG: No more data left in freespace block to examine\n", FL);
-					p = end_point;
-					break;
-				} else {
-					p+=row; forced_length -= row;
-					DEBUG hdump((unsigned char *)p,64, "After freespace decode");
-				}
-			}
-		} else {
-			p++;
+int estimate_report( struct undark_estimate *e, FILE *f ) {
+	static const char *names[UNDARK_STRATA] = { "b-tree", "freelist", "unallocated" };
+	int h;
+
+	fprintf(f,"estimate: %u pages, %u carved in %.1fs ( %.1f%% )\n", e->pages, e->sampled, e->elapsed, e->pages ? 100.0 *e->sampled /e->pages : 0.0);
+	for (h = 0; h < UNDARK_STRATA; h++) {
+		struct undark_estimate_stratum *st = &(e->strata[h]);
+
+		if (!st->pages) continue;
+		if (!st->sampled) {
+			fprintf(f,"estimate: %s, %u pages, none carved\n", names[h], st->pages);
+			continue;
 		}
+		fprintf(f,"estimate: %s, %u pages, %u carved ( %u table leaves ), %.0f rows +/- %.0f, %.0f deleted +/- %.0f\n"
+				, names[h], st->pages, st->sampled, st->sampled_leaf, st->rows, st->rows_ci, st->deleted, st->deleted_ci);
+	}
+	fprintf(f,"estimate: recoverable rows %.0f +/- %.0f\n", e->rows, e->rows_ci);
+	fprintf(f,"estimate: deleted rows %.0f +/- %.0f, %.1f%% +/- %.1f%% of rows\n", e->deleted, e->deleted_ci, 100.0 *e->deleted_ratio, 100.0 *e->deleted_ratio_ci);
+	fprintf(f,"estimate: full carve %.1fs +/- %.1fs, carving only, not writing the rows out\n", e->seconds, e->seconds_ci);
+	if (!e->complete) fprintf(f,"estimate: the budget ran out before every kind of page was carved, the totals leave those pages out\n");
 
-	} while (p < end_point -PAYLOAD_SIZE_MINIMUM);
-
-	return NULL;
-
+	return 0;
 }
 
 
@@ -1144,11 +916,11 @@ Changes:
 \------------------------------------------------------------------*/
 int main( int argc, char **argv ) {
 
-	int fd;
 	struct globals globo, *g;
-	struct stat st;
-	char *p;
-	int stat_result;
+	struct outbuf output;
+	struct undark *u;
+	int result;
+	uint64_t t;
 
 	/**
 	 * Set up our global struct.
@@ -1165,344 +937,267 @@ int main( int argc, char **argv ) {
 
 	UNDARK_init( g );
 	UNDARK_parse_parameters( argc, argv, g );
+	if (g->opt.date_after >= g->opt.date_before) {
+		fprintf(stderr,"--date-after must be earlier than --date-before\n");
+		exit(1);
+	}
+	if ((g->serve_path) && ((g->write_index) || (g->from_index) || (g->baseline) || (g->dedup))) {
+		fprintf(stderr,"--write-index, --from-index, --baseline and --dedup-pages cannot be used with --serve\n");
+		exit(1);
+	}
+	if ((g->compress) && ((g->serve_path) || (g->split_dir))) {
+		fprintf(stderr,"--output-compress cannot be used with --serve or --split-output\n");
+		exit(1);
+	}
+	if ((g->self_check) && ((g->serve_path) || (g->write_index) || (g->from_index) || (g->baseline) || (g->dedup) || (g->split_dir) || (g->compress))) {
+		fprintf(stderr,"--self-check cannot be used with --serve, --write-index, --from-index, --baseline, --dedup-pages, --split-output or --output-compress\n");
+		exit(1);
+	}
+	if ((g->estimate) && ((g->serve_path) || (g->write_index) || (g->from_index) || (g->split_dir) || (g->compress) || (g->self_check))) {
+		fprintf(stderr,"--estimate cannot be used with --serve, --write-index, --from-index, --split-output, --output-compress or --self-check\n");
+		exit(1);
+	}
+	if ((g->opt.scan_order == UNDARK_SCAN_YIELD) && ((g->from_index) || (g->estimate))) {
+		fprintf(stderr,"--scan-order=yield cannot be used with --from-index or --estimate\n");
+		exit(1);
+	}
+	if ((g->scan_reorder) && (g->opt.scan_order != UNDARK_SCAN_YIELD)) {
+		fprintf(stderr,"--scan-reorder needs --scan-order=yield\n");
+		exit(1);
+	}
+	if ((g->scan_reorder) && ((g->serve_path) || (g->split_dir) || (g->self_check))) {
+		fprintf(stderr,"--scan-reorder cannot be used with --serve, --split-output or --self-check\n");
+		exit(1);
+	}
+	if ((g->trace_file) && (g->serve_path)) {
+		fprintf(stderr,"--trace cannot be used with --serve\n");
+		exit(1);
+	}
 
 	/**
-	 * Check our input file sanity
-	 *
+	 * Tracing starts before anything else, so the worker threads
+	 * started from here on all get their tracks named.
 	 */
-	stat_result = stat( g->input_file, &st );
-	if (stat_result != 0) {
-		fprintf(stderr,"ERROR: Cannot access input file '%s' ( %s )\n", g->input_file, strerror(errno));
+	if ((g->trace_file) && (trace_open( g->trace_file, g->trace_sample ))) {
+		fprintf(stderr,"ERROR: Cannot create trace file '%s' ( %s )\n", g->trace_file, strerror(errno));
 		exit(1);
 	}
 
-
 	/**
-	 * Map our input file to memory, makes it a lot easier
-	 * to jump around if we need to and saves us having to
-	 * handle buffer limits - leave it to the OS to manage :)
+	 * As a daemon the databases are opened as they're asked for,
+	 * rows go back over the socket rather than to stdout.
 	 */
-	fd = open( g->input_file, O_RDONLY );
-	g->db_size = st.st_size;
-	g->db_origin = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
-	g->db_end = g->db_origin +st.st_size -1;
-
-	//fprintf(stderr,"DB origin: %p\nDB end: %p\n", g->db_origin, g->db_end );
+	if (g->serve_path) {
+		struct serve *s = malloc( sizeof(struct serve) );
+
+		if ((!s) || (serve_init( s, g->serve_path, &(g->opt) ))) exit(1);
+		s->grep_file = g->grep_file;
+		s->signatures = g->signatures;
+		if (g->input_file) {
+			if (serve_open( s, g->input_file ) < 0) exit(1);
+			s->default_db = g->input_file;
+		}
+		VERBOSE fprintf(stderr,"Serving on %s\n", g->serve_path);
+		result = serve_run( s );
+		if (g->show_stats) {
+			int i;
 
-	/**
-	 * Start decoding the database
-	 *
-	 * Though it's not really required for us to care about the
-	 * SQLite page sizes, it can be useful in case we get boundary
-	 * situations and try to follow the data across a page
-	 *
-	 * If the page size is already set via parameter, then skip
-	 *
-	 */
-	if (g->page_size == 0) {
-		p = g->db_origin +16;
-		g->page_size =	(*(p+1)) | ((*p)<<8);
+			fprintf(stderr,"serve: %llu requests\n", (unsigned long long)s->queries);
+			for (i = 0; i < s->db_count; i++) UNDARK_stats( s->dbs[i].u, stderr );
+		}
+		serve_close( s );
+		free( s );
+		return result;
 	}
 
 	/**
-	 * Get the number of pages that are supposed to be in the database, though
-	 * we can ignore this and simply parse through the whole DB page at a time
-	 * until we reach the end
+	 * Self check, the carve is run several ways and compared,
+	 * nothing goes to stdout.
 	 */
-	p = g->db_origin +28;
-	memcpy( &g->page_count, g->db_origin +28, 4 ); // copy the page count from the header
-	g->page_count = ntohl( g->page_count ); // convert to local format
+	if (g->self_check) {
+		struct selfcheck *c = malloc( sizeof(struct selfcheck) );
 
-	DEBUG fprintf(stdout,"Pagesize: %u, Pagecount: %u\n", g->page_size, g->page_count);
+		if (!c) {
+			fprintf(stderr,"ERROR: Cannot allocate memory for the self check\n");
+			exit(1);
+		}
+		selfcheck_init( c, &(g->opt), g->input_file, stderr );
+		c->grep_file = g->grep_file;
+		c->signatures = g->signatures;
+		result = selfcheck_run( c );
+		selfcheck_close( c );
+		free( c );
+		if ((g->trace_file) && (trace_close())) {
+			fprintf(stderr,"ERROR: Cannot write trace file '%s'\n", g->trace_file);
+			result = 1;
+		}
+		return result;
+	}
 
-	/** 
-	 * Get the free list meta data
-	 *
+	/**
+	 * Rows are gathered up and written with writev, text
+	 * spans going out directly from the mmap'd file where
+	 * they can.  In debug mode we flush on every append so
+	 * the row data stays in sequence with the debug dumps.
 	 */
-	memcpy( &g->freelist_first_page, g->db_origin +32, 4 ); // copy the page count from the header
-	g->freelist_first_page = ntohl( g->freelist_first_page );
-	DEBUG fprintf(stdout,"First page of freelist trunk: %d\n", g->freelist_first_page );
-
-	memcpy( &g->freelist_page_count, g->db_origin +36, 4 ); // copy the page count from the header
-	g->freelist_page_count = ntohl( g->freelist_page_count );
-	DEBUG fprintf(stdout,"Freelist page count: %d\n", g->freelist_page_count );
-
+	g->out = &output;
+	outbuf_init( g->out, STDOUT_FILENO );
+	g->out->unbuffered = g->opt.debug;
 
 	/**
-	 * Get the actual free list pages
-	 *
+	 * Compressed, the flushes just copy in to 1MB blocks, worker
+	 * threads compress them and they're written as they come back.
 	 */
-	if (0) {
-		if (g->freelist_page_count) {
-			g->freelist_pages = malloc( (g->freelist_page_count +1) *sizeof(uint32_t) );
-			if (!g->freelist_pages) {
-				fprintf(stderr,"ERROR: Cannot allocate memory to build page free list\n");
-				exit(1);
-			} else {
-				uint32_t next_page;
-				uint32_t pli;
-
-				next_page = g->freelist_first_page;
-				g->freelist_pages[0] = next_page;
-				g->freelist_pages[1] = 0;
-				pli = 1;
-				if ( pli < g->freelist_page_count ) {
-					do {
-						uint32_t tmp_page, leaf_page_count;
-						char *fp, *current_page_endpoint;
-						uint32_t jump;
-
-						jump = ((next_page-2) *g->page_size);
-						fp = g->db_origin +jump;
-						current_page_endpoint = fp +g->page_size;
-						fprintf(stdout,"Freelist - current trunk page = %d [ offset: %X ]\n", next_page, jump);
-						hdump((unsigned char*)fp, g->page_size, "Current trunk page");
-						DEBUG fflush(stdout);
-
-						memcpy( &tmp_page, fp, sizeof(uint32_t));
-						tmp_page = ntohl(tmp_page);
-						fp += sizeof(uint32_t);
-						DEBUG fprintf(stdout,"Next trunk page (if any): %d\n",tmp_page);
-						DEBUG fflush(stdout);
-
-						memcpy( &leaf_page_count, fp, sizeof(uint32_t));
-						leaf_page_count = ntohl(leaf_page_count);
-						fp += sizeof(uint32_t);
-						DEBUG fprintf(stdout,"Leaf page count: %d\n",leaf_page_count);
-						DEBUG fflush(stdout);
-
-						//while ((pli <= g->freelist_page_count)&&( fp < current_page_endpoint )) {
-						while (( fp < current_page_endpoint )&&( leaf_page_count-- )) {
-							hdump((unsigned char*)fp, 16, "Next free page possible");
-							memcpy( &(g->freelist_pages[pli]), fp, sizeof(uint32_t));
-							g->freelist_pages[pli] = ntohl( g->freelist_pages[pli] );
-							DEBUG fprintf(stdout, "Next free page[%d]: %d\n", pli, g->freelist_pages[pli]);
-							if (g->freelist_pages[pli] == 0) {
-								fprintf(stdout,"End of freelist detected\n");
-								fflush(stdout);
-								break;
-							}
-							fflush(stdout);
-							pli++;
-							fp+= sizeof(uint32_t);
-						}
-
-						next_page = tmp_page;
-					} while (next_page > 0);
-						fprintf(stdout,"Freepages - END\n");
-						fflush(stdout);
-					}
-				} // if there were more than one page
-			}
+	if (g->compress) {
+		int threads = g->compress_threads;
 
+		if (threads < 1) {
+#ifdef _SC_NPROCESSORS_ONLN
+			threads = sysconf( _SC_NPROCESSORS_ONLN );
+#endif
+			if (threads > 8) threads = 8;
 		}
+		g->zip = malloc( sizeof(struct outzip) );
+		if (!g->zip) {
+			fprintf(stderr,"ERROR: Cannot allocate memory for output compression\n");
+			exit(1);
+		}
+		if (outzip_open( g->zip, STDOUT_FILENO, g->compress, g->compress_level, threads )) {
+			fprintf(stderr,"ERROR: %s\n", g->zip->error);
+			exit(1);
+		}
+		g->out->zip = g->zip;
+	}
 
+	/**
+	 * Reordered, the carve writes to a spool and the rows are
+	 * copied out from it in page order at the end.
+	 */
+	if (g->scan_reorder) {
+		g->reorder = malloc( sizeof(struct reorder) );
+		if ((!g->reorder) || (reorder_init( g->reorder ))) exit(1);
+		g->reorder->spool.unbuffered = g->opt.debug;
+	}
 
+	if (g->split_dir) {
+		g->split = malloc( sizeof(struct splitout) );
+		if ((!g->split) || (splitout_init( g->split, g->split_dir, g->split_key, g->split_max_open ))) exit(1);
+		g->split->unbuffered = g->opt.debug;
+	}
 
-		g->db_cfp = g->db_cpp = g->db_origin;
-
-		/*
-			if ((g->freelist_space_only)&&(g->freelist_page_count)) {
-			g->freelist_pages_current_index = 0;
-			data = f+((g->freelist_pages[g->freelist_pages_current_index]-1) *g->page_size);
-			}
-		 */
-
-		DEBUG fprintf(stdout,"%s:%d:DEBUG: Commence decoding data\n", FL );
-		fflush(stdout);
-
-		while (g->db_cfp < g->db_end ) {
-			struct sqlite_leaf_header leaf;
-			int freeblock_mode = 0;
-
-			/* load the next page from the file in to the scratch pad */
-			g->db_cfp = g->db_cpp;
-			g->db_cpp_limit = g->db_cpp +g->page_size ; // was -1 ?
-
-			DEBUG fprintf(stdout,"\n\n%s:%d:-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=START.\n", FL);
-
-			/* process the block, mostly this is just removing any 0-bytes
-				from the block so our strstr() calls aren't prematurely terminated.
-			 */
-			DEBUG {
-				char *p;
-				size_t l;
-				int bc = 0;
-
-				fprintf(stdout,"%s:%d:Dumping main block in RAW... [ Page No: %lu, Offset: %lu (0x%X),  size : %d ]\n"
-						, FL
-						, (long unsigned int)g->page_number
-						, (long unsigned int)(g->db_cpp -g->db_origin)
-						, (unsigned int)(g->db_cpp -g->db_origin)
-						,  g->page_size
-						);
-
-				p = g->db_cfp;
-				l = g->page_size;
-				while (l--) {
-					{ if (isprint(*p)) { fprintf(stdout,"%c", *p); } else fprintf(stdout,"_");}
-					p++;
-					bc++;
-					if (bc%128 == 0) fprintf(stdout,"\n");
-				}
-				fprintf(stdout,"\n");
-				fflush(stdout);
-			} // debug
-
-
-
-			leaf.freeblock_offset = 0;
-			leaf.freeblock_size = 0;
-			leaf.freeblock_next = 0;
-			leaf.page_number = g->page_number;
-
-			/* Decode the page header */
-			if (*(g->db_cfp) == 13) { 
-
-				DEBUG fprintf(stdout,"%s:%d:DEBUG: Decoding page header for page %d\n", FL , g->page_number );
-				fflush(stdout);
-				leaf.page_byte = 13;
-
-				/**
-				 * Get freeblock offset and determine if we have a free block in this
-				 * page that needs to be inspected.  This is one of the more commonly
-				 * needed parts of data for our row recovery 
-				 *
-				 */
-				memcpy( &(leaf.freeblock_offset), (g->db_cfp +1), 2 );
-				leaf.freeblock_offset = ntohs( leaf.freeblock_offset );
-				if (leaf.freeblock_offset > 0) {
-					uint16_t next, sz, off;
-
-					freeblock_mode = 1;
-					off = leaf.freeblock_offset;
-
-					DEBUG fprintf(stdout,"%s:%d:DEBUG: FREEBLOCK mode ON: header decode [offset=%u]\n", FL , leaf.freeblock_offset);
-
-					do {
-						DEBUG hdump((unsigned char *)(g->db_cfp +off), 16, "Freeblock header data");
-
-						memcpy( &next, ( g->db_cfp +off ), 2 );
-						next = ntohs( next );
-						memcpy( &sz, ( g->db_cfp +off +2 ), 2 );
-						sz = ntohs( sz );
-
-						DEBUG fprintf(stdout,"%s:%d:DEBUG: Freeblock size = %u, next position = %u\n", FL, sz, next );
-
-						if (next) off = next;
-					} while (next);
-					DEBUG fprintf(stdout,"%s:%d:DEBUG: END OF FREEBLOCK TRACE\n", FL);
-
-					memcpy( &(leaf.freeblock_next), ( g->db_cfp +leaf.freeblock_offset ), 2 );
-					leaf.freeblock_next = ntohs( leaf.freeblock_next );
-					memcpy( &(leaf.freeblock_size), ( g->db_cfp +leaf.freeblock_offset +2 ), 2 );
-					leaf.freeblock_size = ntohs( leaf.freeblock_size );
-				}
-
-				DEBUG fprintf(stdout,"%s:%d:DEBUG: Freeblock offset = %u, size = %u, next block = %u \n", FL , leaf.freeblock_offset, leaf.freeblock_size, leaf.freeblock_next );
-				if (leaf.freeblock_size > 0) {
-					DEBUG fprintf(stdout,"%s:%d:DEBUG: Freeblock data [ %d bytes total [4 bytes for header] ]\n", FL, leaf.freeblock_size );
-					DEBUG hdump( (unsigned char *)(g->db_cfp +leaf.freeblock_offset+4), leaf.freeblock_size-4, "Actual data in free block" );
-				}
-				fflush(stdout);
-				//				leaf.freeblock_offset = ntohs( ta );
-				leaf.cellcount = ntohs(*(g->db_cfp+3));
-				leaf.cell_offset = ntohs(*(g->db_cfp+5));
-				leaf.freebytes = (*(g->db_cfp+7));
-
-				DEBUG fprintf(stdout,"%s:%d:DEBUG: PAGEHEADER:%d pagebyte: %d, freeblock offset: %d, cell count: %d, first cell offset %d, free bytes %d\n", FL 
-						, leaf.page_number
-						, leaf.page_byte
-						, leaf.freeblock_offset
-						, leaf.cellcount
-						, leaf.cell_offset
-						, leaf.freebytes
-						);
-
-				/**
-				 * If we're wanting free block sourced data, then simply jump
-				 * to the start of the free block space and commence the searching
-				 * in the next section ( find_next_row ).
-				 *
-				 * After this the g->db_cfp pointer should be sitting on the first
-				 * varint of the payload header which defines the header length
-				 * (inclusive)
-				 *
-				 * Detecting rows in the freeblocks is done differently to the 
-				 * normal data, so 
-				 *
-				 */
-				if (g->freelist_space_only) {
-
-					if ((leaf.freeblock_offset > 0) && (leaf.freeblock_size > 0)) {
-
-						DEBUG fprintf(stdout,"%s:%d:DEBUG: Shifting to freespace at %d from page start\n", FL , leaf.freeblock_offset);
-						g->db_cfp = g->db_cfp + leaf.freeblock_offset +4;
-
-						DEBUG fprintf(stdout,"%s:%d:DEBUG: New position = %p\n", FL , g->db_cfp);
-						DEBUG hdump((unsigned char *)g->db_cfp -4,32, "Scratch pointer at freespace data start (including 4 byte header)");
-						DEBUG fflush(stdout);
-					}
-				}
-
-				fflush(stdout);
-			} // if we have a leaf page, which we can decode the header on.
-
-
-
+	u = UNDARK_new( &(g->opt) );
+	if (!u) {
+		fprintf(stderr,"ERROR: Cannot allocate memory for the carving context\n");
+		exit(1);
+	}
 
-			//if ((leaf.page_byte == 13)) {
-			if (1) {
+	if ((g->grep_file) && (UNDARK_grep_load( u, g->grep_file ) != UNDARK_OK)) {
+		fprintf(stderr,"ERROR: %s\n", UNDARK_error( u ));
+		UNDARK_close( u );
+		exit(1);
+	}
 
-				char *row;
-				row = g->db_cfp;
-				DEBUG fprintf(stdout,"%s:%d:DEBUG: g->db_cfp search at = %p\n", FL , g->db_cfp);
-				do {
+	if ((g->signatures) && (UNDARK_signature_add( u, g->signatures ) != UNDARK_OK)) {
+		fprintf(stderr,"ERROR: %s\n", UNDARK_error( u ));
+		UNDARK_close( u );
+		exit(1);
+	}
 
-					if ((row > g->db_origin)&&(row < g->db_end)) {
+	if (UNDARK_open( u, g->input_file ) != UNDARK_OK) {
+		fprintf(stderr,"ERROR: %s\n", UNDARK_error( u ));
+		UNDARK_close( u );
+		exit(1);
+	}
 
-						row = find_next_row( g, row, g->db_cpp_limit, g->db_cfp, freeblock_mode, leaf.freeblock_size );
+	g->text_encoding = UNDARK_text_encoding( u );
+	g->text_by_reference = UNDARK_image_mapped( u );
+	VERBOSE fprintf(stderr,"Text encoding: %s\n", (g->text_encoding == UNDARK_TEXT_UTF8) ? "UTF-8" : (g->text_encoding == UNDARK_TEXT_UTF16LE) ? "UTF-16le" : "UTF-16be");
 
-						//if (row > g->db_end) fprintf(stdout,"ERROR: beyond end point\n");
-						if (row > g->db_cpp_limit) fprintf(stdout,"ERROR: beyond end point\n");
-						if (row < g->db_cfp) DEBUG fprintf(stdout,"%s:%d:DEBUG: Row location not in g->db_cfp page\n", FL );
-						if (row == NULL) DEBUG fprintf(stdout,"%s:%d:DEBUG: Row has been returned as NULL\n", FL );
-						DEBUG fprintf(stdout,"%s:%d:DEBUG: ROW found at offset: %ld\n", FL, row-g->db_cfp);
-					} else {
+	if ((g->baseline) && (UNDARK_baseline( u, g->baseline ) != UNDARK_OK)) {
+		fprintf(stderr,"ERROR: %s\n", UNDARK_error( u ));
+		UNDARK_close( u );
+		exit(1);
+	}
 
-						break;
-					}
+	if ((g->dedup) && (UNDARK_dedup_pages( u, g->dedup_table ) != UNDARK_OK)) {
+		fprintf(stderr,"ERROR: %s\n", UNDARK_error( u ));
+		UNDARK_close( u );
+		exit(1);
+	}
 
-				} while (row && (row < g->db_cpp_limit ));
-				//} while (row && (row < g->db_cpp_limit ) && (row < g->db_end) );
+	if ((g->write_index) && (UNDARK_index_write( u, g->write_index ) != UNDARK_OK)) {
+		fprintf(stderr,"ERROR: %s\n", UNDARK_error( u ));
+		UNDARK_close( u );
+		exit(1);
+	}
 
-				DEBUG fprintf(stdout,"%s:%d:DEBUG: Finished searching for rows in DB page %d\n", FL , g->page_number);
+	/**
+	 * Triage, a sample of pages is carved and the rows only counted
+	 */
+	if (g->estimate) {
+		struct undark_estimate e;
+
+		result = UNDARK_estimate( u, g->estimate, &e );
+		if (result == UNDARK_ERROR) fprintf(stderr,"ERROR: %s\n", UNDARK_error( u ));
+		else estimate_report( &e, stdout );
+		if (g->show_stats) UNDARK_stats( u, stderr );
+		UNDARK_close( u );
+		if ((g->trace_file) && (trace_close())) {
+			fprintf(stderr,"ERROR: Cannot write trace file '%s'\n", g->trace_file);
+			result = UNDARK_ERROR;
 		}
+		return (result == UNDARK_ERROR) ? 1 : 0;
+	}
 
-		/**
-		 * NOTE: Free #pages# are different to freeblocks within a page
-		 *
-		 *
-		 if ((g->freelist_space_only)&&(g->freelist_page_count)) {
-		 g->freelist_pages_current_index++;
-		 if (g->freelist_pages_current_index > g->freelist_page_count) {
-		 DEBUG fprintf(stdout,"%s:%d:DEBUG:Out of freespace pages, exiting search\n", FL );
-		 break;
-		 }
-		 data = f+((g->freelist_pages[g->freelist_pages_current_index] -1) *g->page_size);
-		 } else {
-		 */
-		{
-			g->db_cpp += g->page_size;
-			g->page_number++;
+	/**
+	 * From an index only the records it lists are decoded, the
+	 * rest of the image isn't searched at all.
+	 */
+	t = trace_start( TRACE_ALWAYS );
+	if (g->from_index) result = UNDARK_carve_index( u, g->from_index, dump_row, g );
+	else result = UNDARK_carve( u, dump_row, g );
+	if ((g->reorder) && (reorder_write( g->reorder, g->out ))) result = UNDARK_ERROR;
+	outbuf_flush( g->out );
+	if (t) trace_span( t, "carve", "carve", NULL );
+	if (result == UNDARK_ERROR) fprintf(stderr,"ERROR: %s\n", UNDARK_error( u ));
+	if (g->zip) {
+		if ((outzip_close( g->zip )) && (!g->out->failed)) {
+			fprintf(stderr,"ERROR: %s\n", g->zip->error);
+			result = UNDARK_ERROR;
 		}
+		if (g->out->failed) result = UNDARK_ERROR;
+	}
 
-	} // while (data < endpoint)
+	if (g->show_stats) {
+		UNDARK_stats( u, stderr );
+		if (g->split) splitout_stats( g->split, stderr );
+		if (g->zip) {
+			fprintf(stderr,"output-compress: %s level %d, %d threads, %llu bytes in, %llu bytes out, %llu frames\n"
+					, (g->compress == OUTZIP_GZIP) ? "gzip" : "zstd", g->compress_level, g->zip->threads
+					, (unsigned long long)g->zip->bytes_in, (unsigned long long)g->zip->bytes_out
+					, (unsigned long long)g->zip->frame_count);
+		}
+	}
+	if (g->zip) free(g->zip);
+	if (g->reorder) {
+		reorder_close( g->reorder );
+		free( g->reorder );
+	}
+	if (g->split) {
+		splitout_close( g->split );
+		free( g->split );
+	}
+	UNDARK_close( u );
+	if (g->text) free(g->text);
 
-	close(fd);
+	/* last, every thread that could add to it has been joined */
+	if ((g->trace_file) && (trace_close())) {
+		fprintf(stderr,"ERROR: Cannot write trace file '%s'\n", g->trace_file);
+		result = UNDARK_ERROR;
+	}
 
-	return 0;
-		}
+	return ((result == UNDARK_ERROR) || (g->split_failed)) ? 1 : 0;
+}
 
 
-		/** END **/
+/** END **/
@@ -7,28 +7,30 @@
 #include "varint.h"
 
 int varint_decode(uint64_t *result, char *varint_p, char **end) {
-	char *p;
-	int shift;
+	unsigned char *p;
 	int length;
 	uint64_t value;
 
-	p = varint_p;
+	p = (unsigned char *)varint_p;
 	length = 0;
 	value = 0;
-	shift = 0;
 	for (;;) {
-		value <<= shift;
-		value |= ((*p & 0x7f));
+		value = (value << 7) | (*p & 0x7f);
 		length++;
 		if ((*p & 0x80) == 0x0) {
 			break;
 		}
 		p++;
-		shift += 7;
+		if (length == 8) {
+			/* the ninth byte gives all 8 of its bits */
+			value = (value << 8) | *p;
+			length++;
+			break;
+		}
 	}
 
 	if (end != NULL) {
-		*end = ++p;
+		*end = (char *)++p;
 	}
 
 	*result = value;
@@ -37,3 +39,103 @@ int varint_decode(uint64_t *result, char *varint_p, char **end) {
 }
 
 
+
+
+int varint_map_init( struct varint_map *m ) {
+	memset(m, 0, sizeof(struct varint_map));
+
+	return 0;
+}
+
+
+
+
+/*-----------------------------------------------------------------\
+  Date Code:	: 20261018-163012
+  Function Name	: varint_map_build
+  Returns Type	: int
+  ----Parameter List
+  1. struct varint_map *m,
+  2.  char *p,
+  3.  size_t l ,
+  ------------------
+  Exit Codes	: 1 if we're out of memory, the map is left empty
+  Side Effects	:
+  --------------------------------------------------------------------
+Comments:
+
+Maps the l bytes at p.  Working back from the end, a byte without
+the high bit is a varint by itself, one with it is that byte in
+front of the varint at the next offset, so long as that's under
+8 bytes ( at 9 the last byte carries 8 bits, not 7, the few of
+those are decoded the slow way ).  Varints running off the end of
+the range get length 0, nothing past p +l is read here.
+
+--------------------------------------------------------------------
+Changes:
+
+\------------------------------------------------------------------*/
+int varint_map_build( struct varint_map *m, char *p, size_t l ) {
+	unsigned char *b = (unsigned char *)p;
+	size_t i;
+
+	varint_map_clear( m );
+	if (l == 0) return 0;
+
+	if (l > m->allocated) {
+		uint8_t *length = realloc( m->length, l );
+		uint64_t *value;
+
+		if (length) m->length = length;
+		value = realloc( m->value, l *sizeof(uint64_t) );
+		if (value) m->value = value;
+		if ((!length) || (!value)) return 1;
+		m->allocated = l;
+	}
+
+	i = l;
+	while (i--) {
+		if (b[i] < 0x80) {
+			m->length[i] = 1;
+			m->value[i] = b[i];
+		} else if ((i +1 == l) || (m->length[i +1] == 0)) {
+			m->length[i] = 0;
+		} else if (m->length[i +1] < 8) {
+			m->value[i] = ((uint64_t)(b[i] & 0x7f) << (7 *m->length[i +1])) | m->value[i +1];
+			m->length[i] = m->length[i +1] +1;
+		} else if (i +9 <= l) {
+			m->length[i] = varint_decode( &(m->value[i]), p +i, NULL );
+		} else {
+			m->length[i] = 0;
+		}
+	}
+
+	m->base = p;
+	m->end = p +l;
+
+	return 0;
+}
+
+
+
+
+/**
+ * Empties the map, every lookup goes to varint_decode() until the
+ * next build.
+ */
+int varint_map_clear( struct varint_map *m ) {
+	m->base = m->end = NULL;
+
+	return 0;
+}
+
+
+
+
+int varint_map_free( struct varint_map *m ) {
+	if (m->length) free(m->length);
+	if (m->value) free(m->value);
+	memset(m, 0, sizeof(struct varint_map));
+
+	return 0;
+}
@@ -1,2 +1,44 @@
+#ifndef UNDARK_VARINT_H
+#define UNDARK_VARINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
 int varint_decode(uint64_t *result, char *varint_p, char **end);
 
+/**
+ * The varint starting at every offset of a page, for --fine-search.
+ *
+ * A byte by byte search tries a record at each offset, so each
+ * varint in the page would otherwise be decoded again from every
+ * start that runs in to it.  varint_map_build() does them all in one
+ * pass from the end of the range back, each offset's varint being
+ * its own byte in front of the one at the next offset.  Lookups
+ * outside [base, end), or running past it, fall back to
+ * varint_decode().
+ */
+struct varint_map {
+	char *base, *end;
+	uint8_t *length; // bytes in the varint at each offset, 1..9, 0 if it runs past end
+	uint64_t *value;
+	size_t allocated;
+};
+
+int varint_map_init( struct varint_map *m );
+int varint_map_build( struct varint_map *m, char *p, size_t l );
+int varint_map_clear( struct varint_map *m );
+int varint_map_free( struct varint_map *m );
+
+static inline int varint_map_decode( struct varint_map *m, uint64_t *result, char *p, char **end ) {
+	if ((p >= m->base) && (p < m->end) && (m->length[p -m->base])) {
+		size_t i = p -m->base;
+
+		*result = m->value[i];
+		if (end) *end = p +m->length[i];
+		return m->length[i];
+	}
+
+	return varint_decode( result, p, end );
+}
+
+#endif